@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/logging.h>
+#include <android/os/IServiceManager.h>
+#include <benchmark/benchmark.h>
+#include <binder/Binder.h>
+#include <binder/IServiceManager.h>
+#include <binder/ProcessState.h>
+
+#include "Access.h"
+#include "ServiceManager.h"
+
+// Usage: atest servicemanager_benchmark
+
+using android::Access;
+using android::BBinder;
+using android::IBinder;
+using android::IInterface;
+using android::interface_cast;
+using android::ProcessState;
+using android::ServiceManager;
+using android::sp;
+using android::String16;
+
+class PermissiveAccess : public Access {
+public:
+    CallingContext getCallingContext() override { return {}; }
+    bool canFind(const CallingContext&, const std::string&) override { return true; }
+    bool canAdd(const CallingContext&, const std::string&) override { return true; }
+    bool canList(const CallingContext&) override { return true; }
+};
+
+class LinkableBinder : public BBinder {
+    android::status_t linkToDeath(const sp<DeathRecipient>&, void*, uint32_t) override {
+        // let SM linkToDeath
+        return android::OK;
+    }
+};
+
+// Lookups in a servicemanager with as many services as a booted device, in
+// this process. This is only the cost of finding the service.
+static void BM_checkServiceInProcess(benchmark::State& state) {
+    const size_t services = state.range(0);
+    auto sm = sp<ServiceManager>::make(std::make_unique<PermissiveAccess>());
+    std::vector<std::string> names;
+    for (size_t i = 0; i < services; i++) {
+        names.push_back("benchmark_service_" + std::to_string(i));
+        CHECK(sm->addService(names.back(), sp<LinkableBinder>::make(), false /*allowIsolated*/,
+                             android::os::IServiceManager::DUMP_FLAG_PRIORITY_DEFAULT)
+                      .isOk());
+    }
+
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        sp<IBinder> out;
+        CHECK(sm->checkService(names[i++ % names.size()], &out).isOk());
+        benchmark::DoNotOptimize(out);
+    }
+    state.SetItemsProcessed(state.iterations());
+    sm->clear();
+}
+BENCHMARK(BM_checkServiceInProcess)->Arg(64)->Arg(512)->Arg(4096);
+
+// Lookups which always go to servicemanager, as happens the first time a
+// process looks up a service.
+static void BM_checkServiceCold(benchmark::State& state) {
+    sp<android::os::IServiceManager> sm = interface_cast<android::os::IServiceManager>(
+            IInterface::asBinder(android::defaultServiceManager()));
+    while (state.KeepRunning()) {
+        sp<IBinder> out;
+        CHECK(sm->checkService("manager", &out).isOk());
+        benchmark::DoNotOptimize(out);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_checkServiceCold);
+
+// Repeated lookups of a service this process holds, which hit its cache.
+static void BM_checkServiceWarm(benchmark::State& state) {
+    sp<android::IServiceManager> sm = android::defaultServiceManager();
+    sp<IBinder> held = sm->checkService(String16("manager"));
+    CHECK(held != nullptr);
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(sm->checkService(String16("manager")));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_checkServiceWarm);
+
+int main(int argc, char** argv) {
+    ::benchmark::Initialize(&argc, argv);
+    if (::benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+
+    // the lookup cache needs a threadpool to be kept up to date
+    ProcessState::self()->startThreadPool();
+
+    ::benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
@@ -58,6 +58,14 @@ public:
     [[nodiscard]] status_t triggerablePoll(const android::RpcTransportFd& transportFd,
                                            int16_t event);
 
+#ifndef BINDER_RPC_SINGLE_THREADED
+    /**
+     * The read end of the pipe, which gets POLLHUP once this is triggered. For
+     * callers waiting on this along with other fds, e.g. with epoll.
+     */
+    [[nodiscard]] int readFd() const { return mRead.get(); }
+#endif
+
 private:
 #ifdef BINDER_RPC_SINGLE_THREADED
     bool mTriggered = false;
@@ -21,6 +21,8 @@
 #include <inttypes.h>
 #include <unistd.h>
 
+#include <unordered_map>
+
 #include <android-base/properties.h>
 #include <android/os/BnServiceCallback.h>
 #include <android/os/IServiceManager.h>
@@ -134,6 +136,122 @@ protected:
     virtual Status realGetService(const std::string& name, sp<IBinder>* _aidl_return) {
         return mTheRealServiceManager->getService(name, _aidl_return);
     }
+
+private:
+    class ServiceCache;
+    sp<ServiceCache> mServiceCache;
+};
+
+// Results of checkService, so that looking up a service again doesn't need a
+// transaction to servicemanager. A name is only cached once this process is
+// registered for notifications about it, which update the entry whenever the
+// service is added again, and entries are dropped when their binder dies.
+// Both need a threadpool, so nothing is cached until one is started.
+//
+// Each registration is a callback which servicemanager holds on to for the
+// lifetime of this process, so a name is only registered once it is looked
+// up a second time, and at most kMaxRegistrations names are registered.
+//
+// Entries are weak, so that this doesn't keep lazy services alive. Lookups
+// only hit while something else in this process still holds the service.
+class ServiceManagerShim::ServiceCache : public android::os::BnServiceCallback,
+                                         public IBinder::DeathRecipient {
+public:
+    explicit ServiceCache(const sp<AidlServiceManager>& sm) : mTheRealServiceManager(sm) {}
+
+    sp<IBinder> get(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mLock);
+        auto it = mEntries.find(name);
+        if (it == mEntries.end()) return nullptr;
+        return it->second.promote();
+    }
+
+    // Called with the result of looking up |name| from servicemanager.
+    void put(const std::string& name, const sp<IBinder>& binder) {
+        if (binder == nullptr) return;
+        if (ProcessState::self()->getThreadPoolMaxTotalThreadCount() == 0) return;
+
+        if (!registerForNotifications(name)) return;
+        // the notification is never older than a lookup, so it wins
+        update(name, binder, false /*replace*/);
+    }
+
+    Status onRegistration(const std::string& name, const sp<IBinder>& binder) override {
+        if (binder != nullptr) update(name, binder, true /*replace*/);
+        return Status::ok();
+    }
+
+    void binderDied(const wp<IBinder>& who) override {
+        std::lock_guard<std::mutex> lock(mLock);
+        for (auto it = mEntries.begin(); it != mEntries.end();) {
+            if (it->second.unsafe_get() == who.unsafe_get()) {
+                it = mEntries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+private:
+    static constexpr size_t kMaxRegistrations = 32;
+
+    enum class Registration { LOOKED_UP, PENDING, REGISTERED, FAILED };
+
+    // Returns whether entries for |name| are kept up to date.
+    bool registerForNotifications(const std::string& name) {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            auto [it, inserted] = mRegistrations.try_emplace(name, Registration::LOOKED_UP);
+            if (inserted) return false;
+            if (it->second != Registration::LOOKED_UP) {
+                return it->second == Registration::REGISTERED;
+            }
+            if (mRegistrationCount >= kMaxRegistrations) return false;
+            it->second = Registration::PENDING;
+            mRegistrationCount++;
+        }
+
+        // servicemanager also immediately calls back with the current binder
+        Status status = mTheRealServiceManager->registerForNotifications(name,
+                                                                         sp<ServiceCache>::fromExisting(
+                                                                                 this));
+        if (!status.isOk()) {
+            // e.g. not allowed to find this service, or an isolated process,
+            // so this name is never cached
+            ALOGV("Not caching %s: %s", name.c_str(), status.toString8().c_str());
+        }
+
+        std::lock_guard<std::mutex> lock(mLock);
+        mRegistrations[name] = status.isOk() ? Registration::REGISTERED : Registration::FAILED;
+        if (!status.isOk()) mRegistrationCount--;
+        return status.isOk();
+    }
+
+    void update(const std::string& name, const sp<IBinder>& binder, bool replace) {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            auto [it, inserted] = mEntries.try_emplace(name, binder);
+            if (!inserted) {
+                sp<IBinder> existing = it->second.promote();
+                if (existing == binder || (!replace && existing != nullptr)) return;
+                it->second = binder;
+            }
+        }
+        // local binders never die, and linking remote ones that are already
+        // dead fails, in which case the entry must not stay around
+        if (binder->remoteBinder() == nullptr) return;
+        if (binder->linkToDeath(sp<ServiceCache>::fromExisting(this)) != OK) {
+            binderDied(wp<IBinder>(binder));
+        }
+    }
+
+    const sp<AidlServiceManager> mTheRealServiceManager;
+
+    std::mutex mLock; // for below
+    std::unordered_map<std::string, wp<IBinder>> mEntries;
+    std::unordered_map<std::string, Registration> mRegistrations;
+    // names which are PENDING or REGISTERED
+    size_t mRegistrationCount = 0;
 };
 
 [[clang::no_destroy]] static std::once_flag gSmOnce;
@@ -264,7 +382,7 @@ bool checkPermission(const String16& permission, pid_t pid, uid_t uid, bool logP
 // ----------------------------------------------------------------------
 
 ServiceManagerShim::ServiceManagerShim(const sp<AidlServiceManager>& impl)
- : mTheRealServiceManager(impl)
+ : mTheRealServiceManager(impl), mServiceCache(sp<ServiceCache>::make(impl))
 {}
 
 // This implementation could be simplified and made more efficient by delegating
@@ -317,10 +435,16 @@ sp<IBinder> ServiceManagerShim::getService(const String16& name) const
 
 sp<IBinder> ServiceManagerShim::checkService(const String16& name) const
 {
+    const std::string nameStr = String8(name).c_str();
+    if (sp<IBinder> cached = mServiceCache->get(nameStr); cached != nullptr) {
+        return cached;
+    }
+
     sp<IBinder> ret;
-    if (!mTheRealServiceManager->checkService(String8(name).c_str(), &ret).isOk()) {
+    if (!mTheRealServiceManager->checkService(nameStr, &ret).isOk()) {
         return nullptr;
     }
+    mServiceCache->put(nameStr, ret);
     return ret;
 }
 
@@ -377,6 +501,10 @@ sp<IBinder> ServiceManagerShim::waitForService(const String16& name16)
 
     const std::string name = String8(name16).c_str();
 
+    if (sp<IBinder> cached = mServiceCache->get(name); cached != nullptr) {
+        return cached;
+    }
+
     sp<IBinder> out;
     if (Status status = realGetService(name, &out); !status.isOk()) {
         ALOGW("Failed to getService in waitForService for %s: %s", name.c_str(),
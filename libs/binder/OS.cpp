@@ -20,6 +20,8 @@
 #include <binder/RpcTransportRaw.h>
 #include <log/log.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 using android::base::ErrnoError;
 using android::base::Result;
@@ -162,4 +164,51 @@ ssize_t receiveMessageFromSocket(
     return TEMP_FAILURE_RETRY(recvmsg(socket.fd.get(), &msg, MSG_NOSIGNAL));
 }
 
+status_t createSealedDataFd(const void* data, size_t size, base::unique_fd* outFd) {
+    base::unique_fd fd(memfd_create("binder_rpc_data", MFD_CLOEXEC | MFD_ALLOW_SEALING));
+    if (!fd.ok()) {
+        return -errno;
+    }
+    if (!base::WriteFully(fd, data, size)) {
+        return -errno;
+    }
+    if (TEMP_FAILURE_RETRY(fcntl(fd.get(), F_ADD_SEALS,
+                                 F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL)) != 0) {
+        return -errno;
+    }
+    *outFd = std::move(fd);
+    return OK;
+}
+
+status_t mapSealedDataFd(base::borrowed_fd fd, size_t size, const uint8_t** outData) {
+    // Without these, the sender could change or truncate the data while it is
+    // being read.
+    constexpr int kRequiredSeals = F_SEAL_SHRINK | F_SEAL_WRITE;
+    int seals = TEMP_FAILURE_RETRY(fcntl(fd.get(), F_GET_SEALS));
+    if (seals < 0 || (seals & kRequiredSeals) != kRequiredSeals) {
+        return BAD_VALUE;
+    }
+
+    struct stat st;
+    if (fstat(fd.get(), &st) != 0) {
+        return -errno;
+    }
+    if (size == 0 || st.st_size < 0 || static_cast<uint64_t>(st.st_size) != size) {
+        return BAD_VALUE;
+    }
+
+    void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd.get(), 0);
+    if (addr == MAP_FAILED) {
+        return -errno;
+    }
+    *outData = static_cast<const uint8_t*>(addr);
+    return OK;
+}
+
+void unmapSealedData(const uint8_t* data, size_t size) {
+    if (munmap(const_cast<uint8_t*>(data), size) != 0) {
+        ALOGE("Failed to unmap RPC data: %s", strerror(errno));
+    }
+}
+
 } // namespace android
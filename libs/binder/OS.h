@@ -41,4 +41,14 @@ ssize_t receiveMessageFromSocket(
         const RpcTransportFd& socket, iovec* iovs, int niovs,
         std::vector<std::variant<base::unique_fd, base::borrowed_fd>>* ancillaryFds);
 
+// Copies |size| bytes of |data| into a new memfd, which is sealed so that it can
+// no longer be written to or resized.
+status_t createSealedDataFd(const void* data, size_t size, base::unique_fd* outFd);
+
+// Maps a memfd created by createSealedDataFd read-only. Fails unless it is
+// sealed and exactly |size| bytes long. Release with unmapSealedData.
+status_t mapSealedDataFd(base::borrowed_fd fd, size_t size, const uint8_t** outData);
+
+void unmapSealedData(const uint8_t* data, size_t size);
+
 } // namespace android
@@ -103,6 +103,85 @@ static_assert(sizeof(Parcel) == 60);
 static std::atomic<size_t> gParcelGlobalAllocCount;
 static std::atomic<size_t> gParcelGlobalAllocSize;
 
+// Since the layout of Parcel can't change (see above), small data buffers can't
+// be stored inline. Instead, they are recycled through a small per-thread
+// cache, so that the common case of a Parcel of a few hundred bytes which is
+// created and destroyed on the same thread doesn't hit the allocator. Cached
+// buffers are regular malloc allocations, so they can still be realloc'd and
+// freed like any other Parcel data.
+constexpr size_t kParcelBufferCacheMaxCapacity = 2048;
+constexpr size_t kParcelBufferCacheEntries = 4;
+
+namespace {
+struct ParcelBufferCache {
+    struct Entry {
+        uint8_t* data = nullptr;
+        size_t capacity = 0;
+    };
+    Entry entries[kParcelBufferCacheEntries];
+    size_t size = 0;
+
+    ~ParcelBufferCache();
+};
+} // namespace
+
+// Parcels may still be allocated or freed by other thread exit handlers (for
+// instance, IPCThreadState's) after the cache is destroyed, so those bypass it.
+// This is trivially destructible, so it can still be read then.
+#ifdef BINDER_RPC_SINGLE_THREADED
+static ParcelBufferCache gParcelBufferCache;
+static bool gParcelBufferCacheDestroyed = false;
+#else
+static thread_local ParcelBufferCache gParcelBufferCache;
+static thread_local bool gParcelBufferCacheDestroyed = false;
+#endif
+
+ParcelBufferCache::~ParcelBufferCache() {
+    gParcelBufferCacheDestroyed = true;
+    for (size_t i = 0; i < size; i++) free(entries[i].data);
+    size = 0;
+}
+
+// Returns a buffer of at least |desired| bytes, and its actual capacity.
+static uint8_t* parcelBufferAlloc(size_t desired, size_t* outCapacity) {
+    if (gParcelBufferCacheDestroyed) {
+        *outCapacity = desired;
+        return static_cast<uint8_t*>(malloc(desired));
+    }
+
+    ParcelBufferCache& cache = gParcelBufferCache;
+    size_t best = cache.size;
+    for (size_t i = 0; desired > 0 && i < cache.size; i++) {
+        if (cache.entries[i].capacity >= desired &&
+            (best == cache.size || cache.entries[i].capacity < cache.entries[best].capacity)) {
+            best = i;
+        }
+    }
+    if (best != cache.size) {
+        uint8_t* data = cache.entries[best].data;
+        *outCapacity = cache.entries[best].capacity;
+        cache.entries[best] = cache.entries[--cache.size];
+        return data;
+    }
+
+    *outCapacity = desired;
+    return static_cast<uint8_t*>(malloc(desired));
+}
+
+// Frees a buffer from parcelBufferAlloc or malloc. Contents must already be
+// zeroed if required.
+static void parcelBufferFree(uint8_t* data, size_t capacity) {
+    if (data != nullptr && capacity > 0 && capacity <= kParcelBufferCacheMaxCapacity &&
+        !gParcelBufferCacheDestroyed) {
+        ParcelBufferCache& cache = gParcelBufferCache;
+        if (cache.size < kParcelBufferCacheEntries) {
+            cache.entries[cache.size++] = {.data = data, .capacity = capacity};
+            return;
+        }
+    }
+    free(data);
+}
+
 // Maximum number of file descriptors per Parcel.
 constexpr size_t kMaxFds = 1024;
 
@@ -2755,7 +2834,7 @@ void Parcel::freeDataNoInit()
             if (mDeallocZero) {
                 zeroMemory(mData, mDataSize);
             }
-            free(mData);
+            parcelBufferFree(mData, mDataCapacity);
         }
         auto* kernelFields = maybeKernelFields();
         if (kernelFields && kernelFields->mObjects) free(kernelFields->mObjects);
@@ -2994,16 +3073,30 @@ status_t Parcel::continueWrite(size_t desired)
             }
         }
 
-        // We own the data, so we can just do a realloc().
+        // We own the data, so we can just do a realloc(), unless the new size is
+        // small enough to come from the buffer cache.
         if (desired > mDataCapacity) {
-            uint8_t* data = reallocZeroFree(mData, mDataCapacity, desired, mDeallocZero);
+            uint8_t* data;
+            size_t capacity = desired;
+            if (desired <= kParcelBufferCacheMaxCapacity) {
+                data = parcelBufferAlloc(desired, &capacity);
+                if (data) {
+                    memcpy(data, mData, mDataSize);
+                    if (mDeallocZero) {
+                        zeroMemory(mData, mDataSize);
+                    }
+                    parcelBufferFree(mData, mDataCapacity);
+                }
+            } else {
+                data = reallocZeroFree(mData, mDataCapacity, desired, mDeallocZero);
+            }
             if (data) {
                 LOG_ALLOC("Parcel %p: continue from %zu to %zu capacity", this, mDataCapacity,
-                        desired);
-                gParcelGlobalAllocSize += desired;
+                        capacity);
+                gParcelGlobalAllocSize += capacity;
                 gParcelGlobalAllocSize -= mDataCapacity;
                 mData = data;
-                mDataCapacity = desired;
+                mDataCapacity = capacity;
             } else {
                 mError = NO_MEMORY;
                 return NO_MEMORY;
@@ -3021,7 +3114,8 @@ status_t Parcel::continueWrite(size_t desired)
 
     } else {
         // This is the first data.  Easy!
-        uint8_t* data = (uint8_t*)malloc(desired);
+        size_t capacity;
+        uint8_t* data = parcelBufferAlloc(desired, &capacity);
         if (!data) {
             mError = NO_MEMORY;
             return NO_MEMORY;
@@ -3035,15 +3129,15 @@ status_t Parcel::continueWrite(size_t desired)
                   kernelFields ? kernelFields->mObjectsCapacity : 0, desired);
         }
 
-        LOG_ALLOC("Parcel %p: allocating with %zu capacity", this, desired);
-        gParcelGlobalAllocSize += desired;
+        LOG_ALLOC("Parcel %p: allocating with %zu capacity", this, capacity);
+        gParcelGlobalAllocSize += capacity;
         gParcelGlobalAllocCount++;
 
         mData = data;
         mDataSize = mDataPos = 0;
         ALOGV("continueWrite Setting data size of %p to %zu", this, mDataSize);
         ALOGV("continueWrite Setting data pos of %p to %zu", this, mDataPos);
-        mDataCapacity = desired;
+        mDataCapacity = capacity;
     }
 
     return NO_ERROR;
@@ -21,10 +21,15 @@
 #include <sys/socket.h>
 #include <sys/un.h>
 
+#ifndef BINDER_RPC_SINGLE_THREADED
+#include <sys/epoll.h>
+#endif
+
 #include <thread>
 #include <vector>
 
 #include <android-base/hex.h>
+#include <android-base/macros.h>
 #include <android-base/scopeguard.h>
 #include <binder/Parcel.h>
 #include <binder/RpcServer.h>
@@ -48,6 +53,295 @@ constexpr size_t kSessionIdBytes = 32;
 using base::ScopeGuard;
 using base::unique_fd;
 
+#ifndef BINDER_RPC_SINGLE_THREADED
+// Serves incoming connections of all sessions with a fixed set of worker
+// threads, see RpcServer::setEventLoopThreads.
+//
+// Each connection is in the epoll set with EPOLLONESHOT, so exactly one worker
+// wakes up once a command starts arriving. That worker reads and executes
+// commands until no more data is pending, and then re-arms the connection.
+// A worker waits at most kFrameTimeout for the rest of a command which has
+// started arriving, so that a peer which stops sending in the middle of one
+// only loses its session rather than taking a worker with it.
+// Each session's shutdown trigger is also in the set, so that idle connections
+// are dropped when the session shuts down, same as the blocked reads of a
+// thread per connection would be interrupted.
+class RpcServer::EventLoop {
+public:
+    static std::shared_ptr<EventLoop> make(size_t threads, FdTrigger* shutdownTrigger) {
+        unique_fd epollFd(epoll_create1(EPOLL_CLOEXEC));
+        if (!epollFd.ok()) {
+            ALOGE("Could not create epoll fd: %s", strerror(errno));
+            return nullptr;
+        }
+        // level-triggered, so that every worker sees it
+        if (status_t status = watch(epollFd, EPOLL_CTL_ADD, shutdownTrigger->readFd(),
+                                    kShutdownId, EPOLLIN);
+            status != OK) {
+            return nullptr;
+        }
+
+        std::shared_ptr<EventLoop> loop(new EventLoop(std::move(epollFd)));
+        for (size_t i = 0; i < threads; i++) {
+            loop->mWorkers.emplace_back(&EventLoop::workerLoop, loop.get());
+        }
+        return loop;
+    }
+
+    // Starts serving |connection|. If this fails, the caller is still
+    // responsible for cleaning up the connection.
+    [[nodiscard]] bool add(const sp<RpcSession>& session,
+                           const sp<RpcSession::RpcConnection>& connection, int fd) {
+        // set to the thread which set up the connection until now
+        session->clearConnectionTid(connection);
+
+        RpcMutexLockGuard _l(mLock);
+        if (mStopped) return false;
+
+        auto [sessionIt, newSession] = mSessions.try_emplace(session.get());
+        SessionEntry& entry = sessionIt->second;
+        if (newSession) {
+            entry.triggerId = mNextId++;
+            if (OK !=
+                watch(mEpollFd, EPOLL_CTL_ADD, session->mShutdownTrigger->readFd(),
+                      entry.triggerId, EPOLLIN | EPOLLONESHOT)) {
+                mSessions.erase(sessionIt);
+                return false;
+            }
+            mSessionTriggers[entry.triggerId] = session;
+        } else if (entry.shutdown) {
+            return false;
+        }
+
+        uint64_t id = mNextId++;
+        if (OK != watch(mEpollFd, EPOLL_CTL_ADD, fd, id, EPOLLIN | EPOLLONESHOT)) {
+            if (entry.connections == 0) eraseSessionLocked(sessionIt);
+            return false;
+        }
+        entry.connections++;
+        mConnections[id] = ConnectionEntry{
+                .session = session,
+                .connection = connection,
+                .fd = fd,
+        };
+        return true;
+    }
+
+    // Waits for the workers, which exit once the server's shutdown trigger
+    // fires, and then drops all connections which are left.
+    void join() {
+        for (auto& worker : mWorkers) {
+            worker.join();
+        }
+        mWorkers.clear();
+
+        std::map<uint64_t, ConnectionEntry> connections;
+        {
+            RpcMutexLockGuard _l(mLock);
+            mStopped = true;
+            connections = std::move(mConnections);
+            mConnections.clear();
+            mSessions.clear();
+            mSessionTriggers.clear();
+        }
+        for (auto& [id, entry] : connections) {
+            (void)id;
+            RpcSession::postJoinCleanup(std::move(entry.session), entry.connection);
+        }
+    }
+
+private:
+    static constexpr uint64_t kShutdownId = 0;
+    static constexpr std::chrono::seconds kFrameTimeout{10};
+
+    struct ConnectionEntry {
+        sp<RpcSession> session;
+        sp<RpcSession::RpcConnection> connection;
+        int fd;
+        // whether a worker is executing commands from this connection
+        bool busy = false;
+    };
+
+    struct SessionEntry {
+        uint64_t triggerId = 0;
+        size_t connections = 0;
+        // the session's shutdown trigger fired
+        bool shutdown = false;
+    };
+
+    explicit EventLoop(unique_fd epollFd) : mEpollFd(std::move(epollFd)) {}
+
+    static status_t watch(const unique_fd& epollFd, int op, int fd, uint64_t id, uint32_t events) {
+        epoll_event event{};
+        event.events = events;
+        event.data.u64 = id;
+        if (0 != epoll_ctl(epollFd.get(), op, fd, &event)) {
+            int savedErrno = errno;
+            ALOGE("Could not update epoll set for fd %d: %s", fd, strerror(savedErrno));
+            return -savedErrno;
+        }
+        return OK;
+    }
+
+    // Waits for more data of a command on |fd|, which must arrive by
+    // |deadline|. Interrupted by |triggerFd|, the session's shutdown trigger.
+    static status_t waitForFrame(int fd, int triggerFd,
+                                 std::chrono::steady_clock::time_point deadline) {
+        auto remaining = std::chrono::ceil<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now());
+        pollfd pfd[]{
+                {.fd = fd, .events = POLLIN, .revents = 0},
+                {.fd = triggerFd, .events = 0, .revents = 0},
+        };
+        int ret = 0;
+        if (remaining.count() > 0) {
+            ret = TEMP_FAILURE_RETRY(
+                    poll(pfd, arraysize(pfd), static_cast<int>(remaining.count())));
+        }
+        if (ret < 0) return -errno;
+        if (ret == 0) {
+            ALOGE("Timed out waiting for the rest of a command on fd %d, dropping session", fd);
+            return TIMED_OUT;
+        }
+        if (pfd[1].revents != 0) return DEAD_OBJECT;
+        // data, or an error which the next read reports
+        return OK;
+    }
+
+    void unwatch(int fd) { (void)epoll_ctl(mEpollFd.get(), EPOLL_CTL_DEL, fd, nullptr); }
+
+    void eraseSessionLocked(std::map<RpcSession*, SessionEntry>::iterator it) {
+        if (auto trigger = mSessionTriggers.find(it->second.triggerId);
+            trigger != mSessionTriggers.end()) {
+            unwatch(trigger->second->mShutdownTrigger->readFd());
+            mSessionTriggers.erase(trigger);
+        }
+        mSessions.erase(it);
+    }
+
+    void eraseConnectionLocked(std::map<uint64_t, ConnectionEntry>::iterator it) {
+        unwatch(it->second.fd);
+        auto sessionIt = mSessions.find(it->second.session.get());
+        LOG_ALWAYS_FATAL_IF(sessionIt == mSessions.end(), "Connection without session");
+        if (--sessionIt->second.connections == 0) eraseSessionLocked(sessionIt);
+        mConnections.erase(it);
+    }
+
+    void workerLoop() {
+        while (true) {
+            epoll_event event;
+            int ret = TEMP_FAILURE_RETRY(epoll_wait(mEpollFd.get(), &event, 1, -1));
+            if (ret < 0) {
+                ALOGE("epoll_wait failed, stopping RpcServer worker: %s", strerror(errno));
+                return;
+            }
+            if (ret == 0) continue;
+
+            uint64_t id = event.data.u64;
+            if (id == kShutdownId) return;
+            if (!handleSessionShutdown(id)) handleConnection(id);
+        }
+    }
+
+    // Returns false if |id| isn't a session's shutdown trigger.
+    bool handleSessionShutdown(uint64_t id) {
+        std::vector<ConnectionEntry> ended;
+        {
+            RpcMutexLockGuard _l(mLock);
+            auto trigger = mSessionTriggers.find(id);
+            if (trigger == mSessionTriggers.end()) return false;
+
+            RpcSession* session = trigger->second.get();
+            auto sessionIt = mSessions.find(session);
+            LOG_ALWAYS_FATAL_IF(sessionIt == mSessions.end(), "Trigger without session");
+            // busy connections are dropped by their worker once it sees this
+            sessionIt->second.shutdown = true;
+
+            for (auto it = mConnections.begin(); it != mConnections.end();) {
+                auto next = std::next(it);
+                if (it->second.session.get() == session && !it->second.busy) {
+                    ended.push_back(it->second);
+                    // may erase the session and its trigger
+                    eraseConnectionLocked(it);
+                }
+                it = next;
+            }
+        }
+
+        for (auto& entry : ended) {
+            RpcSession::postJoinCleanup(std::move(entry.session), entry.connection);
+        }
+        return true;
+    }
+
+    void handleConnection(uint64_t id) {
+        sp<RpcSession> session;
+        sp<RpcSession::RpcConnection> connection;
+        int fd;
+        {
+            RpcMutexLockGuard _l(mLock);
+            auto it = mConnections.find(id);
+            if (it == mConnections.end()) return;
+            it->second.busy = true;
+            session = it->second.session;
+            connection = it->second.connection;
+            fd = it->second.fd;
+        }
+        int triggerFd = session->mShutdownTrigger->readFd();
+
+        {
+            // so that nested calls from this thread use this connection
+            RpcMutexLockGuard _l(session->mMutex);
+            connection->exclusiveTid = rpcGetThreadId();
+        }
+        status_t status;
+        do {
+            auto deadline = std::chrono::steady_clock::now() + kFrameTimeout;
+            connection->framePoll = [=]() { return waitForFrame(fd, triggerFd, deadline); };
+            status = session->state()->getAndExecuteCommand(connection, session,
+                                                            RpcState::CommandType::ANY);
+            connection->framePoll = nullptr;
+        } while (status == OK && session->state()->pollRead(connection) == OK);
+        session->clearConnectionTid(connection);
+
+        {
+            RpcMutexLockGuard _l(mLock);
+            auto it = mConnections.find(id);
+            LOG_ALWAYS_FATAL_IF(it == mConnections.end(), "Busy connection was erased");
+            it->second.busy = false;
+            if (status == OK && !mSessions.at(session.get()).shutdown &&
+                OK == watch(mEpollFd, EPOLL_CTL_MOD, it->second.fd, id,
+                            EPOLLIN | EPOLLONESHOT)) {
+                return;
+            }
+            eraseConnectionLocked(it);
+        }
+
+        LOG_RPC_DETAIL("Binder connection closing w/ status %s", statusToString(status).c_str());
+        RpcSession::postJoinCleanup(std::move(session), connection);
+    }
+
+    const unique_fd mEpollFd;
+    std::vector<RpcMaybeThread> mWorkers;
+
+    RpcMutex mLock; // for below
+    bool mStopped = false;
+    uint64_t mNextId = kShutdownId + 1;
+    std::map<uint64_t, ConnectionEntry> mConnections;
+    std::map<uint64_t, sp<RpcSession>> mSessionTriggers;
+    std::map<RpcSession*, SessionEntry> mSessions;
+};
+#else  // BINDER_RPC_SINGLE_THREADED
+class RpcServer::EventLoop {
+public:
+    static std::shared_ptr<EventLoop> make(size_t, FdTrigger*) { return nullptr; }
+    [[nodiscard]] bool add(const sp<RpcSession>&, const sp<RpcSession::RpcConnection>&, int) {
+        return false;
+    }
+    void join() {}
+};
+#endif // BINDER_RPC_SINGLE_THREADED
+
 RpcServer::RpcServer(std::unique_ptr<RpcTransportCtx> ctx) : mCtx(std::move(ctx)) {}
 RpcServer::~RpcServer() {
     RpcMutexUniqueLock _l(mLock);
@@ -124,6 +418,16 @@ size_t RpcServer::getMaxThreads() {
     return mMaxThreads;
 }
 
+void RpcServer::setEventLoopThreads(size_t threads) {
+    LOG_ALWAYS_FATAL_IF(!kEnableRpcThreads && threads > 0,
+                        "RpcServer event loop requires threads to be enabled at build time");
+    LOG_ALWAYS_FATAL_IF(mJoinThreadRunning, "Cannot set event loop threads while running");
+    LOG_ALWAYS_FATAL_IF(threads > 0 && !mCtx->signalsIncomingDataOnFd(),
+                        "RpcServer event loop requires a transport which signals incoming data on "
+                        "its socket");
+    mEventLoopThreads = threads;
+}
+
 void RpcServer::setProtocolVersion(uint32_t version) {
     mProtocolVersion = version;
 }
@@ -230,7 +534,7 @@ status_t RpcServer::recvmsgSocketConnection(const RpcServer& server, RpcTranspor
 }
 
 void RpcServer::join() {
-
+    std::shared_ptr<EventLoop> eventLoop;
     {
         RpcMutexLockGuard _l(mLock);
         LOG_ALWAYS_FATAL_IF(!mServer.fd.ok(), "RpcServer must be setup to join.");
@@ -239,6 +543,11 @@ void RpcServer::join() {
         mJoinThreadRunning = true;
         mShutdownTrigger = FdTrigger::make();
         LOG_ALWAYS_FATAL_IF(mShutdownTrigger == nullptr, "Cannot create join signaler");
+        if (mEventLoopThreads > 0) {
+            mEventLoop = EventLoop::make(mEventLoopThreads, mShutdownTrigger.get());
+            LOG_ALWAYS_FATAL_IF(mEventLoop == nullptr, "Cannot create event loop");
+            eventLoop = mEventLoop;
+        }
     }
 
     status_t status;
@@ -268,12 +577,21 @@ void RpcServer::join() {
             continue;
         }
 
+        std::function<void(sp<RpcSession>&&, RpcSession::PreJoinSetupResult&&)> joinFn =
+                RpcSession::join;
+        if (eventLoop != nullptr) {
+            joinFn = [fd = clientSocket.fd.get()](sp<RpcSession>&& session,
+                                                  RpcSession::PreJoinSetupResult&& setupResult) {
+                joinEventLoop(fd, std::move(session), std::move(setupResult));
+            };
+        }
+
         {
             RpcMutexLockGuard _l(mLock);
             RpcMaybeThread thread =
                     RpcMaybeThread(&RpcServer::establishConnection,
                                    sp<RpcServer>::fromExisting(this), std::move(clientSocket), addr,
-                                   addrLen, RpcSession::join);
+                                   addrLen, std::move(joinFn));
 
             auto& threadRef = mConnectingThreads[thread.get_id()];
             threadRef = std::move(thread);
@@ -282,6 +600,10 @@ void RpcServer::join() {
     }
     LOG_RPC_DETAIL("RpcServer::join exiting with %s", statusToString(status).c_str());
 
+    if (eventLoop != nullptr) {
+        eventLoop->join();
+    }
+
     if constexpr (kEnableRpcThreads) {
         RpcMutexLockGuard _l(mLock);
         mJoinThreadRunning = false;
@@ -546,6 +868,25 @@ void RpcServer::establishConnection(
     joinFn(std::move(session), std::move(setupResult));
 }
 
+void RpcServer::joinEventLoop(int fd, sp<RpcSession>&& session,
+                              RpcSession::PreJoinSetupResult&& setupResult) {
+    if (setupResult.status != OK) {
+        RpcSession::join(std::move(session), std::move(setupResult));
+        return;
+    }
+
+    std::shared_ptr<EventLoop> eventLoop;
+    if (sp<RpcServer> server = session->server(); server != nullptr) {
+        RpcMutexLockGuard _l(server->mLock);
+        eventLoop = server->mEventLoop;
+    }
+
+    session->releaseJoinThread();
+    if (eventLoop == nullptr || !eventLoop->add(session, setupResult.connection, fd)) {
+        RpcSession::postJoinCleanup(std::move(session), setupResult.connection);
+    }
+}
+
 status_t RpcServer::setupSocketServer(const RpcSocketAddress& addr) {
     LOG_RPC_DETAIL("Setting up socket server %s", addr.toString().c_str());
     LOG_ALWAYS_FATAL_IF(hasServer(), "Each RpcServer can only have one server.");
@@ -145,6 +145,29 @@ RpcSession::FileDescriptorTransportMode RpcSession::getFileDescriptorTransportMo
     return mFileDescriptorTransportMode;
 }
 
+bool RpcSession::setOnewayBatching(size_t maxBytes, std::chrono::microseconds maxDelay) {
+    if constexpr (!kEnableRpcThreads) {
+        ALOGE("Oneway batching is not supported on single-threaded libbinder");
+        return false;
+    }
+
+    RpcMutexLockGuard _l(mMutex);
+    LOG_ALWAYS_FATAL_IF(mStartedSetup, "Must set oneway batching before setting up connections");
+    mRpcBinderState->setOnewayBatching(maxBytes, maxDelay);
+    return true;
+}
+
+void RpcSession::setOutOfLineDataThreshold(size_t bytes) {
+    RpcMutexLockGuard _l(mMutex);
+    LOG_ALWAYS_FATAL_IF(mStartedSetup,
+                        "Must set out of line data threshold before setting up connections");
+    mOutOfLineDataThreshold = bytes;
+}
+
+size_t RpcSession::getOutOfLineDataThreshold() {
+    return mOutOfLineDataThreshold;
+}
+
 status_t RpcSession::setupUnixDomainClient(const char* path) {
     return setupSocketClient(UnixSocketAddress(path));
 }
@@ -249,6 +272,10 @@ status_t RpcSession::getRemoteMaxThreads(size_t* maxThreads) {
 }
 
 bool RpcSession::shutdownAndWait(bool wait) {
+    // Oneway transactions which were buffered have been reported as sent, so
+    // they are written while the connections are still up.
+    (void)state()->flushAndStopOnewayBatching(sp<RpcSession>::fromExisting(this));
+
     RpcMutexUniqueLock _l(mMutex);
     LOG_ALWAYS_FATAL_IF(mShutdownTrigger == nullptr, "Shutdown trigger not installed");
 
@@ -451,14 +478,22 @@ void RpcSession::join(sp<RpcSession>&& session, PreJoinSetupResult&& setupResult
               statusToString(setupResult.status).c_str());
     }
 
+    session->releaseJoinThread();
+    postJoinCleanup(std::move(session), connection);
+}
+
+void RpcSession::releaseJoinThread() {
+    RpcMutexLockGuard _l(mMutex);
+    auto it = mConnections.mThreads.find(rpc_this_thread::get_id());
+    LOG_ALWAYS_FATAL_IF(it == mConnections.mThreads.end());
+    it->second.detach();
+    mConnections.mThreads.erase(it);
+}
+
+void RpcSession::postJoinCleanup(sp<RpcSession>&& session, const sp<RpcConnection>& connection) {
     sp<RpcSession::EventListener> listener;
     {
         RpcMutexLockGuard _l(session->mMutex);
-        auto it = session->mConnections.mThreads.find(rpc_this_thread::get_id());
-        LOG_ALWAYS_FATAL_IF(it == session->mConnections.mThreads.end());
-        it->second.detach();
-        session->mConnections.mThreads.erase(it);
-
         listener = session->mEventListener.promote();
     }
 
@@ -830,6 +865,7 @@ sp<RpcSession::RpcConnection> RpcSession::assignIncomingConnectionToThisThread(
     sp<RpcConnection> session = sp<RpcConnection>::make();
     session->rpcTransport = std::move(rpcTransport);
     session->exclusiveTid = rpcGetThreadId();
+    session->readAhead = true;
 
     mConnections.mIncoming.push_back(session);
     mConnections.mMaxIncoming = mConnections.mIncoming.size();
@@ -27,10 +27,12 @@
 #include <binder/RpcServer.h>
 
 #include "Debug.h"
+#include "OS.h"
 #include "RpcWireFormat.h"
 #include "Utils.h"
 
 #include <random>
+#include <utility>
 
 #include <inttypes.h>
 
@@ -62,7 +64,9 @@ static bool enableAncillaryFds(RpcSession::FileDescriptorTransportMode mode) {
 }
 
 RpcState::RpcState() {}
-RpcState::~RpcState() {}
+RpcState::~RpcState() {
+    stopOnewayBatching();
+}
 
 status_t RpcState::onBinderLeaving(const sp<RpcSession>& session, const sp<IBinder>& binder,
                                    uint64_t* outAddress) {
@@ -89,58 +93,69 @@ status_t RpcState::onBinderLeaving(const sp<RpcSession>& session, const sp<IBind
         return INVALID_OPERATION;
     }
 
-    RpcMutexLockGuard _l(mNodeMutex);
-    if (mTerminated) return DEAD_OBJECT;
+    NodeShard& shard = isRpc
+            ? shardForAddress(binder->remoteBinder()->getPrivateAccessor().rpcAddress())
+            : shardForBinder(binder.get());
+    RpcMutexLockGuard _l(shard.mutex);
+    if (isTerminated()) return DEAD_OBJECT;
+
+    if (isRpc) {
+        uint64_t addr = binder->remoteBinder()->getPrivateAccessor().rpcAddress();
+        auto it = shard.nodeForAddress.find(addr);
+        LOG_ALWAYS_FATAL_IF(it == shard.nodeForAddress.end() || binder != it->second.binder,
+                            "RPC binder must have known address at this point: %" PRIu64, addr);
+        it->second.timesSent++;
+        it->second.sentRef = binder; // might already be set
+        *outAddress = addr;
+        return OK;
+    }
 
-    // TODO(b/182939933): maybe move address out of BpBinder, and keep binder->address map
-    // in RpcState
-    for (auto& [addr, node] : mNodeForAddress) {
-        if (binder == node.binder) {
-            if (isRpc) {
-                // check integrity of data structure
-                uint64_t actualAddr = binder->remoteBinder()->getPrivateAccessor().rpcAddress();
-                LOG_ALWAYS_FATAL_IF(addr != actualAddr, "Address mismatch %" PRIu64 " vs %" PRIu64,
-                                    addr, actualAddr);
-            }
-            node.timesSent++;
-            node.sentRef = binder; // might already be set
-            *outAddress = addr;
+    if (auto local = shard.addressForLocalBinder.find(binder.get());
+        local != shard.addressForLocalBinder.end()) {
+        auto it = shard.nodeForAddress.find(local->second);
+        LOG_ALWAYS_FATAL_IF(it == shard.nodeForAddress.end(),
+                            "No node for local binder at address %" PRIu64, local->second);
+        // The node may belong to a binder which was destroyed, and whose memory
+        // was reused for this one. Then this binder gets a node of its own, and
+        // takes over the entry below.
+        if (binder == it->second.binder) {
+            it->second.timesSent++;
+            it->second.sentRef = binder; // might already be set
+            *outAddress = it->first;
             return OK;
         }
     }
-    LOG_ALWAYS_FATAL_IF(isRpc, "RPC binder must have known address at this point");
 
     bool forServer = session->server() != nullptr;
 
     // arbitrary limit for maximum number of nodes in a process (otherwise we
     // might run out of addresses)
-    if (mNodeForAddress.size() > 100000) {
+    if ((mNodeCount & ~kNodeCountTerminated) > 100000) {
         return NO_MEMORY;
     }
+    if (!reserveNode()) return DEAD_OBJECT;
 
+    // The address must map back to this shard, see shardForAddress.
+    const uint64_t shardIndex = &shard - mNodeShards.data();
     while (true) {
+        uint64_t id = static_cast<uint64_t>(mNextId++) * kNodeShards + shardIndex;
         RpcWireAddress address{
                 .options = RPC_WIRE_ADDRESS_OPTION_CREATED,
-                .address = mNextId,
+                // wraps around, like mNextId
+                .address = static_cast<uint32_t>(id & std::numeric_limits<uint32_t>::max()),
         };
         if (forServer) {
             address.options |= RPC_WIRE_ADDRESS_OPTION_FOR_SERVER;
         }
 
-        // avoid ubsan abort
-        if (mNextId >= std::numeric_limits<uint32_t>::max()) {
-            mNextId = 0;
-        } else {
-            mNextId++;
-        }
-
-        auto&& [it, inserted] = mNodeForAddress.insert({RpcWireAddress::toRaw(address),
-                                                        BinderNode{
-                                                                .binder = binder,
-                                                                .sentRef = binder,
-                                                                .timesSent = 1,
-                                                        }});
+        auto&& [it, inserted] = shard.nodeForAddress.insert({RpcWireAddress::toRaw(address),
+                                                             BinderNode{
+                                                                     .binder = binder,
+                                                                     .sentRef = binder,
+                                                                     .timesSent = 1,
+                                                             }});
         if (inserted) {
+            shard.addressForLocalBinder[binder.get()] = it->first;
             *outAddress = it->first;
             return OK;
         }
@@ -165,10 +180,11 @@ status_t RpcState::onBinderEntering(const sp<RpcSession>& session, uint64_t addr
         return BAD_VALUE;
     }
 
-    RpcMutexLockGuard _l(mNodeMutex);
-    if (mTerminated) return DEAD_OBJECT;
+    NodeShard& shard = shardForAddress(address);
+    RpcMutexLockGuard _l(shard.mutex);
+    if (isTerminated()) return DEAD_OBJECT;
 
-    if (auto it = mNodeForAddress.find(address); it != mNodeForAddress.end()) {
+    if (auto it = shard.nodeForAddress.find(address); it != shard.nodeForAddress.end()) {
         *out = it->second.binder.promote();
 
         // implicitly have strong RPC refcount, since we received this binder
@@ -184,7 +200,8 @@ status_t RpcState::onBinderEntering(const sp<RpcSession>& session, uint64_t addr
         return BAD_VALUE;
     }
 
-    auto&& [it, inserted] = mNodeForAddress.insert({address, BinderNode{}});
+    if (!reserveNode()) return DEAD_OBJECT;
+    auto&& [it, inserted] = shard.nodeForAddress.insert({address, BinderNode{}});
     LOG_ALWAYS_FATAL_IF(!inserted, "Failed to insert binder when creating proxy");
 
     // Currently, all binders are assumed to be part of the same session (no
@@ -200,12 +217,13 @@ status_t RpcState::flushExcessBinderRefs(const sp<RpcSession>& session, uint64_t
     // extra reference counting packets now.
     if (binder->remoteBinder()) return OK;
 
-    RpcMutexUniqueLock _l(mNodeMutex);
-    if (mTerminated) return DEAD_OBJECT;
+    NodeShard& shard = shardForAddress(address);
+    RpcMutexUniqueLock _l(shard.mutex);
+    if (isTerminated()) return DEAD_OBJECT;
 
-    auto it = mNodeForAddress.find(address);
+    auto it = shard.nodeForAddress.find(address);
 
-    LOG_ALWAYS_FATAL_IF(it == mNodeForAddress.end(), "Can't be deleted while we hold sp<>");
+    LOG_ALWAYS_FATAL_IF(it == shard.nodeForAddress.end(), "Can't be deleted while we hold sp<>");
     LOG_ALWAYS_FATAL_IF(it->second.binder != binder,
                         "Caller of flushExcessBinderRefs using inconsistent arguments");
 
@@ -228,19 +246,19 @@ status_t RpcState::flushExcessBinderRefs(const sp<RpcSession>& session, uint64_t
 }
 
 status_t RpcState::sendObituaries(const sp<RpcSession>& session) {
-    RpcMutexUniqueLock _l(mNodeMutex);
-
     // Gather strong pointers to all of the remote binders for this session so
     // we hold the strong references. remoteBinder() returns a raw pointer.
     // Send the obituaries and drop the strong pointers outside of the lock so
     // the destructors and the onBinderDied calls are not done while locked.
     std::vector<sp<IBinder>> remoteBinders;
-    for (const auto& [_, binderNode] : mNodeForAddress) {
-        if (auto binder = binderNode.binder.promote()) {
-            remoteBinders.push_back(std::move(binder));
+    for (auto& shard : mNodeShards) {
+        RpcMutexLockGuard _l(shard.mutex);
+        for (const auto& [_, binderNode] : shard.nodeForAddress) {
+            if (auto binder = binderNode.binder.promote()) {
+                remoteBinders.push_back(std::move(binder));
+            }
         }
     }
-    _l.unlock();
 
     for (const auto& binder : remoteBinders) {
         if (binder->remoteBinder() &&
@@ -252,59 +270,80 @@ status_t RpcState::sendObituaries(const sp<RpcSession>& session) {
 }
 
 size_t RpcState::countBinders() {
-    RpcMutexLockGuard _l(mNodeMutex);
-    return mNodeForAddress.size();
+    size_t count = 0;
+    for (auto& shard : mNodeShards) {
+        RpcMutexLockGuard _l(shard.mutex);
+        count += shard.nodeForAddress.size();
+    }
+    return count;
 }
 
 void RpcState::dump() {
-    RpcMutexLockGuard _l(mNodeMutex);
-    dumpLocked();
+    ALOGE("DUMP OF RpcState %p", this);
+    ALOGE("DUMP OF RpcState (%zu nodes)", countBinders());
+    for (auto& shard : mNodeShards) {
+        RpcMutexLockGuard _l(shard.mutex);
+        dumpLocked(shard);
+    }
+    ALOGE("END DUMP OF RpcState");
 }
 
 void RpcState::clear() {
-    return clear(RpcMutexUniqueLock(mNodeMutex));
+    size_t count = mNodeCount.fetch_or(kNodeCountTerminated);
+    if ((count & kNodeCountTerminated) == 0) {
+        // Buffered oneway transactions can't be delivered anymore. An orderly
+        // shutdown flushed them already, see RpcSession::shutdownAndWait.
+        stopOnewayBatching();
+    }
+
+    // Even if another thread terminated this state, wait for all nodes to be
+    // cleared before returning.
+    clearNodes();
 }
 
-void RpcState::clear(RpcMutexUniqueLock nodeLock) {
-    if (mTerminated) {
-        LOG_ALWAYS_FATAL_IF(!mNodeForAddress.empty(),
-                            "New state should be impossible after terminating!");
-        return;
-    }
-    mTerminated = true;
+void RpcState::clearNodes() {
+    LOG_ALWAYS_FATAL_IF(!isTerminated(), "Nodes can only be cleared after terminating");
 
-    if (SHOULD_LOG_RPC_DETAIL) {
-        ALOGE("RpcState::clear()");
-        dumpLocked();
-    }
+    for (auto& shard : mNodeShards) {
+        RpcMutexUniqueLock _l(shard.mutex);
+        if (shard.cleared) {
+            LOG_ALWAYS_FATAL_IF(!shard.nodeForAddress.empty(),
+                                "New state should be impossible after terminating!");
+            continue;
+        }
+        shard.cleared = true;
 
-    // invariants
-    for (auto& [address, node] : mNodeForAddress) {
-        bool guaranteedHaveBinder = node.timesSent > 0;
-        if (guaranteedHaveBinder) {
-            LOG_ALWAYS_FATAL_IF(node.sentRef == nullptr,
-                                "Binder expected to be owned with address: %" PRIu64 " %s", address,
-                                node.toString().c_str());
+        if (SHOULD_LOG_RPC_DETAIL) {
+            ALOGE("RpcState::clear() %p shard %zu", this, &shard - mNodeShards.data());
+            dumpLocked(shard);
         }
-    }
 
-    // if the destructor of a binder object makes another RPC call, then calling
-    // decStrong could deadlock. So, we must hold onto these binders until
-    // mNodeMutex is no longer taken.
-    auto temp = std::move(mNodeForAddress);
-    mNodeForAddress.clear(); // RpcState isn't reusable, but for future/explicit
+        // invariants
+        for (auto& [address, node] : shard.nodeForAddress) {
+            bool guaranteedHaveBinder = node.timesSent > 0;
+            if (guaranteedHaveBinder) {
+                LOG_ALWAYS_FATAL_IF(node.sentRef == nullptr,
+                                    "Binder expected to be owned with address: %" PRIu64 " %s",
+                                    address, node.toString().c_str());
+            }
+        }
 
-    nodeLock.unlock();
-    temp.clear(); // explicit
+        // if the destructor of a binder object makes another RPC call, then calling
+        // decStrong could deadlock. So, we must hold onto these binders until
+        // the shard's mutex is no longer taken.
+        auto temp = std::move(shard.nodeForAddress);
+        shard.nodeForAddress.clear(); // RpcState isn't reusable, but for future/explicit
+        shard.addressForLocalBinder.clear();
+
+        _l.unlock();
+        temp.clear(); // explicit
+    }
 }
 
-void RpcState::dumpLocked() {
-    ALOGE("DUMP OF RpcState %p", this);
-    ALOGE("DUMP OF RpcState (%zu nodes)", mNodeForAddress.size());
-    for (const auto& [address, node] : mNodeForAddress) {
+void RpcState::dumpLocked(const NodeShard& shard) {
+    for (const auto& [address, node] : shard.nodeForAddress) {
         ALOGE("- address: %" PRIu64 " %s", address, node.toString().c_str());
     }
-    ALOGE("END DUMP OF RpcState");
 }
 
 std::string RpcState::BinderNode::toString() const {
@@ -368,6 +407,9 @@ status_t RpcState::rpcSend(
         status != OK) {
         LOG_RPC_DETAIL("Failed to write %s (%d iovs) on RpcTransport %p, error: %s", what, niovs,
                        connection->rpcTransport.get(), statusToString(status).c_str());
+        // Don't let the shutdown flush buffered oneway transactions. This may
+        // be the write of the batch itself.
+        stopOnewayBatching();
         (void)session->shutdownAndWait(false);
         return status;
     }
@@ -379,13 +421,20 @@ status_t RpcState::rpcRec(
         const sp<RpcSession::RpcConnection>& connection, const sp<RpcSession>& session,
         const char* what, iovec* iovs, int niovs,
         std::vector<std::variant<base::unique_fd, base::borrowed_fd>>* ancillaryFds) {
-    if (status_t status =
-                connection->rpcTransport->interruptableReadFully(session->mShutdownTrigger.get(),
-                                                                 iovs, niovs, std::nullopt,
-                                                                 ancillaryFds);
-        status != OK) {
+    std::optional<android::base::function_ref<status_t()>> altPoll;
+    if (connection->framePoll) altPoll.emplace(connection->framePoll);
+    status_t status;
+    if (connection->readAhead && !enableAncillaryFds(session->getFileDescriptorTransportMode())) {
+        status = rpcRecBuffered(connection, session, iovs, niovs, altPoll);
+    } else {
+        status = connection->rpcTransport->interruptableReadFully(session->mShutdownTrigger.get(),
+                                                                  iovs, niovs, altPoll,
+                                                                  ancillaryFds);
+    }
+    if (status != OK) {
         LOG_RPC_DETAIL("Failed to read %s (%d iovs) on RpcTransport %p, error: %s", what, niovs,
                        connection->rpcTransport.get(), statusToString(status).c_str());
+        stopOnewayBatching();
         (void)session->shutdownAndWait(false);
         return status;
     }
@@ -398,6 +447,143 @@ status_t RpcState::rpcRec(
     return OK;
 }
 
+status_t RpcState::rpcRecBuffered(
+        const sp<RpcSession::RpcConnection>& connection, const sp<RpcSession>& session,
+        iovec* iovs, int niovs,
+        const std::optional<android::base::function_ref<status_t()>>& altPoll) {
+    // Large enough for a batch of small oneway transactions, so that they are
+    // parsed from one read instead of two reads per command.
+    constexpr size_t kReadBufferSize = 16 * 1024;
+
+    RpcTransport* transport = connection->rpcTransport.get();
+    FdTrigger* trigger = session->mShutdownTrigger.get();
+    if (connection->readBuffer == nullptr) {
+        connection->readBuffer.reset(new (std::nothrow) uint8_t[kReadBufferSize]);
+        if (connection->readBuffer == nullptr) {
+            connection->readAhead = false;
+            return transport->interruptableReadFully(trigger, iovs, niovs, altPoll, nullptr);
+        }
+    }
+
+    for (int i = 0; i < niovs; i++) {
+        uint8_t* data = static_cast<uint8_t*>(iovs[i].iov_base);
+        size_t size = iovs[i].iov_len;
+        while (size > 0) {
+            if (connection->readBufferBegin == connection->readBufferEnd) {
+                // Nothing to gain from copying a large body through the buffer.
+                if (size >= kReadBufferSize) {
+                    iovec iov{data, size};
+                    if (status_t status =
+                                transport->interruptableReadFully(trigger, &iov, 1, altPoll,
+                                                                  nullptr);
+                        status != OK) {
+                        return status;
+                    }
+                    break;
+                }
+
+                size_t readSize = 0;
+                status_t status =
+                        transport->interruptableReadAvailable(trigger,
+                                                              connection->readBuffer.get(),
+                                                              kReadBufferSize, &readSize, altPoll);
+                if (status == INVALID_OPERATION) {
+                    // Not supported by this transport. Nothing was buffered.
+                    connection->readAhead = false;
+                    std::vector<iovec> rest(iovs + i, iovs + niovs);
+                    rest[0] = {data, size};
+                    return transport->interruptableReadFully(trigger, rest.data(),
+                                                             static_cast<int>(rest.size()),
+                                                             altPoll, nullptr);
+                }
+                if (status != OK) return status;
+                connection->readBufferBegin = 0;
+                connection->readBufferEnd = readSize;
+            }
+
+            size_t copySize =
+                    std::min(size, connection->readBufferEnd - connection->readBufferBegin);
+            memcpy(data, connection->readBuffer.get() + connection->readBufferBegin, copySize);
+            connection->readBufferBegin += copySize;
+            data += copySize;
+            size -= copySize;
+        }
+    }
+    return OK;
+}
+
+bool RpcState::moveParcelDataOutOfLine(
+        const sp<RpcSession>& session, const Parcel& parcel, base::unique_fd* outDataFd,
+        std::vector<std::variant<base::unique_fd, base::borrowed_fd>>* outFds) {
+    size_t threshold = session->getOutOfLineDataThreshold();
+    if (threshold == 0 || parcel.dataSize() <= threshold) return false;
+    if (session->getFileDescriptorTransportMode() !=
+        RpcSession::FileDescriptorTransportMode::UNIX) {
+        return false;
+    }
+    if (session->getProtocolVersion().value() <
+        RPC_WIRE_PROTOCOL_VERSION_RPC_HEADER_FEATURE_OUT_OF_LINE_DATA) {
+        return false;
+    }
+
+    auto* rpcFields = parcel.maybeRpcFields();
+    LOG_ALWAYS_FATAL_IF(rpcFields == nullptr);
+    size_t fdCount = rpcFields->mFds ? rpcFields->mFds->size() : 0;
+    // Leave room for the memfd (see validateParcel).
+    constexpr size_t kMaxFdsPerMsg = 253;
+    if (fdCount >= kMaxFdsPerMsg) return false;
+
+    if (status_t status = createSealedDataFd(parcel.data(), parcel.dataSize(), outDataFd);
+        status != OK) {
+        ALOGW("Failed to move %zu bytes of Parcel data out of line, sending inline: %s",
+              parcel.dataSize(), statusToString(status).c_str());
+        return false;
+    }
+
+    outFds->clear();
+    outFds->reserve(fdCount + 1);
+    for (size_t i = 0; i < fdCount; i++) {
+        int fd = std::visit([](const auto& fd) { return fd.get(); }, rpcFields->mFds->at(i));
+        outFds->emplace_back(base::borrowed_fd(fd));
+    }
+    outFds->emplace_back(base::borrowed_fd(*outDataFd));
+    return true;
+}
+
+bool RpcState::hasOutOfLineParcelData(const sp<RpcSession>& session, uint32_t parcelOptions) {
+    return session->getProtocolVersion().value() >=
+            RPC_WIRE_PROTOCOL_VERSION_RPC_HEADER_FEATURE_OUT_OF_LINE_DATA &&
+            (parcelOptions & RPC_WIRE_PARCEL_OPTION_OUT_OF_LINE);
+}
+
+status_t RpcState::mapOutOfLineParcelData(
+        std::vector<std::variant<base::unique_fd, base::borrowed_fd>>* ancillaryFds,
+        uint32_t dataSize, const uint8_t** outData) {
+    if (ancillaryFds->empty()) {
+        ALOGE("Parcel data sent out of line, but no file descriptor for it was received.");
+        return BAD_VALUE;
+    }
+    // The mapping stays valid after the memfd is closed.
+    auto dataFd = std::move(ancillaryFds->back());
+    ancillaryFds->pop_back();
+    int fd = std::visit([](const auto& fd) { return fd.get(); }, dataFd);
+
+    if (status_t status = mapSealedDataFd(base::borrowed_fd(fd), dataSize, outData);
+        status != OK) {
+        ALOGE("Failed to map %" PRIu32 " bytes of out of line Parcel data: %s", dataSize,
+              statusToString(status).c_str());
+        return status;
+    }
+    return OK;
+}
+
+static void unmap_out_of_line_data(const uint8_t* data, size_t dataSize,
+                                   const binder_size_t* objects, size_t objectsCount) {
+    unmapSealedData(data, dataSize);
+    LOG_ALWAYS_FATAL_IF(objects != nullptr);
+    (void)objectsCount;
+}
+
 status_t RpcState::readNewSessionResponse(const sp<RpcSession::RpcConnection>& connection,
                                           const sp<RpcSession>& session, uint32_t* version) {
     RpcNewSessionResponse response;
@@ -517,10 +703,11 @@ status_t RpcState::transactAddress(const sp<RpcSession::RpcConnection>& connecti
     uint64_t asyncNumber = 0;
 
     if (address != 0) {
-        RpcMutexUniqueLock _l(mNodeMutex);
-        if (mTerminated) return DEAD_OBJECT; // avoid fatal only, otherwise races
-        auto it = mNodeForAddress.find(address);
-        LOG_ALWAYS_FATAL_IF(it == mNodeForAddress.end(),
+        NodeShard& shard = shardForAddress(address);
+        RpcMutexUniqueLock _l(shard.mutex);
+        if (isTerminated()) return DEAD_OBJECT; // avoid fatal only, otherwise races
+        auto it = shard.nodeForAddress.find(address);
+        LOG_ALWAYS_FATAL_IF(it == shard.nodeForAddress.end(),
                             "Sending transact on unknown address %" PRIu64, address);
 
         if (flags & IBinder::FLAG_ONEWAY) {
@@ -539,15 +726,21 @@ status_t RpcState::transactAddress(const sp<RpcSession::RpcConnection>& connecti
     Span<const uint32_t> objectTableSpan = Span<const uint32_t>{rpcFields->mObjectPositions.data(),
                                                                 rpcFields->mObjectPositions.size()};
 
+    base::unique_fd outOfLineDataFd;
+    std::vector<std::variant<base::unique_fd, base::borrowed_fd>> outOfLineFds;
+    bool outOfLine = moveParcelDataOutOfLine(session, data, &outOfLineDataFd, &outOfLineFds);
+    const auto* fds = outOfLine ? &outOfLineFds : rpcFields->mFds.get();
+
     uint32_t bodySize;
     LOG_ALWAYS_FATAL_IF(__builtin_add_overflow(sizeof(RpcWireTransaction), data.dataSize(),
                                                &bodySize) ||
                                 __builtin_add_overflow(objectTableSpan.byteSize(), bodySize,
                                                        &bodySize),
                         "Too much data %zu", data.dataSize());
+    const size_t inlineDataSize = outOfLine ? 0 : data.dataSize();
     RpcWireHeader command{
             .command = RPC_COMMAND_TRANSACT,
-            .bodySize = bodySize,
+            .bodySize = bodySize - static_cast<uint32_t>(data.dataSize() - inlineDataSize),
     };
 
     RpcWireTransaction transaction{
@@ -557,6 +750,7 @@ status_t RpcState::transactAddress(const sp<RpcSession::RpcConnection>& connecti
             .asyncNumber = asyncNumber,
             // bodySize didn't overflow => this cast is safe
             .parcelDataSize = static_cast<uint32_t>(data.dataSize()),
+            .parcelOptions = outOfLine ? RPC_WIRE_PARCEL_OPTION_OUT_OF_LINE : 0,
     };
 
     // Oneway calls have no sync point, so if many are sent before, whether this
@@ -569,9 +763,40 @@ status_t RpcState::transactAddress(const sp<RpcSession::RpcConnection>& connecti
     iovec iovs[]{
             {&command, sizeof(RpcWireHeader)},
             {&transaction, sizeof(RpcWireTransaction)},
-            {const_cast<uint8_t*>(data.data()), data.dataSize()},
+            {const_cast<uint8_t*>(data.data()), inlineDataSize},
             objectTableSpan.toIovec(),
     };
+
+    bool hasFds = fds != nullptr && !fds->empty();
+    if ((flags & IBinder::FLAG_ONEWAY) && mOnewayBatch != nullptr && !hasFds) {
+        bool flushNow;
+        {
+            RpcMutexLockGuard _l(mOnewayBatch->mutex);
+            if (mOnewayBatch->stopped) return DEAD_OBJECT;
+            flushNow = appendToOnewayBatchLocked(session, iovs, arraysize(iovs));
+        }
+
+        LOG_RPC_DETAIL("Oneway command buffered for RpcTransport %p",
+                       connection->rpcTransport.get());
+        return flushNow ? flushOnewayBatch(connection, session) : OK;
+    }
+
+    if (mOnewayBatch != nullptr) {
+        RpcMutexLockGuard _l(mOnewayBatch->mutex);
+        if (mOnewayBatch->flushingThread == rpc_this_thread::get_id()) {
+            // Called while this thread writes a batch, for instance by a
+            // command processed while waiting for the peer to read it. This
+            // transaction would be written in the middle of that batch.
+            ALOGE("Cannot send transaction while this thread writes a oneway batch");
+            return INVALID_OPERATION;
+        }
+    }
+
+    // Anything buffered was sent before this transaction, so it must be written
+    // first. For instance, a binder in it may only be kept alive by a buffered
+    // transaction.
+    if (status_t status = flushOnewayBatch(connection, session); status != OK) return status;
+
     if (status_t status = rpcSend(
                 connection, session, "transaction", iovs, arraysize(iovs),
                 [&] {
@@ -590,7 +815,7 @@ status_t RpcState::transactAddress(const sp<RpcSession::RpcConnection>& connecti
 
                     return drainCommands(connection, session, CommandType::CONTROL_ONLY);
                 },
-                rpcFields->mFds.get());
+                fds);
         status != OK) {
         // rpcSend calls shutdownAndWait, so all refcounts should be reset. If we ever tolerate
         // errors here, then we may need to undo the binder-sent counts for the transaction as
@@ -670,10 +895,13 @@ status_t RpcState::waitForReply(const sp<RpcSession::RpcConnection>& connection,
 
     Span<const uint8_t> parcelSpan = {data.data(), data.size()};
     Span<const uint32_t> objectTableSpan;
+    bool outOfLine = hasOutOfLineParcelData(session, rpcReply.parcelOptions);
     if (session->getProtocolVersion().value() >=
         RPC_WIRE_PROTOCOL_VERSION_RPC_HEADER_FEATURE_EXPLICIT_PARCEL_SIZE) {
-        std::optional<Span<const uint8_t>> objectTableBytes =
-                parcelSpan.splitOff(rpcReply.parcelDataSize);
+        // Out of line data leaves only the object table in the body.
+        std::optional<Span<const uint8_t>> objectTableBytes = outOfLine
+                ? std::make_optional(std::exchange(parcelSpan, {}))
+                : parcelSpan.splitOff(rpcReply.parcelDataSize);
         if (!objectTableBytes.has_value()) {
             ALOGE("Parcel size larger than available bytes: %" PRId32 " vs %zu. Terminating!",
                   rpcReply.parcelDataSize, parcelSpan.byteSize());
@@ -692,6 +920,21 @@ status_t RpcState::waitForReply(const sp<RpcSession::RpcConnection>& connection,
         objectTableSpan = *maybeSpan;
     }
 
+    if (outOfLine) {
+        if (status_t status = mapOutOfLineParcelData(&ancillaryFds, rpcReply.parcelDataSize,
+                                                     &parcelSpan.data);
+            status != OK) {
+            (void)session->shutdownAndWait(false);
+            return status;
+        }
+        parcelSpan.size = rpcReply.parcelDataSize;
+
+        // The object table is copied, so 'data' doesn't need to outlive the reply.
+        return reply->rpcSetDataReference(session, parcelSpan.data, parcelSpan.size,
+                                          objectTableSpan.data, objectTableSpan.size,
+                                          std::move(ancillaryFds), unmap_out_of_line_data);
+    }
+
     data.release();
     return reply->rpcSetDataReference(session, parcelSpan.data, parcelSpan.size,
                                       objectTableSpan.data, objectTableSpan.size,
@@ -706,10 +949,11 @@ status_t RpcState::sendDecStrongToTarget(const sp<RpcSession::RpcConnection>& co
     };
 
     {
-        RpcMutexUniqueLock _l(mNodeMutex);
-        if (mTerminated) return DEAD_OBJECT; // avoid fatal only, otherwise races
-        auto it = mNodeForAddress.find(addr);
-        LOG_ALWAYS_FATAL_IF(it == mNodeForAddress.end(),
+        NodeShard& shard = shardForAddress(addr);
+        RpcMutexUniqueLock _l(shard.mutex);
+        if (isTerminated()) return DEAD_OBJECT; // avoid fatal only, otherwise races
+        auto it = shard.nodeForAddress.find(addr);
+        LOG_ALWAYS_FATAL_IF(it == shard.nodeForAddress.end(),
                             "Sending dec strong on unknown address %" PRIu64, addr);
 
         LOG_ALWAYS_FATAL_IF(it->second.timesRecd < target, "Can't dec count of %zu to %zu.",
@@ -722,7 +966,7 @@ status_t RpcState::sendDecStrongToTarget(const sp<RpcSession::RpcConnection>& co
         body.amount = it->second.timesRecd - target;
         it->second.timesRecd = target;
 
-        LOG_ALWAYS_FATAL_IF(nullptr != tryEraseNode(session, std::move(_l), it),
+        LOG_ALWAYS_FATAL_IF(nullptr != tryEraseNode(session, shard, std::move(_l), it),
                             "Bad state. RpcState shouldn't own received binder");
         // LOCK ALREADY RELEASED
     }
@@ -732,9 +976,168 @@ status_t RpcState::sendDecStrongToTarget(const sp<RpcSession::RpcConnection>& co
             .bodySize = sizeof(RpcDecStrong),
     };
     iovec iovs[]{{&cmd, sizeof(cmd)}, {&body, sizeof(body)}};
+
+    if (mOnewayBatch != nullptr) {
+        RpcMutexLockGuard _l(mOnewayBatch->mutex);
+        if (mOnewayBatch->flushingThread == rpc_this_thread::get_id()) {
+            // This is a command processed while this thread writes a batch
+            // dropping a binder. Writing it now would split that batch, so it
+            // is sent after it instead.
+            if (mOnewayBatch->stopped) return DEAD_OBJECT;
+            (void)appendToOnewayBatchLocked(session, iovs, arraysize(iovs));
+            return OK;
+        }
+    }
+
+    // A buffered transaction may reference this binder.
+    if (status_t status = flushOnewayBatch(connection, session); status != OK) return status;
+
     return rpcSend(connection, session, "dec ref", iovs, arraysize(iovs), std::nullopt);
 }
 
+void RpcState::setOnewayBatching(size_t maxBytes, std::chrono::microseconds maxDelay) {
+    if (maxBytes == 0) {
+        mOnewayBatch = nullptr;
+        return;
+    }
+    mOnewayBatch = std::make_shared<OnewayBatch>();
+    mOnewayBatch->maxBytes = maxBytes;
+    mOnewayBatch->maxDelay = maxDelay;
+}
+
+bool RpcState::appendToOnewayBatchLocked(const sp<RpcSession>& session, const iovec* iovs,
+                                         int niovs) {
+    bool wasEmpty = mOnewayBatch->data.empty();
+    for (int i = 0; i < niovs; i++) {
+        auto* begin = reinterpret_cast<const uint8_t*>(iovs[i].iov_base);
+        mOnewayBatch->data.insert(mOnewayBatch->data.end(), begin, begin + iovs[i].iov_len);
+    }
+    bool flushNow = mOnewayBatch->data.size() >= mOnewayBatch->maxBytes;
+
+    if (wasEmpty && !flushNow) {
+        mOnewayBatch->deadline = std::chrono::steady_clock::now() + mOnewayBatch->maxDelay;
+        if (!mOnewayBatch->flusherStarted) {
+            mOnewayBatch->flusherStarted = true;
+            RpcMaybeThread(onewayBatchFlusherLoop, mOnewayBatch, wp<RpcSession>(session)).detach();
+        }
+        mOnewayBatch->cv.notify_all();
+    }
+    return flushNow;
+}
+
+status_t RpcState::flushOnewayBatch(const sp<RpcSession::RpcConnection>& connection,
+                                    const sp<RpcSession>& session) {
+    if (mOnewayBatch == nullptr) return OK;
+
+    std::vector<uint8_t> data;
+    {
+        RpcMutexUniqueLock _l(mOnewayBatch->mutex);
+        // Nested in the write of a batch by this thread, by a oneway
+        // transaction which filled the batch again (transact rejects other
+        // transactions here). It stays buffered for a later flush.
+        if (mOnewayBatch->flushingThread == rpc_this_thread::get_id()) return OK;
+        // A batch another thread is writing was sent before the caller's
+        // command, so that command waits until the batch is on the wire.
+        while (mOnewayBatch->flushingThread != RpcMaybeThread::id()) {
+            mOnewayBatch->cv.wait(_l);
+        }
+        if (mOnewayBatch->data.empty()) return OK;
+        data.swap(mOnewayBatch->data);
+        mOnewayBatch->flushingThread = rpc_this_thread::get_id();
+    }
+
+    iovec iov{data.data(), data.size()};
+    status_t status = rpcSend(
+            connection, session, "oneway batch", &iov, 1,
+            [&] { return drainCommands(connection, session, CommandType::CONTROL_ONLY); });
+
+    RpcMutexLockGuard _l(mOnewayBatch->mutex);
+    mOnewayBatch->flushingThread = RpcMaybeThread::id();
+    mOnewayBatch->cv.notify_all();
+    return status;
+}
+
+status_t RpcState::flushOnewayBatch(const sp<RpcSession>& session) {
+    if (mOnewayBatch == nullptr) return OK;
+
+    RpcSession::ExclusiveConnection connection;
+    if (status_t status =
+                RpcSession::ExclusiveConnection::find(session,
+                                                      RpcSession::ConnectionUse::CLIENT_ASYNC,
+                                                      &connection);
+        status != OK) {
+        return status;
+    }
+    return flushOnewayBatch(connection.get(), session);
+}
+
+status_t RpcState::flushAndStopOnewayBatching(const sp<RpcSession>& session) {
+    if (mOnewayBatch == nullptr) return OK;
+
+    {
+        RpcMutexLockGuard _l(mOnewayBatch->mutex);
+        if (mOnewayBatch->stopped) return OK;
+        // Later transactions fail, rather than being buffered after the flush.
+        mOnewayBatch->stopped = true;
+        mOnewayBatch->cv.notify_all();
+        if (mOnewayBatch->flushingThread == rpc_this_thread::get_id()) {
+            // Called while this thread writes a batch, for instance by a
+            // command processed while waiting for the peer to read it. Writing
+            // more now would split that batch, and waiting would never end.
+            ALOGE("Dropping oneway batch of %zu bytes, shutting down while writing a batch",
+                  mOnewayBatch->data.size());
+            mOnewayBatch->data.clear();
+            return DEAD_OBJECT;
+        }
+        if (mOnewayBatch->data.empty()) return OK;
+    }
+
+    status_t status = flushOnewayBatch(session);
+    if (status != OK) {
+        ALOGE("Failed to flush oneway batch before shutdown: %s", statusToString(status).c_str());
+    }
+    stopOnewayBatching();
+    return status;
+}
+
+void RpcState::stopOnewayBatching() {
+    if (mOnewayBatch == nullptr) return;
+
+    RpcMutexLockGuard _l(mOnewayBatch->mutex);
+    mOnewayBatch->stopped = true;
+    mOnewayBatch->data.clear();
+    mOnewayBatch->cv.notify_all();
+}
+
+void RpcState::onewayBatchFlusherLoop(std::shared_ptr<OnewayBatch> batch,
+                                      wp<RpcSession> weakSession) {
+    RpcMutexUniqueLock _l(batch->mutex);
+    while (!batch->stopped) {
+        if (batch->data.empty()) {
+            batch->cv.wait(_l);
+            continue;
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (now < batch->deadline) {
+            batch->cv.wait_for(_l, batch->deadline - now);
+            continue;
+        }
+        _l.unlock();
+
+        {
+            sp<RpcSession> session = weakSession.promote();
+            if (session == nullptr) return;
+
+            if (status_t status = session->state()->flushOnewayBatch(session); status != OK) {
+                ALOGE("Failed to flush oneway batch: %s", statusToString(status).c_str());
+                session->state()->stopOnewayBatching();
+            }
+        }
+
+        _l.lock();
+    }
+}
+
 status_t RpcState::getAndExecuteCommand(const sp<RpcSession::RpcConnection>& connection,
                                         const sp<RpcSession>& session, CommandType type) {
     LOG_RPC_DETAIL("getAndExecuteCommand on RpcTransport %p", connection->rpcTransport.get());
@@ -755,7 +1158,7 @@ status_t RpcState::getAndExecuteCommand(const sp<RpcSession::RpcConnection>& con
 status_t RpcState::drainCommands(const sp<RpcSession::RpcConnection>& connection,
                                  const sp<RpcSession>& session, CommandType type) {
     while (true) {
-        status_t status = connection->rpcTransport->pollRead();
+        status_t status = pollRead(connection);
         if (status == WOULD_BLOCK) break;
         if (status != OK) return status;
 
@@ -765,6 +1168,11 @@ status_t RpcState::drainCommands(const sp<RpcSession::RpcConnection>& connection
     return OK;
 }
 
+status_t RpcState::pollRead(const sp<RpcSession::RpcConnection>& connection) {
+    if (connection->readBufferBegin != connection->readBufferEnd) return OK;
+    return connection->rpcTransport->pollRead();
+}
+
 status_t RpcState::processCommand(
         const sp<RpcSession::RpcConnection>& connection, const sp<RpcSession>& session,
         const RpcWireHeader& command, CommandType type,
@@ -819,6 +1227,8 @@ status_t RpcState::processTransact(
     if (status_t status = rpcRec(connection, session, "transaction body", &iov, 1, nullptr);
         status != OK)
         return status;
+    // the whole command is read, and executing it may block
+    connection->framePoll = nullptr;
 
     return processTransactInternal(connection, session, std::move(transactionData),
                                    std::move(ancillaryFds));
@@ -879,8 +1289,9 @@ processTransactInternalTailCall:
             (void)session->shutdownAndWait(false);
             replyStatus = BAD_VALUE;
         } else if (oneway) {
-            RpcMutexUniqueLock _l(mNodeMutex);
-            auto it = mNodeForAddress.find(addr);
+            NodeShard& shard = shardForAddress(addr);
+            RpcMutexUniqueLock _l(shard.mutex);
+            auto it = shard.nodeForAddress.find(addr);
             if (it->second.binder.promote() != target) {
                 ALOGE("Binder became invalid during transaction. Bad client? %" PRIu64, addr);
                 replyStatus = BAD_VALUE;
@@ -928,10 +1339,13 @@ processTransactInternalTailCall:
                                           transactionData.size() -
                                                   offsetof(RpcWireTransaction, data)};
         Span<const uint32_t> objectTableSpan;
+        bool outOfLine = hasOutOfLineParcelData(session, transaction->parcelOptions);
         if (session->getProtocolVersion().value() >=
             RPC_WIRE_PROTOCOL_VERSION_RPC_HEADER_FEATURE_EXPLICIT_PARCEL_SIZE) {
-            std::optional<Span<const uint8_t>> objectTableBytes =
-                    parcelSpan.splitOff(transaction->parcelDataSize);
+            // Out of line data leaves only the object table in the body.
+            std::optional<Span<const uint8_t>> objectTableBytes = outOfLine
+                    ? std::make_optional(std::exchange(parcelSpan, {}))
+                    : parcelSpan.splitOff(transaction->parcelDataSize);
             if (!objectTableBytes.has_value()) {
                 ALOGE("Parcel size (%" PRId32 ") greater than available bytes (%zu). Terminating!",
                       transaction->parcelDataSize, parcelSpan.byteSize());
@@ -951,15 +1365,29 @@ processTransactInternalTailCall:
             objectTableSpan = *maybeSpan;
         }
 
+        if (outOfLine) {
+            if (status_t status = mapOutOfLineParcelData(&ancillaryFds,
+                                                         transaction->parcelDataSize,
+                                                         &parcelSpan.data);
+                status != OK) {
+                (void)session->shutdownAndWait(false);
+                return status;
+            }
+            parcelSpan.size = transaction->parcelDataSize;
+        }
+
         Parcel data;
         // transaction->data is owned by this function. Parcel borrows this data and
         // only holds onto it for the duration of this function call. Parcel will be
-        // deleted before the 'transactionData' object.
+        // deleted before the 'transactionData' object. Out of line data is owned by
+        // the Parcel.
 
         replyStatus =
                 data.rpcSetDataReference(session, parcelSpan.data, parcelSpan.size,
                                          objectTableSpan.data, objectTableSpan.size,
-                                         std::move(ancillaryFds), do_nothing_to_transact_data);
+                                         std::move(ancillaryFds),
+                                         outOfLine ? unmap_out_of_line_data
+                                                   : do_nothing_to_transact_data);
         // Reset to avoid spurious use-after-move warning from clang-tidy.
         ancillaryFds = std::remove_reference<decltype(ancillaryFds)>::type();
 
@@ -1028,10 +1456,11 @@ processTransactInternalTailCall:
         // downside: asynchronous transactions may drown out synchronous
         // transactions.
         {
-            RpcMutexUniqueLock _l(mNodeMutex);
-            auto it = mNodeForAddress.find(addr);
+            NodeShard& shard = shardForAddress(addr);
+            RpcMutexUniqueLock _l(shard.mutex);
+            auto it = shard.nodeForAddress.find(addr);
             // last refcount dropped after this transaction happened
-            if (it == mNodeForAddress.end()) return OK;
+            if (it == shard.nodeForAddress.end()) return OK;
 
             if (!nodeProgressAsyncNumber(&it->second)) {
                 _l.unlock();
@@ -1092,14 +1521,19 @@ processTransactInternalTailCall:
     Span<const uint32_t> objectTableSpan = Span<const uint32_t>{rpcFields->mObjectPositions.data(),
                                                                 rpcFields->mObjectPositions.size()};
 
+    base::unique_fd outOfLineDataFd;
+    std::vector<std::variant<base::unique_fd, base::borrowed_fd>> outOfLineFds;
+    bool outOfLine = moveParcelDataOutOfLine(session, reply, &outOfLineDataFd, &outOfLineFds);
+
     uint32_t bodySize;
     LOG_ALWAYS_FATAL_IF(__builtin_add_overflow(rpcReplyWireSize, reply.dataSize(), &bodySize) ||
                                 __builtin_add_overflow(objectTableSpan.byteSize(), bodySize,
                                                        &bodySize),
                         "Too much data for reply %zu", reply.dataSize());
+    const size_t inlineDataSize = outOfLine ? 0 : reply.dataSize();
     RpcWireHeader cmdReply{
             .command = RPC_COMMAND_REPLY,
-            .bodySize = bodySize,
+            .bodySize = bodySize - static_cast<uint32_t>(reply.dataSize() - inlineDataSize),
     };
     RpcWireReply rpcReply{
             .status = replyStatus,
@@ -1107,16 +1541,17 @@ processTransactInternalTailCall:
             // version.
             // NOTE: bodySize didn't overflow => this cast is safe
             .parcelDataSize = static_cast<uint32_t>(reply.dataSize()),
-            .reserved = {0, 0, 0},
+            .parcelOptions = outOfLine ? RPC_WIRE_PARCEL_OPTION_OUT_OF_LINE : 0,
+            .reserved = {0, 0},
     };
     iovec iovs[]{
             {&cmdReply, sizeof(RpcWireHeader)},
             {&rpcReply, rpcReplyWireSize},
-            {const_cast<uint8_t*>(reply.data()), reply.dataSize()},
+            {const_cast<uint8_t*>(reply.data()), inlineDataSize},
             objectTableSpan.toIovec(),
     };
     return rpcSend(connection, session, "reply", iovs, arraysize(iovs), std::nullopt,
-                   rpcFields->mFds.get());
+                   outOfLine ? &outOfLineFds : rpcFields->mFds.get());
 }
 
 status_t RpcState::processDecStrong(const sp<RpcSession::RpcConnection>& connection,
@@ -1135,11 +1570,13 @@ status_t RpcState::processDecStrong(const sp<RpcSession::RpcConnection>& connect
     if (status_t status = rpcRec(connection, session, "dec ref body", &iov, 1, nullptr);
         status != OK)
         return status;
+    connection->framePoll = nullptr;
 
     uint64_t addr = RpcWireAddress::toRaw(body.address);
-    RpcMutexUniqueLock _l(mNodeMutex);
-    auto it = mNodeForAddress.find(addr);
-    if (it == mNodeForAddress.end()) {
+    NodeShard& shard = shardForAddress(addr);
+    RpcMutexUniqueLock _l(shard.mutex);
+    auto it = shard.nodeForAddress.find(addr);
+    if (it == shard.nodeForAddress.end()) {
         ALOGE("Unknown binder address %" PRIu64 " for dec strong.", addr);
         return OK;
     }
@@ -1167,7 +1604,7 @@ status_t RpcState::processDecStrong(const sp<RpcSession::RpcConnection>& connect
                    it->second.timesSent);
 
     it->second.timesSent -= body.amount;
-    sp<IBinder> tempHold = tryEraseNode(session, std::move(_l), it);
+    sp<IBinder> tempHold = tryEraseNode(session, shard, std::move(_l), it);
     // LOCK ALREADY RELEASED
     tempHold = nullptr; // destructor may make binder calls on this session
 
@@ -1232,7 +1669,30 @@ status_t RpcState::validateParcel(const sp<RpcSession>& session, const Parcel& p
     return OK;
 }
 
-sp<IBinder> RpcState::tryEraseNode(const sp<RpcSession>& session, RpcMutexUniqueLock nodeLock,
+RpcState::NodeShard& RpcState::shardForAddress(uint64_t address) {
+    return mNodeShards[RpcWireAddress::fromRaw(address).address & (kNodeShards - 1)];
+}
+
+RpcState::NodeShard& RpcState::shardForBinder(const IBinder* binder) {
+    // heap pointers have little entropy in their lowest bits
+    uintptr_t bits = reinterpret_cast<uintptr_t>(binder);
+    return mNodeShards[((bits >> 4) ^ (bits >> 12) ^ (bits >> 20)) & (kNodeShards - 1)];
+}
+
+bool RpcState::isTerminated() const {
+    return mNodeCount & kNodeCountTerminated;
+}
+
+bool RpcState::reserveNode() {
+    size_t count = mNodeCount;
+    do {
+        if (count & kNodeCountTerminated) return false;
+    } while (!mNodeCount.compare_exchange_weak(count, count + 1));
+    return true;
+}
+
+sp<IBinder> RpcState::tryEraseNode(const sp<RpcSession>& session, NodeShard& shard,
+                                   RpcMutexUniqueLock nodeLock,
                                    std::map<uint64_t, BinderNode>::iterator& it) {
     bool shouldShutdown = false;
 
@@ -1244,24 +1704,32 @@ sp<IBinder> RpcState::tryEraseNode(const sp<RpcSession>& session, RpcMutexUnique
         if (it->second.timesRecd == 0) {
             LOG_ALWAYS_FATAL_IF(!it->second.asyncTodo.empty(),
                                 "Can't delete binder w/ pending async transactions");
-            mNodeForAddress.erase(it);
-
-            if (mNodeForAddress.size() == 0) {
-                shouldShutdown = true;
+            if (auto local = shard.addressForLocalBinder.find(it->second.binder.unsafe_get());
+                local != shard.addressForLocalBinder.end() && local->second == it->first) {
+                shard.addressForLocalBinder.erase(local);
             }
+            shard.nodeForAddress.erase(it);
+
+            // If this was the last node, terminate in the same step, so that no
+            // node can be added in another shard in the meantime.
+            size_t count = mNodeCount;
+            size_t newCount;
+            do {
+                newCount = count == 1 ? kNodeCountTerminated : count - 1;
+            } while (!mNodeCount.compare_exchange_weak(count, newCount));
+            shouldShutdown = count == 1;
         }
     }
 
+    nodeLock.unlock(); // explicit
+    // LOCK IS RELEASED
+
     // If we shutdown, prevent RpcState from being re-used. This prevents another
     // thread from getting the root object again.
     if (shouldShutdown) {
-        clear(std::move(nodeLock));
-    } else {
-        nodeLock.unlock(); // explicit
-    }
-    // LOCK IS RELEASED
+        (void)flushAndStopOnewayBatching(session);
+        clearNodes();
 
-    if (shouldShutdown) {
         ALOGI("RpcState has no binders left, so triggering shutdown...");
         (void)session->shutdownAndWait(false);
     }
@@ -21,7 +21,11 @@
 #include <binder/RpcSession.h>
 #include <binder/RpcThreads.h>
 
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <map>
+#include <memory>
 #include <optional>
 #include <queue>
 
@@ -87,6 +91,20 @@ public:
                                            const sp<RpcSession>& session, Parcel* reply,
                                            uint32_t flags);
 
+    /**
+     * Buffer oneway transactions instead of writing them immediately, see
+     * RpcSession::setOnewayBatching. Must be called before any transaction is
+     * sent. A |maxBytes| of 0 disables batching.
+     */
+    void setOnewayBatching(size_t maxBytes, std::chrono::microseconds maxDelay);
+
+    /**
+     * Writes buffered oneway transactions, which the caller was already told
+     * were sent, and stops batching, so that later oneway transactions fail.
+     * Called before shutting down a session in an orderly way.
+     */
+    [[nodiscard]] status_t flushAndStopOnewayBatching(const sp<RpcSession>& session);
+
     /**
      * The ownership model here carries an implicit strong refcount whenever a
      * binder is sent across processes. Since we have a local strong count in
@@ -118,6 +136,11 @@ public:
                                                 const sp<RpcSession>& session, CommandType type);
     [[nodiscard]] status_t drainCommands(const sp<RpcSession::RpcConnection>& connection,
                                          const sp<RpcSession>& session, CommandType type);
+    /**
+     * Like RpcTransport::pollRead, but also returns OK when data read ahead
+     * from the connection is waiting to be parsed.
+     */
+    [[nodiscard]] status_t pollRead(const sp<RpcSession::RpcConnection>& connection);
 
     /**
      * Called by Parcel for outgoing binders. This implies one refcount of
@@ -168,9 +191,6 @@ public:
     void clear();
 
 private:
-    void clear(RpcMutexUniqueLock nodeLock);
-    void dumpLocked();
-
     // Alternative to std::vector<uint8_t> that doesn't abort on allocation failure and caps
     // large allocations to avoid being requested from allocating too much data.
     struct CommandData {
@@ -195,6 +215,10 @@ private:
             const sp<RpcSession::RpcConnection>& connection, const sp<RpcSession>& session,
             const char* what, iovec* iovs, int niovs,
             std::vector<std::variant<base::unique_fd, base::borrowed_fd>>* ancillaryFds = nullptr);
+    [[nodiscard]] status_t rpcRecBuffered(
+            const sp<RpcSession::RpcConnection>& connection, const sp<RpcSession>& session,
+            iovec* iovs, int niovs,
+            const std::optional<android::base::function_ref<status_t()>>& altPoll);
 
     [[nodiscard]] status_t waitForReply(const sp<RpcSession::RpcConnection>& connection,
                                         const sp<RpcSession>& session, Parcel* reply);
@@ -214,6 +238,61 @@ private:
                                             const sp<RpcSession>& session,
                                             const RpcWireHeader& command);
 
+    // Oneway transactions which have been serialized but not written yet. This
+    // is shared with the thread which flushes the batch when its deadline
+    // passes, so that thread doesn't keep the session alive.
+    struct OnewayBatch {
+        size_t maxBytes = 0;
+        std::chrono::microseconds maxDelay{0};
+
+        RpcMutex mutex; // for all below
+        RpcConditionVariable cv;
+        bool stopped = false;
+        bool flusherStarted = false;
+        std::vector<uint8_t> data;
+        std::chrono::steady_clock::time_point deadline;
+        // The thread writing a batch taken out of |data|, if any. No lock is
+        // held while it writes. Other threads wait on |cv| for the batch to
+        // be on the wire before sending anything after flushing.
+        RpcMaybeThread::id flushingThread;
+    };
+
+    // Appends a command to the batch, starting its deadline if it was empty.
+    // Returns whether the batch should be flushed now. Requires
+    // mOnewayBatch->mutex.
+    bool appendToOnewayBatchLocked(const sp<RpcSession>& session, const iovec* iovs, int niovs);
+
+    // Writes buffered oneway transactions, if any, to |connection|. Must be
+    // called before sending any other command on an outgoing connection.
+    [[nodiscard]] status_t flushOnewayBatch(const sp<RpcSession::RpcConnection>& connection,
+                                            const sp<RpcSession>& session);
+    // Same, on any outgoing connection of |session|.
+    [[nodiscard]] status_t flushOnewayBatch(const sp<RpcSession>& session);
+    // Drops buffered oneway transactions, and fails any later ones. Called
+    // before shutting down a session after an error, since the batch can't be
+    // written in order anymore.
+    void stopOnewayBatching();
+    // Flushes the batch of one session when its deadline passes. Each session
+    // has its own thread, so that a peer which stops reading only delays the
+    // oneway transactions sent to it. The thread exits once batching stops.
+    static void onewayBatchFlusherLoop(std::shared_ptr<OnewayBatch> batch,
+                                       wp<RpcSession> weakSession);
+
+    // If the data of |parcel| should be sent out of line to |session|, copies it
+    // into a sealed memfd in |outDataFd| and sets |outFds| to the file
+    // descriptors to send instead of the Parcel's own, followed by the memfd.
+    static bool moveParcelDataOutOfLine(
+            const sp<RpcSession>& session, const Parcel& parcel, base::unique_fd* outDataFd,
+            std::vector<std::variant<base::unique_fd, base::borrowed_fd>>* outFds);
+    // Whether Parcel data received on |session| with |parcelOptions| is in a
+    // memfd at the end of the received file descriptors.
+    static bool hasOutOfLineParcelData(const sp<RpcSession>& session, uint32_t parcelOptions);
+    // Takes the memfd holding out of line Parcel data off the end of
+    // |ancillaryFds| and maps it.
+    [[nodiscard]] static status_t mapOutOfLineParcelData(
+            std::vector<std::variant<base::unique_fd, base::borrowed_fd>>* ancillaryFds,
+            uint32_t dataSize, const uint8_t** outData);
+
     // Whether `parcel` is compatible with `session`.
     [[nodiscard]] static status_t validateParcel(const sp<RpcSession>& session,
                                                  const Parcel& parcel, std::string* errorMsg);
@@ -269,6 +348,31 @@ private:
         std::string toString() const;
     };
 
+    // Nodes are split into shards by address, each with its own lock, so that
+    // threads working on unrelated binders don't contend. Addresses created by
+    // this process are picked so that a local binder's node is in the shard for
+    // its pointer (see shardForBinder).
+    static constexpr size_t kNodeShards = 16;
+    static_assert((kNodeShards & (kNodeShards - 1)) == 0, "must be a power of two");
+
+    struct NodeShard {
+        RpcMutex mutex; // for all below
+        // set when this shard was emptied by clear()
+        bool cleared = false;
+        // binders known by both sides of a session
+        std::map<uint64_t, BinderNode> nodeForAddress;
+        // addresses of local binders in nodeForAddress
+        std::map<const IBinder*, uint64_t> addressForLocalBinder;
+    };
+
+    NodeShard& shardForAddress(uint64_t address);
+    NodeShard& shardForBinder(const IBinder* binder);
+    bool isTerminated() const;
+
+    // Accounts for a node which is about to be added. Fails if the state has
+    // been terminated.
+    [[nodiscard]] bool reserveNode();
+
     // Checks if there is any reference left to a node and erases it. If this
     // is the last node, shuts down the session.
     //
@@ -279,19 +383,29 @@ private:
     // lock and instead just return whether or not we should shutdown, but
     // this introduces the posssibility that another thread calls
     // getRootBinder and thinks it is valid, rather than immediately getting
-    // an error.
-    sp<IBinder> tryEraseNode(const sp<RpcSession>& session, RpcMutexUniqueLock nodeLock,
+    // an error. This is prevented by terminating in the same atomic step which
+    // finds that the last node is gone (see mNodeCount).
+    sp<IBinder> tryEraseNode(const sp<RpcSession>& session, NodeShard& shard,
+                             RpcMutexUniqueLock nodeLock,
                              std::map<uint64_t, BinderNode>::iterator& it);
 
+    // Empties every shard. Must only be called once the state is terminated.
+    void clearNodes();
+    void dumpLocked(const NodeShard& shard);
+
     // true - success
     // false - session shutdown, halt
     [[nodiscard]] bool nodeProgressAsyncNumber(BinderNode* node);
 
-    RpcMutex mNodeMutex;
-    bool mTerminated = false;
-    uint32_t mNextId = 0;
-    // binders known by both sides of a session
-    std::map<uint64_t, BinderNode> mNodeForAddress;
+    std::array<NodeShard, kNodeShards> mNodeShards;
+    // Number of nodes in all shards, or'd with kNodeCountTerminated once this
+    // state has been terminated, after which no nodes can be added.
+    static constexpr size_t kNodeCountTerminated = size_t(1) << (sizeof(size_t) * 8 - 1);
+    std::atomic<size_t> mNodeCount = 0;
+    std::atomic<uint32_t> mNextId = 0;
+
+    // null unless batching is enabled
+    std::shared_ptr<OnewayBatch> mOnewayBatch;
 };
 
 } // namespace android
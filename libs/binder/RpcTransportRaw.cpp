@@ -81,6 +81,40 @@ public:
                                         altPoll);
     }
 
+    status_t interruptableReadAvailable(
+            FdTrigger* fdTrigger, void* data, size_t size, size_t* outSize,
+            const std::optional<android::base::function_ref<status_t()>>& altPoll) override {
+        if (size == 0) return BAD_VALUE;
+        if (fdTrigger->isTriggered()) return DEAD_OBJECT;
+
+        // Usually the data is already there, so try without waiting first.
+        ssize_t ret = TEMP_FAILURE_RETRY(::recv(mSocket.fd.get(), data, size, MSG_DONTWAIT));
+        if (ret > 0) {
+            *outSize = static_cast<size_t>(ret);
+            return OK;
+        }
+        if (ret == 0) return DEAD_OBJECT;
+        if (int savedErrno = errno; savedErrno != EAGAIN && savedErrno != EWOULDBLOCK) {
+            LOG_RPC_DETAIL("RpcTransport recv(): %s", strerror(savedErrno));
+            return -savedErrno;
+        }
+
+        // Wait for one byte, then take whatever else came with it.
+        iovec iov{data, 1};
+        if (status_t status = interruptableReadFully(fdTrigger, &iov, 1, altPoll, nullptr);
+            status != OK) {
+            return status;
+        }
+        *outSize = 1;
+        if (size > 1) {
+            ret = TEMP_FAILURE_RETRY(::recv(mSocket.fd.get(), static_cast<uint8_t*>(data) + 1,
+                                            size - 1, MSG_DONTWAIT));
+            // Any error is reported by the next read.
+            if (ret > 0) *outSize += static_cast<size_t>(ret);
+        }
+        return OK;
+    }
+
     virtual bool isWaiting() { return mSocket.isInPollingState(); }
 
 private:
@@ -0,0 +1,510 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "RpcShmTransport"
+#include <log/log.h>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+
+#include <android-base/scopeguard.h>
+
+#include <binder/RpcTransportShm.h>
+
+#include "FdTrigger.h"
+#include "OS.h"
+#include "RpcState.h"
+#include "RpcTransportUtils.h"
+
+namespace android {
+
+using base::borrowed_fd;
+using base::unique_fd;
+
+namespace {
+
+constexpr uint32_t kShmMagic = 0x42534d31; // "BSM1"
+constexpr size_t kMinRingCapacity = 4096;
+constexpr size_t kMaxRingCapacity = 16 * 1024 * 1024;
+
+// How many times a ring is re-checked before parking on the socket. This keeps
+// short request/reply exchanges between two busy peers free of syscalls.
+constexpr size_t kSpinCount = 1024;
+
+// Control block for one direction. Positions are free-running and wrap at 2^32.
+// Each side only trusts its own local copy of the position it owns.
+struct ShmRingControl {
+    alignas(64) std::atomic<uint32_t> writePos;
+    alignas(64) std::atomic<uint32_t> readPos;
+    // Set by a side right before it parks on the socket. Whoever makes progress
+    // on the ring clears it and sends a wake-up byte over the socket.
+    alignas(64) std::atomic<uint32_t> readerParked;
+    std::atomic<uint32_t> writerParked;
+};
+
+struct ShmHeader {
+    uint32_t magic;
+    uint32_t ringCapacity;
+    ShmRingControl clientToServer;
+    ShmRingControl serverToClient;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free);
+
+size_t shmSize(size_t ringCapacity) {
+    return sizeof(ShmHeader) + 2 * ringCapacity;
+}
+
+bool isValidRingCapacity(size_t ringCapacity) {
+    return ringCapacity >= kMinRingCapacity && ringCapacity <= kMaxRingCapacity &&
+            (ringCapacity & (ringCapacity - 1)) == 0;
+}
+
+class ShmMapping {
+public:
+    ShmMapping(void* addr, size_t size) : mAddr(addr), mSize(size) {}
+    ~ShmMapping() {
+        if (mAddr != MAP_FAILED) munmap(mAddr, mSize);
+    }
+    ShmMapping(const ShmMapping&) = delete;
+    ShmMapping& operator=(const ShmMapping&) = delete;
+
+    static std::unique_ptr<ShmMapping> map(borrowed_fd fd, size_t size) {
+        void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+        if (addr == MAP_FAILED) {
+            int savedErrno = errno;
+            ALOGE("Failed to map shared memory of size %zu: %s", size, strerror(savedErrno));
+            return nullptr;
+        }
+        return std::make_unique<ShmMapping>(addr, size);
+    }
+
+    uint8_t* data() const { return reinterpret_cast<uint8_t*>(mAddr); }
+    ShmHeader* header() const { return reinterpret_cast<ShmHeader*>(mAddr); }
+
+private:
+    void* mAddr;
+    size_t mSize;
+};
+
+// One direction of the transport, as seen by one of the two sides.
+class ShmRing {
+public:
+    ShmRing(ShmRingControl* control, uint8_t* data, uint32_t capacity)
+          : mControl(control), mData(data), mCapacity(capacity) {}
+
+    ShmRingControl* control() const { return mControl; }
+
+    // Bytes which can be read, or -1 if the peer corrupted the ring.
+    ssize_t readable() const {
+        uint32_t used = mControl->writePos.load() - mPos;
+        return used > mCapacity ? -1 : static_cast<ssize_t>(used);
+    }
+
+    // Bytes which can be written, or -1 if the peer corrupted the ring.
+    ssize_t writable() const {
+        uint32_t used = mPos - mControl->readPos.load();
+        return used > mCapacity ? -1 : static_cast<ssize_t>(mCapacity - used);
+    }
+
+    ssize_t read(uint8_t* dst, size_t size) {
+        ssize_t avail = readable();
+        if (avail <= 0) return avail;
+        uint32_t n = static_cast<uint32_t>(std::min(static_cast<size_t>(avail), size));
+        copyOut(dst, n);
+        mPos += n;
+        mControl->readPos.store(mPos);
+        return n;
+    }
+
+    ssize_t write(const uint8_t* src, size_t size) {
+        ssize_t avail = writable();
+        if (avail <= 0) return avail;
+        uint32_t n = static_cast<uint32_t>(std::min(static_cast<size_t>(avail), size));
+        copyIn(src, n);
+        mPos += n;
+        mControl->writePos.store(mPos);
+        return n;
+    }
+
+private:
+    void copyOut(uint8_t* dst, uint32_t n) const {
+        uint32_t offset = mPos & (mCapacity - 1);
+        uint32_t first = std::min(n, mCapacity - offset);
+        memcpy(dst, mData + offset, first);
+        memcpy(dst + first, mData, n - first);
+    }
+    void copyIn(const uint8_t* src, uint32_t n) {
+        uint32_t offset = mPos & (mCapacity - 1);
+        uint32_t first = std::min(n, mCapacity - offset);
+        memcpy(mData + offset, src, first);
+        memcpy(mData, src + first, n - first);
+    }
+
+    ShmRingControl* mControl;
+    uint8_t* mData;
+    uint32_t mCapacity;
+    // Local copy of readPos (for the receiving ring) or writePos (for the
+    // sending ring).
+    uint32_t mPos = 0;
+};
+
+// RpcTransport backed by shared memory.
+class RpcTransportShm : public RpcTransport {
+public:
+    RpcTransportShm(android::RpcTransportFd socket, std::unique_ptr<ShmMapping> mapping,
+                    uint32_t ringCapacity, bool isServer)
+          : mSocket(std::move(socket)),
+            mMapping(std::move(mapping)),
+            mTx(isServer ? &mMapping->header()->serverToClient
+                         : &mMapping->header()->clientToServer,
+                mMapping->data() + sizeof(ShmHeader) + (isServer ? ringCapacity : 0),
+                ringCapacity),
+            mRx(isServer ? &mMapping->header()->clientToServer
+                         : &mMapping->header()->serverToClient,
+                mMapping->data() + sizeof(ShmHeader) + (isServer ? 0 : ringCapacity),
+                ringCapacity) {}
+
+    status_t pollRead(void) override {
+        ssize_t avail = mRx.readable();
+        if (avail < 0) return BAD_VALUE;
+        if (avail > 0) return OK;
+
+        // Nothing in the ring, but check whether the peer is still around.
+        uint8_t buf;
+        ssize_t ret = TEMP_FAILURE_RETRY(
+                ::recv(mSocket.fd.get(), &buf, sizeof(buf), MSG_PEEK | MSG_DONTWAIT));
+        if (ret < 0) {
+            int savedErrno = errno;
+            if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK) {
+                return WOULD_BLOCK;
+            }
+
+            LOG_RPC_DETAIL("RpcTransport poll(): %s", strerror(savedErrno));
+            return -savedErrno;
+        } else if (ret == 0) {
+            return DEAD_OBJECT;
+        }
+
+        // Only wake-up bytes are pending.
+        return WOULD_BLOCK;
+    }
+
+    status_t interruptableWriteFully(
+            FdTrigger* fdTrigger, iovec* iovs, int niovs,
+            const std::optional<android::base::function_ref<status_t()>>& altPoll,
+            const std::vector<std::variant<base::unique_fd, base::borrowed_fd>>* ancillaryFds)
+            override {
+        // Like TLS, file descriptors are dropped here, and the receiver rejects
+        // any parcel which is missing them.
+        (void)ancillaryFds;
+
+        MAYBE_WAIT_IN_FLAKE_MODE;
+
+        if (niovs < 0) {
+            return BAD_VALUE;
+        }
+        if (fdTrigger->isTriggered()) {
+            return DEAD_OBJECT;
+        }
+
+        for (int i = 0; i < niovs; i++) {
+            auto* buf = reinterpret_cast<const uint8_t*>(iovs[i].iov_base);
+            size_t remaining = iovs[i].iov_len;
+            while (remaining > 0) {
+                ssize_t written = mTx.write(buf, remaining);
+                if (written < 0) return BAD_VALUE;
+                if (written > 0) {
+                    buf += written;
+                    remaining -= written;
+                    continue;
+                }
+
+                // The ring is full. Make sure the reader is going to drain it
+                // before waiting for space.
+                if (status_t status = wakePeer(&mTx.control()->readerParked); status != OK) {
+                    return status;
+                }
+                if (altPoll) {
+                    if (status_t status = (*altPoll)(); status != OK) return status;
+                }
+                // With altPoll, incoming data must also wake us up so that it can
+                // be drained, otherwise both sides could be waiting on each other.
+                status_t status = waitFor(
+                        fdTrigger, &mTx.control()->writerParked,
+                        altPoll ? &mRx.control()->readerParked : nullptr,
+                        [&] { return mTx.writable() != 0 || (altPoll && mRx.readable() != 0); });
+                if (status != OK) return status;
+            }
+        }
+
+        return wakePeer(&mTx.control()->readerParked);
+    }
+
+    status_t interruptableReadFully(
+            FdTrigger* fdTrigger, iovec* iovs, int niovs,
+            const std::optional<android::base::function_ref<status_t()>>& altPoll,
+            std::vector<std::variant<base::unique_fd, base::borrowed_fd>>* /*ancillaryFds*/)
+            override {
+        MAYBE_WAIT_IN_FLAKE_MODE;
+
+        if (niovs < 0) {
+            return BAD_VALUE;
+        }
+        if (fdTrigger->isTriggered()) {
+            return DEAD_OBJECT;
+        }
+
+        for (int i = 0; i < niovs; i++) {
+            auto* buf = reinterpret_cast<uint8_t*>(iovs[i].iov_base);
+            size_t remaining = iovs[i].iov_len;
+            while (remaining > 0) {
+                ssize_t read = mRx.read(buf, remaining);
+                if (read < 0) return BAD_VALUE;
+                if (read > 0) {
+                    buf += read;
+                    remaining -= read;
+                    continue;
+                }
+
+                // The ring is empty. Let a writer blocked on a full ring continue
+                // before waiting for more data.
+                if (status_t status = wakePeer(&mRx.control()->writerParked); status != OK) {
+                    return status;
+                }
+                if (altPoll) {
+                    if (status_t status = (*altPoll)(); status != OK) return status;
+                }
+                status_t status = waitFor(fdTrigger, &mRx.control()->readerParked, nullptr,
+                                          [&] { return mRx.readable() != 0; });
+                if (status != OK) return status;
+            }
+        }
+
+        return wakePeer(&mRx.control()->writerParked);
+    }
+
+    bool isWaiting() override { return mSocket.isInPollingState(); }
+
+private:
+    // If the peer parked itself on |parked|, wake it up.
+    status_t wakePeer(std::atomic<uint32_t>* parked) {
+        if (parked->load() == 0 || parked->exchange(0) == 0) return OK;
+
+        uint8_t byte = 0;
+        ssize_t ret = TEMP_FAILURE_RETRY(
+                ::send(mSocket.fd.get(), &byte, sizeof(byte), MSG_NOSIGNAL | MSG_DONTWAIT));
+        if (ret < 0) {
+            int savedErrno = errno;
+            // A full socket buffer means a wake-up is already pending.
+            if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK) return OK;
+            LOG_RPC_DETAIL("RpcTransport send(): %s", strerror(savedErrno));
+            return savedErrno == EPIPE ? DEAD_OBJECT : -savedErrno;
+        }
+        return OK;
+    }
+
+    // Spins briefly on |ready|, then parks on the socket until the peer wakes
+    // us up. Spurious wake-ups are fine, callers re-check the rings.
+    template <typename Ready>
+    status_t waitFor(FdTrigger* fdTrigger, std::atomic<uint32_t>* parked,
+                     std::atomic<uint32_t>* alsoParked, Ready ready) {
+        for (size_t i = 0; i < kSpinCount; i++) {
+            if (ready()) return OK;
+        }
+
+        // The peer clears the flags after publishing a new position, and the
+        // flags are set before re-checking, so a wake-up can't be missed.
+        parked->store(1);
+        if (alsoParked != nullptr) alsoParked->store(1);
+        auto clearFlags = base::make_scope_guard([&] {
+            parked->store(0);
+            if (alsoParked != nullptr) alsoParked->store(0);
+        });
+        if (ready()) return OK;
+
+        if (status_t status = fdTrigger->triggerablePoll(mSocket, POLLIN); status != OK) {
+            return status;
+        }
+
+        // Drain wake-up bytes.
+        uint8_t buf[64];
+        while (true) {
+            ssize_t ret = TEMP_FAILURE_RETRY(
+                    ::recv(mSocket.fd.get(), buf, sizeof(buf), MSG_DONTWAIT));
+            if (ret > 0) continue;
+            if (ret == 0) {
+                // The peer is gone, but it may have published data before leaving.
+                return ready() ? OK : DEAD_OBJECT;
+            }
+            int savedErrno = errno;
+            if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK) return OK;
+            LOG_RPC_DETAIL("RpcTransport recv(): %s", strerror(savedErrno));
+            return -savedErrno;
+        }
+    }
+
+    android::RpcTransportFd mSocket;
+    std::unique_ptr<ShmMapping> mMapping;
+    ShmRing mTx;
+    ShmRing mRx;
+};
+
+// Client side: allocates the shared memory and sends it to the server.
+class RpcTransportCtxShmClient : public RpcTransportCtx {
+public:
+    explicit RpcTransportCtxShmClient(size_t ringCapacity) : mRingCapacity(ringCapacity) {}
+
+    std::unique_ptr<RpcTransport> newTransport(android::RpcTransportFd socket,
+                                               FdTrigger* fdTrigger) const override {
+        size_t size = shmSize(mRingCapacity);
+        unique_fd memfd(memfd_create("RpcTransportShm", MFD_CLOEXEC | MFD_ALLOW_SEALING));
+        if (!memfd.ok()) {
+            int savedErrno = errno;
+            ALOGE("Failed memfd_create: %s", strerror(savedErrno));
+            return nullptr;
+        }
+        if (ftruncate(memfd.get(), static_cast<off_t>(size)) != 0) {
+            int savedErrno = errno;
+            ALOGE("Failed ftruncate(%zu): %s", size, strerror(savedErrno));
+            return nullptr;
+        }
+        // The server maps this memory as well, so it must not be able to change size.
+        if (fcntl(memfd.get(), F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0) {
+            int savedErrno = errno;
+            ALOGE("Failed to seal shared memory: %s", strerror(savedErrno));
+            return nullptr;
+        }
+
+        auto mapping = ShmMapping::map(memfd, size);
+        if (mapping == nullptr) return nullptr;
+        ShmHeader* header = new (mapping->data()) ShmHeader{};
+        header->magic = kShmMagic;
+        header->ringCapacity = static_cast<uint32_t>(mRingCapacity);
+
+        uint8_t byte = 0;
+        iovec iov{&byte, sizeof(byte)};
+        std::vector<std::variant<unique_fd, borrowed_fd>> fds;
+        fds.emplace_back(borrowed_fd(memfd));
+        auto send = [&](iovec* iovs, int niovs) -> ssize_t {
+            return sendMessageOnSocket(socket, iovs, niovs, &fds);
+        };
+        if (status_t status = interruptableReadOrWrite(socket, fdTrigger, &iov, 1, send, "sendmsg",
+                                                       POLLOUT, std::nullopt);
+            status != OK) {
+            ALOGE("Failed to send shared memory to server: %s", statusToString(status).c_str());
+            return nullptr;
+        }
+
+        return std::make_unique<RpcTransportShm>(std::move(socket), std::move(mapping),
+                                                 static_cast<uint32_t>(mRingCapacity), false /*isServer*/);
+    }
+    std::vector<uint8_t> getCertificate(RpcCertificateFormat) const override { return {}; }
+    // The data goes through the shared memory rings rather than the socket.
+    bool signalsIncomingDataOnFd() const override { return false; }
+
+private:
+    size_t mRingCapacity;
+};
+
+// Server side: receives and validates the shared memory from the client.
+class RpcTransportCtxShmServer : public RpcTransportCtx {
+public:
+    std::unique_ptr<RpcTransport> newTransport(android::RpcTransportFd socket,
+                                               FdTrigger* fdTrigger) const override {
+        uint8_t byte;
+        iovec iov{&byte, sizeof(byte)};
+        std::vector<std::variant<unique_fd, borrowed_fd>> fds;
+        auto recv = [&](iovec* iovs, int niovs) -> ssize_t {
+            return receiveMessageFromSocket(socket, iovs, niovs, &fds);
+        };
+        if (status_t status = interruptableReadOrWrite(socket, fdTrigger, &iov, 1, recv, "recvmsg",
+                                                       POLLIN, std::nullopt);
+            status != OK) {
+            ALOGE("Failed to receive shared memory from client: %s",
+                  statusToString(status).c_str());
+            return nullptr;
+        }
+        if (fds.size() != 1) {
+            ALOGE("Expected 1 shared memory fd from client, got %zu", fds.size());
+            return nullptr;
+        }
+        unique_fd memfd = std::move(std::get<unique_fd>(fds[0]));
+
+        // Without these seals, the client could truncate the memory and crash us
+        // with SIGBUS.
+        int seals = fcntl(memfd.get(), F_GET_SEALS);
+        constexpr int kRequiredSeals = F_SEAL_SHRINK | F_SEAL_SEAL;
+        if (seals < 0 || (seals & kRequiredSeals) != kRequiredSeals) {
+            ALOGE("Shared memory from client is not sealed: %d", seals);
+            return nullptr;
+        }
+        struct stat st;
+        if (fstat(memfd.get(), &st) != 0 || st.st_size < static_cast<off_t>(sizeof(ShmHeader))) {
+            ALOGE("Invalid shared memory from client");
+            return nullptr;
+        }
+
+        auto mapping = ShmMapping::map(memfd, static_cast<size_t>(st.st_size));
+        if (mapping == nullptr) return nullptr;
+        uint32_t magic = mapping->header()->magic;
+        uint32_t ringCapacity = mapping->header()->ringCapacity;
+        if (magic != kShmMagic || !isValidRingCapacity(ringCapacity) ||
+            static_cast<size_t>(st.st_size) < shmSize(ringCapacity)) {
+            ALOGE("Invalid shared memory header from client: magic %" PRIx32 " capacity %" PRIu32,
+                  magic, ringCapacity);
+            return nullptr;
+        }
+
+        return std::make_unique<RpcTransportShm>(std::move(socket), std::move(mapping),
+                                                 ringCapacity, true /*isServer*/);
+    }
+    std::vector<uint8_t> getCertificate(RpcCertificateFormat) const override { return {}; }
+    // The data goes through the shared memory rings rather than the socket.
+    bool signalsIncomingDataOnFd() const override { return false; }
+};
+
+} // namespace
+
+std::unique_ptr<RpcTransportCtx> RpcTransportCtxFactoryShm::newServerCtx() const {
+    return std::make_unique<RpcTransportCtxShmServer>();
+}
+
+std::unique_ptr<RpcTransportCtx> RpcTransportCtxFactoryShm::newClientCtx() const {
+    return std::make_unique<RpcTransportCtxShmClient>(mRingCapacity);
+}
+
+const char* RpcTransportCtxFactoryShm::toCString() const {
+    return "shm";
+}
+
+std::unique_ptr<RpcTransportCtxFactory> RpcTransportCtxFactoryShm::make(size_t ringCapacity) {
+    if (!isValidRingCapacity(ringCapacity)) {
+        ALOGE("Invalid shared memory ring capacity %zu", ringCapacity);
+        return nullptr;
+    }
+    return std::unique_ptr<RpcTransportCtxFactoryShm>(new RpcTransportCtxFactoryShm(ringCapacity));
+}
+
+} // namespace android
@@ -76,6 +76,13 @@ struct RpcOutgoingConnectionInit {
 };
 static_assert(sizeof(RpcOutgoingConnectionInit) == 8);
 
+/**
+ * The Parcel data is not included in the body of the transaction or reply.
+ * Instead, it is in a sealed memfd, sent as the last file descriptor of the
+ * command. The body only contains the object table.
+ */
+constexpr uint32_t RPC_WIRE_PARCEL_OPTION_OUT_OF_LINE = 1 << 0;
+
 enum : uint32_t {
     /**
      * follows is RpcWireTransaction, if flags != oneway, reply w/ RPC_COMMAND_REPLY expected
@@ -139,7 +146,11 @@ struct RpcWireTransaction {
     // The size of the Parcel data directly following RpcWireTransaction.
     uint32_t parcelDataSize;
 
-    uint32_t reserved[3];
+    // RPC_WIRE_PARCEL_OPTION_*, starting at protocol version
+    // RPC_WIRE_PROTOCOL_VERSION_RPC_HEADER_FEATURE_OUT_OF_LINE_DATA.
+    uint32_t parcelOptions;
+
+    uint32_t reserved[2];
 
     uint8_t data[];
 };
@@ -153,7 +164,11 @@ struct RpcWireReply {
     // The size of the Parcel data directly following RpcWireReply.
     uint32_t parcelDataSize;
 
-    uint32_t reserved[3];
+    // RPC_WIRE_PARCEL_OPTION_*, starting at protocol version
+    // RPC_WIRE_PROTOCOL_VERSION_RPC_HEADER_FEATURE_OUT_OF_LINE_DATA.
+    uint32_t parcelOptions;
+
+    uint32_t reserved[2];
 
     // Byte size of RpcWireReply in the wire protocol.
     static size_t wireSize(uint32_t protocolVersion) {
@@ -997,17 +997,26 @@ private:
         using T = first_template_type_t<CT>;  // The T in CT == C<T, ...>
         if (c.size() >  std::numeric_limits<int32_t>::max()) return BAD_VALUE;
         const auto size = static_cast<int32_t>(c.size());
-        writeData(size);
         if constexpr (is_pointer_equivalent_array_v<T>) {
-            constexpr size_t limit = std::numeric_limits<size_t>::max() / sizeof(T);
+            constexpr size_t limit =
+                    (std::numeric_limits<int32_t>::max() - sizeof(int32_t)) / sizeof(T);
             if (c.size() > limit) return BAD_VALUE;
             // is_pointer_equivalent types do not have gaps which could leak info,
             // which is only a concern when writing through binder.
 
-            // TODO: Padding of the write is suboptimal when the length of the
-            // data is not a multiple of 4.  Consider improving the write() method.
-            return write(c.data(), c.size() * sizeof(T));
-        } else if constexpr (std::is_same_v<T, bool>
+            // Reserve the size and the contents together, so that bounds checks
+            // and growth of the Parcel only happen once for the whole vector.
+            const size_t dataLen = c.size() * sizeof(T);
+            auto data = reinterpret_cast<uint8_t*>(writeInplace(sizeof(int32_t) + dataLen));
+            // writeInplace doesn't set mError. The size was checked above, so
+            // growing the Parcel failed.
+            if (data == nullptr) return NO_MEMORY;
+            memcpy(data, &size, sizeof(int32_t));
+            if (dataLen > 0) memcpy(data + sizeof(int32_t), c.data(), dataLen);
+            return OK;
+        }
+        writeData(size);
+        if constexpr (std::is_same_v<T, bool>
                 || std::is_same_v<T, char16_t>) {
             // reserve data space to write to
             auto data = reinterpret_cast<int32_t*>(writeInplace(c.size() * sizeof(int32_t)));
@@ -132,6 +132,29 @@ public:
     void setMaxThreads(size_t threads);
     size_t getMaxThreads();
 
+    /**
+     * By default, join() starts a thread for each incoming connection, which
+     * stays blocked reading from it while the connection is idle. If this is
+     * set to a non-zero number, join() instead waits for commands on all
+     * connections in a single epoll set, and only that many worker threads
+     * process them. This keeps the number of threads a server uses bounded,
+     * regardless of the number of clients, for servers with many mostly idle
+     * clients.
+     *
+     * A worker executes a command until it returns, so handlers which block
+     * for a long time, or which make calls that can only complete once another
+     * command from a client is executed on this server, take a worker while
+     * they wait. If all workers are taken this way, the server deadlocks.
+     * Nested calls back to the client on the same connection are fine. A
+     * client which stops sending in the middle of a command has its session
+     * shut down after a timeout.
+     *
+     * Must be called before join(). Requires threads, and a transport which
+     * signals incoming data on its socket (not RpcTransportCtxFactoryShm).
+     * Aborts otherwise.
+     */
+    void setEventLoopThreads(size_t threads);
+
     /**
      * By default, the latest protocol version which is supported by a client is
      * used. However, this can be used in order to prevent newer protocol
@@ -245,6 +268,9 @@ private:
             sp<RpcServer>&& server, RpcTransportFd clientFd,
             std::array<uint8_t, kRpcAddressSize> addr, size_t addrLen,
             std::function<void(sp<RpcSession>&&, RpcSession::PreJoinSetupResult&&)>&& joinFn);
+    class EventLoop;
+    static void joinEventLoop(int fd, sp<RpcSession>&& session,
+                              RpcSession::PreJoinSetupResult&& setupResult);
     static status_t acceptSocketConnection(const RpcServer& server, RpcTransportFd* out);
     static status_t recvmsgSocketConnection(const RpcServer& server, RpcTransportFd* out);
 
@@ -252,6 +278,7 @@ private:
 
     const std::unique_ptr<RpcTransportCtx> mCtx;
     size_t mMaxThreads = 1;
+    size_t mEventLoopThreads = 0;
     std::optional<uint32_t> mProtocolVersion;
     // A mode is supported if the N'th bit is on, where N is the mode enum's value.
     std::bitset<8> mSupportedFileDescriptorTransportModes = std::bitset<8>().set(
@@ -262,6 +289,8 @@ private:
     std::unique_ptr<RpcMaybeThread> mJoinThread;
     bool mJoinThreadRunning = false;
     std::map<RpcMaybeThread::id, RpcMaybeThread> mConnectingThreads;
+    // only when mEventLoopThreads is set
+    std::shared_ptr<EventLoop> mEventLoop;
 
     sp<IBinder> mRootObject;
     wp<IBinder> mRootObjectWeak;
@@ -23,6 +23,8 @@
 #include <utils/Errors.h>
 #include <utils/RefBase.h>
 
+#include <chrono>
+#include <functional>
 #include <map>
 #include <optional>
 #include <vector>
@@ -47,6 +49,12 @@ constexpr uint32_t RPC_WIRE_PROTOCOL_VERSION = 1;
 // * RpcWireTransaction and RpcWireReplyV1 include the parcel data size.
 constexpr uint32_t RPC_WIRE_PROTOCOL_VERSION_RPC_HEADER_FEATURE_EXPLICIT_PARCEL_SIZE = 1;
 
+// Starting with this version:
+//
+// * Parcel data may be sent out of line in a memfd, see
+//   RpcSession::setOutOfLineDataThreshold.
+constexpr uint32_t RPC_WIRE_PROTOCOL_VERSION_RPC_HEADER_FEATURE_OUT_OF_LINE_DATA = 2;
+
 /**
  * This represents a session (group of connections) between a client
  * and a server. Multiple connections are needed for multiple parallel "binder"
@@ -115,6 +123,42 @@ public:
     void setFileDescriptorTransportMode(FileDescriptorTransportMode mode);
     FileDescriptorTransportMode getFileDescriptorTransportMode();
 
+    /**
+     * Coalesce oneway transactions sent on this session. Instead of being
+     * written individually, they are buffered and written together once
+     * |maxBytes| are pending, once |maxDelay| has passed since the first of
+     * them was buffered (by a thread of this session), before any other
+     * transaction or reference count command is sent by this session, or when
+     * it is shut down with shutdownAndWait. Replies to incoming transactions
+     * are written on other connections, so they don't flush the batch, and
+     * aren't ordered with respect to it. Oneway transactions with file
+     * descriptors are never buffered. A |maxBytes| of 0 disables batching (the
+     * default).
+     *
+     * This must be called before setting up this session. Returns false if
+     * libbinder was built without thread support.
+     */
+    [[nodiscard]] bool setOnewayBatching(size_t maxBytes, std::chrono::microseconds maxDelay);
+
+    static constexpr size_t kDefaultOutOfLineDataThreshold = 64 * 1024;
+
+    /**
+     * Parcels with more than |bytes| of data which are sent by this session are
+     * copied into a sealed memfd, which is passed alongside the transaction or
+     * reply and mapped by the receiver, instead of being written to the
+     * connection. This avoids copying large payloads through the socket, and
+     * allows payloads which would be too large to receive inline. It is only
+     * done when file descriptors can be sent (FileDescriptorTransportMode::UNIX)
+     * and both sides support protocol version
+     * RPC_WIRE_PROTOCOL_VERSION_RPC_HEADER_FEATURE_OUT_OF_LINE_DATA. A value of
+     * 0 disables this. By default, this is |kDefaultOutOfLineDataThreshold|.
+     *
+     * This must be called before setting up this session. Server sessions
+     * always use the default.
+     */
+    void setOutOfLineDataThreshold(size_t bytes);
+    size_t getOutOfLineDataThreshold();
+
     /**
      * This should be called once per thread, matching 'join' in the remote
      * process.
@@ -259,6 +303,23 @@ private:
         std::optional<uint64_t> exclusiveTid;
 
         bool allowNested = false;
+
+        // Set by RpcServer's event loop while a command is read from this
+        // connection, and used instead of polling without a timeout, so that
+        // a peer which stops in the middle of a command can't hold a worker.
+        // Cleared once the command is read, since executing it may block.
+        std::function<status_t()> framePoll;
+
+        // Set for incoming connections, so that several small commands, such
+        // as a batch of oneway transactions, are read from the transport at
+        // once. Cleared if the transport doesn't support it. Not used while
+        // file descriptors are sent, since those arrive with specific bytes.
+        bool readAhead = false;
+        // Bytes read ahead, of which [readBufferBegin, readBufferEnd) are not
+        // parsed yet. Allocated on the first read.
+        std::unique_ptr<uint8_t[]> readBuffer;
+        size_t readBufferBegin = 0;
+        size_t readBufferEnd = 0;
     };
 
     [[nodiscard]] status_t readId();
@@ -281,6 +342,13 @@ private:
     PreJoinSetupResult preJoinSetup(std::unique_ptr<RpcTransport> rpcTransport);
     // join on thread passed to preJoinThreadOwnership
     static void join(sp<RpcSession>&& session, PreJoinSetupResult&& result);
+    // Instead of join, for connections which are served by something other
+    // than the thread passed to preJoinThreadOwnership (see
+    // RpcServer::setEventLoopThreads). releaseJoinThread gives up ownership of
+    // that thread, and postJoinCleanup must be called once the connection is no
+    // longer served.
+    void releaseJoinThread();
+    static void postJoinCleanup(sp<RpcSession>&& session, const sp<RpcConnection>& connection);
 
     [[nodiscard]] status_t setupClient(
             const std::function<status_t(const std::vector<uint8_t>& sessionId, bool incoming)>&
@@ -378,6 +446,7 @@ private:
     size_t mMaxOutgoingConnections = kDefaultMaxOutgoingConnections;
     std::optional<uint32_t> mProtocolVersion;
     FileDescriptorTransportMode mFileDescriptorTransportMode = FileDescriptorTransportMode::NONE;
+    size_t mOutOfLineDataThreshold = kDefaultOutOfLineDataThreshold;
 
     RpcConditionVariable mAvailableConnectionCv; // for mWaitingThreads
 
@@ -83,6 +83,24 @@ public:
             const std::optional<android::base::function_ref<status_t()>> &altPoll,
             std::vector<std::variant<base::unique_fd, base::borrowed_fd>> *ancillaryFds) = 0;
 
+    /**
+     * Read at least one byte, waiting for it like interruptableReadFully, and
+     * as many more as are available without waiting, up to 'size'. Any FDs
+     * received are dropped.
+     *
+     * outSize - set to the number of bytes read.
+     *
+     * Return:
+     *   OK - succeeded in reading at least one byte
+     *   INVALID_OPERATION - not supported by this transport, nothing was read
+     *   error - interrupted (failure or trigger)
+     */
+    [[nodiscard]] virtual status_t interruptableReadAvailable(
+            FdTrigger * /*fdTrigger*/, void * /*data*/, size_t /*size*/, size_t * /*outSize*/,
+            const std::optional<android::base::function_ref<status_t()>> & /*altPoll*/) {
+        return INVALID_OPERATION;
+    }
+
     /**
      *  Check whether any threads are blocked while polling the transport
      *  for read operations
@@ -117,6 +135,11 @@ public:
     [[nodiscard]] virtual std::vector<uint8_t> getCertificate(
             RpcCertificateFormat format) const = 0;
 
+    // Whether the sockets of the transports this creates become readable when there is data to
+    // read. Otherwise, the socket cannot be polled for incoming data, see
+    // RpcServer::setEventLoopThreads.
+    [[nodiscard]] virtual bool signalsIncomingDataOnFd() const { return true; }
+
 protected:
     RpcTransportCtx() = default;
 };
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Wraps the transport layer of RPC. Implementation moves data through a pair of
+// single-producer/single-consumer rings in a memfd shared between the two peers.
+// The underlying Unix domain socket is only used to hand over the memfd and to
+// wake up a peer which is parked waiting for data or for space in a ring.
+//
+// Only usable for peers on the same host connected over a Unix domain socket.
+// File descriptors cannot be sent in parcels over this transport, so it
+// should only be used with FileDescriptorTransportMode::NONE. For the same
+// reason, Unix domain socket bootstrap clients are not supported.
+
+#pragma once
+
+#include <memory>
+
+#include <binder/RpcTransport.h>
+
+namespace android {
+
+// RpcTransportCtxFactory which exchanges data over shared memory.
+class RpcTransportCtxFactoryShm : public RpcTransportCtxFactory {
+public:
+    // Default capacity of each direction's ring, in bytes.
+    static constexpr size_t kDefaultRingCapacity = 64 * 1024;
+
+    // |ringCapacity| is only used by clients, which allocate the shared memory,
+    // and must be a power of two. Servers accept any valid capacity from a client.
+    static std::unique_ptr<RpcTransportCtxFactory> make(
+            size_t ringCapacity = kDefaultRingCapacity);
+
+    std::unique_ptr<RpcTransportCtx> newServerCtx() const override;
+    std::unique_ptr<RpcTransportCtx> newClientCtx() const override;
+    const char* toCString() const override;
+
+private:
+    explicit RpcTransportCtxFactoryShm(size_t ringCapacity) : mRingCapacity(ringCapacity) {}
+
+    size_t mRingCapacity;
+};
+
+} // namespace android
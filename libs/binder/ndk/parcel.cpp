@@ -39,13 +39,6 @@ using ::android::os::ParcelFileDescriptor;
 template <typename T>
 using ContiguousArrayAllocator = bool (*)(void* arrayData, int32_t length, T** outBuffer);
 
-template <typename T>
-using ArrayAllocator = bool (*)(void* arrayData, int32_t length);
-template <typename T>
-using ArrayGetter = T (*)(const void* arrayData, size_t index);
-template <typename T>
-using ArraySetter = void (*)(void* arrayData, size_t index, T value);
-
 static binder_status_t WriteAndValidateArraySize(AParcel* parcel, bool isNullArray,
                                                  int32_t length) {
     // only -1 can be used to represent a null array
@@ -105,14 +98,13 @@ binder_status_t WriteArray<char16_t>(AParcel* parcel, const char16_t* array, int
     if (length <= 0) return STATUS_OK;
 
     int32_t size = 0;
-    if (__builtin_smul_overflow(sizeof(char16_t), length, &size)) return STATUS_NO_MEMORY;
+    if (__builtin_smul_overflow(sizeof(int32_t), length, &size)) return STATUS_NO_MEMORY;
 
-    Parcel* rawParcel = parcel->get();
+    int32_t* data = static_cast<int32_t*>(parcel->get()->writeInplace(size));
+    if (data == nullptr) return STATUS_NO_MEMORY;
 
     for (int32_t i = 0; i < length; i++) {
-        status = rawParcel->writeChar(array[i]);
-
-        if (status != STATUS_OK) return PruneStatusT(status);
+        data[i] = static_cast<int32_t>(array[i]);
     }
 
     return STATUS_OK;
@@ -175,40 +167,44 @@ binder_status_t ReadArray<char16_t>(const AParcel* parcel, void* arrayData,
     if (array == nullptr) return STATUS_NO_MEMORY;
 
     int32_t size = 0;
-    if (__builtin_smul_overflow(sizeof(char16_t), length, &size)) return STATUS_NO_MEMORY;
+    if (__builtin_smul_overflow(sizeof(int32_t), length, &size)) return STATUS_NO_MEMORY;
 
-    for (int32_t i = 0; i < length; i++) {
-        status_t status = rawParcel->readChar(array + i);
+    const int32_t* data = static_cast<const int32_t*>(rawParcel->readInplace(size));
+    if (data == nullptr) return STATUS_NOT_ENOUGH_DATA;
 
-        if (status != STATUS_OK) return PruneStatusT(status);
+    for (int32_t i = 0; i < length; i++) {
+        array[i] = static_cast<char16_t>(data[i]);
     }
 
     return STATUS_OK;
 }
 
-template <typename T>
-binder_status_t WriteArray(AParcel* parcel, const void* arrayData, int32_t length,
-                           ArrayGetter<T> getter, status_t (Parcel::*write)(T)) {
+// Each element is converted to an int32_t (not packed), as Parcel::writeBool does.
+static binder_status_t WriteBoolArray(AParcel* parcel, const void* arrayData, int32_t length,
+                                      AParcel_boolArrayGetter getter) {
     // we have no clue if arrayData represents a null object or not, we can only infer from length
     bool arrayIsNull = length < 0;
     binder_status_t status = WriteAndValidateArraySize(parcel, arrayIsNull, length);
     if (status != STATUS_OK) return status;
     if (length <= 0) return STATUS_OK;
 
-    Parcel* rawParcel = parcel->get();
+    int32_t size = 0;
+    if (__builtin_smul_overflow(sizeof(int32_t), length, &size)) return STATUS_NO_MEMORY;
 
-    for (int32_t i = 0; i < length; i++) {
-        status = (rawParcel->*write)(getter(arrayData, i));
+    int32_t* data = static_cast<int32_t*>(parcel->get()->writeInplace(size));
+    if (data == nullptr) return STATUS_NO_MEMORY;
 
-        if (status != STATUS_OK) return PruneStatusT(status);
+    for (int32_t i = 0; i < length; i++) {
+        data[i] = getter(arrayData, i) ? 1 : 0;
     }
 
     return STATUS_OK;
 }
 
-template <typename T>
-binder_status_t ReadArray(const AParcel* parcel, void* arrayData, ArrayAllocator<T> allocator,
-                          ArraySetter<T> setter, status_t (Parcel::*read)(T*) const) {
+// Each element is read from an int32_t (not packed), as Parcel::readBool does.
+static binder_status_t ReadBoolArray(const AParcel* parcel, void* arrayData,
+                                     AParcel_boolArrayAllocator allocator,
+                                     AParcel_boolArraySetter setter) {
     const Parcel* rawParcel = parcel->get();
 
     int32_t length;
@@ -226,12 +222,14 @@ binder_status_t ReadArray(const AParcel* parcel, void* arrayData, ArrayAllocator
 
     if (length <= 0) return STATUS_OK;
 
-    for (int32_t i = 0; i < length; i++) {
-        T readTarget;
-        status_t status = (rawParcel->*read)(&readTarget);
-        if (status != STATUS_OK) return PruneStatusT(status);
+    int32_t size = 0;
+    if (__builtin_smul_overflow(sizeof(int32_t), length, &size)) return STATUS_NO_MEMORY;
 
-        setter(arrayData, i, readTarget);
+    const int32_t* data = static_cast<const int32_t*>(rawParcel->readInplace(size));
+    if (data == nullptr) return STATUS_NOT_ENOUGH_DATA;
+
+    for (int32_t i = 0; i < length; i++) {
+        setter(arrayData, i, data[i] != 0);
     }
 
     return STATUS_OK;
@@ -612,7 +610,7 @@ binder_status_t AParcel_writeDoubleArray(AParcel* parcel, const double* arrayDat
 
 binder_status_t AParcel_writeBoolArray(AParcel* parcel, const void* arrayData, int32_t length,
                                        AParcel_boolArrayGetter getter) {
-    return WriteArray<bool>(parcel, arrayData, length, getter, &Parcel::writeBool);
+    return WriteBoolArray(parcel, arrayData, length, getter);
 }
 
 binder_status_t AParcel_writeCharArray(AParcel* parcel, const char16_t* arrayData, int32_t length) {
@@ -656,7 +654,7 @@ binder_status_t AParcel_readDoubleArray(const AParcel* parcel, void* arrayData,
 binder_status_t AParcel_readBoolArray(const AParcel* parcel, void* arrayData,
                                       AParcel_boolArrayAllocator allocator,
                                       AParcel_boolArraySetter setter) {
-    return ReadArray<bool>(parcel, arrayData, allocator, setter, &Parcel::readBool);
+    return ReadBoolArray(parcel, arrayData, allocator, setter);
 }
 
 binder_status_t AParcel_readCharArray(const AParcel* parcel, void* arrayData,
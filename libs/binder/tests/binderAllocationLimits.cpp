@@ -194,9 +194,23 @@ TEST(BinderAllocation, InterfaceDescriptorTransaction) {
     EXPECT_EQ(mallocs, 1);
 }
 
+// Takes every buffer out of the per-thread Parcel buffer cache until it is
+// destroyed, so that earlier tests on this thread don't affect allocations.
+struct EmptyParcelBufferCache {
+    EmptyParcelBufferCache() {
+        for (Parcel& parcel : parcels) {
+            parcel.setDataCapacity(1);
+        }
+    }
+
+    // at least the capacity of the cache
+    Parcel parcels[8];
+};
+
 TEST(BinderAllocation, SmallTransaction) {
     String16 empty_descriptor = String16("");
     sp<IServiceManager> manager = defaultServiceManager();
+    EmptyParcelBufferCache emptyCache;
 
     size_t mallocs = 0;
     const auto on_malloc = OnMalloc([&](size_t bytes) {
@@ -209,6 +223,23 @@ TEST(BinderAllocation, SmallTransaction) {
     EXPECT_EQ(mallocs, 1);
 }
 
+TEST(BinderAllocation, SmallTransactionReusesBuffers) {
+    String16 empty_descriptor = String16("");
+    sp<IServiceManager> manager = defaultServiceManager();
+
+    // warm up the per-thread Parcel buffer cache
+    manager->checkService(empty_descriptor);
+
+    size_t mallocs = 0;
+    const auto on_malloc = OnMalloc([&](size_t bytes) {
+        (void)bytes;
+        mallocs++;
+    });
+    manager->checkService(empty_descriptor);
+
+    EXPECT_EQ(mallocs, 0);
+}
+
 TEST(RpcBinderAllocation, SetupRpcServer) {
     std::string tmp = getenv("TMPDIR") ?: "/tmp";
     std::string addr = tmp + "/binderRpcBenchmark";
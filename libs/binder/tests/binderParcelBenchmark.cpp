@@ -36,6 +36,8 @@ void writeVector(android::Parcel &p, const V<T, Args...> &v) {
         p.writeInt32Vector(v);
     } else if constexpr (std::is_same_v<T, int64_t>) {
         p.writeInt64Vector(v);
+    } else if constexpr (std::is_same_v<T, float>) {
+        p.writeFloatVector(v);
     } else {
         static_assert(dependent_false_v<V<T>>);
     }
@@ -53,6 +55,8 @@ void readVector(android::Parcel &p, V<T, Args...> *v) {
         p.readInt32Vector(v);
     } else if constexpr (std::is_same_v<T, int64_t>) {
         p.readInt64Vector(v);
+    } else if constexpr (std::is_same_v<T, float>) {
+        p.readFloatVector(v);
     } else {
         static_assert(dependent_false_v<V<T>>);
     }
@@ -65,6 +69,12 @@ static void VectorArgs(benchmark::internal::Benchmark* b) {
     }
 }
 
+// Large arrays, such as those shipped by sensor and input pipelines.
+static void LargeVectorArgs(benchmark::internal::Benchmark* b) {
+    b->Args({1 << 10});
+    b->Args({1 << 16});
+}
+
 template <typename T>
 static void BM_ParcelVector(benchmark::State& state) {
     const size_t elements = state.range(0);
@@ -163,10 +173,36 @@ static void BM_Int64Vector(benchmark::State& state) {
     BM_ParcelVector<int64_t>(state);
 }
 
+static void BM_FloatVector(benchmark::State& state) {
+    BM_ParcelVector<float>(state);
+}
+
 BENCHMARK(BM_BoolVector)->Apply(VectorArgs);
 BENCHMARK(BM_ByteVector)->Apply(VectorArgs);
 BENCHMARK(BM_CharVector)->Apply(VectorArgs);
 BENCHMARK(BM_Int32Vector)->Apply(VectorArgs);
 BENCHMARK(BM_Int64Vector)->Apply(VectorArgs);
+BENCHMARK(BM_FloatVector)->Apply(VectorArgs);
+
+BENCHMARK(BM_BoolVector)->Apply(LargeVectorArgs);
+BENCHMARK(BM_CharVector)->Apply(LargeVectorArgs);
+BENCHMARK(BM_Int32Vector)->Apply(LargeVectorArgs);
+BENCHMARK(BM_Int64Vector)->Apply(LargeVectorArgs);
+BENCHMARK(BM_FloatVector)->Apply(LargeVectorArgs);
+
+// Create, fill and destroy a small Parcel, as is done for most transactions.
+// Measures the cost of allocating and freeing the Parcel's data buffer.
+static void BM_SmallParcelLifecycle(benchmark::State& state) {
+    const size_t words = state.range(0);
+    while (state.KeepRunning()) {
+        android::Parcel p;
+        for (size_t i = 0; i < words; ++i) {
+            p.writeInt32(static_cast<int32_t>(i));
+        }
+        benchmark::DoNotOptimize(p.data());
+    }
+}
+
+BENCHMARK(BM_SmallParcelLifecycle)->Arg(1)->Arg(16)->Arg(64)->Arg(256);
 
 BENCHMARK_MAIN();
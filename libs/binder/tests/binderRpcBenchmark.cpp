@@ -28,9 +28,12 @@
 #include <binder/RpcTlsTestUtils.h>
 #include <binder/RpcTlsUtils.h>
 #include <binder/RpcTransportRaw.h>
+#include <binder/RpcTransportShm.h>
 #include <binder/RpcTransportTls.h>
 #include <openssl/ssl.h>
 
+#include <algorithm>
+#include <chrono>
 #include <thread>
 
 #include <signal.h>
@@ -54,6 +57,7 @@ using android::RpcServer;
 using android::RpcSession;
 using android::RpcTransportCtxFactory;
 using android::RpcTransportCtxFactoryRaw;
+using android::RpcTransportCtxFactoryShm;
 using android::RpcTransportCtxFactoryTls;
 using android::sp;
 using android::status_t;
@@ -74,12 +78,20 @@ class MyBinderRpcBenchmark : public BnBinderRpcBenchmark {
         *out = bytes;
         return Status::ok();
     }
+    Status sendBytesOneway(const std::vector<uint8_t>& /*bytes*/) override { return Status::ok(); }
 };
 
 enum Transport {
     KERNEL,
     RPC,
     RPC_TLS,
+    RPC_SHM,
+    // only used for oneway benchmarks
+    RPC_ONEWAY_BATCHED,
+    // only used for large payload benchmarks
+    RPC_OUT_OF_LINE,
+    // only used for connection scaling benchmarks
+    RPC_EVENT_LOOP,
 };
 
 static const std::initializer_list<int64_t> kTransportList = {
@@ -88,6 +100,7 @@ static const std::initializer_list<int64_t> kTransportList = {
 #endif
         Transport::RPC,
         Transport::RPC_TLS,
+        Transport::RPC_SHM,
 };
 
 std::unique_ptr<RpcTransportCtxFactory> makeFactoryTls() {
@@ -107,6 +120,17 @@ static sp<IBinder> gRpcBinder;
 // Skip certificate validation to simplify the setup process.
 static sp<RpcSession> gSessionTls = RpcSession::make(makeFactoryTls());
 static sp<IBinder> gRpcTlsBinder;
+static sp<RpcSession> gSessionShm = RpcSession::make(RpcTransportCtxFactoryShm::make());
+static sp<IBinder> gRpcShmBinder;
+static sp<RpcSession> gSessionBatched = RpcSession::make();
+static sp<IBinder> gRpcBatchedBinder;
+static sp<RpcSession> gSessionOutOfLine = RpcSession::make();
+static sp<IBinder> gRpcOutOfLineBinder;
+static constexpr size_t kConcurrentThreads = 8;
+static std::string gRpcAddr;
+static std::string gRpcEventLoopAddr;
+static sp<RpcSession> gSessionConcurrent = RpcSession::make();
+static sp<IBinder> gRpcConcurrentBinder;
 #ifdef __BIONIC__
 static const String16 kKernelBinderInstance = String16(u"binderRpcBenchmark-control");
 static sp<IBinder> gKernelBinder;
@@ -123,6 +147,12 @@ static sp<IBinder> getBinderForOptions(benchmark::State& state) {
             return gRpcBinder;
         case RPC_TLS:
             return gRpcTlsBinder;
+        case RPC_SHM:
+            return gRpcShmBinder;
+        case RPC_ONEWAY_BATCHED:
+            return gRpcBatchedBinder;
+        case RPC_OUT_OF_LINE:
+            return gRpcOutOfLineBinder;
         default:
             LOG(FATAL) << "Unknown transport value: " << transport;
             return nullptr;
@@ -138,6 +168,27 @@ void BM_pingTransaction(benchmark::State& state) {
 }
 BENCHMARK(BM_pingTransaction)->ArgsProduct({kTransportList});
 
+// Same as BM_pingTransaction, but also reports tail latencies, which matter more
+// than the mean when comparing transports.
+void BM_pingTransactionLatency(benchmark::State& state) {
+    sp<IBinder> binder = getBinderForOptions(state);
+
+    std::vector<int64_t> latenciesNs;
+    while (state.KeepRunning()) {
+        auto start = std::chrono::steady_clock::now();
+        CHECK_EQ(OK, binder->pingBinder());
+        auto end = std::chrono::steady_clock::now();
+        latenciesNs.push_back(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+
+    if (latenciesNs.empty()) return;
+    std::sort(latenciesNs.begin(), latenciesNs.end());
+    state.counters["p50_ns"] = latenciesNs[latenciesNs.size() / 2];
+    state.counters["p99_ns"] = latenciesNs[latenciesNs.size() * 99 / 100];
+}
+BENCHMARK(BM_pingTransactionLatency)->ArgsProduct({kTransportList});
+
 void BM_repeatTwoPageString(benchmark::State& state) {
     sp<IBinder> binder = getBinderForOptions(state);
 
@@ -187,6 +238,14 @@ BENCHMARK(BM_throughputForTransportAndBytes)
         ->ArgsProduct({kTransportList,
                        {64, 1024, 2048, 4096, 8182, 16364, 32728, 65535, 65536, 65537}});
 
+// Payloads above RpcSession::kDefaultOutOfLineDataThreshold are passed in a
+// memfd by RPC_OUT_OF_LINE. Inline RPC transactions are limited to about 100KB,
+// so only RPC_OUT_OF_LINE covers the larger sizes.
+BENCHMARK(BM_throughputForTransportAndBytes)
+        ->ArgsProduct({{Transport::RPC, Transport::RPC_OUT_OF_LINE}, {4 << 10, 16 << 10, 64 << 10}})
+        ->ArgsProduct({{Transport::RPC_OUT_OF_LINE},
+                       {256 << 10, 1 << 20, 4 << 20, 16 << 20, 64 << 20}});
+
 void BM_repeatBinder(benchmark::State& state) {
     sp<IBinder> binder = getBinderForOptions(state);
     CHECK(binder != nullptr);
@@ -204,6 +263,76 @@ void BM_repeatBinder(benchmark::State& state) {
 }
 BENCHMARK(BM_repeatBinder)->ArgsProduct({kTransportList});
 
+// Many client threads sending distinct binders over one session at once, so
+// that both sides are constantly adding and removing nodes from their tables.
+void BM_repeatBinderConcurrent(benchmark::State& state) {
+    sp<IBinderRpcBenchmark> iface = interface_cast<IBinderRpcBenchmark>(gRpcConcurrentBinder);
+    CHECK(iface != nullptr);
+
+    while (state.KeepRunning()) {
+        sp<IBinder> binder = sp<BBinder>::make();
+
+        sp<IBinder> out;
+        Status ret = iface->repeatBinder(binder, &out);
+        CHECK(ret.isOk()) << ret;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_repeatBinderConcurrent)->ThreadRange(1, kConcurrentThreads)->UseRealTime();
+
+// Pings one session while many other idle sessions are connected to the same
+// server, to compare a thread per connection with the server's event loop.
+void BM_pingWithIdleSessions(benchmark::State& state) {
+    Transport transport = static_cast<Transport>(state.range(0));
+    const std::string& addr = transport == Transport::RPC_EVENT_LOOP ? gRpcEventLoopAddr : gRpcAddr;
+
+    std::vector<sp<RpcSession>> sessions(state.range(1));
+    std::vector<sp<IBinder>> roots;
+    for (auto& session : sessions) {
+        session = RpcSession::make();
+        CHECK_EQ(OK, session->setupUnixDomainClient(addr.c_str()));
+        roots.push_back(session->getRootObject());
+        CHECK(roots.back() != nullptr);
+    }
+
+    while (state.KeepRunning()) {
+        CHECK_EQ(OK, roots.front()->pingBinder());
+    }
+
+    roots.clear();
+    for (auto& session : sessions) {
+        CHECK(session->shutdownAndWait(true));
+    }
+}
+BENCHMARK(BM_pingWithIdleSessions)
+        ->ArgsProduct({{Transport::RPC, Transport::RPC_EVENT_LOOP}, {1, 64, 256}});
+
+// Floods the server with small oneway calls, which is syscall-bound unless they
+// are batched. The sync call at the end makes sure everything was received.
+void BM_onewayFlood(benchmark::State& state) {
+    sp<IBinder> binder = getBinderForOptions(state);
+    sp<IBinderRpcBenchmark> iface = interface_cast<IBinderRpcBenchmark>(binder);
+    CHECK(iface != nullptr);
+
+    std::vector<uint8_t> bytes = std::vector<uint8_t>(state.range(1));
+    while (state.KeepRunning()) {
+        Status ret = iface->sendBytesOneway(bytes);
+        CHECK(ret.isOk()) << ret;
+    }
+
+    std::vector<uint8_t> out;
+    Status ret = iface->repeatBytes({}, &out);
+    CHECK(ret.isOk()) << ret;
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_onewayFlood)
+        ->ArgsProduct({{
+#ifdef __BIONIC__
+                               Transport::KERNEL,
+#endif
+                               Transport::RPC, Transport::RPC_ONEWAY_BATCHED},
+                       {16, 256}});
+
 void forkRpcServer(const char* addr, const sp<RpcServer>& server) {
     if (0 == fork()) {
         prctl(PR_SET_PDEATHSIG, SIGHUP); // racey, okay
@@ -232,6 +361,13 @@ int main(int argc, char** argv) {
     std::cerr << "\t.../" << Transport::KERNEL << " is KERNEL" << std::endl;
     std::cerr << "\t.../" << Transport::RPC << " is RPC" << std::endl;
     std::cerr << "\t.../" << Transport::RPC_TLS << " is RPC with TLS" << std::endl;
+    std::cerr << "\t.../" << Transport::RPC_SHM << " is RPC over shared memory" << std::endl;
+    std::cerr << "\t.../" << Transport::RPC_ONEWAY_BATCHED << " is RPC with oneway batching"
+              << std::endl;
+    std::cerr << "\t.../" << Transport::RPC_OUT_OF_LINE << " is RPC with out of line data"
+              << std::endl;
+    std::cerr << "\t.../" << Transport::RPC_EVENT_LOOP << " is RPC with a server event loop"
+              << std::endl;
 
 #ifdef __BIONIC__
     if (0 == fork()) {
@@ -252,18 +388,55 @@ int main(int argc, char** argv) {
 
     std::string tmp = getenv("TMPDIR") ?: "/tmp";
 
-    std::string addr = tmp + "/binderRpcBenchmark";
-    (void)unlink(addr.c_str());
-    forkRpcServer(addr.c_str(), RpcServer::make(RpcTransportCtxFactoryRaw::make()));
-    setupClient(gSession, addr.c_str());
+    gRpcAddr = tmp + "/binderRpcBenchmark";
+    (void)unlink(gRpcAddr.c_str());
+    forkRpcServer(gRpcAddr.c_str(), RpcServer::make(RpcTransportCtxFactoryRaw::make()));
+    setupClient(gSession, gRpcAddr.c_str());
     gRpcBinder = gSession->getRootObject();
 
+    // same server, but with oneway calls coalesced by the client
+    CHECK(gSessionBatched->setOnewayBatching(64 * 1024, std::chrono::microseconds(200)));
+    setupClient(gSessionBatched, gRpcAddr.c_str());
+    gRpcBatchedBinder = gSessionBatched->getRootObject();
+
+    std::string outOfLineAddr = tmp + "/binderRpcOutOfLineBenchmark";
+    (void)unlink(outOfLineAddr.c_str());
+    auto outOfLineServer = RpcServer::make(RpcTransportCtxFactoryRaw::make());
+    outOfLineServer->setProtocolVersion(android::RPC_WIRE_PROTOCOL_VERSION_EXPERIMENTAL);
+    outOfLineServer->setSupportedFileDescriptorTransportModes(
+            {RpcSession::FileDescriptorTransportMode::UNIX});
+    forkRpcServer(outOfLineAddr.c_str(), outOfLineServer);
+    CHECK(gSessionOutOfLine->setProtocolVersion(android::RPC_WIRE_PROTOCOL_VERSION_EXPERIMENTAL));
+    gSessionOutOfLine->setFileDescriptorTransportMode(RpcSession::FileDescriptorTransportMode::UNIX);
+    setupClient(gSessionOutOfLine, outOfLineAddr.c_str());
+    gRpcOutOfLineBinder = gSessionOutOfLine->getRootObject();
+
+    gRpcEventLoopAddr = tmp + "/binderRpcEventLoopBenchmark";
+    (void)unlink(gRpcEventLoopAddr.c_str());
+    auto eventLoopServer = RpcServer::make(RpcTransportCtxFactoryRaw::make());
+    eventLoopServer->setEventLoopThreads(4);
+    forkRpcServer(gRpcEventLoopAddr.c_str(), eventLoopServer);
+
+    std::string concurrentAddr = tmp + "/binderRpcConcurrentBenchmark";
+    (void)unlink(concurrentAddr.c_str());
+    auto concurrentServer = RpcServer::make(RpcTransportCtxFactoryRaw::make());
+    concurrentServer->setMaxThreads(kConcurrentThreads);
+    forkRpcServer(concurrentAddr.c_str(), concurrentServer);
+    setupClient(gSessionConcurrent, concurrentAddr.c_str());
+    gRpcConcurrentBinder = gSessionConcurrent->getRootObject();
+
     std::string tlsAddr = tmp + "/binderRpcTlsBenchmark";
     (void)unlink(tlsAddr.c_str());
     forkRpcServer(tlsAddr.c_str(), RpcServer::make(makeFactoryTls()));
     setupClient(gSessionTls, tlsAddr.c_str());
     gRpcTlsBinder = gSessionTls->getRootObject();
 
+    std::string shmAddr = tmp + "/binderRpcShmBenchmark";
+    (void)unlink(shmAddr.c_str());
+    forkRpcServer(shmAddr.c_str(), RpcServer::make(RpcTransportCtxFactoryShm::make()));
+    setupClient(gSessionShm, shmAddr.c_str());
+    gRpcShmBinder = gSessionShm->getRootObject();
+
     ::benchmark::RunSpecifiedBenchmarks();
     return 0;
 }
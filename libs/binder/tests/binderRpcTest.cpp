@@ -17,9 +17,11 @@
 #include <aidl/IBinderRpcTest.h>
 #include <android-base/stringprintf.h>
 
+#include <atomic>
 #include <chrono>
 #include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <thread>
 #include <type_traits>
 
@@ -357,6 +359,9 @@ std::unique_ptr<ProcessSession> BinderRpc::createRpcTestSocketServerProcessEtc(
         session->setMaxIncomingThreads(numIncoming);
         session->setMaxOutgoingConnections(options.numOutgoingConnections);
         session->setFileDescriptorTransportMode(options.clientFileDescriptorTransportMode);
+        if (options.onewayBatchMaxBytes > 0) {
+            CHECK(session->setOnewayBatching(options.onewayBatchMaxBytes, 100us));
+        }
 
         switch (socketType) {
             case SocketType::PRECONNECTED:
@@ -619,6 +624,147 @@ TEST_P(BinderRpc, OnewayCallQueueing) {
     saturateThreadPool(1 + kNumExtraServerThreads, proc.rootIface);
 }
 
+TEST_P(BinderRpc, OnewayCallQueueingBatched) {
+    if (clientOrServerSingleThreaded()) {
+        GTEST_SKIP() << "This test requires multiple threads";
+    }
+
+    constexpr size_t kNumQueued = 10;
+    constexpr size_t kNumExtraServerThreads = 4;
+
+    // large enough that only the deadline or the twoway calls below flush
+    auto proc = createRpcTestSocketServerProcess({
+            .numThreads = 1 + kNumExtraServerThreads,
+            .onewayBatchMaxBytes = 1024 * 1024,
+    });
+
+    for (size_t i = 0; i + 1 < kNumQueued; i++) {
+        EXPECT_OK(proc.rootIface->blockingSendIntOneway(i));
+    }
+    for (size_t i = 0; i + 1 < kNumQueued; i++) {
+        int n;
+        EXPECT_OK(proc.rootIface->blockingRecvInt(&n));
+        EXPECT_EQ(n, i);
+    }
+
+    saturateThreadPool(1 + kNumExtraServerThreads, proc.rootIface);
+}
+
+TEST_P(BinderRpc, OnewayBatchFlushSendsNestedDecStrong) {
+    if (clientOrServerSingleThreaded()) {
+        GTEST_SKIP() << "This test requires multiple threads";
+    }
+
+    // much more than the socket buffers, so writing the batch blocks
+    constexpr size_t kBatchBytes = 4 * 1024 * 1024;
+    constexpr size_t kStringBytes = 64 * 1024;
+
+    auto proc = createRpcTestSocketServerProcess({
+            .numThreads = 1,
+            .onewayBatchMaxBytes = kBatchBytes,
+    });
+
+    // only kept alive by the server, and holds a binder from the same session
+    class HoldingCallback : public MyBinderRpcCallback {
+    public:
+        sp<IBinder> held;
+    };
+
+    wp<HoldingCallback> weakCallback;
+    {
+        auto callback = sp<HoldingCallback>::make();
+        EXPECT_OK(proc.rootIface->alwaysGiveMeTheSameBinder(&callback->held));
+        weakCallback = callback;
+
+        // The server drops the callback while it processes this, then stops
+        // reading while it sleeps. The dec ref for the callback is processed
+        // while the rest of the batch is written, and dropping the callback
+        // sends a dec ref for the binder it holds.
+        EXPECT_OK(proc.rootIface->doCallbackAsync(callback, true /*oneway*/, false /*delayed*/,
+                                                  "x"));
+    }
+    EXPECT_OK(proc.rootIface->sleepMsAsync(100));
+
+    std::string str(kStringBytes, 'a');
+    for (size_t sent = 0; sent < kBatchBytes; sent += kStringBytes) {
+        EXPECT_OK(proc.rootIface->sendString(str));
+    }
+
+    for (size_t i = 0; i < 100 && weakCallback.promote() != nullptr; i++) {
+        usleep(10 * 1000);
+    }
+    EXPECT_EQ(nullptr, weakCallback.promote());
+
+    // the dec ref for the held binder was written after the batch
+    std::vector<int32_t> remoteCounts;
+    EXPECT_OK(proc.rootIface->countBinders(&remoteCounts));
+    EXPECT_EQ(remoteCounts, std::vector<int32_t>{1});
+}
+
+TEST_P(BinderRpc, OnewayBatchRejectsNestedTwowayCall) {
+    if (clientOrServerSingleThreaded()) {
+        GTEST_SKIP() << "This test requires multiple threads";
+    }
+
+    // much more than the socket buffers, so writing the batch blocks
+    constexpr size_t kBatchBytes = 4 * 1024 * 1024;
+    constexpr size_t kStringBytes = 64 * 1024;
+
+    auto proc = createRpcTestSocketServerProcess({
+            .numThreads = 1,
+            .onewayBatchMaxBytes = kBatchBytes,
+    });
+
+    struct NestedCall {
+        std::atomic<bool> done = false;
+        std::atomic<status_t> status = OK;
+    };
+    auto nestedCall = std::make_shared<NestedCall>();
+
+    // only kept alive by the server, and makes a twoway call when dropped
+    class PingingCallback : public MyBinderRpcCallback {
+    public:
+        explicit PingingCallback(std::shared_ptr<NestedCall> nestedCall)
+              : mNestedCall(std::move(nestedCall)) {}
+        ~PingingCallback() override {
+            mNestedCall->status = held->pingBinder();
+            mNestedCall->done = true;
+        }
+        sp<IBinder> held;
+
+    private:
+        std::shared_ptr<NestedCall> mNestedCall;
+    };
+
+    {
+        auto callback = sp<PingingCallback>::make(nestedCall);
+        EXPECT_OK(proc.rootIface->alwaysGiveMeTheSameBinder(&callback->held));
+
+        // As in OnewayBatchFlushSendsNestedDecStrong, the callback is dropped
+        // while this thread writes the rest of the batch.
+        EXPECT_OK(proc.rootIface->doCallbackAsync(callback, true /*oneway*/, false /*delayed*/,
+                                                  "x"));
+    }
+    EXPECT_OK(proc.rootIface->sleepMsAsync(100));
+
+    std::string str(kStringBytes, 'a');
+    for (size_t sent = 0; sent < kBatchBytes; sent += kStringBytes) {
+        EXPECT_OK(proc.rootIface->sendString(str));
+    }
+
+    for (size_t i = 0; i < 100 && !nestedCall->done; i++) {
+        usleep(10 * 1000);
+    }
+    ASSERT_TRUE(nestedCall->done);
+    // writing the call would have split the batch
+    EXPECT_EQ(INVALID_OPERATION, nestedCall->status);
+
+    // the session is still usable, and the held binder was released
+    std::vector<int32_t> remoteCounts;
+    EXPECT_OK(proc.rootIface->countBinders(&remoteCounts));
+    EXPECT_EQ(remoteCounts, std::vector<int32_t>{1});
+}
+
 TEST_P(BinderRpc, OnewayCallExhaustion) {
     if (clientOrServerSingleThreaded()) {
         GTEST_SKIP() << "This test requires multiple threads";
@@ -998,6 +1144,27 @@ TEST_P(BinderRpc, SendMaxFiles) {
     EXPECT_EQ(result, std::string(253, 'a'));
 }
 
+TEST_P(BinderRpc, LargeDataOutOfLine) {
+    if (!supportsFdTransport() ||
+        std::min(clientVersion(), serverVersion()) <
+                RPC_WIRE_PROTOCOL_VERSION_RPC_HEADER_FEATURE_OUT_OF_LINE_DATA) {
+        GTEST_SKIP() << "Out of line data requires file descriptor support and a newer protocol";
+    }
+
+    auto proc = createRpcTestSocketServerProcess({
+            .clientFileDescriptorTransportMode = RpcSession::FileDescriptorTransportMode::UNIX,
+            .serverSupportedFileDescriptorTransportModes =
+                    {RpcSession::FileDescriptorTransportMode::UNIX},
+    });
+
+    // Larger than any transaction which can be received inline, in both
+    // directions.
+    std::string single = std::string(512 * 1024, 'a');
+    std::string doubled;
+    EXPECT_OK(proc.rootIface->doubleString(single, &doubled));
+    EXPECT_EQ(single + single, doubled);
+}
+
 TEST_P(BinderRpc, SendTooManyFiles) {
     if (!supportsFdTransport()) {
         GTEST_SKIP() << "Would fail trivially (which is tested by BinderRpc::SendFiles)";
@@ -1238,6 +1405,18 @@ INSTANTIATE_TEST_CASE_P(PerSocket, BinderRpc,
                                            ::testing::Values(false, true)),
                         BinderRpc::PrintParamInfo);
 
+// The shared memory transport needs a Unix domain socket to hand over the memory.
+INSTANTIATE_TEST_CASE_P(PerSocketShm, BinderRpc,
+                        ::testing::Combine(::testing::Values(SocketType::PRECONNECTED,
+                                                             SocketType::UNIX,
+                                                             SocketType::UNIX_RAW),
+                                           ::testing::Values(RpcSecurity::SHM),
+                                           ::testing::ValuesIn(testVersions()),
+                                           ::testing::ValuesIn(testVersions()),
+                                           ::testing::Values(false, true),
+                                           ::testing::Values(false, true)),
+                        BinderRpc::PrintParamInfo);
+
 class BinderRpcServerRootObject
       : public ::testing::TestWithParam<std::tuple<bool, bool, RpcSecurity>> {};
 
@@ -1392,6 +1571,74 @@ TEST_P(BinderRpcServerOnly, Shutdown) {
             << "After server->shutdown() returns true, join() did not stop after 2s";
 }
 
+TEST_P(BinderRpcServerOnly, EventLoop) {
+    if constexpr (!kEnableRpcThreads) {
+        GTEST_SKIP() << "Test skipped because threads were disabled at build time";
+    }
+    if (std::get<0>(GetParam()) != RpcSecurity::RAW) {
+        GTEST_SKIP() << "Test only needs to run once per protocol version";
+    }
+
+    auto addr = allocateSocketAddress();
+    auto server = RpcServer::make();
+    server->setProtocolVersion(std::get<1>(GetParam()));
+    server->setEventLoopThreads(2);
+    server->setRootObject(sp<BBinder>::make());
+    ASSERT_EQ(OK, server->setupUnixDomainServer(addr.c_str()));
+    server->start();
+
+    // more sessions than worker threads
+    std::vector<sp<RpcSession>> sessions(10);
+    std::vector<sp<IBinder>> roots;
+    for (auto& session : sessions) {
+        session = RpcSession::make();
+        ASSERT_EQ(OK, session->setupUnixDomainClient(addr.c_str()));
+        roots.push_back(session->getRootObject());
+        ASSERT_NE(nullptr, roots.back());
+    }
+    for (int i = 0; i < 3; i++) {
+        for (auto& root : roots) {
+            EXPECT_EQ(OK, root->pingBinder());
+        }
+    }
+    EXPECT_EQ(sessions.size(), server->listSessions().size());
+
+    // dropping the last binder shuts down the server side of the session,
+    // while its connection is idle
+    roots.pop_back();
+    for (size_t tries = 0; tries < 100 && server->listSessions().size() != roots.size();
+         tries++) {
+        usleep(10 * 1000);
+    }
+    EXPECT_EQ(roots.size(), server->listSessions().size());
+    for (auto& root : roots) {
+        EXPECT_EQ(OK, root->pingBinder());
+    }
+
+    roots.clear();
+    for (auto& session : sessions) {
+        EXPECT_TRUE(session->shutdownAndWait(true));
+    }
+    EXPECT_TRUE(server->shutdown());
+}
+
+TEST_P(BinderRpcServerOnly, EventLoopRequiresTransportSignalingOnSocket) {
+    if constexpr (!kEnableRpcThreads) {
+        GTEST_SKIP() << "Test skipped because threads were disabled at build time";
+    }
+    if (std::get<0>(GetParam()) != RpcSecurity::RAW) {
+        GTEST_SKIP() << "Test only needs to run once per protocol version";
+    }
+
+    // With the shared memory transport, incoming data never makes the socket readable, so the
+    // event loop would never execute a command.
+    auto server = RpcServer::make(newTlsFactory(RpcSecurity::SHM));
+    server->setProtocolVersion(std::get<1>(GetParam()));
+    EXPECT_DEATH_IF_SUPPORTED(server->setEventLoopThreads(2),
+                              "requires a transport which signals incoming data");
+    server->setEventLoopThreads(0);
+}
+
 INSTANTIATE_TEST_CASE_P(BinderRpc, BinderRpcServerOnly,
                         ::testing::Combine(::testing::ValuesIn(RpcSecurityValues()),
                                            ::testing::ValuesIn(testVersions())),
@@ -1693,6 +1940,9 @@ public:
                             ret.emplace_back(socketType, rpcSecurity, RpcCertificateFormat::DER,
                                              serverVersion);
                         } break;
+                        case RpcSecurity::SHM: {
+                            // Covered by the PerSocketShm instantiation of BinderRpc instead.
+                        } break;
                     }
                 }
             }
@@ -46,6 +46,7 @@
 #include <binder/ProcessState.h>
 #include <binder/RpcTlsTestUtils.h>
 #include <binder/RpcTlsUtils.h>
+#include <binder/RpcTransportShm.h>
 #include <binder/RpcTransportTls.h>
 
 #include <signal.h>
@@ -64,7 +65,7 @@ namespace android {
 
 constexpr char kLocalInetAddress[] = "127.0.0.1";
 
-enum class RpcSecurity { RAW, TLS };
+enum class RpcSecurity { RAW, TLS, SHM };
 
 static inline std::vector<RpcSecurity> RpcSecurityValues() {
     return {RpcSecurity::RAW, RpcSecurity::TLS};
@@ -138,6 +139,9 @@ struct BinderRpcOptions {
             serverSupportedFileDescriptorTransportModes = {
                     RpcSession::FileDescriptorTransportMode::NONE};
 
+    // If non-zero, enables RpcSession::setOnewayBatching on client sessions.
+    size_t onewayBatchMaxBytes = 0;
+
     // If true, connection failures will result in `ProcessSession::sessions` being empty
     // instead of a fatal error.
     bool allowConnectFailure = false;
@@ -189,6 +193,8 @@ static inline std::unique_ptr<RpcTransportCtxFactory> newTlsFactory(
             }
             return RpcTransportCtxFactoryTls::make(std::move(verifier), std::move(auth));
         }
+        case RpcSecurity::SHM:
+            return RpcTransportCtxFactoryShm::make();
         default:
             LOG_ALWAYS_FATAL("Unknown RpcSecurity %d", rpcSecurity);
     }
@@ -125,7 +125,7 @@ public:
             // Trusty does not support file descriptors yet
             return false;
         }
-        return clientVersion() >= 1 && serverVersion() >= 1 && rpcSecurity() != RpcSecurity::TLS &&
+        return clientVersion() >= 1 && serverVersion() >= 1 && rpcSecurity() == RpcSecurity::RAW &&
                 (socketType() == SocketType::PRECONNECTED || socketType() == SocketType::UNIX ||
                  socketType() == SocketType::UNIX_BOOTSTRAP ||
                  socketType() == SocketType::UNIX_RAW);
@@ -135,6 +135,9 @@ public:
         if (socketType() == SocketType::UNIX_BOOTSTRAP && rpcSecurity() == RpcSecurity::TLS) {
             GTEST_SKIP() << "Unix bootstrap not supported over a TLS transport";
         }
+        if (socketType() == SocketType::UNIX_BOOTSTRAP && rpcSecurity() == RpcSecurity::SHM) {
+            GTEST_SKIP() << "Unix bootstrap not supported over a shared memory transport";
+        }
     }
 
     BinderRpcTestProcessSession createRpcTestSocketServerProcess(const BinderRpcOptions& options) {
@@ -73,4 +73,16 @@ ssize_t receiveMessageFromSocket(
     return -1;
 }
 
+status_t createSealedDataFd(const void* /* data */, size_t /* size */,
+                            base::unique_fd* /* outFd */) {
+    return INVALID_OPERATION;
+}
+
+status_t mapSealedDataFd(base::borrowed_fd /* fd */, size_t /* size */,
+                         const uint8_t** /* outData */) {
+    return INVALID_OPERATION;
+}
+
+void unmapSealedData(const uint8_t* /* data */, size_t /* size */) {}
+
 } // namespace android
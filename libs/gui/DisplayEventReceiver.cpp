@@ -26,6 +26,7 @@
 #include <private/gui/ComposerServiceAIDL.h>
 
 #include <private/gui/BitTube.h>
+#include <private/gui/VsyncEventRing.h>
 
 // ---------------------------------------------------------------------------
 
@@ -107,6 +108,36 @@ status_t DisplayEventReceiver::getLatestVsyncEventData(
     return NO_INIT;
 }
 
+status_t DisplayEventReceiver::getVsyncEventRing(std::unique_ptr<gui::VsyncEventRing>* outRing,
+                                                size_t* outReaderIndex) const {
+    if (mEventConnection == nullptr) {
+        return NO_INIT;
+    }
+
+    gui::VsyncEventRingInfo info;
+    auto status = mEventConnection->getVsyncEventRing(&info);
+    if (!status.isOk()) {
+        ALOGE("Failed to get vsync event ring: %s", status.toString8().c_str());
+        return status.transactionError();
+    }
+
+    // Vsync events are still delivered through the BitTube unless the ring is enabled.
+    auto ring = gui::VsyncEventRing::map(base::unique_fd(info.ring.release()));
+    if (ring == nullptr || info.readerIndex < 0) {
+        ALOGE("Failed to map vsync event ring");
+        return BAD_VALUE;
+    }
+
+    status = mEventConnection->enableVsyncEventRing();
+    if (!status.isOk()) {
+        ALOGE("Failed to enable vsync event ring: %s", status.toString8().c_str());
+        return status.transactionError();
+    }
+    *outRing = std::move(ring);
+    *outReaderIndex = static_cast<size_t>(info.readerIndex);
+    return NO_ERROR;
+}
+
 ssize_t DisplayEventReceiver::getEvents(DisplayEventReceiver::Event* events,
         size_t count) {
     return DisplayEventReceiver::getEvents(mDataChannel.get(), events, count);
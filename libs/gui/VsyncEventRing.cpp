@@ -0,0 +1,265 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "VsyncEventRing"
+
+#include <private/gui/VsyncEventRing.h>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+#include <log/log.h>
+
+#ifndef F_SEAL_FUTURE_WRITE
+#define F_SEAL_FUTURE_WRITE 0x0010
+#endif
+
+namespace android::gui {
+
+namespace {
+
+constexpr uint32_t kMagic = fourcc('v', 'r', 'n', 'g');
+constexpr size_t kMaxCapacity = 64;
+
+// Without the first two, the writer could truncate the memfd while it is mapped by a reader.
+// F_SEAL_FUTURE_WRITE keeps readers from mapping the ring writable, and needs Linux 5.1.
+constexpr int kRequiredSeals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_FUTURE_WRITE;
+
+} // namespace
+
+struct VsyncEventRing::Header {
+    uint32_t magic;
+    uint32_t capacity;
+    uint32_t eventSize;
+    // The low bits of the latest sequence number, which readers wait on.
+    std::atomic<uint32_t> futexWord;
+    std::atomic<uint64_t> latestSequence;
+};
+
+struct VsyncEventRing::Slot {
+    // Twice the sequence number of the event in the slot, minus one while it is being written.
+    std::atomic<uint64_t> version;
+    ReaderMask readers;
+    Event event;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free);
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+static_assert(std::is_trivially_copyable_v<DisplayEventReceiver::Event>);
+
+std::unique_ptr<VsyncEventRing> VsyncEventRing::create(size_t capacity) {
+    capacity = std::clamp<size_t>(capacity, 1, kMaxCapacity);
+    const size_t size = sizeof(Header) + capacity * sizeof(Slot);
+
+    base::unique_fd fd(memfd_create("vsync_event_ring", MFD_CLOEXEC | MFD_ALLOW_SEALING));
+    if (!fd.ok()) {
+        ALOGE("Failed to create memfd: %s", strerror(errno));
+        return nullptr;
+    }
+    if (ftruncate(fd.get(), static_cast<off_t>(size)) != 0) {
+        ALOGE("Failed to resize memfd: %s", strerror(errno));
+        return nullptr;
+    }
+
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+    if (memory == MAP_FAILED) {
+        ALOGE("Failed to map memfd: %s", strerror(errno));
+        return nullptr;
+    }
+
+    if (TEMP_FAILURE_RETRY(fcntl(fd.get(), F_ADD_SEALS, kRequiredSeals)) != 0) {
+        ALOGE("Failed to seal memfd: %s", strerror(errno));
+        munmap(memory, size);
+        return nullptr;
+    }
+
+    // The memfd is zero-filled, so the slots are initially empty.
+    auto* header = new (memory) Header{};
+    header->magic = kMagic;
+    header->capacity = static_cast<uint32_t>(capacity);
+    header->eventSize = sizeof(Event);
+
+    return std::unique_ptr<VsyncEventRing>(
+            new VsyncEventRing(std::move(fd), memory, size, /*writable*/ true));
+}
+
+std::unique_ptr<VsyncEventRing> VsyncEventRing::map(base::unique_fd fd) {
+    const int seals = TEMP_FAILURE_RETRY(fcntl(fd.get(), F_GET_SEALS));
+    if (seals < 0 || (seals & kRequiredSeals) != kRequiredSeals) {
+        ALOGE("Refusing to map a ring which is not sealed");
+        return nullptr;
+    }
+
+    struct stat st;
+    if (fstat(fd.get(), &st) != 0 || st.st_size < static_cast<off_t>(sizeof(Header))) {
+        ALOGE("Invalid ring size");
+        return nullptr;
+    }
+    const size_t size = static_cast<size_t>(st.st_size);
+
+    void* memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd.get(), 0);
+    if (memory == MAP_FAILED) {
+        ALOGE("Failed to map ring: %s", strerror(errno));
+        return nullptr;
+    }
+
+    const auto* header = static_cast<const Header*>(memory);
+    if (header->magic != kMagic || header->eventSize != sizeof(Event) || header->capacity == 0 ||
+        header->capacity > kMaxCapacity ||
+        size != sizeof(Header) + header->capacity * sizeof(Slot)) {
+        ALOGE("Incompatible ring layout");
+        munmap(memory, size);
+        return nullptr;
+    }
+
+    return std::unique_ptr<VsyncEventRing>(
+            new VsyncEventRing(std::move(fd), memory, size, /*writable*/ false));
+}
+
+VsyncEventRing::VsyncEventRing(base::unique_fd fd, void* memory, size_t size, bool writable)
+      : mFd(std::move(fd)),
+        mMemory(memory),
+        mSize(size),
+        mWritable(writable),
+        mHeader(static_cast<Header*>(memory)),
+        mCapacity(mHeader->capacity) {}
+
+VsyncEventRing::~VsyncEventRing() {
+    munmap(mMemory, mSize);
+}
+
+base::unique_fd VsyncEventRing::dupFd() const {
+    return base::unique_fd(fcntl(mFd.get(), F_DUPFD_CLOEXEC, 0));
+}
+
+const VsyncEventRing::Slot& VsyncEventRing::getSlot(uint64_t sequence) const {
+    const auto* slots = reinterpret_cast<const Slot*>(mHeader + 1);
+    return slots[sequence % mCapacity];
+}
+
+VsyncEventRing::Slot& VsyncEventRing::getSlot(uint64_t sequence) {
+    auto* slots = reinterpret_cast<Slot*>(mHeader + 1);
+    return slots[sequence % mCapacity];
+}
+
+void VsyncEventRing::publish(const Event& event, const ReaderMask& readers) {
+    LOG_ALWAYS_FATAL_IF(!mWritable, "Only the creator of a VsyncEventRing can publish");
+
+    const uint64_t sequence = mHeader->latestSequence.load(std::memory_order_relaxed) + 1;
+    Slot& slot = getSlot(sequence);
+
+    slot.version.store(2 * sequence - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&slot.readers, &readers, sizeof(readers));
+    std::memcpy(&slot.event, &event, sizeof(event));
+    slot.version.store(2 * sequence, std::memory_order_release);
+
+    mHeader->latestSequence.store(sequence, std::memory_order_release);
+    mHeader->futexWord.store(static_cast<uint32_t>(sequence), std::memory_order_release);
+    syscall(SYS_futex, &mHeader->futexWord, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+uint64_t VsyncEventRing::getLatestSequence() const {
+    return mHeader->latestSequence.load(std::memory_order_acquire);
+}
+
+bool VsyncEventRing::readLatest(size_t readerIndex, uint64_t* lastSequence,
+                                Event* outEvent) const {
+    if (readerIndex >= kMaxReaders) {
+        return false;
+    }
+    const uint64_t readerBit = uint64_t(1) << (readerIndex % 64);
+
+    while (true) {
+        const uint64_t latest = getLatestSequence();
+        // Older events have been overwritten.
+        const uint64_t oldest =
+                std::max(*lastSequence + 1, latest >= mCapacity ? latest - mCapacity + 1 : 1);
+
+        bool overwritten = false;
+        for (uint64_t sequence = latest; sequence >= oldest && sequence > 0; --sequence) {
+            const Slot& slot = getSlot(sequence);
+            const uint64_t version = slot.version.load(std::memory_order_acquire);
+            if (version != 2 * sequence) {
+                overwritten = true;
+                break;
+            }
+
+            uint64_t readers;
+            std::memcpy(&readers, &slot.readers[readerIndex / 64], sizeof(readers));
+            Event event;
+            std::memcpy(&event, &slot.event, sizeof(event));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.version.load(std::memory_order_relaxed) != version) {
+                overwritten = true;
+                break;
+            }
+
+            if (readers & readerBit) {
+                *lastSequence = latest;
+                *outEvent = event;
+                return true;
+            }
+        }
+
+        // The writer lapped this reader while it was scanning, so start over from the new latest.
+        if (overwritten) {
+            continue;
+        }
+
+        *lastSequence = std::max(*lastSequence, latest);
+        return false;
+    }
+}
+
+bool VsyncEventRing::waitForEvent(uint64_t lastSequence, std::chrono::nanoseconds timeout) const {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (true) {
+        // Load the futex word before checking the sequence, so that a publish in between makes the
+        // wait return immediately.
+        const uint32_t futexWord = mHeader->futexWord.load(std::memory_order_acquire);
+        if (getLatestSequence() > lastSequence) {
+            return true;
+        }
+
+        const auto remaining = deadline - std::chrono::steady_clock::now();
+        if (remaining <= std::chrono::nanoseconds::zero()) {
+            return false;
+        }
+        const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(remaining);
+        const timespec relativeTimeout{
+                .tv_sec = static_cast<time_t>(seconds.count()),
+                .tv_nsec = static_cast<long>(
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(remaining - seconds)
+                                .count()),
+        };
+        syscall(SYS_futex, &mHeader->futexWord, FUTEX_WAIT, futexWord, &relativeTimeout, nullptr,
+                0);
+    }
+}
+
+} // namespace android::gui
@@ -46,6 +46,7 @@ using gui::VsyncEventData;
 
 namespace gui {
 class BitTube;
+class VsyncEventRing;
 } // namespace gui
 
 static inline constexpr uint32_t fourcc(char c1, char c2, char c3, char c4) {
@@ -176,6 +177,16 @@ public:
      */
     status_t getLatestVsyncEventData(ParcelableVsyncEventData* outVsyncEventData) const;
 
+    /**
+     * getVsyncEventRing() maps a ring in shared memory, and then switches the delivery of vsync
+     * events to it. Vsync events for this receiver are then read from the ring with
+     * outReaderIndex, while other events are still delivered through getEvents(). Reading should
+     * start from the latest sequence of the ring, as the reader index may have belonged to another
+     * receiver. If this fails, vsync events are still delivered through getEvents().
+     */
+    status_t getVsyncEventRing(std::unique_ptr<gui::VsyncEventRing>* outRing,
+                               size_t* outReaderIndex) const;
+
 private:
     sp<IDisplayEventConnection> mEventConnection;
     std::unique_ptr<gui::BitTube> mDataChannel;
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/unique_fd.h>
+#include <gui/DisplayEventReceiver.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace android::gui {
+
+// A ring of the latest vsync events in shared memory. SurfaceFlinger writes each vsync event once
+// for all the connections that read the ring, instead of writing it to the BitTube of each
+// connection, and wakes all the waiting readers with a single futex wake.
+//
+// Each event is tagged with the readers it is meant for, so that the requests and throttling of
+// each connection still apply. A reader only consumes the events that are tagged with its index.
+//
+// Slots are protected by a seqlock: the writer never waits for readers, and a reader retries if
+// the slot it copies is overwritten in the meantime. The memfd is sealed so that readers can only
+// map it read-only.
+class VsyncEventRing {
+public:
+    static constexpr size_t kDefaultCapacity = 8;
+    // Maximum number of readers of a ring.
+    static constexpr size_t kMaxReaders = 1024;
+
+    using Event = DisplayEventReceiver::Event;
+
+    // Creates a ring in a new memfd, mapped writable. Returns nullptr on failure.
+    static std::unique_ptr<VsyncEventRing> create(size_t capacity = kDefaultCapacity);
+
+    // Maps a ring created by another process read-only. Returns nullptr on failure.
+    static std::unique_ptr<VsyncEventRing> map(base::unique_fd fd);
+
+    ~VsyncEventRing();
+
+    VsyncEventRing(const VsyncEventRing&) = delete;
+    VsyncEventRing& operator=(const VsyncEventRing&) = delete;
+
+    // Returns a new file descriptor for the ring, to hand out to readers.
+    base::unique_fd dupFd() const;
+
+    // Writer only. Publishes the event to the given readers, and wakes all waiting readers.
+    template <typename Indices>
+    void publish(const Event& event, const Indices& readerIndices) {
+        ReaderMask readers{};
+        for (size_t index : readerIndices) {
+            if (index < kMaxReaders) {
+                readers[index / 64] |= uint64_t(1) << (index % 64);
+            }
+        }
+        publish(event, readers);
+    }
+
+    // Returns the sequence number of the latest event, or 0 if none was published yet.
+    uint64_t getLatestSequence() const;
+
+    // Copies the latest event for the reader published after lastSequence, if any, into outEvent.
+    // Events which were overwritten before being read are skipped. lastSequence is updated to the
+    // latest sequence number, whether an event was found or not.
+    bool readLatest(size_t readerIndex, uint64_t* lastSequence, Event* outEvent) const;
+
+    // Blocks until an event is published after lastSequence, or until the timeout expires.
+    // Returns true if there is a new event, which may not be meant for this reader.
+    bool waitForEvent(uint64_t lastSequence, std::chrono::nanoseconds timeout) const;
+
+private:
+    using ReaderMask = uint64_t[kMaxReaders / 64];
+
+    struct Header;
+    struct Slot;
+
+    VsyncEventRing(base::unique_fd fd, void* memory, size_t size, bool writable);
+
+    void publish(const Event& event, const ReaderMask& readers);
+
+    const Slot& getSlot(uint64_t sequence) const;
+    Slot& getSlot(uint64_t sequence);
+
+    const base::unique_fd mFd;
+    void* const mMemory;
+    const size_t mSize;
+    const bool mWritable;
+    Header* const mHeader;
+    const size_t mCapacity;
+};
+
+} // namespace android::gui
@@ -0,0 +1,166 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <private/gui/VsyncEventRing.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <thread>
+#include <vector>
+
+#ifndef F_SEAL_FUTURE_WRITE
+#define F_SEAL_FUTURE_WRITE 0x0010
+#endif
+
+namespace android::test {
+
+using namespace std::chrono_literals;
+using gui::VsyncEventRing;
+
+namespace {
+
+DisplayEventReceiver::Event makeVsync(uint32_t count) {
+    DisplayEventReceiver::Event event{};
+    event.header.type = DisplayEventReceiver::DISPLAY_EVENT_VSYNC;
+    event.header.timestamp = count * 1000;
+    event.vsync.count = count;
+    event.vsync.vsyncData.frameInterval = 16'666'667;
+    return event;
+}
+
+bool supportsFutureWriteSeal() {
+    base::unique_fd fd(memfd_create("seal_probe", MFD_CLOEXEC | MFD_ALLOW_SEALING));
+    return fd.ok() && TEMP_FAILURE_RETRY(fcntl(fd.get(), F_ADD_SEALS, F_SEAL_FUTURE_WRITE)) == 0;
+}
+
+} // namespace
+
+class VsyncEventRingTest : public testing::Test {
+protected:
+    void SetUp() override {
+        mWriter = VsyncEventRing::create(4);
+        if (mWriter == nullptr && !supportsFutureWriteSeal()) {
+            GTEST_SKIP() << "The kernel does not support F_SEAL_FUTURE_WRITE";
+        }
+        ASSERT_NE(nullptr, mWriter);
+        mReader = VsyncEventRing::map(mWriter->dupFd());
+        ASSERT_NE(nullptr, mReader);
+    }
+
+    std::unique_ptr<VsyncEventRing> mWriter;
+    std::unique_ptr<VsyncEventRing> mReader;
+};
+
+TEST_F(VsyncEventRingTest, readsPublishedEvent) {
+    uint64_t lastSequence = 0;
+    DisplayEventReceiver::Event event;
+    EXPECT_FALSE(mReader->readLatest(0, &lastSequence, &event));
+
+    mWriter->publish(makeVsync(1), std::vector<size_t>{0});
+    ASSERT_TRUE(mReader->readLatest(0, &lastSequence, &event));
+    EXPECT_EQ(1u, lastSequence);
+    EXPECT_EQ(1u, event.vsync.count);
+    EXPECT_EQ(16'666'667, event.vsync.vsyncData.frameInterval);
+
+    // The event is only read once
+    EXPECT_FALSE(mReader->readLatest(0, &lastSequence, &event));
+}
+
+TEST_F(VsyncEventRingTest, onlyReadsEventsForReader) {
+    mWriter->publish(makeVsync(1), std::vector<size_t>{1, 100});
+    mWriter->publish(makeVsync(2), std::vector<size_t>{100});
+
+    uint64_t lastSequence = 0;
+    DisplayEventReceiver::Event event;
+    EXPECT_FALSE(mReader->readLatest(0, &lastSequence, &event));
+    EXPECT_EQ(2u, lastSequence);
+
+    lastSequence = 0;
+    ASSERT_TRUE(mReader->readLatest(1, &lastSequence, &event));
+    EXPECT_EQ(1u, event.vsync.count);
+
+    lastSequence = 0;
+    ASSERT_TRUE(mReader->readLatest(100, &lastSequence, &event));
+    EXPECT_EQ(2u, event.vsync.count);
+}
+
+TEST_F(VsyncEventRingTest, skipsOverwrittenEvents) {
+    for (uint32_t count = 1; count <= 10; count++) {
+        mWriter->publish(makeVsync(count), std::vector<size_t>{count == 3 ? 1u : 0u});
+    }
+
+    uint64_t lastSequence = 0;
+    DisplayEventReceiver::Event event;
+    ASSERT_TRUE(mReader->readLatest(0, &lastSequence, &event));
+    EXPECT_EQ(10u, event.vsync.count);
+
+    // The event for reader 1 was overwritten by the following ones.
+    lastSequence = 0;
+    EXPECT_FALSE(mReader->readLatest(1, &lastSequence, &event));
+}
+
+TEST_F(VsyncEventRingTest, waitForEventTimesOut) {
+    EXPECT_FALSE(mReader->waitForEvent(0, 1ms));
+
+    mWriter->publish(makeVsync(1), std::vector<size_t>{0});
+    EXPECT_TRUE(mReader->waitForEvent(0, 1ms));
+    EXPECT_FALSE(mReader->waitForEvent(1, 1ms));
+}
+
+TEST_F(VsyncEventRingTest, publishWakesAllReaders) {
+    constexpr size_t kReaderCount = 4;
+    std::vector<std::thread> readers;
+    std::vector<uint32_t> counts(kReaderCount, 0);
+    for (size_t i = 0; i < kReaderCount; i++) {
+        readers.emplace_back([&, i] {
+            uint64_t lastSequence = 0;
+            DisplayEventReceiver::Event event;
+            while (!mReader->readLatest(i, &lastSequence, &event)) {
+                mReader->waitForEvent(lastSequence, 5s);
+            }
+            counts[i] = event.vsync.count;
+        });
+    }
+
+    mWriter->publish(makeVsync(7), std::vector<size_t>{0, 1, 2, 3});
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(std::vector<uint32_t>(kReaderCount, 7), counts);
+}
+
+TEST_F(VsyncEventRingTest, readerCannotMapWritable) {
+    const base::unique_fd fd = mWriter->dupFd();
+    struct stat st;
+    ASSERT_EQ(0, fstat(fd.get(), &st));
+    void* memory = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ | PROT_WRITE,
+                        MAP_SHARED, fd.get(), 0);
+    EXPECT_EQ(MAP_FAILED, memory);
+    if (memory != MAP_FAILED) munmap(memory, static_cast<size_t>(st.st_size));
+}
+
+TEST_F(VsyncEventRingTest, refusesUnsealedMemory) {
+    base::unique_fd fd(memfd_create("not_a_ring", MFD_CLOEXEC));
+    ASSERT_TRUE(fd.ok());
+    ASSERT_EQ(0, ftruncate(fd.get(), 4096));
+    EXPECT_EQ(nullptr, VsyncEventRing::map(std::move(fd)));
+}
+
+} // namespace android::test
@@ -26,6 +26,7 @@
 #include <ui/Point.h>
 #include <ui/Rect.h>
 #include <ui/Region.h>
+#include <ui/RegionBandOperator.h>
 #include <ui/RegionHelper.h>
 
 // ----------------------------------------------------------------------------
@@ -659,12 +660,15 @@ void Region::boolean_operation(uint32_t op, Region& dst,
     size_t rhs_count;
     Rect const * const rhs_rects = rhs.getArray(&rhs_count);
 
-    region_operator<Rect>::region lhs_region(lhs_rects, lhs_count);
-    region_operator<Rect>::region rhs_region(rhs_rects, rhs_count, dx, dy);
-    region_operator<Rect> operation(op, lhs_region, rhs_region);
-    { // scope for rasterizer (dtor has side effects)
-        rasterizer r(dst);
-        operation(r);
+    if (!region_band_operator::apply(op, dst.mStorage, lhs_rects, lhs_count, rhs_rects,
+                                     rhs_count, dx, dy)) {
+        region_operator<Rect>::region lhs_region(lhs_rects, lhs_count);
+        region_operator<Rect>::region rhs_region(rhs_rects, rhs_count, dx, dy);
+        region_operator<Rect> operation(op, lhs_region, rhs_region);
+        { // scope for rasterizer (dtor has side effects)
+            rasterizer r(dst);
+            operation(r);
+        }
     }
 
 #if defined(VALIDATE_REGIONS)
@@ -770,12 +774,14 @@ void Region::boolean_operation(uint32_t op, Region& dst,
     size_t lhs_count;
     Rect const * const lhs_rects = lhs.getArray(&lhs_count);
 
-    region_operator<Rect>::region lhs_region(lhs_rects, lhs_count);
-    region_operator<Rect>::region rhs_region(&rhs, 1, dx, dy);
-    region_operator<Rect> operation(op, lhs_region, rhs_region);
-    { // scope for rasterizer (dtor has side effects)
-        rasterizer r(dst);
-        operation(r);
+    if (!region_band_operator::apply(op, dst.mStorage, lhs_rects, lhs_count, &rhs, 1, dx, dy)) {
+        region_operator<Rect>::region lhs_region(lhs_rects, lhs_count);
+        region_operator<Rect>::region rhs_region(&rhs, 1, dx, dy);
+        region_operator<Rect> operation(op, lhs_region, rhs_region);
+        { // scope for rasterizer (dtor has side effects)
+            rasterizer r(dst);
+            operation(r);
+        }
     }
 
 #endif
@@ -0,0 +1,385 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_UI_PRIVATE_REGION_BAND_OPERATOR_H
+#define ANDROID_UI_PRIVATE_REGION_BAND_OPERATOR_H
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include <limits>
+
+#include <ui/FatVector.h>
+#include <ui/Rect.h>
+
+namespace android {
+// ----------------------------------------------------------------------------
+
+/*
+ * Band oriented implementation of the region boolean operations.
+ *
+ * Both operands are first converted to a structure-of-arrays form: a top, a bottom and a
+ * span range for each band (a run of rects sharing the same top), and the left and right
+ * edges of all the spans in two flat arrays. The bands are then swept from top to bottom,
+ * and the spans of each piece of band are merged straight into the same form, coalescing
+ * touching spans and identical adjacent bands as Region::rasterizer does. Because the edges
+ * are contiguous, runs of spans lying entirely before the other operand's current span, and
+ * the spans of adjacent bands, are compared four at a time with the compiler's vector
+ * extensions, which lower to NEON on ARM and SSE on x86.
+ *
+ * The op mask is the same as region_operator's, and so is the result, rect for rect.
+ * Operands region_operator does not handle consistently (invalid, unsorted or overlapping
+ * rects, or coordinates reaching max_value) are rejected: apply() then returns false without
+ * touching the destination, and the caller is expected to fall back to region_operator.
+ */
+class region_band_operator {
+public:
+    typedef Rect::value_type TYPE;
+    static const TYPE max_value = std::numeric_limits<TYPE>::max();
+
+    // Computes lhs op (rhs + (dx, dy)) into dst, which may alias either operand.
+    static bool apply(uint32_t op, FatVector<Rect>& dst, Rect const* lhs, size_t lhs_count,
+                      Rect const* rhs, size_t rhs_count, TYPE dx, TYPE dy) {
+        bands a;
+        bands b;
+        if (!a.load(lhs, lhs_count, 0, 0) || !b.load(rhs, rhs_count, dx, dy)) {
+            return false;
+        }
+        bands result;
+        sweep(op, a, b, result);
+        result.store(dst);
+        return true;
+    }
+
+private:
+    typedef TYPE vec4 __attribute__((vector_size(4 * sizeof(TYPE))));
+    typedef uint32_t uvec4 __attribute__((vector_size(4 * sizeof(uint32_t))));
+    static_assert(sizeof(TYPE) == sizeof(uint32_t), "vec4 must hold four edges");
+    static_assert(sizeof(Rect) == sizeof(vec4), "Rect must be four packed edges");
+
+    // op_mask bits, as computed by region_operator: a piece of a span is kept if the bit for
+    // the operands covering it is set.
+    enum { lhs_only = 1, rhs_only = 2, both = 4 };
+
+    static inline vec4 load4(const TYPE* p) {
+        vec4 v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    // Comparisons yield -1 in the lanes where they hold, 0 elsewhere.
+    static inline bool any(vec4 mask) { return (mask[0] | mask[1] | mask[2] | mask[3]) != 0; }
+    static inline bool all(vec4 mask) { return (mask[0] & mask[1] & mask[2] & mask[3]) != 0; }
+    static inline size_t lanes(vec4 mask) {
+        return static_cast<size_t>(-(mask[0] + mask[1] + mask[2] + mask[3]));
+    }
+
+    // Returns the length of the run of values, from the first one, that are <= limit. The
+    // values must be sorted.
+    static inline size_t count_at_most(const TYPE* values, size_t count, TYPE limit) {
+        const vec4 limits = {limit, limit, limit, limit};
+        size_t n = 0;
+        for (; n + 4 <= count; n += 4) {
+            const vec4 mask = load4(values + n) <= limits;
+            if (!all(mask)) {
+                return n + lanes(mask);
+            }
+        }
+        while (n < count && values[n] <= limit) {
+            n++;
+        }
+        return n;
+    }
+
+    static inline bool equal(const TYPE* lhs, const TYPE* rhs, size_t count) {
+        size_t n = 0;
+        for (; n + 4 <= count; n += 4) {
+            if (!all(load4(lhs + n) == load4(rhs + n))) {
+                return false;
+            }
+        }
+        for (; n < count; n++) {
+            if (lhs[n] != rhs[n]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    struct bands {
+        FatVector<TYPE, 16> tops;
+        FatVector<TYPE, 16> bottoms;
+        // Index of the first span of each band, followed by the total number of spans.
+        FatVector<uint32_t, 17> spans;
+        FatVector<TYPE, 32> lefts;
+        FatVector<TYPE, 32> rights;
+
+        bands() { spans.push_back(0); }
+
+        inline size_t size() const { return tops.size(); }
+        inline size_t first(size_t band) const { return spans[band]; }
+        inline size_t count(size_t band) const { return spans[band + 1] - spans[band]; }
+
+        bool load(Rect const* rects, size_t count, TYPE dx, TYPE dy) {
+            const vec4 offset = {dx, dy, dx, dy};
+            for (size_t i = 0; i < count; i++) {
+                const vec4 rect = load_rect(rects[i]);
+                // Wrapping add, then detect signed overflow: it happened in the lanes where
+                // the result has a different sign than both operands.
+                const vec4 edges = (vec4)((uvec4)rect + (uvec4)offset);
+                if (any(((rect ^ edges) & (offset ^ edges)) < 0)) {
+                    return false;
+                }
+                const TYPE left = edges[0];
+                const TYPE top = edges[1];
+                const TYPE right = edges[2];
+                const TYPE bottom = edges[3];
+                if (left > right || top > bottom) {
+                    return false;
+                }
+                if (left == right || top == bottom) {
+                    // Empty rects, such as the one of an empty region, cover nothing.
+                    continue;
+                }
+                if (right == max_value || bottom == max_value) {
+                    return false;
+                }
+                if (!tops.empty() && top == tops.back()) {
+                    if (bottom != bottoms.back() || left < rights.back()) {
+                        return false;
+                    }
+                    spans.back()++;
+                } else {
+                    if (!tops.empty() && top < bottoms.back()) {
+                        return false;
+                    }
+                    tops.push_back(top);
+                    bottoms.push_back(bottom);
+                    spans.push_back(spans.back() + 1);
+                }
+                lefts.push_back(left);
+                rights.push_back(right);
+            }
+            return true;
+        }
+
+        // Appends a span to the band being built, merging it with the previous one if they
+        // touch. Spans must be added from left to right.
+        inline void add_span(TYPE left, TYPE right) {
+            if (lefts.size() > spans.back() && rights.back() == left) {
+                rights.back() = right;
+            } else {
+                lefts.push_back(left);
+                rights.push_back(right);
+            }
+        }
+
+        // Terminates the band being built. It is dropped if it has no spans, and merged
+        // into the previous band if they touch and have the same spans.
+        void end_band(TYPE top, TYPE bottom) {
+            const size_t begin = spans.back();
+            const size_t n = lefts.size() - begin;
+            if (n == 0) {
+                return;
+            }
+            const size_t last = size() - 1;
+            if (size() && bottoms[last] == top && count(last) == n &&
+                equal(lefts.data() + first(last), lefts.data() + begin, n) &&
+                equal(rights.data() + first(last), rights.data() + begin, n)) {
+                bottoms[last] = bottom;
+                lefts.resize(begin);
+                rights.resize(begin);
+                return;
+            }
+            tops.push_back(top);
+            bottoms.push_back(bottom);
+            spans.push_back(static_cast<uint32_t>(lefts.size()));
+        }
+
+        void copy_band(TYPE top, TYPE bottom, const bands& src, size_t band) {
+            const size_t begin = src.first(band);
+            const size_t end = begin + src.count(band);
+            for (size_t i = begin; i < end; i++) {
+                add_span(src.lefts[i], src.rights[i]);
+            }
+            end_band(top, bottom);
+        }
+
+        // Appends the spans [begin, end) of src, if keep is set.
+        inline void copy_spans(bool keep, const bands& src, size_t begin, size_t end) {
+            if (keep) {
+                for (size_t i = begin; i < end; i++) {
+                    add_span(src.lefts[i], src.rights[i]);
+                }
+            }
+        }
+
+        void merge_bands(uint32_t op, TYPE top, TYPE bottom, const bands& a, size_t a_band,
+                         const bands& b, size_t b_band) {
+            const TYPE* const a_rights = a.rights.data();
+            const TYPE* const b_rights = b.rights.data();
+            size_t i = a.first(a_band);
+            size_t j = b.first(b_band);
+            const size_t i_end = i + a.count(a_band);
+            const size_t j_end = j + b.count(b_band);
+            // Left edge of the part of the current span of each operand not processed yet.
+            TYPE a_head = a.lefts[i];
+            TYPE b_head = b.lefts[j];
+            while (i < i_end && j < j_end) {
+                if (a_rights[i] <= b_head) {
+                    // The span of a ends before the one of b starts, and so might the next ones.
+                    if (op & lhs_only) {
+                        add_span(a_head, a_rights[i]);
+                    }
+                    const size_t run = i + 1 + count_at_most(a_rights + i + 1, i_end - i - 1, b_head);
+                    copy_spans(op & lhs_only, a, i + 1, run);
+                    i = run;
+                    if (i < i_end) {
+                        a_head = a.lefts[i];
+                    }
+                } else if (b_rights[j] <= a_head) {
+                    if (op & rhs_only) {
+                        add_span(b_head, b_rights[j]);
+                    }
+                    const size_t run = j + 1 + count_at_most(b_rights + j + 1, j_end - j - 1, a_head);
+                    copy_spans(op & rhs_only, b, j + 1, run);
+                    j = run;
+                    if (j < j_end) {
+                        b_head = b.lefts[j];
+                    }
+                } else if (a_head < b_head) {
+                    // The spans overlap, and a starts first.
+                    if (op & lhs_only) {
+                        add_span(a_head, b_head);
+                    }
+                    a_head = b_head;
+                } else if (b_head < a_head) {
+                    if (op & rhs_only) {
+                        add_span(b_head, a_head);
+                    }
+                    b_head = a_head;
+                } else {
+                    const TYPE right = a_rights[i] < b_rights[j] ? a_rights[i] : b_rights[j];
+                    if (op & both) {
+                        add_span(a_head, right);
+                    }
+                    a_head = right;
+                    b_head = right;
+                    if (a_rights[i] == right && ++i < i_end) {
+                        a_head = a.lefts[i];
+                    }
+                    if (b_rights[j] == right && ++j < j_end) {
+                        b_head = b.lefts[j];
+                    }
+                }
+            }
+            if (i < i_end && (op & lhs_only)) {
+                add_span(a_head, a_rights[i]);
+                copy_spans(true, a, i + 1, i_end);
+            }
+            if (j < j_end && (op & rhs_only)) {
+                add_span(b_head, b_rights[j]);
+                copy_spans(true, b, j + 1, j_end);
+            }
+            end_band(top, bottom);
+        }
+
+        void store(FatVector<Rect>& dst) const {
+            dst.clear();
+            if (lefts.empty()) {
+                dst.push_back(Rect(0, 0));
+                return;
+            }
+            Rect bounds(max_value, tops.front(), std::numeric_limits<TYPE>::min(), bottoms.back());
+            dst.reserve(lefts.size() + 1);
+            for (size_t band = 0; band < size(); band++) {
+                const size_t begin = first(band);
+                const size_t end = begin + count(band);
+                for (size_t i = begin; i < end; i++) {
+                    dst.push_back(Rect(lefts[i], tops[band], rights[i], bottoms[band]));
+                }
+                bounds.left = lefts[begin] < bounds.left ? lefts[begin] : bounds.left;
+                bounds.right = rights[end - 1] > bounds.right ? rights[end - 1] : bounds.right;
+            }
+            if (dst.size() > 1) {
+                dst.push_back(bounds);
+            }
+        }
+
+    private:
+        static inline vec4 load_rect(const Rect& rect) {
+            vec4 v;
+            memcpy(&v, &rect, sizeof(v));
+            return v;
+        }
+    };
+
+    static void sweep(uint32_t op, const bands& a, const bands& b, bands& result) {
+        size_t i = 0;
+        size_t j = 0;
+        // Top of the part of the current band of each operand not processed yet.
+        TYPE a_top = a.size() ? a.tops[0] : 0;
+        TYPE b_top = b.size() ? b.tops[0] : 0;
+        while (i < a.size() || j < b.size()) {
+            if ((j == b.size() && !(op & lhs_only)) || (i == a.size() && !(op & rhs_only))) {
+                // Nothing left can make it to the result.
+                break;
+            }
+            if (j == b.size() || (i < a.size() && a_top < b_top)) {
+                TYPE bottom = a.bottoms[i];
+                if (j < b.size() && b_top < bottom) {
+                    bottom = b_top;
+                }
+                if (op & lhs_only) {
+                    result.copy_band(a_top, bottom, a, i);
+                }
+                a_top = bottom;
+                if (a.bottoms[i] == bottom && ++i < a.size()) {
+                    a_top = a.tops[i];
+                }
+            } else if (i == a.size() || b_top < a_top) {
+                TYPE bottom = b.bottoms[j];
+                if (i < a.size() && a_top < bottom) {
+                    bottom = a_top;
+                }
+                if (op & rhs_only) {
+                    result.copy_band(b_top, bottom, b, j);
+                }
+                b_top = bottom;
+                if (b.bottoms[j] == bottom && ++j < b.size()) {
+                    b_top = b.tops[j];
+                }
+            } else {
+                const TYPE bottom = a.bottoms[i] < b.bottoms[j] ? a.bottoms[i] : b.bottoms[j];
+                result.merge_bands(op, a_top, bottom, a, i, b, j);
+                a_top = bottom;
+                b_top = bottom;
+                if (a.bottoms[i] == bottom && ++i < a.size()) {
+                    a_top = a.tops[i];
+                }
+                if (b.bottoms[j] == bottom && ++j < b.size()) {
+                    b_top = b.tops[j];
+                }
+            }
+        }
+    }
+};
+
+// ----------------------------------------------------------------------------
+}; // namespace android
+
+#endif /* ANDROID_UI_PRIVATE_REGION_BAND_OPERATOR_H */
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <ui/Rect.h>
+#include <ui/Region.h>
+
+#include <vector>
+
+namespace android {
+namespace {
+
+// Usage: atest Region_benchmark
+
+constexpr int32_t kDisplayWidth = 1080;
+constexpr int32_t kDisplayHeight = 2340;
+const Rect kDisplayBounds(kDisplayWidth, kDisplayHeight);
+
+struct Layer {
+    Rect bounds;
+    bool isOpaque;
+};
+
+// Partially overlapping layers, similar to a launcher with many widgets, listed front to back.
+std::vector<Layer> createLayers(size_t count) {
+    std::vector<Layer> layers;
+    layers.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        const int32_t left = static_cast<int32_t>((i * 37) % (kDisplayWidth - 300));
+        const int32_t top = static_cast<int32_t>((i * 53) % (kDisplayHeight - 300));
+        const int32_t size = 100 + static_cast<int32_t>((i * 71) % 200);
+        layers.push_back({Rect(left, top, left + size, top + size), i % 3 == 0});
+    }
+    return layers;
+}
+
+// The region computations done for each layer when SurfaceFlinger rebuilds the layer stack of
+// a display: what the layer covers, what is visible of it, and what changed.
+void BM_computeVisibleRegions(benchmark::State& state) {
+    const std::vector<Layer> layers = createLayers(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        Region aboveOpaqueLayers;
+        Region aboveCoveredLayers;
+        Region dirtyRegion;
+        for (const Layer& layer : layers) {
+            const Region visibleRegion = Region(layer.bounds).subtract(aboveOpaqueLayers);
+            const Region coveredRegion = aboveCoveredLayers.intersect(layer.bounds);
+            aboveCoveredLayers.orSelf(layer.bounds);
+            if (layer.isOpaque) {
+                aboveOpaqueLayers.orSelf(layer.bounds);
+            }
+            const Region visibleNonTransparentRegion = visibleRegion.subtract(coveredRegion);
+            dirtyRegion.orSelf(visibleNonTransparentRegion.intersect(kDisplayBounds));
+            benchmark::DoNotOptimize(visibleNonTransparentRegion);
+        }
+        benchmark::DoNotOptimize(dirtyRegion);
+    }
+}
+BENCHMARK(BM_computeVisibleRegions)->Arg(8)->Arg(32)->Arg(128);
+
+// Accumulates many small damage rects, as done for the dirty region of a display.
+void BM_accumulateDirtyRects(benchmark::State& state) {
+    const size_t count = static_cast<size_t>(state.range(0));
+    std::vector<Rect> rects;
+    rects.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        const int32_t left = static_cast<int32_t>((i * 97) % (kDisplayWidth - 64));
+        const int32_t top = static_cast<int32_t>((i * 131) % (kDisplayHeight - 64));
+        rects.emplace_back(left, top, left + 64, top + 48);
+    }
+    for (auto _ : state) {
+        Region dirtyRegion;
+        for (const Rect& rect : rects) {
+            dirtyRegion.orSelf(rect);
+        }
+        benchmark::DoNotOptimize(dirtyRegion);
+    }
+}
+BENCHMARK(BM_accumulateDirtyRects)->Arg(16)->Arg(64)->Arg(256);
+
+// Region against region operations on complex regions, such as those of the layers in the
+// middle of a stack.
+void BM_regionOperations(benchmark::State& state) {
+    const std::vector<Layer> layers = createLayers(static_cast<size_t>(state.range(0)));
+    Region lhs;
+    Region rhs;
+    for (size_t i = 0; i < layers.size(); i++) {
+        (i % 2 ? lhs : rhs).orSelf(layers[i].bounds);
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(lhs.merge(rhs));
+        benchmark::DoNotOptimize(lhs.intersect(rhs));
+        benchmark::DoNotOptimize(lhs.subtract(rhs));
+        benchmark::DoNotOptimize(lhs.mergeExclusive(rhs));
+        benchmark::DoNotOptimize(lhs.intersect(rhs, 10, 20));
+    }
+}
+BENCHMARK(BM_regionOperations)->Arg(8)->Arg(32)->Arg(128);
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
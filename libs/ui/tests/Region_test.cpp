@@ -53,6 +53,56 @@ protected:
         }
         EXPECT_TRUE((original ^ modified).isEmpty());
     }
+
+    // Checks that the rects of r are in the form produced by the boolean operations: touching
+    // rects of a span are merged, and so are touching spans made of the same rects.
+    void verifyCanonical(const Region& r) {
+        const Rect* const end = r.end();
+        const Rect* previousSpan = nullptr;
+        for (const Rect* span = r.begin(); span < end;) {
+            const Rect* spanEnd = span + 1;
+            while (spanEnd < end && spanEnd->top == span->top) {
+                EXPECT_EQ(spanEnd->bottom, span->bottom);
+                EXPECT_GT(spanEnd->left, (spanEnd - 1)->right);
+                spanEnd++;
+            }
+            if (previousSpan && previousSpan->bottom == span->top &&
+                span - previousSpan == spanEnd - span) {
+                bool same = true;
+                for (ptrdiff_t i = 0; i < spanEnd - span; i++) {
+                    same &= previousSpan[i].left == span[i].left &&
+                            previousSpan[i].right == span[i].right;
+                }
+                EXPECT_FALSE(same) << "spans at " << previousSpan->top << " and " << span->top
+                                   << " were not merged";
+            }
+            previousSpan = span;
+            span = spanEnd;
+        }
+    }
+
+    // Checks every boolean operation of lhs and rhs, offset by (dx, dy), against the
+    // pixels of the operands.
+    void checkBooleanOperations(const Region& lhs, const Region& rhs, int dx, int dy, int w,
+                                int h) {
+        const Region merged = lhs.merge(rhs, dx, dy);
+        const Region exclusive = lhs.mergeExclusive(rhs, dx, dy);
+        const Region intersected = lhs.intersect(rhs, dx, dy);
+        const Region subtracted = lhs.subtract(rhs, dx, dy);
+        for (const Region* result : {&merged, &exclusive, &intersected, &subtracted}) {
+            verifyCanonical(*result);
+        }
+        for (int y = -1; y <= h; y++) {
+            for (int x = -1; x <= w; x++) {
+                const bool inLhs = lhs.contains(x, y);
+                const bool inRhs = rhs.contains(x - dx, y - dy);
+                ASSERT_EQ(inLhs || inRhs, merged.contains(x, y)) << x << "," << y;
+                ASSERT_EQ(inLhs != inRhs, exclusive.contains(x, y)) << x << "," << y;
+                ASSERT_EQ(inLhs && inRhs, intersected.contains(x, y)) << x << "," << y;
+                ASSERT_EQ(inLhs && !inRhs, subtracted.contains(x, y)) << x << "," << y;
+            }
+        }
+    }
 };
 
 TEST_F(RegionTest, MinimalDivision_TJunction) {
@@ -179,5 +229,86 @@ TEST_F(RegionTest, RegionHash) {
     EXPECT_NE(std::hash<Region>{}(region1), std::hash<Region>{}(region2));
 }
 
+TEST_F(RegionTest, BooleanOperations_Random) {
+    srandom(12345);
+
+    for (int iter = 0; iter < ITER_MAX; iter++) {
+        Region lhs;
+        Region rhs;
+        for (Region* r : {&lhs, &rhs}) {
+            const int count = random() % 6;
+            for (int i = 0; i < count; i++) {
+                const int left = random() % X_MAX;
+                const int top = random() % Y_MAX;
+                r->orSelf(Rect(left, top, left + 1 + random() % 4, top + 1 + random() % 4));
+            }
+        }
+        // T-junction free regions have touching rects, which must be merged in the results.
+        if (iter % 2) {
+            lhs = Region::createTJunctionFreeRegion(lhs);
+        }
+        const int dx = random() % 5 - 2;
+        const int dy = random() % 5 - 2;
+        checkBooleanOperations(lhs, rhs, dx, dy, X_MAX + 4, Y_MAX + 4);
+    }
+}
+
+TEST_F(RegionTest, BooleanOperations_ManySpans) {
+    // Spans are compared several at a time, so use bands with more of them than that.
+    Region lhs;
+    Region rhs;
+    for (int i = 0; i < 16; i++) {
+        lhs.orSelf(Rect(i * 4, 0, i * 4 + 2, 10));
+        rhs.orSelf(Rect(i * 6, 4 + i % 3, i * 6 + 3, 14));
+    }
+    rhs.orSelf(Rect(20, 0, 40, 2));
+    checkBooleanOperations(lhs, rhs, 0, 0, 100, 16);
+    checkBooleanOperations(lhs, rhs, 1, -3, 100, 16);
+    checkBooleanOperations(lhs, lhs, 2, 0, 100, 16);
+}
+
+TEST_F(RegionTest, BooleanOperations_MergeSpans) {
+    Region r(Rect(0, 0, 10, 10));
+    r.orSelf(Rect(10, 0, 20, 10));
+    r.orSelf(Rect(0, 10, 20, 20));
+    EXPECT_TRUE(r.isRect());
+    EXPECT_EQ(Rect(0, 0, 20, 20), r.getBounds());
+
+    r.subtractSelf(Rect(5, 5, 15, 15));
+    size_t count;
+    const Rect* rects = r.getArray(&count);
+    ASSERT_EQ(4u, count);
+    EXPECT_EQ(Rect(0, 0, 20, 5), rects[0]);
+    EXPECT_EQ(Rect(0, 5, 5, 15), rects[1]);
+    EXPECT_EQ(Rect(15, 5, 20, 15), rects[2]);
+    EXPECT_EQ(Rect(0, 15, 20, 20), rects[3]);
+    EXPECT_EQ(Rect(0, 0, 20, 20), r.getBounds());
+
+    r.orSelf(Rect(5, 5, 15, 15));
+    EXPECT_TRUE(r.isRect());
+    EXPECT_EQ(Rect(0, 0, 20, 20), r.getBounds());
+
+    r.andSelf(Rect(30, 30, 40, 40));
+    EXPECT_TRUE(r.isEmpty());
+    EXPECT_EQ(Rect(0, 0, 0, 0), r.getBounds());
+}
+
+TEST_F(RegionTest, BooleanOperations_WithSelf) {
+    Region r(Rect(0, 0, 10, 10));
+    r.orSelf(Rect(20, 0, 30, 10));
+
+    Region merged(r);
+    merged.orSelf(merged, 5, 5);
+    EXPECT_TRUE(merged.hasSameRects(r.merge(r, 5, 5)));
+
+    Region subtracted(r);
+    subtracted.subtractSelf(subtracted);
+    EXPECT_TRUE(subtracted.isEmpty());
+
+    Region intersected(r);
+    intersected.andSelf(intersected.getBounds());
+    EXPECT_TRUE(intersected.hasSameRects(r));
+}
+
 }; // namespace android
 
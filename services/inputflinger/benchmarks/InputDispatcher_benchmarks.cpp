@@ -199,6 +199,11 @@ public:
         mInfo.displayId = ADISPLAY_ID_DEFAULT;
     }
 
+    void setFrame(const Rect& frame) {
+        mFrame = frame;
+        updateInfo();
+    }
+
 protected:
     Rect mFrame;
 };
@@ -293,6 +298,59 @@ static void benchmarkNotifyMotion(benchmark::State& state) {
     dispatcher.stop();
 }
 
+// Creates a scene of the given number of non-overlapping windows. The last window, at the back,
+// covers the location of the generated motion events.
+static std::vector<sp<FakeWindowHandle>> createWindowScene(InputDispatcher& dispatcher,
+                                                           size_t windowCount) {
+    std::shared_ptr<FakeApplicationHandle> application = std::make_shared<FakeApplicationHandle>();
+    std::vector<sp<FakeWindowHandle>> windows;
+    for (size_t i = 0; i + 1 < windowCount; i++) {
+        sp<FakeWindowHandle> window =
+                sp<FakeWindowHandle>::make(application, dispatcher,
+                                           "Fake Window " + std::to_string(i));
+        const int32_t left = FakeWindowHandle::WIDTH + (i % 20) * 50;
+        const int32_t top = (i / 20) * 50;
+        window->setFrame(Rect(left, top, left + 50, top + 50));
+        windows.push_back(window);
+    }
+    windows.push_back(sp<FakeWindowHandle>::make(application, dispatcher, "Touched Window"));
+    return windows;
+}
+
+static void benchmarkNotifyMotionWithManyWindows(benchmark::State& state) {
+    // Create dispatcher
+    FakeInputDispatcherPolicy fakePolicy;
+    InputDispatcher dispatcher(fakePolicy);
+    dispatcher.setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher.start();
+
+    std::vector<sp<FakeWindowHandle>> windows = createWindowScene(dispatcher, state.range(0));
+    dispatcher.setInputWindows(
+            {{ADISPLAY_ID_DEFAULT, std::vector<sp<WindowInfoHandle>>(windows.begin(),
+                                                                     windows.end())}});
+    const sp<FakeWindowHandle>& touchedWindow = windows.back();
+
+    NotifyMotionArgs motionArgs = generateMotionArgs();
+
+    for (auto _ : state) {
+        // Send ACTION_DOWN
+        motionArgs.action = AMOTION_EVENT_ACTION_DOWN;
+        motionArgs.downTime = now();
+        motionArgs.eventTime = motionArgs.downTime;
+        dispatcher.notifyMotion(motionArgs);
+
+        // Send ACTION_UP
+        motionArgs.action = AMOTION_EVENT_ACTION_UP;
+        motionArgs.eventTime = now();
+        dispatcher.notifyMotion(motionArgs);
+
+        touchedWindow->consumeEvent();
+        touchedWindow->consumeEvent();
+    }
+
+    dispatcher.stop();
+}
+
 static void benchmarkInjectMotion(benchmark::State& state) {
     // Create dispatcher
     FakeInputDispatcherPolicy fakePolicy;
@@ -353,11 +411,38 @@ static void benchmarkOnWindowInfosChanged(benchmark::State& state) {
     dispatcher.stop();
 }
 
+static void benchmarkOnWindowInfosChangedWithManyWindows(benchmark::State& state) {
+    // Create dispatcher
+    FakeInputDispatcherPolicy fakePolicy;
+    InputDispatcher dispatcher(fakePolicy);
+    dispatcher.setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher.start();
+
+    std::vector<sp<FakeWindowHandle>> windows = createWindowScene(dispatcher, state.range(0));
+    std::vector<gui::WindowInfo> windowInfos;
+    for (const sp<FakeWindowHandle>& window : windows) {
+        windowInfos.push_back(*window->getInfo());
+    }
+    gui::DisplayInfo info;
+    info.displayId = ADISPLAY_ID_DEFAULT;
+    std::vector<gui::DisplayInfo> displayInfos{info};
+
+    for (auto _ : state) {
+        dispatcher.onWindowInfosChanged(
+                {windowInfos, displayInfos, /*vsyncId=*/0, /*timestamp=*/0});
+        dispatcher.onWindowInfosChanged(
+                {/*windowInfos=*/{}, /*displayInfos=*/{}, /*vsyncId=*/{}, /*timestamp=*/0});
+    }
+    dispatcher.stop();
+}
+
 } // namespace
 
 BENCHMARK(benchmarkNotifyMotion);
+BENCHMARK(benchmarkNotifyMotionWithManyWindows)->Arg(200);
 BENCHMARK(benchmarkInjectMotion);
 BENCHMARK(benchmarkOnWindowInfosChanged);
+BENCHMARK(benchmarkOnWindowInfosChangedWithManyWindows)->Arg(200);
 
 } // namespace android::inputdispatcher
 
@@ -1248,6 +1248,37 @@ InputDispatcher::findTouchedWindowAtLocked(int32_t displayId, float x, float y,
     // Traverse windows from front to back to find touched window.
     std::vector<InputTarget> outsideTargets;
     const auto& windowHandles = getWindowHandlesLocked(displayId);
+    const ui::Transform displayTransform = getTransformLocked(displayId);
+    if (const TouchWindowIndex* index = getTouchWindowIndexLocked(displayId, displayTransform)) {
+        // Only the windows whose touchable bounds cover the point can be touched. The windows
+        // watching for outside touches are the ones in front of the touched window.
+        for (size_t i : index->getCandidatesAt(x, y)) {
+            const sp<WindowInfoHandle>& windowHandle = windowHandles[i];
+            if (ignoreDragWindow && haveSameToken(windowHandle, mDragState->dragWindow)) {
+                continue;
+            }
+            const WindowInfo& info = *windowHandle->getInfo();
+            if (info.isSpy() ||
+                !windowAcceptsTouchAt(info, displayId, x, y, isStylus, displayTransform)) {
+                continue;
+            }
+            for (size_t watcher : index->getOutsideTouchWatchers()) {
+                if (watcher >= i) {
+                    break;
+                }
+                const sp<WindowInfoHandle>& watcherHandle = windowHandles[watcher];
+                if (ignoreDragWindow && haveSameToken(watcherHandle, mDragState->dragWindow)) {
+                    continue;
+                }
+                addWindowTargetLocked(watcherHandle, InputTarget::Flags::DISPATCH_AS_OUTSIDE,
+                                      /*pointerIds=*/{}, /*firstDownTimeInTarget=*/std::nullopt,
+                                      outsideTargets);
+            }
+            return {windowHandle, outsideTargets};
+        }
+        return {nullptr, {}};
+    }
+
     for (const sp<WindowInfoHandle>& windowHandle : windowHandles) {
         if (ignoreDragWindow && haveSameToken(windowHandle, mDragState->dragWindow)) {
             continue;
@@ -1255,7 +1286,7 @@ InputDispatcher::findTouchedWindowAtLocked(int32_t displayId, float x, float y,
 
         const WindowInfo& info = *windowHandle->getInfo();
         if (!info.isSpy() &&
-            windowAcceptsTouchAt(info, displayId, x, y, isStylus, getTransformLocked(displayId))) {
+            windowAcceptsTouchAt(info, displayId, x, y, isStylus, displayTransform)) {
             return {windowHandle, outsideTargets};
         }
 
@@ -1273,17 +1304,33 @@ std::vector<sp<WindowInfoHandle>> InputDispatcher::findTouchedSpyWindowsAtLocked
     // Traverse windows from front to back and gather the touched spy windows.
     std::vector<sp<WindowInfoHandle>> spyWindows;
     const auto& windowHandles = getWindowHandlesLocked(displayId);
-    for (const sp<WindowInfoHandle>& windowHandle : windowHandles) {
+    const ui::Transform displayTransform = getTransformLocked(displayId);
+    const auto visitWindow = [&](const sp<WindowInfoHandle>& windowHandle) {
         const WindowInfo& info = *windowHandle->getInfo();
 
-        if (!windowAcceptsTouchAt(info, displayId, x, y, isStylus, getTransformLocked(displayId))) {
-            continue;
+        if (!windowAcceptsTouchAt(info, displayId, x, y, isStylus, displayTransform)) {
+            return true;
         }
         if (!info.isSpy()) {
             // The first touched non-spy window was found, so return the spy windows touched so far.
-            return spyWindows;
+            return false;
         }
         spyWindows.push_back(windowHandle);
+        return true;
+    };
+
+    if (const TouchWindowIndex* index = getTouchWindowIndexLocked(displayId, displayTransform)) {
+        for (size_t i : index->getCandidatesAt(x, y)) {
+            if (!visitWindow(windowHandles[i])) {
+                break;
+            }
+        }
+        return spyWindows;
+    }
+    for (const sp<WindowInfoHandle>& windowHandle : windowHandles) {
+        if (!visitWindow(windowHandle)) {
+            break;
+        }
     }
     return spyWindows;
 }
@@ -4990,6 +5037,16 @@ ui::Transform InputDispatcher::getTransformLocked(int32_t displayId) const {
                                                 : kIdentityTransform;
 }
 
+const TouchWindowIndex* InputDispatcher::getTouchWindowIndexLocked(
+        int32_t displayId, const ui::Transform& displayTransform) const {
+    const auto it = mTouchWindowIndexByDisplay.find(displayId);
+    if (it == mTouchWindowIndexByDisplay.end() || !it->second.isValidFor(displayTransform)) {
+        // Not enough windows to index, or the display info changed since the index was built.
+        return nullptr;
+    }
+    return &it->second;
+}
+
 bool InputDispatcher::canWindowReceiveMotionLocked(const sp<WindowInfoHandle>& window,
                                                    const MotionEntry& motionEntry) const {
     const WindowInfo& info = *window->getInfo();
@@ -5059,6 +5116,7 @@ void InputDispatcher::updateWindowHandlesForDisplayLocked(
     if (windowInfoHandles.empty()) {
         // Remove all handles on a display if there are no windows left.
         mWindowHandlesByDisplay.erase(displayId);
+        mTouchWindowIndexByDisplay.erase(displayId);
         return;
     }
 
@@ -5102,6 +5160,16 @@ void InputDispatcher::updateWindowHandlesForDisplayLocked(
         }
     }
 
+    // Rebuild the touch index, which refers to windows by their position in the new list. The
+    // display info has already been updated at this point, so the current transform is used.
+    if (newHandles.size() >= TouchWindowIndex::MIN_WINDOWS) {
+        mTouchWindowIndexByDisplay.insert_or_assign(displayId,
+                                                    TouchWindowIndex(newHandles,
+                                                                     getTransformLocked(displayId)));
+    } else {
+        mTouchWindowIndexByDisplay.erase(displayId);
+    }
+
     // Insert or replace
     mWindowHandlesByDisplay[displayId] = newHandles;
 }
@@ -32,6 +32,7 @@
 #include "LatencyTracker.h"
 #include "Monitor.h"
 #include "TouchState.h"
+#include "TouchWindowIndex.h"
 #include "TouchedWindow.h"
 
 #include <attestation/HmacKeyManager.h>
@@ -368,6 +369,10 @@ private:
             mWindowHandlesByDisplay GUARDED_BY(mLock);
     std::unordered_map<int32_t /*displayId*/, android::gui::DisplayInfo> mDisplayInfos
             GUARDED_BY(mLock);
+    // Spatial index over mWindowHandlesByDisplay used for hit-testing, only kept for displays with
+    // enough windows to benefit from it.
+    std::unordered_map<int32_t /*displayId*/, TouchWindowIndex> mTouchWindowIndexByDisplay
+            GUARDED_BY(mLock);
     void setInputWindowsLocked(
             const std::vector<sp<android::gui::WindowInfoHandle>>& inputWindowHandles,
             int32_t displayId) REQUIRES(mLock);
@@ -377,6 +382,10 @@ private:
     sp<android::gui::WindowInfoHandle> getWindowHandleLocked(
             const sp<IBinder>& windowHandleToken) const REQUIRES(mLock);
     ui::Transform getTransformLocked(int32_t displayId) const REQUIRES(mLock);
+    // Get the touch window index for the display, or null if the windows must be scanned linearly.
+    const TouchWindowIndex* getTouchWindowIndexLocked(int32_t displayId,
+                                                      const ui::Transform& displayTransform) const
+            REQUIRES(mLock);
 
     // Same function as above, but faster. Since displayId is provided, this avoids the need
     // to loop through all displays.
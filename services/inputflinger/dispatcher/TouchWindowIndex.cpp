@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TouchWindowIndex.h"
+
+#include <algorithm>
+#include <cmath>
+
+using android::gui::WindowInfo;
+using android::gui::WindowInfoHandle;
+
+namespace android::inputdispatcher {
+
+namespace {
+
+const std::vector<size_t> EMPTY_CANDIDATES;
+
+int32_t divideRoundingUp(int32_t value, int32_t divisor) {
+    return (value + divisor - 1) / divisor;
+}
+
+} // namespace
+
+TouchWindowIndex::TouchWindowIndex(const std::vector<sp<WindowInfoHandle>>& windowHandles,
+                                   const ui::Transform& displayTransform)
+      : mDisplayTransform(displayTransform) {
+    // Compute the bounds with the same transform that is used for the hit test, so that a window
+    // is listed in every cell containing a point it could accept.
+    std::vector<Rect> windowBounds(windowHandles.size(), Rect::EMPTY_RECT);
+    for (size_t i = 0; i < windowHandles.size(); i++) {
+        const WindowInfo& info = *windowHandles[i]->getInfo();
+        if (info.inputConfig.test(WindowInfo::InputConfig::WATCH_OUTSIDE_TOUCH)) {
+            mOutsideTouchWatchers.push_back(i);
+        }
+        if (info.inputConfig.test(WindowInfo::InputConfig::NOT_VISIBLE)) {
+            continue;
+        }
+        const Rect bounds = displayTransform.transform(info.touchableRegion).getBounds();
+        if (bounds.isEmpty()) {
+            continue;
+        }
+        windowBounds[i] = bounds;
+        if (mBounds.isEmpty()) {
+            mBounds = bounds;
+        } else {
+            mBounds.left = std::min(mBounds.left, bounds.left);
+            mBounds.top = std::min(mBounds.top, bounds.top);
+            mBounds.right = std::max(mBounds.right, bounds.right);
+            mBounds.bottom = std::max(mBounds.bottom, bounds.bottom);
+        }
+    }
+    if (mBounds.isEmpty()) {
+        return;
+    }
+
+    mCellWidth = std::max(1, divideRoundingUp(mBounds.getWidth(), GRID_SIZE));
+    mCellHeight = std::max(1, divideRoundingUp(mBounds.getHeight(), GRID_SIZE));
+    mColumns = divideRoundingUp(mBounds.getWidth(), mCellWidth);
+    const int32_t rows = divideRoundingUp(mBounds.getHeight(), mCellHeight);
+    mCells.resize(mColumns * rows);
+
+    for (size_t i = 0; i < windowBounds.size(); i++) {
+        const Rect& bounds = windowBounds[i];
+        if (bounds.isEmpty()) {
+            continue;
+        }
+        // Rect is exclusive of its right and bottom edges.
+        const int32_t firstColumn = (bounds.left - mBounds.left) / mCellWidth;
+        const int32_t lastColumn = (bounds.right - 1 - mBounds.left) / mCellWidth;
+        const int32_t firstRow = (bounds.top - mBounds.top) / mCellHeight;
+        const int32_t lastRow = (bounds.bottom - 1 - mBounds.top) / mCellHeight;
+        for (int32_t row = firstRow; row <= lastRow; row++) {
+            for (int32_t column = firstColumn; column <= lastColumn; column++) {
+                mCells[row * mColumns + column].push_back(i);
+            }
+        }
+    }
+}
+
+const std::vector<size_t>& TouchWindowIndex::getCandidatesAt(float x, float y) const {
+    const auto p = mDisplayTransform.transform(x, y);
+    const float px = std::floor(p.x);
+    const float py = std::floor(p.y);
+    // Written so that NaN coordinates are rejected as well.
+    if (!(px >= mBounds.left && px < mBounds.right && py >= mBounds.top && py < mBounds.bottom)) {
+        return EMPTY_CANDIDATES;
+    }
+    const int32_t column = (static_cast<int32_t>(px) - mBounds.left) / mCellWidth;
+    const int32_t row = (static_cast<int32_t>(py) - mBounds.top) / mCellHeight;
+    return mCells[row * mColumns + column];
+}
+
+} // namespace android::inputdispatcher
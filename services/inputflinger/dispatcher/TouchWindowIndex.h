@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gui/WindowInfo.h>
+#include <ui/Rect.h>
+#include <ui/Transform.h>
+#include <utils/StrongPointer.h>
+#include <vector>
+
+namespace android {
+
+namespace inputdispatcher {
+
+/**
+ * A uniform grid over the touchable bounds of the windows on a display, used to narrow down the
+ * windows that need to be hit-tested for a touch. Windows are referred to by their position in the
+ * display's window list, so each cell lists its windows from front to back. The grid is built in
+ * the logical display space, the same space in which the hit test is performed, so it must be
+ * rebuilt whenever the window list or the display transform changes.
+ *
+ * The index only filters out windows that cannot contain the point. Candidates must still be
+ * hit-tested by the caller.
+ */
+class TouchWindowIndex {
+public:
+    // Below this number of windows, a linear scan of the window list is cheaper than the index.
+    static constexpr size_t MIN_WINDOWS = 16;
+
+    TouchWindowIndex(const std::vector<sp<android::gui::WindowInfoHandle>>& windowHandles,
+                     const ui::Transform& displayTransform);
+
+    // Returns true if the index was built with the given display transform.
+    bool isValidFor(const ui::Transform& displayTransform) const {
+        return mDisplayTransform == displayTransform;
+    }
+
+    // The positions, from front to back, of the windows whose touchable bounds contain the given
+    // point in display coordinates.
+    const std::vector<size_t>& getCandidatesAt(float x, float y) const;
+
+    // The positions, from front to back, of all windows that watch for outside touches.
+    const std::vector<size_t>& getOutsideTouchWatchers() const { return mOutsideTouchWatchers; }
+
+private:
+    static constexpr int32_t GRID_SIZE = 16;
+
+    const ui::Transform mDisplayTransform;
+    // The union of the touchable bounds of all windows, in logical display space.
+    Rect mBounds = Rect::EMPTY_RECT;
+    int32_t mCellWidth = 1;
+    int32_t mCellHeight = 1;
+    int32_t mColumns = 0;
+    std::vector<std::vector<size_t>> mCells;
+    std::vector<size_t> mOutsideTouchWatchers;
+};
+
+} // namespace inputdispatcher
+} // namespace android
@@ -3777,6 +3777,54 @@ TEST_F(InputDispatcherTest, ActionOutsideSentOnlyWhenAWindowIsTouched) {
     thirdWindow->consumeMotionDown();
 }
 
+/**
+ * Displays with many windows are hit-tested through a spatial index. Make sure that the touched
+ * window and the ACTION_OUTSIDE targets are the same as with a linear scan of the windows: only the
+ * watchers in front of the touched window get ACTION_OUTSIDE.
+ */
+TEST_F(InputDispatcherTest, ActionOutsideWithManyWindows) {
+    std::shared_ptr<FakeApplicationHandle> application = std::make_shared<FakeApplicationHandle>();
+    sp<FakeWindowHandle> frontWatcher =
+            sp<FakeWindowHandle>::make(application, mDispatcher, "Front Watcher",
+                                       ADISPLAY_ID_DEFAULT);
+    frontWatcher->setFrame(Rect{1000, 1000, 1100, 1100});
+    frontWatcher->setWatchOutsideTouch(true);
+    sp<FakeWindowHandle> backWatcher =
+            sp<FakeWindowHandle>::make(application, mDispatcher, "Back Watcher",
+                                       ADISPLAY_ID_DEFAULT);
+    backWatcher->setFrame(Rect{1000, 1100, 1100, 1200});
+    backWatcher->setWatchOutsideTouch(true);
+
+    // A grid of 5x5 non-overlapping windows, placed between the two watchers.
+    std::vector<sp<FakeWindowHandle>> windows;
+    std::vector<sp<WindowInfoHandle>> handles{frontWatcher};
+    for (int32_t i = 0; i < 25; i++) {
+        sp<FakeWindowHandle> window =
+                sp<FakeWindowHandle>::make(application, mDispatcher,
+                                           "Window " + std::to_string(i), ADISPLAY_ID_DEFAULT);
+        const int32_t left = (i % 5) * 100;
+        const int32_t top = (i / 5) * 100;
+        window->setFrame(Rect{left, top, left + 100, top + 100});
+        windows.push_back(window);
+        handles.push_back(window);
+    }
+    handles.push_back(backWatcher);
+    mDispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, handles}});
+
+    // Tap on the window at (2, 3) in the grid.
+    mDispatcher->notifyMotion(generateMotionArgs(AMOTION_EVENT_ACTION_DOWN,
+                                                 AINPUT_SOURCE_TOUCHSCREEN, ADISPLAY_ID_DEFAULT,
+                                                 {PointF{250, 350}}));
+    windows[17]->consumeMotionDown();
+    frontWatcher->consumeMotionEvent(WithMotionAction(ACTION_OUTSIDE));
+    backWatcher->assertNoEvents();
+    for (size_t i = 0; i < windows.size(); i++) {
+        if (i != 17) {
+            windows[i]->assertNoEvents();
+        }
+    }
+}
+
 TEST_F(InputDispatcherTest, OnWindowInfosChanged_RemoveAllWindowsOnDisplay) {
     std::shared_ptr<FakeApplicationHandle> application = std::make_shared<FakeApplicationHandle>();
     sp<FakeWindowHandle> window = sp<FakeWindowHandle>::make(application, mDispatcher,
@@ -106,6 +106,17 @@ struct CompositionRefreshArgs {
 
     bool hasTrustedPresentationListener = false;
 
+    // If true, the visibility of the layers on each output is computed on
+    // multiple threads, and reused for the layers whose geometry and coverage
+    // did not change since the previous rebuild.
+    bool parallelVisibility = false;
+
+    // If true, each output is prepared and presented on its own thread, so that
+    // the frame takes as long as the slowest output rather than all of them.
+    // Ignored unless RenderEngine runs on its own thread, and the composer supports presenting
+    // each of the displays concurrently (see HWComposer::hasMultiThreadedPresentSupport).
+    bool parallelOutputs = false;
+
     ICEPowerCallback* powerCallback = nullptr;
 };
 
@@ -59,6 +59,12 @@ public:
     // Sends the brightness setting to HWC
     virtual void applyDisplayBrightness(const bool applyImmediately) = 0;
 
+    // If set, when the composition strategy is predicted and the HWC requested no changes to the
+    // composition types or layers, the client target is queued before the HWC is asked for the
+    // composition strategy, so that it can present the frame in the same call instead of
+    // validating it first.
+    virtual void setEarlyClientTarget(bool) = 0;
+
 protected:
     ~Display() = default;
 };
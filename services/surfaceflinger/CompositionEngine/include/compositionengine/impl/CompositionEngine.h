@@ -17,6 +17,7 @@
 #pragma once
 
 #include <compositionengine/CompositionEngine.h>
+#include <compositionengine/impl/WorkerPool.h>
 
 namespace android::compositionengine::impl {
 
@@ -57,11 +58,16 @@ public:
     void setNeedsAnotherUpdateForTest(bool);
 
 private:
+    // Returns true if each output can be prepared and presented on its own thread.
+    bool canPresentOutputsInParallel(const CompositionRefreshArgs&) const;
+    void presentOutputsInParallel(CompositionRefreshArgs&);
+
     std::unique_ptr<HWComposer> mHwComposer;
-    renderengine::RenderEngine* mRenderEngine;
+    renderengine::RenderEngine* mRenderEngine = nullptr;
     std::shared_ptr<TimeStats> mTimeStats;
     bool mNeedsAnotherUpdate = false;
     nsecs_t mRefreshStartTime = 0;
+    std::unique_ptr<WorkerPool> mOutputWorkers;
 };
 
 std::unique_ptr<compositionengine::CompositionEngine> createCompositionEngine();
@@ -61,6 +61,7 @@ public:
     bool getSkipColorTransform() const override;
     compositionengine::Output::FrameFences presentAndGetFrameFences() override;
     void setExpensiveRenderingExpected(bool) override;
+    GpuCompositionResult prepareFrameAsync() override;
     void finishFrame(GpuCompositionResult&&) override;
 
     // compositionengine::Display overrides
@@ -73,6 +74,7 @@ public:
     void createRenderSurface(const compositionengine::RenderSurfaceCreationArgs&) override;
     void createClientCompositionCache(uint32_t cacheSize) override;
     void applyDisplayBrightness(const bool applyImmediately) override;
+    void setEarlyClientTarget(bool) override;
 
     // Internal helpers used by chooseCompositionStrategy()
     using ChangedTypes = android::HWComposer::DeviceRequestedChanges::ChangedTypes;
@@ -95,6 +97,9 @@ private:
     DisplayId mId;
     bool mIsDisconnected = false;
     Hwc2::PowerAdvisor* mPowerAdvisor = nullptr;
+    bool mEarlyClientTarget = false;
+    // Set while choosing the composition strategy of a frame whose client target is queued.
+    bool mClientTargetQueued = false;
 };
 
 // This template factory function standardizes the implementation details of the
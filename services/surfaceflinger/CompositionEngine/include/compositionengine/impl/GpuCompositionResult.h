@@ -29,6 +29,10 @@ struct GpuCompositionResult {
     // then we want to reuse the buffer instead of dequeuing another buffer.
     std::shared_ptr<renderengine::ExternalTexture> buffer = nullptr;
 
+    // True if the composited buffer was queued to the render surface already, before the
+    // composition strategy was chosen.
+    bool bufferQueued = false;
+
     bool bufferAvailable() const { return buffer != nullptr; };
 };
 
@@ -24,11 +24,13 @@
 #include <compositionengine/impl/HwcAsyncWorker.h>
 #include <compositionengine/impl/OutputCompositionState.h>
 #include <compositionengine/impl/OutputLayerCompositionState.h>
+#include <compositionengine/impl/WorkerPool.h>
 #include <compositionengine/impl/planner/Planner.h>
 #include <renderengine/DisplaySettings.h>
 #include <renderengine/LayerSettings.h>
 
 #include <memory>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -153,6 +155,7 @@ protected:
     virtual void dumpState(std::string& out) const = 0;
 
     bool mustRecompose() const;
+    void finishPrepareFrame();
 
     const std::string& getNamePlusId() const { return mNamePlusId; }
 
@@ -160,11 +163,72 @@ private:
     void dirtyEntireOutput();
     void updateCompositionStateForBorder(const compositionengine::CompositionRefreshArgs&);
     compositionengine::OutputLayer* findLayerRequestingBackgroundComposition() const;
-    void finishPrepareFrame();
     ui::Dataspace getBestDataspace(ui::Dataspace*, bool*) const;
     compositionengine::Output::ColorProfile pickColorProfile(
             const compositionengine::CompositionRefreshArgs&) const;
 
+    // The regions of a layer which do not depend on the layers above it, in
+    // layer stack space.
+    struct LayerGeometry {
+        // The footprint of the layer, including its shadow.
+        Region visibleRegion;
+        Region shadowRegion;
+        Region transparentRegion;
+        Region opaqueRegion;
+    };
+
+    // The visibility of a layer on this output, as stored in its output layer
+    // state, along with the part of the output the layer dirties.
+    struct LayerVisibility {
+        Region visibleRegion;
+        Region visibleNonTransparentRegion;
+        Region coveredRegion;
+        Region outputSpaceVisibleRegion;
+        Region shadowRegion;
+        Region outputSpaceBlockingRegionHint;
+        Region dirtyRegion;
+    };
+
+    // The inputs from which the visibility of a layer was computed on the
+    // previous rebuild of the layer stacks.
+    struct CachedLayerVisibility {
+        const compositionengine::OutputLayer* outputLayer = nullptr;
+        aidl::android::hardware::graphics::composer3::Composition compositionType;
+        LayerGeometry geometry;
+        Region aboveCoveredLayers;
+        Region aboveOpaqueLayers;
+    };
+
+    struct VisibilityCache {
+        // How the layer stack mapped to the output when the entries were computed.
+        ui::Transform transform;
+        Rect displayBounds;
+        Rect layerStackContent;
+        std::unordered_map<const LayerFE*, CachedLayerVisibility> layers;
+    };
+
+    // Returns false if the layer has an empty footprint.
+    bool computeLayerGeometry(const LayerFE&, const LayerFECompositionState&,
+                              LayerGeometry&) const;
+    // Computes the visibility of a layer given its visible region, minus the
+    // opaque layers above it, and its covered region. Returns true if the
+    // layer is drawn on this output. The dirty region is set in either case.
+    bool computeLayerVisibility(const LayerFECompositionState&, const LayerGeometry&,
+                                Region visibleRegion, Region coveredRegion,
+                                const Region& aboveOpaqueLayers,
+                                const compositionengine::OutputLayer* prevOutputLayer,
+                                LayerVisibility&) const;
+    static void storeLayerVisibility(LayerVisibility&&, OutputLayerCompositionState&);
+    // Same as calling ensureOutputLayerIfVisible for each layer from front to
+    // back, but computes the per-layer regions on mVisibilityWorkers, and skips
+    // the layers whose inputs did not change since the previous rebuild.
+    void collectVisibleLayersInParallel(const compositionengine::CompositionRefreshArgs&,
+                                        compositionengine::Output::CoverageState&);
+    bool isCachedVisibilityValid(const LayerFE&, const LayerFECompositionState&,
+                                 const LayerGeometry&, const Region& aboveCoveredLayers,
+                                 const Region& aboveOpaqueLayers,
+                                 const compositionengine::OutputLayer* prevOutputLayer) const;
+
     std::string mName;
     std::string mNamePlusId;
 
@@ -176,6 +240,8 @@ private:
     std::unique_ptr<ClientCompositionRequestCache> mClientCompositionRequestCache;
     std::unique_ptr<planner::Planner> mPlanner;
     std::unique_ptr<HwcAsyncWorker> mHwComposerAsyncWorker;
+    std::unique_ptr<WorkerPool> mVisibilityWorkers;
+    VisibilityCache mVisibilityCache;
 
     // Whether the content must be recomposed this frame.
     bool mMustRecompose = false;
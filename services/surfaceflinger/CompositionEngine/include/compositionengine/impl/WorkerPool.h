@@ -0,0 +1,63 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/thread_annotations.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace android::compositionengine::impl {
+
+// A small pool of real time threads used to spread independent per-layer work
+// of a frame across cores. The calling thread takes part in the work, and
+// parallelFor returns only once every item has been processed, so callers can
+// treat it as a plain loop.
+class WorkerPool final {
+public:
+    WorkerPool(const std::string& name, size_t threadCount);
+    ~WorkerPool();
+
+    // Calls fn(i) for every i in [0, count), from the calling thread and the
+    // pool threads. The calls may run concurrently and in any order.
+    void parallelFor(size_t count, const std::function<void(size_t)>& fn);
+
+private:
+    void run();
+    void processItems();
+
+    std::mutex mMutex;
+    std::condition_variable mCv;
+    std::condition_variable mDoneCv;
+    bool mDone GUARDED_BY(mMutex) = false;
+    // Incremented for each parallelFor call so that the threads pick up each job once.
+    uint64_t mGeneration GUARDED_BY(mMutex) = 0;
+    size_t mActiveWorkers GUARDED_BY(mMutex) = 0;
+
+    // The current job. Only written while no pool thread is processing items.
+    const std::function<void(size_t)>* mFn = nullptr;
+    size_t mCount = 0;
+    std::atomic<size_t> mNextItem = 0;
+
+    std::vector<std::thread> mThreads;
+};
+
+} // namespace android::compositionengine::impl
@@ -65,9 +65,8 @@ public:
     size_t getLayerCount() const { return mLayers.size(); }
     const Layer& getFirstLayer() const { return mLayers[0]; }
     const Rect& getBounds() const { return mBounds; }
-    Rect getTextureBounds() const {
-        return mTexture ? mTexture->get()->getBuffer()->getBounds() : Rect::INVALID_RECT;
-    }
+    // Returns the area of the output space that the rendered texture covers.
+    Rect getTextureBounds() const { return mTexture ? mTextureBounds : Rect::INVALID_RECT; }
     const Region& getVisibleRegion() const { return mVisibleRegion; }
     size_t getAge() const { return mAge; }
     std::shared_ptr<renderengine::ExternalTexture> getBuffer() const {
@@ -168,6 +167,7 @@ private:
     // TODO(b/190411067): This is a shared pointer only because CachedSets are copied into different
     // containers in the Flattener. Logically this should have unique ownership otherwise.
     std::shared_ptr<TexturePool::AutoTexture> mTexture;
+    Rect mTextureBounds;
     sp<Fence> mDrawFence;
     ProjectionSpace mOutputSpace;
     ui::Dataspace mOutputDataspace;
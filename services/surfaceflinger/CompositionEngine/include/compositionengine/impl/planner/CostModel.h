@@ -0,0 +1,104 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <compositionengine/impl/planner/CachedSet.h>
+#include <ui/Size.h>
+
+#include <chrono>
+#include <vector>
+
+namespace android::compositionengine::impl::planner {
+
+using namespace std::chrono_literals;
+
+// Estimates whether flattening a run of CachedSets into a single CachedSet pays off.
+//
+// Costs are expressed in pixels read or written, like CachedSet::getCreationCost, and GPU work
+// that is more expensive than a plain read is weighted accordingly. Rendering the run is paid once,
+// while presenting one layer instead of several to the HWC saves memory bandwidth and an overlay on
+// every frame for which the run stays inactive.
+//
+// The Flattener uses the default model if its tunables enable it, or a model that is plugged in.
+// Without one, it flattens the first candidate run.
+class CostModel {
+public:
+    // Collection of tunables which are backed by sysprops
+    struct Tunables {
+        static constexpr float kDefaultBlurWeight = 4.f;
+        static constexpr float kDefaultRoundedCornersWeight = 0.5f;
+        static constexpr float kDefaultDataspaceConversionWeight = 1.f;
+        static constexpr float kDefaultOverlayWeight = 0.1f;
+        static constexpr std::chrono::nanoseconds kDefaultFramePeriod = 16'666'667ns;
+        static constexpr size_t kDefaultMaxExpectedFrames = 120;
+
+        // Cost of blurring behind a layer, per pixel of the layer, relative to reading it once.
+        const float blurWeight = kDefaultBlurWeight;
+        // Cost of clipping a layer to rounded corners, per pixel of the layer.
+        const float roundedCornersWeight = kDefaultRoundedCornersWeight;
+        // Cost of converting a layer to another dataspace, per pixel of the layer.
+        const float dataspaceConversionWeight = kDefaultDataspaceConversionWeight;
+        // Cost of presenting a layer as an HWC overlay on each frame, as a fraction of the display
+        // area. This accounts for fixed costs per layer, and for fewer layers leaving more
+        // overlays for other layers instead of falling back to client composition.
+        const float overlayWeight = kDefaultOverlayWeight;
+        // Expected frame period, used to turn how long a run has been inactive into frames. The
+        // default is used instead of a period of 0.
+        const std::chrono::nanoseconds framePeriod = kDefaultFramePeriod;
+        // Upper bound on the number of frames a flattened run is expected to be presented for.
+        const size_t maxExpectedFrames = kDefaultMaxExpectedFrames;
+        // If set, the Flattener uses the default model built from these tunables. Otherwise it
+        // flattens the first candidate run, unless another model is plugged in.
+        const bool enabled = false;
+        // If set, runs that are not expected to pay off are not flattened. Otherwise the model only
+        // ranks the candidate runs.
+        const bool skipUnprofitableRuns = false;
+    };
+
+    struct RunEstimate {
+        // Cost of rendering the run into a CachedSet once.
+        float renderCost = 0.f;
+        // Cost saved on each frame that the CachedSet is presented instead of the run.
+        float savedCostPerFrame = 0.f;
+        // Number of frames the CachedSet is expected to be presented for. Runs that have been
+        // inactive for longer are expected to stay inactive for longer.
+        float expectedFrames = 0.f;
+
+        float getBenefit() const { return savedCostPerFrame * expectedFrames - renderCost; }
+    };
+
+    explicit CostModel(const Tunables& tunables) : mTunables(tunables) {}
+    virtual ~CostModel() = default;
+
+    // Estimates flattening the setCount CachedSets starting at start. blurringLayer is the layer
+    // whose background blur would be rendered into the CachedSet, if any.
+    virtual RunEstimate estimateRun(std::vector<CachedSet>::const_iterator start, size_t setCount,
+                                    const CachedSet* blurringLayer, ui::Size displaySize,
+                                    std::chrono::steady_clock::time_point now) const;
+
+    const Tunables& getTunables() const { return mTunables; }
+
+protected:
+    // Cost of drawing a single layer with the GPU, when the CachedSet is rendered in
+    // outputDataspace.
+    float getLayerRenderCost(const CachedSet::Layer&, ui::Dataspace outputDataspace) const;
+
+private:
+    const Tunables mTunables;
+};
+
+} // namespace android::compositionengine::impl::planner
@@ -18,9 +18,11 @@
 
 #include <compositionengine/Output.h>
 #include <compositionengine/impl/planner/CachedSet.h>
+#include <compositionengine/impl/planner/CostModel.h>
 #include <compositionengine/impl/planner/LayerState.h>
 
 #include <chrono>
+#include <memory>
 #include <numeric>
 #include <vector>
 
@@ -85,6 +87,14 @@ public:
 
         // True if the hole punching feature should be enabled.
         const bool mEnableHolePunch;
+
+        // Tunables of the default model used to choose which run to flatten.
+        // See: CostModel
+        const CostModel::Tunables mCostModel = {};
+
+        // Tunables of the pool of textures that cached sets are rendered into.
+        // See: TexturePool
+        const TexturePool::Tunables mTexturePool = TexturePool::kDefaultTunables;
     };
 
     // Constants not yet backed by a sysprop
@@ -111,6 +121,10 @@ public:
 
     void setTexturePoolEnabled(bool enabled) { mTexturePool.setEnabled(enabled); }
 
+    // Replaces the model used to choose which run to flatten. The candidate run with the highest
+    // benefit is flattened as long as a model is set, whatever its tunables.
+    void setCostModel(std::unique_ptr<CostModel> costModel) { mCostModel = std::move(costModel); }
+
     void dump(std::string& result) const;
     void dumpLayers(std::string& result) const;
 
@@ -188,7 +202,7 @@ private:
                     }
                 }
 
-                return Run(mStart,
+                return Run(mStart, static_cast<size_t>(mNumSets),
                            std::reduce(mStart, mStart + mNumSets, 0u,
                                        [](size_t length, const CachedSet& set) {
                                            return length + set.getLayerCount();
@@ -202,6 +216,8 @@ private:
         // Gets the starting CachedSet of this run.
         // This is an iterator into mLayers
         const std::vector<CachedSet>::const_iterator& getStart() const { return mStart; }
+        // Gets the number of CachedSets in this Run.
+        size_t getSetCount() const { return mSetCount; }
         // Gets the total number of layers encompassing this Run.
         size_t getLayerLength() const { return mLength; }
         // Gets the hole punch candidate for this Run.
@@ -209,13 +225,15 @@ private:
         const CachedSet* getBlurringLayer() const { return mBlurringLayer; }
 
     private:
-        Run(std::vector<CachedSet>::const_iterator start, size_t length,
+        Run(std::vector<CachedSet>::const_iterator start, size_t setCount, size_t length,
             const CachedSet* holePunchCandidate, const CachedSet* blurringLayer)
               : mStart(start),
+                mSetCount(setCount),
                 mLength(length),
                 mHolePunchCandidate(holePunchCandidate),
                 mBlurringLayer(blurringLayer) {}
         const std::vector<CachedSet>::const_iterator mStart;
+        const size_t mSetCount;
         const size_t mLength;
         const CachedSet* const mHolePunchCandidate;
         const CachedSet* const mBlurringLayer;
@@ -225,12 +243,15 @@ private:
 
     std::vector<Run> findCandidateRuns(std::chrono::steady_clock::time_point now) const;
 
-    std::optional<Run> findBestRun(std::vector<Run>& runs) const;
+    std::optional<Run> findBestRun(std::vector<Run>& runs,
+                                   std::chrono::steady_clock::time_point now);
 
     void buildCachedSets(std::chrono::steady_clock::time_point now);
 
     renderengine::RenderEngine& mRenderEngine;
     const Tunables mTunables;
+    // Null if the first candidate run is flattened.
+    std::unique_ptr<CostModel> mCostModel;
 
     TexturePool mTexturePool;
 
@@ -254,6 +275,16 @@ private:
     size_t mCachedSetCreationCount = 0;
     size_t mCachedSetCreationCost = 0;
     std::unordered_map<size_t, size_t> mInvalidatedCachedSetAges;
+
+    // Run selection statistics, with the costs estimated by mCostModel
+    size_t mCandidateRunCount = 0;
+    size_t mChosenRunCount = 0;
+    size_t mChosenRunLayerCount = 0;
+    size_t mChosenLaterRunCount = 0;
+    size_t mUnprofitableRunCount = 0;
+    float mChosenRunRenderCost = 0.f;
+    float mChosenRunSavedCostPerFrame = 0.f;
+    float mChosenRunBenefit = 0.f;
 };
 
 } // namespace compositionengine::impl::planner
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/thread_annotations.h>
+#include <compositionengine/impl/planner/Predictor.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace android::compositionengine::impl::planner {
+
+// A bounded cache of the plans that were confirmed for exact layer stacks, which outlives the
+// Predictor. The Predictor consults it for stacks that it has not seen yet in this process, so that
+// known stacks are predicted on their first frame, e.g. after SurfaceFlinger restarts.
+//
+// When the cache is full, the entry with the fewest uses is evicted, and the least recently used
+// one among those. Use counts are halved periodically so that stacks which were frequent a long
+// time ago eventually make room for newer ones.
+//
+// If a path is given, the cache is loaded from it on construction, and written back on a background
+// thread after it changes. Layer stack hashes are only stable for a given build, so entries written
+// by another build are discarded.
+//
+// The cache may be shared by the Predictors of several displays and is thread-safe.
+class PlanCache {
+public:
+    static constexpr size_t kDefaultCapacity = 64;
+    static constexpr size_t kUseLogCapacity = 256;
+
+    // How long the writer waits for more changes before writing the cache.
+    static constexpr std::chrono::seconds kPersistDelay = std::chrono::seconds(10);
+
+    // An empty path keeps the cache in memory only.
+    PlanCache(size_t capacity, std::string path, std::string buildFingerprint);
+    ~PlanCache();
+
+    // Returns the plan recorded for the layer stack, if any.
+    std::optional<Plan> getPlan(NonBufferHash);
+
+    // Records that the plan was used for the layer stack, adding it to the cache if needed.
+    void recordPlan(NonBufferHash, const Plan&);
+
+    // Records that the plan of a layer stack already in the cache was used again. Unlike
+    // recordPlan, this doesn't lock, so that it can be called on every frame. The use is applied
+    // with the next change, eviction or write, and ignored if the layer stack is no longer
+    // in the cache by then. If more than kUseLogCapacity uses are pending, the oldest are dropped.
+    void recordUse(NonBufferHash);
+
+    // Drops the entry of a layer stack whose cached plan was not the one used.
+    void recordMisprediction(NonBufferHash);
+
+    size_t size() const;
+
+    // Writes the cache to its file now, if there are unsaved changes.
+    void persist();
+
+    void dump(std::string&) const;
+
+private:
+    struct Entry {
+        Plan plan;
+        uint32_t useCount = 0;
+        // Value of mClock when the entry was last used.
+        uint64_t lastUse = 0;
+    };
+
+    void load();
+    std::string serializeLocked() const REQUIRES(mMutex);
+    void writeFile(const std::string& contents) const;
+    void useLocked(Entry&) REQUIRES(mMutex);
+    void applyUsesLocked() REQUIRES(mMutex);
+    void evictLocked() REQUIRES(mMutex);
+    void agingLocked() REQUIRES(mMutex);
+    void threadMain();
+
+    const size_t mCapacity;
+    const std::string mPath;
+    const std::string mBuildFingerprint;
+
+    mutable std::mutex mMutex;
+    std::unordered_map<NonBufferHash, Entry> mEntries GUARDED_BY(mMutex);
+    uint64_t mClock GUARDED_BY(mMutex) = 0;
+
+    // Layer stacks passed to recordUse, in a ring. A slot is claimed before it is written, so it
+    // may be read too early if a use races with applyUsesLocked, which makes use counts
+    // approximate.
+    std::array<std::atomic<NonBufferHash>, kUseLogCapacity> mUseLog{};
+    std::atomic<uint64_t> mUseLogHead = 0;
+    uint64_t mUseLogTail GUARDED_BY(mMutex) = 0;
+
+    // Only set when entries are added, dropped or change plans. Use counts alone are written along
+    // with the next change, so that a busy but stable cache does not write its file repeatedly.
+    bool mDirty GUARDED_BY(mMutex) = false;
+    bool mDone GUARDED_BY(mMutex) = false;
+    std::condition_variable mCondition;
+
+    size_t mHitCount GUARDED_BY(mMutex) = 0;
+    size_t mMissCount GUARDED_BY(mMutex) = 0;
+    size_t mMispredictionCount GUARDED_BY(mMutex) = 0;
+    size_t mEvictionCount GUARDED_BY(mMutex) = 0;
+    size_t mLoadedCount GUARDED_BY(mMutex) = 0;
+
+    std::thread mThread;
+};
+
+} // namespace android::compositionengine::impl::planner
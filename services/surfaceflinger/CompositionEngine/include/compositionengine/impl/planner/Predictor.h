@@ -20,8 +20,12 @@
 
 #include <compositionengine/impl/planner/LayerState.h>
 
+#include <memory>
+
 namespace android::compositionengine::impl::planner {
 
+class PlanCache;
+
 class LayerStack {
 public:
     LayerStack(const std::vector<const LayerState*>& layers) : mLayers(copyLayers(layers)) {}
@@ -111,6 +115,7 @@ public:
     static std::optional<Plan> fromString(const std::string&);
 
     void reset() { mLayerTypes.clear(); }
+    bool empty() const { return mLayerTypes.empty(); }
     void addLayerType(aidl::android::hardware::graphics::composer3::Composition type) {
         mLayerTypes.emplace_back(type);
     }
@@ -238,6 +243,9 @@ public:
     // If the exact layer stack has previously been seen by the predictor, then report the plan used
     // for that layer stack.
     //
+    // If the layer stack is new to the predictor, but its plan was confirmed before and kept in the
+    // plan cache, then report that plan as an exact match.
+    //
     // Otherwise, try to match to the best approximate stack to retireve the most likely plan.
     std::optional<PredictedPlan> getPredictedPlan(const std::vector<const LayerState*>& layers,
                                                   NonBufferHash hash) const;
@@ -251,6 +259,9 @@ public:
 
     void dump(std::string&) const;
 
+    // Sets the cache in which the plans of exact layer stacks are kept once they are confirmed.
+    void setPlanCache(std::shared_ptr<PlanCache> planCache) { mPlanCache = std::move(planCache); }
+
     void compareLayerStacks(NonBufferHash leftHash, NonBufferHash rightHash, std::string&) const;
     void describeLayerStack(NonBufferHash, std::string&) const;
     void listSimilarStacks(Plan, std::string&) const;
@@ -259,6 +270,7 @@ private:
     // Retrieves a prediction from either the main prediction list or from the candidate list
     const Prediction& getPrediction(NonBufferHash) const;
     Prediction& getPrediction(NonBufferHash);
+    bool hasPrediction(NonBufferHash) const;
 
     std::optional<Plan> getExactMatch(NonBufferHash) const;
     std::optional<NonBufferHash> getApproximateMatch(
@@ -267,6 +279,8 @@ private:
     void promoteIfCandidate(NonBufferHash);
     void recordPredictedResult(PredictedPlan, const std::vector<const LayerState*>& layers,
                                Plan result);
+    void recordCachedResult(PredictedPlan, const std::vector<const LayerState*>& layers,
+                            Plan result);
     bool findSimilarPrediction(const std::vector<const LayerState*>& layers, Plan result);
 
     void dumpPredictionsByFrequency(std::string&) const;
@@ -306,7 +320,10 @@ private:
 
     std::vector<ApproximateStack> mApproximateStacks;
 
+    std::shared_ptr<PlanCache> mPlanCache;
+
     mutable size_t mExactHitCount = 0;
+    mutable size_t mCachedHitCount = 0;
     mutable size_t mApproximateHitCount = 0;
     mutable size_t mMissCount = 0;
 };
@@ -27,12 +27,16 @@
 
 namespace android::compositionengine::impl::planner {
 
-// A pool of textures that only manages textures of a single size.
-// While it is possible to define a texture pool supporting variable-sized textures to save on
-// memory, it is a simpler implementation to only manage screen-sized textures. The texture pool is
-// unbounded - there are a minimum number of textures preallocated. Under heavy system load, new
-// textures may be allocated, but only a maximum number of retained once those textures are no
-// longer necessary.
+// A pool of scratch textures for rendering CachedSets.
+// By default the pool only manages screen-sized textures, which is the simplest implementation.
+// There are a minimum number of textures preallocated. Under heavy system load, new textures may be
+// allocated, but only a maximum number are retained once those textures are no longer necessary.
+//
+// Alternatively, the pool may hand out textures that fit the bounds of a CachedSet, to save memory
+// when CachedSets are small. Requested sizes are rounded up to buckets so that textures can be
+// reused by CachedSets of similar sizes, and textures are then allocated on demand. Either way,
+// the textures held by the pool are bounded by a byte budget, and the least recently returned
+// textures are freed first when it is exceeded.
 class TexturePool {
 public:
     // RAII class helping with managing textures from the texture pool
@@ -63,8 +67,31 @@ public:
         sp<Fence> mFence;
     };
 
-    TexturePool(renderengine::RenderEngine& renderEngine)
-          : mRenderEngine(renderEngine), mEnabled(false) {}
+    // Collection of tunables which are backed by sysprops
+    struct Tunables {
+        static const constexpr bool kDefaultFitCachedSetBounds = false;
+        static const constexpr int32_t kDefaultBucketGranularity = 128;
+        static const constexpr size_t kDefaultBudgetBytes = 0;
+
+        // True if textures should fit the bounds of CachedSets instead of the display.
+        const bool fitCachedSetBounds;
+        // Granularity in pixels to which the dimensions of requested textures are rounded up, when
+        // fitting the bounds of CachedSets.
+        const int32_t bucketGranularity;
+        // Maximum number of bytes held by textures in the pool, excluding borrowed textures. Zero
+        // means as many bytes as kMaxPoolSize screen-sized textures.
+        const size_t budgetBytes;
+    };
+
+    static const constexpr Tunables kDefaultTunables = {
+            .fitCachedSetBounds = Tunables::kDefaultFitCachedSetBounds,
+            .bucketGranularity = Tunables::kDefaultBucketGranularity,
+            .budgetBytes = Tunables::kDefaultBudgetBytes,
+    };
+
+    TexturePool(renderengine::RenderEngine& renderEngine,
+                const Tunables& tunables = kDefaultTunables)
+          : mRenderEngine(renderEngine), mTunables(tunables), mEnabled(false) {}
 
     virtual ~TexturePool() = default;
 
@@ -79,6 +106,10 @@ public:
     // to the pool.
     std::shared_ptr<AutoTexture> borrowTexture();
 
+    // Borrows a texture that is at least as large as the given size, if the pool fits the bounds of
+    // CachedSets, but no larger than the display. Otherwise, borrows a screen-sized texture.
+    std::shared_ptr<AutoTexture> borrowTexture(ui::Size size);
+
     // Enables or disables the pool. When the pool is disabled, no buffers will
     // be held by the pool. This is useful when the active display changes.
     void setEnabled(bool enable);
@@ -95,17 +126,34 @@ protected:
         sp<Fence> fence;
     };
 
+    // Ordered from the least to the most recently returned texture.
     std::deque<Entry> mPool;
 
+    // Returns the size of the textures handed out for the given requested size.
+    ui::Size getBucketSize(ui::Size size) const;
+    size_t getBudgetBytes() const;
+    size_t getPoolBytes() const;
+
 private:
-    std::shared_ptr<renderengine::ExternalTexture> genTexture();
+    std::shared_ptr<renderengine::ExternalTexture> genTexture(ui::Size size);
     // Returns a previously borrowed texture to the pool.
     void returnTexture(std::shared_ptr<renderengine::ExternalTexture>&& texture,
                        const sp<Fence>& fence);
     void allocatePool();
+    // Frees the least recently returned textures until the pool is within its budget.
+    void trimToBudget();
     renderengine::RenderEngine& mRenderEngine;
+    const Tunables mTunables;
     ui::Size mSize;
     bool mEnabled;
+
+    // Bytes held by textures which are currently borrowed.
+    size_t mBorrowedBytes = 0;
+    size_t mBorrowCount = 0;
+    // Number of borrowed textures that had to be allocated because no texture of the right size was
+    // available in the pool.
+    size_t mAllocationStallCount = 0;
+    size_t mTrimCount = 0;
 };
 
 } // namespace android::compositionengine::impl::planner
@@ -43,6 +43,7 @@ public:
     MOCK_METHOD1(createClientCompositionCache, void(uint32_t));
     MOCK_METHOD1(applyDisplayBrightness, void(const bool));
     MOCK_METHOD1(setPredictCompositionStrategy, void(bool));
+    MOCK_METHOD1(setEarlyClientTarget, void(bool));
 };
 
 } // namespace android::compositionengine::mock
@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+
 #include <compositionengine/CompositionRefreshArgs.h>
 #include <compositionengine/LayerFE.h>
 #include <compositionengine/LayerFECompositionState.h>
@@ -38,6 +40,12 @@ namespace android::compositionengine {
 CompositionEngine::~CompositionEngine() = default;
 
 namespace impl {
+namespace {
+
+// The number of threads, besides the main thread, presenting outputs in parallel.
+constexpr size_t kOutputWorkerThreadCount = 2;
+
+} // namespace
 
 std::unique_ptr<compositionengine::CompositionEngine> createCompositionEngine() {
     return std::make_unique<CompositionEngine>();
@@ -94,6 +102,11 @@ void CompositionEngine::present(CompositionRefreshArgs& args) {
 
     preComposition(args);
 
+    if (canPresentOutputsInParallel(args)) {
+        presentOutputsInParallel(args);
+        return;
+    }
+
     {
         // latchedLayers is used to track the set of front-end layer state that
         // has been latched across all outputs for the prepare step, and is not
@@ -110,6 +123,40 @@ void CompositionEngine::present(CompositionRefreshArgs& args) {
     }
 }
 
+bool CompositionEngine::canPresentOutputsInParallel(const CompositionRefreshArgs& args) const {
+    // RenderEngine can only be used from several threads when it runs on its own thread.
+    if (!args.parallelOutputs || args.outputs.size() <= 1 || !mRenderEngine ||
+        !mRenderEngine->getRenderEngineTid().has_value()) {
+        return false;
+    }
+
+    // Unless each display reads back its own results from the composer, presenting displays
+    // concurrently races on the shared reader. Outputs which are not backed by the composer, e.g.
+    // GPU virtual displays, do not call into it.
+    return std::all_of(args.outputs.begin(), args.outputs.end(), [this](const auto& output) {
+        const auto displayId = output->getDisplayId();
+        const auto halDisplayId = displayId ? HalDisplayId::tryCast(*displayId) : std::nullopt;
+        return !halDisplayId || mHwComposer->hasMultiThreadedPresentSupport(*halDisplayId);
+    });
+}
+
+void CompositionEngine::presentOutputsInParallel(CompositionRefreshArgs& args) {
+    ATRACE_CALL();
+
+    if (!mOutputWorkers) {
+        mOutputWorkers = std::make_unique<WorkerPool>("CEOutput", kOutputWorkerThreadCount);
+    }
+
+    // The outputs only share the front-end layer state, which LayerFE synchronizes. The latched
+    // layers are not used beyond the prepare step, so each output can track its own.
+    mOutputWorkers->parallelFor(args.outputs.size(), [&args](size_t i) {
+        const auto& output = args.outputs[i];
+        LayerFESet latchedLayers;
+        output->prepare(args, latchedLayers);
+        output->present(args);
+    });
+}
+
 void CompositionEngine::updateCursorAsync(CompositionRefreshArgs& args) {
 
     for (const auto& output : args.outputs) {
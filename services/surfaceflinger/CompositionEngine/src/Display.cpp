@@ -45,6 +45,9 @@ using aidl::android::hardware::graphics::composer3::DisplayCapability;
 
 namespace android::compositionengine::impl {
 
+using CompositionStrategyPredictionState =
+        OutputCompositionState::CompositionStrategyPredictionState;
+
 std::shared_ptr<Display> createDisplay(
         const compositionengine::CompositionEngine& compositionEngine,
         const compositionengine::DisplayCreationArgs& args) {
@@ -222,6 +225,10 @@ void Display::applyDisplayBrightness(const bool applyImmediately) {
     editState().displayBrightness.reset();
 }
 
+void Display::setEarlyClientTarget(bool enable) {
+    mEarlyClientTarget = enable;
+}
+
 void Display::beginFrame() {
     Output::beginFrame();
 
@@ -260,8 +267,11 @@ bool Display::chooseCompositionStrategy(
 
     const TimePoint hwcValidateStartTime = TimePoint::now();
 
+    // If the client target is queued already, the HWC can present the frame right away, as it
+    // would without client composition.
     if (status_t result =
-                hwc.getDeviceCompositionChanges(*halDisplayId, requiresClientComposition,
+                hwc.getDeviceCompositionChanges(*halDisplayId,
+                                                requiresClientComposition && !mClientTargetQueued,
                                                 getState().earliestPresentTime,
                                                 getState().expectedPresentTime, outChanges);
         result != NO_ERROR) {
@@ -422,6 +432,78 @@ void Display::setHintSessionGpuFence(std::unique_ptr<FenceTime>&& gpuFence) {
     mPowerAdvisor->setGpuFenceTime(mId, std::move(gpuFence));
 }
 
+GpuCompositionResult Display::prepareFrameAsync() {
+    const auto halDisplayId = HalDisplayId::tryCast(mId);
+    // The HWC can only present the frame without validating it if it composes the layers as
+    // requested. Changed composition types and layer requests are only applied to the output
+    // layers, so the HWC would present the frame with the requested types instead.
+    const auto& previousChanges = getState().previousDeviceRequestedChanges;
+    const bool previousChangesEmpty = !previousChanges ||
+            (previousChanges->changedTypes.empty() && previousChanges->layerRequests.empty());
+    if (!mEarlyClientTarget || mIsDisconnected || !halDisplayId ||
+        !getState().previousDeviceRequestedSuccess || !previousChangesEmpty) {
+        return impl::Output::prepareFrameAsync();
+    }
+
+    ATRACE_CALL();
+    ALOGV(__FUNCTION__);
+    // Compose the client target with the predicted strategy, and queue it before asking the HWC
+    // for the composition strategy. If the HWC accepts the predicted strategy, it presents the
+    // frame with a single presentOrValidate call, rather than a validate call followed by a
+    // present call once the client target is set.
+    auto& state = editState();
+    resetCompositionStrategy();
+    applyCompositionStrategy(previousChanges);
+    finishPrepareFrame();
+
+    base::unique_fd bufferFence;
+    std::shared_ptr<renderengine::ExternalTexture> buffer;
+    updateProtectedContentState();
+    GpuCompositionResult compositionResult;
+    if (dequeueRenderBuffer(&bufferFence, &buffer)) {
+        if (auto optReadyFence = composeSurfaces(Region::INVALID_REGION, buffer, bufferFence)) {
+            if (isPowerHintSessionEnabled()) {
+                setHintSessionGpuFence(
+                        std::make_unique<FenceTime>(sp<Fence>::make(dup(optReadyFence->get()))));
+            }
+            getRenderSurface()->queueBuffer(std::move(*optReadyFence));
+            compositionResult.bufferQueued = true;
+        } else {
+            compositionResult.buffer = buffer;
+        }
+    }
+
+    std::optional<android::HWComposer::DeviceRequestedChanges> changes;
+    mClientTargetQueued = compositionResult.bufferQueued;
+    const bool chooseCompositionSuccess = chooseCompositionStrategy(&changes);
+    mClientTargetQueued = false;
+
+    // A frame presented along with the strategy used the predicted strategy as is.
+    const bool presented = chooseCompositionSuccess &&
+            getCompositionEngine().getHwComposer().getValidateSkipped(*halDisplayId);
+    const bool predictionSucceeded =
+            compositionResult.bufferQueued && (presented || changes == previousChanges);
+    state.strategyPrediction = predictionSucceeded ? CompositionStrategyPredictionState::SUCCESS
+                                                   : CompositionStrategyPredictionState::FAIL;
+    if (!predictionSucceeded) {
+        ATRACE_NAME("CompositionStrategyPredictionMiss");
+        resetCompositionStrategy();
+        if (chooseCompositionSuccess) {
+            applyCompositionStrategy(changes);
+        }
+        finishPrepareFrame();
+        // The client target is composed again with the new strategy.
+        compositionResult.bufferQueued = false;
+    } else {
+        ATRACE_NAME("CompositionStrategyPredictionHit");
+    }
+    if (!presented) {
+        state.previousDeviceRequestedChanges = std::move(changes);
+    }
+    state.previousDeviceRequestedSuccess = chooseCompositionSuccess;
+    return compositionResult;
+}
+
 void Display::finishFrame(GpuCompositionResult&& result) {
     // We only need to actually compose the display if:
     // 1) It is being handled by hardware composer, which may need this to
@@ -28,6 +28,7 @@
 #include <compositionengine/impl/OutputCompositionState.h>
 #include <compositionengine/impl/OutputLayer.h>
 #include <compositionengine/impl/OutputLayerCompositionState.h>
+#include <compositionengine/impl/WorkerPool.h>
 #include <compositionengine/impl/planner/Planner.h>
 #include <ftl/future.h>
 #include <gui/TraceUtils.h>
@@ -95,6 +96,9 @@ ScaleVector getScale(const Rect& from, const Rect& to) {
             .y = static_cast<float>(to.height()) / from.height()};
 }
 
+// The number of threads, besides the main thread, computing the layer visibility in parallel.
+constexpr size_t kVisibilityWorkerThreadCount = 3;
+
 } // namespace
 
 std::shared_ptr<Output> createOutput(
@@ -498,15 +502,24 @@ void Output::rebuildLayerStacks(const compositionengine::CompositionRefreshArgs&
 
 void Output::collectVisibleLayers(const compositionengine::CompositionRefreshArgs& refreshArgs,
                                   compositionengine::Output::CoverageState& coverage) {
-    // Evaluate the layers from front to back to determine what is visible. This
-    // also incrementally calculates the coverage information for each layer as
-    // well as the entire output.
-    for (auto layer : reversed(refreshArgs.layers)) {
-        // Incrementally process the coverage for each layer
-        ensureOutputLayerIfVisible(layer, coverage);
-
-        // TODO(b/121291683): Stop early if the output is completely covered and
-        // no more layers could even be visible underneath the ones on top.
+    // The parallel path does not track the coverage excluding display overlays, which is only
+    // needed while a TrustedPresentationListener is registered.
+    if (refreshArgs.parallelVisibility && !coverage.aboveCoveredLayersExcludingOverlays) {
+        collectVisibleLayersInParallel(refreshArgs, coverage);
+    } else {
+        // The cached visibility is only valid if it was computed on the previous rebuild.
+        mVisibilityCache.layers.clear();
+
+        // Evaluate the layers from front to back to determine what is visible. This
+        // also incrementally calculates the coverage information for each layer as
+        // well as the entire output.
+        for (auto layer : reversed(refreshArgs.layers)) {
+            // Incrementally process the coverage for each layer
+            ensureOutputLayerIfVisible(layer, coverage);
+
+            // TODO(b/121291683): Stop early if the output is completely covered and
+            // no more layers could even be visible underneath the ones on top.
+        }
     }
 
     setReleasedLayers(refreshArgs);
@@ -542,18 +555,10 @@ void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
     bool computeAboveCoveredExcludingOverlays = coverage.aboveCoveredLayersExcludingOverlays &&
             !layerFEState->outputFilter.toInternalDisplay;
 
-    /*
-     * opaqueRegion: area of a surface that is fully opaque.
-     */
-    Region opaqueRegion;
-
-    /*
-     * visibleRegion: area of a surface that is visible on screen and not fully
-     * transparent. This is essentially the layer's footprint minus the opaque
-     * regions above it. Areas covered by a translucent surface are considered
-     * visible.
-     */
-    Region visibleRegion;
+    LayerGeometry geometry;
+    if (!computeLayerGeometry(*layerFE, *layerFEState, geometry)) {
+        return;
+    }
 
     /*
      * coveredRegion: area of a surface that is covered by all visible regions
@@ -561,57 +566,93 @@ void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
      */
     Region coveredRegion;
 
-    /*
-     * transparentRegion: area of a surface that is hinted to be completely
-     * transparent.
-     * This is used to tell when the layer has no visible non-transparent
-     * regions and can be removed from the layer list. It does not affect the
-     * visibleRegion of this layer or any layers beneath it. The hint may not
-     * be correct if apps don't respect the SurfaceView restrictions (which,
-     * sadly, some don't).
-     *
-     * In addition, it is used on DISPLAY_DECORATION layers to specify the
-     * blockingRegion, allowing the DPU to skip it to save power. Once we have
-     * hardware that supports a blockingRegion on frames with AFBC, it may be
-     * useful to use this for other layers, too, so long as we can prevent
-     * regressions on b/7179570.
-     */
-    Region transparentRegion;
-
-    /*
-     * shadowRegion: Region cast by the layer's shadow.
-     */
-    Region shadowRegion;
-
     /**
      * covered region above excluding internal display overlay layers
      */
     std::optional<Region> coveredRegionExcludingDisplayOverlays = std::nullopt;
 
-    const ui::Transform& tr = layerFEState->geomLayerTransform;
+    // Clip the covered region to the visible region
+    coveredRegion = coverage.aboveCoveredLayers.intersect(geometry.visibleRegion);
+
+    // Update accumAboveCoveredLayers for next (lower) layer
+    coverage.aboveCoveredLayers.orSelf(geometry.visibleRegion);
+
+    if (CC_UNLIKELY(computeAboveCoveredExcludingOverlays)) {
+        coveredRegionExcludingDisplayOverlays =
+                coverage.aboveCoveredLayersExcludingOverlays->intersect(geometry.visibleRegion);
+        coverage.aboveCoveredLayersExcludingOverlays->orSelf(geometry.visibleRegion);
+    }
+
+    // subtract the opaque region covered by the layers above us
+    Region visibleRegion = geometry.visibleRegion.subtract(coverage.aboveOpaqueLayers);
+
+    if (visibleRegion.isEmpty()) {
+        return;
+    }
+
+    // Get coverage information for the layer as previously displayed,
+    // also taking over ownership from mOutputLayersorderedByZ.
+    auto prevOutputLayerIndex = findCurrentOutputLayerForLayer(layerFE);
+    auto prevOutputLayer =
+            prevOutputLayerIndex ? getOutputLayerOrderedByZByIndex(*prevOutputLayerIndex) : nullptr;
+
+    LayerVisibility visibility;
+    const bool drawn =
+            computeLayerVisibility(*layerFEState, geometry, std::move(visibleRegion),
+                                   std::move(coveredRegion), coverage.aboveOpaqueLayers,
+                                   prevOutputLayer, visibility);
+
+    // accumulate to the screen dirty region
+    coverage.dirtyRegion.orSelf(visibility.dirtyRegion);
+
+    // Update accumAboveOpaqueLayers for next (lower) layer
+    coverage.aboveOpaqueLayers.orSelf(geometry.opaqueRegion);
+
+    if (!drawn) {
+        return;
+    }
+
+    // The layer is visible. Either reuse the existing outputLayer if we have
+    // one, or create a new one if we do not.
+    auto result = ensureOutputLayer(prevOutputLayerIndex, layerFE);
+
+    // Store the layer coverage information into the layer state as some of it
+    // is useful later.
+    auto& outputLayerState = result->editState();
+    storeLayerVisibility(std::move(visibility), outputLayerState);
+    if (CC_UNLIKELY(computeAboveCoveredExcludingOverlays)) {
+        outputLayerState.coveredRegionExcludingDisplayOverlays =
+                std::move(coveredRegionExcludingDisplayOverlays);
+    }
+}
+
+bool Output::computeLayerGeometry(const compositionengine::LayerFE& layerFE,
+                                  const LayerFECompositionState& layerFEState,
+                                  LayerGeometry& geometry) const {
+    const ui::Transform& tr = layerFEState.geomLayerTransform;
 
     // Get the visible region
     // TODO(b/121291683): Is it worth creating helper methods on LayerFEState
     // for computations like this?
-    const Rect visibleRect(tr.transform(layerFEState->geomLayerBounds));
-    visibleRegion.set(visibleRect);
+    const Rect visibleRect(tr.transform(layerFEState.geomLayerBounds));
+    geometry.visibleRegion.set(visibleRect);
 
-    if (layerFEState->shadowRadius > 0.0f) {
+    if (layerFEState.shadowRadius > 0.0f) {
         // if the layer casts a shadow, offset the layers visible region and
         // calculate the shadow region.
-        const auto inset = static_cast<int32_t>(ceilf(layerFEState->shadowRadius) * -1.0f);
+        const auto inset = static_cast<int32_t>(ceilf(layerFEState.shadowRadius) * -1.0f);
         Rect visibleRectWithShadows(visibleRect);
         visibleRectWithShadows.inset(inset, inset, inset, inset);
-        visibleRegion.set(visibleRectWithShadows);
-        shadowRegion = visibleRegion.subtract(visibleRect);
+        geometry.visibleRegion.set(visibleRectWithShadows);
+        geometry.shadowRegion = geometry.visibleRegion.subtract(visibleRect);
     }
 
-    if (visibleRegion.isEmpty()) {
-        return;
+    if (geometry.visibleRegion.isEmpty()) {
+        return false;
     }
 
     // Remove the transparent area from the visible region
-    if (!layerFEState->isOpaque) {
+    if (!layerFEState.isOpaque) {
         if (tr.preserveRects()) {
             // Clip the transparent region to geomLayerBounds first
             // The transparent region may be influenced by applications, for
@@ -623,62 +664,44 @@ void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
             // layer bounds are expected to play nicely with the full
             // transform.
             const Region clippedTransparentRegionHint =
-                    layerFEState->transparentRegionHint.intersect(
-                            Rect(layerFEState->geomLayerBounds));
+                    layerFEState.transparentRegionHint.intersect(
+                            Rect(layerFEState.geomLayerBounds));
 
             if (clippedTransparentRegionHint.isEmpty()) {
-                if (!layerFEState->transparentRegionHint.isEmpty()) {
+                if (!layerFEState.transparentRegionHint.isEmpty()) {
                     ALOGD("Layer: %s had an out of bounds transparent region",
-                          layerFE->getDebugName());
-                    layerFEState->transparentRegionHint.dump("transparentRegionHint");
+                          layerFE.getDebugName());
+                    layerFEState.transparentRegionHint.dump("transparentRegionHint");
                 }
-                transparentRegion.clear();
+                geometry.transparentRegion.clear();
             } else {
-                transparentRegion = tr.transform(clippedTransparentRegionHint);
+                geometry.transparentRegion = tr.transform(clippedTransparentRegionHint);
             }
         } else {
             // transformation too complex, can't do the
             // transparent region optimization.
-            transparentRegion.clear();
+            geometry.transparentRegion.clear();
         }
     }
 
     // compute the opaque region
     const auto layerOrientation = tr.getOrientation();
-    if (layerFEState->isOpaque && ((layerOrientation & ui::Transform::ROT_INVALID) == 0)) {
+    if (layerFEState.isOpaque && ((layerOrientation & ui::Transform::ROT_INVALID) == 0)) {
         // If we one of the simple category of transforms (0/90/180/270 rotation
         // + any flip), then the opaque region is the layer's footprint.
         // Otherwise we don't try and compute the opaque region since there may
         // be errors at the edges, and we treat the entire layer as
         // translucent.
-        opaqueRegion.set(visibleRect);
-    }
-
-    // Clip the covered region to the visible region
-    coveredRegion = coverage.aboveCoveredLayers.intersect(visibleRegion);
-
-    // Update accumAboveCoveredLayers for next (lower) layer
-    coverage.aboveCoveredLayers.orSelf(visibleRegion);
-
-    if (CC_UNLIKELY(computeAboveCoveredExcludingOverlays)) {
-        coveredRegionExcludingDisplayOverlays =
-                coverage.aboveCoveredLayersExcludingOverlays->intersect(visibleRegion);
-        coverage.aboveCoveredLayersExcludingOverlays->orSelf(visibleRegion);
+        geometry.opaqueRegion.set(visibleRect);
     }
+    return true;
+}
 
-    // subtract the opaque region covered by the layers above us
-    visibleRegion.subtractSelf(coverage.aboveOpaqueLayers);
-
-    if (visibleRegion.isEmpty()) {
-        return;
-    }
-
-    // Get coverage information for the layer as previously displayed,
-    // also taking over ownership from mOutputLayersorderedByZ.
-    auto prevOutputLayerIndex = findCurrentOutputLayerForLayer(layerFE);
-    auto prevOutputLayer =
-            prevOutputLayerIndex ? getOutputLayerOrderedByZByIndex(*prevOutputLayerIndex) : nullptr;
-
+bool Output::computeLayerVisibility(const LayerFECompositionState& layerFEState,
+                                    const LayerGeometry& geometry, Region visibleRegion,
+                                    Region coveredRegion, const Region& aboveOpaqueLayers,
+                                    const compositionengine::OutputLayer* prevOutputLayer,
+                                    LayerVisibility& visibility) const {
     //  Get coverage information for the layer as previously displayed
     // TODO(b/121291683): Define kEmptyRegion as a constant in Region.h
     const Region kEmptyRegion;
@@ -689,7 +712,7 @@ void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
 
     // compute this layer's dirty region
     Region dirty;
-    if (layerFEState->contentDirty) {
+    if (layerFEState.contentDirty) {
         // we need to invalidate the whole region
         dirty = visibleRegion;
         // as well, as the old visible region
@@ -712,16 +735,11 @@ void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
         const Region oldExposed = oldVisibleRegion - oldCoveredRegion;
         dirty = (visibleRegion & oldCoveredRegion) | (newExposed - oldExposed);
     }
-    dirty.subtractSelf(coverage.aboveOpaqueLayers);
-
-    // accumulate to the screen dirty region
-    coverage.dirtyRegion.orSelf(dirty);
-
-    // Update accumAboveOpaqueLayers for next (lower) layer
-    coverage.aboveOpaqueLayers.orSelf(opaqueRegion);
+    dirty.subtractSelf(aboveOpaqueLayers);
+    visibility.dirtyRegion = std::move(dirty);
 
     // Compute the visible non-transparent region
-    Region visibleNonTransparentRegion = visibleRegion.subtract(transparentRegion);
+    Region visibleNonTransparentRegion = visibleRegion.subtract(geometry.transparentRegion);
 
     // Perform the final check to see if this layer is visible on this output
     // TODO(b/121291683): Why does this not use visibleRegion? (see outputSpaceVisibleRegion below)
@@ -729,33 +747,212 @@ void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
     Region drawRegion(outputState.transform.transform(visibleNonTransparentRegion));
     drawRegion.andSelf(outputState.displaySpace.getBoundsAsRect());
     if (drawRegion.isEmpty()) {
-        return;
+        return false;
     }
 
-    Region visibleNonShadowRegion = visibleRegion.subtract(shadowRegion);
-
-    // The layer is visible. Either reuse the existing outputLayer if we have
-    // one, or create a new one if we do not.
-    auto result = ensureOutputLayer(prevOutputLayerIndex, layerFE);
+    Region visibleNonShadowRegion = visibleRegion.subtract(geometry.shadowRegion);
 
-    // Store the layer coverage information into the layer state as some of it
-    // is useful later.
-    auto& outputLayerState = result->editState();
-    outputLayerState.visibleRegion = visibleRegion;
-    outputLayerState.visibleNonTransparentRegion = visibleNonTransparentRegion;
-    outputLayerState.coveredRegion = coveredRegion;
-    outputLayerState.outputSpaceVisibleRegion = outputState.transform.transform(
+    visibility.outputSpaceVisibleRegion = outputState.transform.transform(
             visibleNonShadowRegion.intersect(outputState.layerStackSpace.getContent()));
-    outputLayerState.shadowRegion = shadowRegion;
-    outputLayerState.outputSpaceBlockingRegionHint =
-            layerFEState->compositionType == Composition::DISPLAY_DECORATION
+    visibility.outputSpaceBlockingRegionHint =
+            layerFEState.compositionType == Composition::DISPLAY_DECORATION
             ? outputState.transform.transform(
-                      transparentRegion.intersect(outputState.layerStackSpace.getContent()))
+                      geometry.transparentRegion.intersect(outputState.layerStackSpace.getContent()))
             : Region();
-    if (CC_UNLIKELY(computeAboveCoveredExcludingOverlays)) {
-        outputLayerState.coveredRegionExcludingDisplayOverlays =
-                std::move(coveredRegionExcludingDisplayOverlays);
+    visibility.visibleRegion = std::move(visibleRegion);
+    visibility.visibleNonTransparentRegion = std::move(visibleNonTransparentRegion);
+    visibility.coveredRegion = std::move(coveredRegion);
+    visibility.shadowRegion = geometry.shadowRegion;
+    return true;
+}
+
+void Output::storeLayerVisibility(LayerVisibility&& visibility,
+                                  OutputLayerCompositionState& outputLayerState) {
+    outputLayerState.visibleRegion = std::move(visibility.visibleRegion);
+    outputLayerState.visibleNonTransparentRegion =
+            std::move(visibility.visibleNonTransparentRegion);
+    outputLayerState.coveredRegion = std::move(visibility.coveredRegion);
+    outputLayerState.outputSpaceVisibleRegion = std::move(visibility.outputSpaceVisibleRegion);
+    outputLayerState.shadowRegion = std::move(visibility.shadowRegion);
+    outputLayerState.outputSpaceBlockingRegionHint =
+            std::move(visibility.outputSpaceBlockingRegionHint);
+}
+
+void Output::collectVisibleLayersInParallel(
+        const compositionengine::CompositionRefreshArgs& refreshArgs,
+        compositionengine::Output::CoverageState& coverage) {
+    ATRACE_CALL();
+
+    // The candidate layers of this output, from front to back.
+    struct Candidate {
+        const sp<LayerFE>* layerFE;
+        const LayerFECompositionState* layerFEState;
+        std::optional<size_t> prevOutputLayerIndex;
+        compositionengine::OutputLayer* prevOutputLayer = nullptr;
+        bool hasGeometry = false;
+        LayerGeometry geometry;
+        // The coverage of the layers above this one.
+        Region aboveCoveredLayers;
+        Region aboveOpaqueLayers;
+        // Set if the visibility stored in the previous output layer is still valid.
+        bool reused = false;
+        bool drawn = false;
+        LayerVisibility visibility;
+    };
+
+    std::unordered_map<const LayerFE*, size_t> outputLayerIndices;
+    outputLayerIndices.reserve(getOutputLayerCount());
+    for (size_t i = 0; i < getOutputLayerCount(); i++) {
+        if (const auto* outputLayer = getOutputLayerOrderedByZByIndex(i)) {
+            outputLayerIndices.emplace(&outputLayer->getLayerFE(), i);
+        }
+    }
+
+    std::vector<Candidate> candidates;
+    candidates.reserve(refreshArgs.layers.size());
+    for (const auto& layerFE : reversed(refreshArgs.layers)) {
+        // Latch every layer, whether it is on this output or not, as in
+        // ensureOutputLayerIfVisible.
+        if (!coverage.latchedLayers.count(layerFE)) {
+            coverage.latchedLayers.insert(layerFE);
+        }
+        if (!includesLayer(layerFE)) {
+            continue;
+        }
+        const auto* layerFEState = layerFE->getCompositionState();
+        if (CC_UNLIKELY(!layerFEState) || CC_UNLIKELY(!layerFEState->isVisible)) {
+            continue;
+        }
+        Candidate& candidate = candidates.emplace_back();
+        candidate.layerFE = &layerFE;
+        candidate.layerFEState = layerFEState;
+        if (const auto it = outputLayerIndices.find(layerFE.get());
+            it != outputLayerIndices.end()) {
+            candidate.prevOutputLayerIndex = it->second;
+            candidate.prevOutputLayer = getOutputLayerOrderedByZByIndex(it->second);
+        }
+    }
+
+    if (!mVisibilityWorkers) {
+        mVisibilityWorkers =
+                std::make_unique<WorkerPool>("CEVisibility", kVisibilityWorkerThreadCount);
+    }
+
+    // The geometry of each layer does not depend on the other layers.
+    mVisibilityWorkers->parallelFor(candidates.size(), [&](size_t i) {
+        Candidate& candidate = candidates[i];
+        candidate.hasGeometry =
+                computeLayerGeometry(**candidate.layerFE, *candidate.layerFEState,
+                                     candidate.geometry);
+    });
+
+    // Accumulate the coverage from front to back. This is the only part of the
+    // computation that depends on the layers above, and only involves unions.
+    // Unlike ensureOutputLayerIfVisible, the opaque region of a layer hidden by
+    // the opaque layers above it is accumulated as well, which does not change
+    // the result since it is contained in them.
+    for (Candidate& candidate : candidates) {
+        if (!candidate.hasGeometry) {
+            continue;
+        }
+        candidate.aboveCoveredLayers = coverage.aboveCoveredLayers;
+        candidate.aboveOpaqueLayers = coverage.aboveOpaqueLayers;
+        coverage.aboveCoveredLayers.orSelf(candidate.geometry.visibleRegion);
+        coverage.aboveOpaqueLayers.orSelf(candidate.geometry.opaqueRegion);
+    }
+
+    // Only reuse the previous results if the layer stack maps to the output the same way.
+    const auto& outputState = getState();
+    if (mVisibilityCache.transform != outputState.transform ||
+        mVisibilityCache.displayBounds != outputState.displaySpace.getBoundsAsRect() ||
+        mVisibilityCache.layerStackContent != outputState.layerStackSpace.getContent()) {
+        mVisibilityCache.layers.clear();
+        mVisibilityCache.transform = outputState.transform;
+        mVisibilityCache.displayBounds = outputState.displaySpace.getBoundsAsRect();
+        mVisibilityCache.layerStackContent = outputState.layerStackSpace.getContent();
+    }
+
+    mVisibilityWorkers->parallelFor(candidates.size(), [&](size_t i) {
+        Candidate& candidate = candidates[i];
+        if (!candidate.hasGeometry) {
+            return;
+        }
+
+        if (isCachedVisibilityValid(**candidate.layerFE, *candidate.layerFEState,
+                                    candidate.geometry, candidate.aboveCoveredLayers,
+                                    candidate.aboveOpaqueLayers, candidate.prevOutputLayer)) {
+            // With the same visible and covered regions as in the previous
+            // rebuild, and no content change, only the covered part of the
+            // layer is dirty.
+            const auto& prevState = candidate.prevOutputLayer->getState();
+            candidate.visibility.dirtyRegion =
+                    prevState.visibleRegion.intersect(prevState.coveredRegion);
+            candidate.reused = true;
+            candidate.drawn = true;
+            return;
+        }
+
+        Region coveredRegion =
+                candidate.aboveCoveredLayers.intersect(candidate.geometry.visibleRegion);
+        Region visibleRegion =
+                candidate.geometry.visibleRegion.subtract(candidate.aboveOpaqueLayers);
+        if (visibleRegion.isEmpty()) {
+            return;
+        }
+        candidate.drawn =
+                computeLayerVisibility(*candidate.layerFEState, candidate.geometry,
+                                       std::move(visibleRegion), std::move(coveredRegion),
+                                       candidate.aboveOpaqueLayers, candidate.prevOutputLayer,
+                                       candidate.visibility);
+    });
+
+    // Creating output layers and taking them over from the previous frame must
+    // happen in order, on this thread.
+    std::unordered_map<const LayerFE*, CachedLayerVisibility> cachedLayers;
+    cachedLayers.reserve(candidates.size());
+    for (Candidate& candidate : candidates) {
+        coverage.dirtyRegion.orSelf(candidate.visibility.dirtyRegion);
+        if (!candidate.drawn) {
+            continue;
+        }
+
+        auto result = ensureOutputLayer(candidate.prevOutputLayerIndex, *candidate.layerFE);
+        if (!candidate.reused) {
+            storeLayerVisibility(std::move(candidate.visibility), result->editState());
+        }
+
+        CachedLayerVisibility& cached = cachedLayers[candidate.layerFE->get()];
+        cached.outputLayer = result;
+        cached.compositionType = candidate.layerFEState->compositionType;
+        cached.geometry = std::move(candidate.geometry);
+        cached.aboveCoveredLayers = std::move(candidate.aboveCoveredLayers);
+        cached.aboveOpaqueLayers = std::move(candidate.aboveOpaqueLayers);
     }
+    mVisibilityCache.layers = std::move(cachedLayers);
+}
+
+bool Output::isCachedVisibilityValid(const LayerFE& layerFE,
+                                     const LayerFECompositionState& layerFEState,
+                                     const LayerGeometry& geometry,
+                                     const Region& aboveCoveredLayers,
+                                     const Region& aboveOpaqueLayers,
+                                     const compositionengine::OutputLayer* prevOutputLayer) const {
+    if (!prevOutputLayer || layerFEState.contentDirty) {
+        return false;
+    }
+    const auto it = mVisibilityCache.layers.find(&layerFE);
+    if (it == mVisibilityCache.layers.end()) {
+        return false;
+    }
+    const CachedLayerVisibility& cached = it->second;
+    return cached.outputLayer == prevOutputLayer &&
+            cached.compositionType == layerFEState.compositionType &&
+            cached.geometry.visibleRegion.hasSameRects(geometry.visibleRegion) &&
+            cached.geometry.shadowRegion.hasSameRects(geometry.shadowRegion) &&
+            cached.geometry.transparentRegion.hasSameRects(geometry.transparentRegion) &&
+            cached.geometry.opaqueRegion.hasSameRects(geometry.opaqueRegion) &&
+            cached.aboveOpaqueLayers.hasSameRects(aboveOpaqueLayers) &&
+            cached.aboveCoveredLayers.hasSameRects(aboveCoveredLayers);
 }
 
 void Output::setReleasedLayers(const compositionengine::CompositionRefreshArgs&) {
@@ -1188,6 +1385,9 @@ void Output::finishFrame(GpuCompositionResult&& result) {
     std::shared_ptr<renderengine::ExternalTexture> buffer;
     base::unique_fd bufferFence;
     if (outputState.strategyPrediction == CompositionStrategyPredictionState::SUCCESS) {
+        if (result.bufferQueued) {
+            return;
+        }
         optReadyFence = std::move(result.fence);
     } else {
         if (result.bufferAvailable()) {
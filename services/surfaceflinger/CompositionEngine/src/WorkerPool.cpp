@@ -0,0 +1,117 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <compositionengine/impl/WorkerPool.h>
+#include <processgroup/sched_policy.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <android-base/stringprintf.h>
+#include <cutils/sched_policy.h>
+
+namespace android::compositionengine::impl {
+
+WorkerPool::WorkerPool(const std::string& name, size_t threadCount) {
+    mThreads.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; i++) {
+        mThreads.emplace_back(&WorkerPool::run, this);
+        // Thread names are limited to 15 characters.
+        const std::string threadName = base::StringPrintf("%s%zu", name.c_str(), i).substr(0, 15);
+        pthread_setname_np(mThreads.back().native_handle(), threadName.c_str());
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::scoped_lock lock(mMutex);
+        mDone = true;
+    }
+    mCv.notify_all();
+    for (auto& thread : mThreads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+void WorkerPool::parallelFor(size_t count, const std::function<void(size_t)>& fn) {
+    if (count == 0) {
+        return;
+    }
+    if (count == 1 || mThreads.empty()) {
+        for (size_t i = 0; i < count; i++) {
+            fn(i);
+        }
+        return;
+    }
+
+    {
+        std::scoped_lock lock(mMutex);
+        mFn = &fn;
+        mCount = count;
+        mNextItem = 0;
+        mGeneration++;
+    }
+    mCv.notify_all();
+
+    processItems();
+
+    // The items are all claimed, but pool threads may still be processing theirs.
+    std::unique_lock<std::mutex> lock(mMutex);
+    base::ScopedLockAssertion assumeLock(mMutex);
+    mDoneCv.wait(lock, [this]() REQUIRES(mMutex) { return mActiveWorkers == 0; });
+    mFn = nullptr;
+}
+
+void WorkerPool::processItems() {
+    for (size_t i = mNextItem++; i < mCount; i = mNextItem++) {
+        (*mFn)(i);
+    }
+}
+
+void WorkerPool::run() {
+    // The work is on the critical path of the frame, so run at the same
+    // priority as the other composition helper threads.
+    set_sched_policy(0, SP_FOREGROUND);
+    struct sched_param param = {0};
+    param.sched_priority = 2;
+    sched_setscheduler(gettid(), SCHED_FIFO, &param);
+
+    uint64_t lastGeneration = 0;
+    std::unique_lock<std::mutex> lock(mMutex);
+    base::ScopedLockAssertion assumeLock(mMutex);
+    while (true) {
+        mCv.wait(lock, [&]() REQUIRES(mMutex) { return mDone || mGeneration != lastGeneration; });
+        if (mDone) {
+            return;
+        }
+        lastGeneration = mGeneration;
+        if (mFn == nullptr) {
+            // The job already completed before this thread woke up.
+            continue;
+        }
+
+        mActiveWorkers++;
+        lock.unlock();
+        processItems();
+        lock.lock();
+        if (--mActiveWorkers == 0) {
+            mDoneCv.notify_one();
+        }
+    }
+}
+
+} // namespace android::compositionengine::impl
@@ -263,8 +263,33 @@ void CachedSet::render(renderengine::RenderEngine& renderEngine, TexturePool& te
         layerSettings.emplace_back(highlight);
     }
 
-    auto texture = texturePool.borrowTexture();
-    LOG_ALWAYS_FATAL_IF(texture->get()->getBuffer()->initCheck() != OK);
+    // A texture that only covers the bounds of this set is enough, unless some content is drawn
+    // outside of them, or the layers are not positioned in the framebuffer's coordinates. Square
+    // displays installed rotated have the same bounds in both spaces, so compare the orientations
+    // as well.
+    const bool fitsBounds = !mBlurLayer &&
+            outputState.framebufferSpace.getBounds() == outputState.displaySpace.getBounds() &&
+            outputState.framebufferSpace.getOrientation() ==
+                    outputState.displaySpace.getOrientation() &&
+            std::none_of(layerSettings.cbegin(), layerSettings.cend(),
+                         [](const renderengine::LayerSettings& settings) {
+                             return settings.shadow.length > 0.f;
+                         });
+    auto texture = fitsBounds ? texturePool.borrowTexture(mBounds.getSize())
+                              : texturePool.borrowTexture();
+    const auto& buffer = texture->get()->getBuffer();
+    LOG_ALWAYS_FATAL_IF(buffer->initCheck() != OK);
+
+    // Place the texture over the bounds while keeping it within the framebuffer, and shift the
+    // rendered content accordingly. Screen-sized textures always start at the origin.
+    const auto& framebufferSize = outputState.framebufferSpace.getBounds();
+    const int32_t textureWidth = static_cast<int32_t>(buffer->getWidth());
+    const int32_t textureHeight = static_cast<int32_t>(buffer->getHeight());
+    const int32_t textureLeft =
+            std::max(0, std::min(mBounds.left, framebufferSize.getWidth() - textureWidth));
+    const int32_t textureTop =
+            std::max(0, std::min(mBounds.top, framebufferSize.getHeight() - textureHeight));
+    displaySettings.physicalDisplay.offsetBy(-textureLeft, -textureTop);
 
     base::unique_fd bufferFence;
     if (texture->getReadyFence()) {
@@ -287,6 +312,8 @@ void CachedSet::render(renderengine::RenderEngine& renderEngine, TexturePool& te
         mOutputSpace = outputState.framebufferSpace;
         mTexture = texture;
         mTexture->setReadyFence(mDrawFence);
+        mTextureBounds = Rect(textureLeft, textureTop, textureLeft + textureWidth,
+                              textureTop + textureHeight);
         mOutputSpace.setOrientation(outputState.framebufferSpace.getOrientation());
         mOutputDataspace = outputDataspace;
         mOrientation = orientation;
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "Planner"
+
+#include <compositionengine/LayerFE.h>
+#include <compositionengine/OutputLayer.h>
+#include <compositionengine/impl/planner/CostModel.h>
+#include <compositionengine/impl/planner/LayerState.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace android::compositionengine::impl::planner {
+
+namespace {
+
+float getArea(const Rect& rect) {
+    return rect.isValid() ? static_cast<float>(rect.width()) * static_cast<float>(rect.height())
+                          : 0.f;
+}
+
+// The CachedSet is rendered in a single dataspace. Assume that it is the most common one among the
+// layers, so that the fewest layers need to be converted.
+ui::Dataspace getMostCommonDataspace(std::vector<CachedSet>::const_iterator start,
+                                     std::vector<CachedSet>::const_iterator end) {
+    std::unordered_map<ui::Dataspace, size_t> counts;
+    for (auto set = start; set != end; ++set) {
+        for (const CachedSet::Layer& layer : set->getConstituentLayers()) {
+            ++counts[layer.getState()->getDataspace()];
+        }
+    }
+
+    const auto mostCommon =
+            std::max_element(counts.cbegin(), counts.cend(), [](const auto& lhs, const auto& rhs) {
+                return lhs.second < rhs.second;
+            });
+    return mostCommon == counts.cend() ? ui::Dataspace::UNKNOWN : mostCommon->first;
+}
+
+} // namespace
+
+CostModel::RunEstimate CostModel::estimateRun(std::vector<CachedSet>::const_iterator start,
+                                              size_t setCount, const CachedSet* blurringLayer,
+                                              ui::Size displaySize,
+                                              std::chrono::steady_clock::time_point now) const {
+    const auto end = start + static_cast<std::ptrdiff_t>(setCount);
+    const float overlayCost = mTunables.overlayWeight * getArea(Rect(displaySize));
+    const ui::Dataspace outputDataspace = getMostCommonDataspace(start, end);
+
+    RunEstimate estimate;
+    Region boundingRegion;
+    std::chrono::steady_clock::time_point lastUpdate;
+    for (auto set = start; set != end; ++set) {
+        boundingRegion.orSelf(set->getBounds());
+        lastUpdate = std::max(lastUpdate, set->getLastUpdate());
+
+        // Each set is currently read by the DPU on every frame, and takes an overlay
+        estimate.savedCostPerFrame += static_cast<float>(set->getDisplayCost()) + overlayCost;
+
+        for (const CachedSet::Layer& layer : set->getConstituentLayers()) {
+            estimate.renderCost += getLayerRenderCost(layer, outputDataspace);
+        }
+    }
+
+    // Once flattened, the run is read once and takes a single overlay
+    const float boundsArea = getArea(boundingRegion.getBounds());
+    estimate.savedCostPerFrame -= boundsArea + overlayCost;
+
+    if (blurringLayer) {
+        estimate.renderCost += mTunables.blurWeight * getArea(blurringLayer->getBounds());
+    }
+
+    // Write - assumes that the output buffer only gets written once per pixel
+    estimate.renderCost += boundsArea;
+
+    const std::chrono::duration<float> inactiveDuration = now - lastUpdate;
+    const std::chrono::duration<float> framePeriod = mTunables.framePeriod > 0ns
+            ? mTunables.framePeriod
+            : Tunables::kDefaultFramePeriod;
+    estimate.expectedFrames =
+            std::clamp(inactiveDuration / framePeriod, 1.f,
+                       static_cast<float>(std::max<size_t>(mTunables.maxExpectedFrames, 1)));
+    return estimate;
+}
+
+float CostModel::getLayerRenderCost(const CachedSet::Layer& layer,
+                                    ui::Dataspace outputDataspace) const {
+    const LayerState& state = *layer.getState();
+
+    // Regardless of the effects, each input is read once
+    float weight = 1.f;
+    if (state.hasBlurBehind()) {
+        weight += mTunables.blurWeight;
+    }
+    if (state.getOutputLayer()->getLayerFE().hasRoundedCorners()) {
+        weight += mTunables.roundedCornersWeight;
+    }
+    if (state.getDataspace() != outputDataspace) {
+        weight += mTunables.dataspaceConversionWeight;
+    }
+    return weight * getArea(layer.getDisplayFrame());
+}
+
+} // namespace android::compositionengine::impl::planner
@@ -61,7 +61,11 @@ bool isSameStack(const std::vector<const LayerState*>& incomingLayers,
 } // namespace
 
 Flattener::Flattener(renderengine::RenderEngine& renderEngine, const Tunables& tunables)
-      : mRenderEngine(renderEngine), mTunables(tunables), mTexturePool(mRenderEngine) {}
+      : mRenderEngine(renderEngine),
+        mTunables(tunables),
+        mCostModel(tunables.mCostModel.enabled ? std::make_unique<CostModel>(tunables.mCostModel)
+                                               : nullptr),
+        mTexturePool(mRenderEngine, tunables.mTexturePool) {}
 
 NonBufferHash Flattener::flattenLayers(const std::vector<const LayerState*>& layers,
                                        NonBufferHash hash, time_point now) {
@@ -189,6 +193,20 @@ void Flattener::dump(std::string& result) const {
     base::StringAppendF(&result, "    Cost: %.2f\n",
                         static_cast<float>(mCachedSetCreationCost) / displayArea);
 
+    result.append("\n    Run selection (estimated costs in screen-size buffers):\n");
+    base::StringAppendF(&result, "      Candidate runs: %zd\n", mCandidateRunCount);
+    base::StringAppendF(&result, "      Chosen runs: %zd (%zd not the first candidate)\n",
+                        mChosenRunCount, mChosenLaterRunCount);
+    base::StringAppendF(&result, "      Skipped as unprofitable: %zd\n", mUnprofitableRunCount);
+    if (mChosenRunCount > 0) {
+        base::StringAppendF(&result, "      Average layers per run: %.2f\n",
+                            static_cast<float>(mChosenRunLayerCount) / mChosenRunCount);
+    }
+    base::StringAppendF(&result, "      Render cost: %.2f\n", mChosenRunRenderCost / displayArea);
+    base::StringAppendF(&result, "      Saved cost per frame: %.2f\n",
+                        mChosenRunSavedCostPerFrame / displayArea);
+    base::StringAppendF(&result, "      Benefit: %.2f\n", mChosenRunBenefit / displayArea);
+
     const auto lastUpdate =
             std::chrono::duration_cast<std::chrono::milliseconds>(now - mLastGeometryUpdate);
     base::StringAppendF(&result, "\n  Current hash %016zx, last update %sago\n\n", mCurrentGeometry,
@@ -472,13 +490,61 @@ std::vector<Flattener::Run> Flattener::findCandidateRuns(time_point now) const {
     return runs;
 }
 
-std::optional<Flattener::Run> Flattener::findBestRun(std::vector<Flattener::Run>& runs) const {
+std::optional<Flattener::Run> Flattener::findBestRun(std::vector<Flattener::Run>& runs,
+                                                     time_point now) {
     if (runs.empty()) {
         return std::nullopt;
     }
 
-    // TODO (b/181192467): Choose the best run, instead of just the first.
-    return runs[0];
+    mCandidateRunCount += runs.size();
+
+    if (!mCostModel) {
+        ++mChosenRunCount;
+        mChosenRunLayerCount += runs[0].getLayerLength();
+        return runs[0];
+    }
+
+    // Choose the run that is expected to save the most. Ties go to the earliest run, since runs
+    // closer to the bottom of the stack are the least likely to be invalidated by the layers above.
+    std::optional<size_t> bestIndex;
+    CostModel::RunEstimate bestEstimate;
+    for (size_t i = 0; i < runs.size(); ++i) {
+        const Run& run = runs[i];
+        const auto estimate =
+                mCostModel->estimateRun(run.getStart(), run.getSetCount(), run.getBlurringLayer(),
+                                        mDisplaySize, now);
+        ALOGV("[%s] Run %zu: render cost %.0f, saved cost per frame %.0f, expected frames %.0f",
+              __func__, i, estimate.renderCost, estimate.savedCostPerFrame,
+              estimate.expectedFrames);
+
+        // A hole punch is needed regardless of the cost of the run
+        const bool requiresHolePunch =
+                run.getHolePunchCandidate() && run.getHolePunchCandidate()->requiresHolePunch();
+        if (!requiresHolePunch && mCostModel->getTunables().skipUnprofitableRuns &&
+            estimate.getBenefit() <= 0.f) {
+            ++mUnprofitableRunCount;
+            continue;
+        }
+
+        if (!bestIndex || estimate.getBenefit() > bestEstimate.getBenefit()) {
+            bestIndex = i;
+            bestEstimate = estimate;
+        }
+    }
+
+    if (!bestIndex) {
+        return std::nullopt;
+    }
+
+    ++mChosenRunCount;
+    if (*bestIndex != 0) {
+        ++mChosenLaterRunCount;
+    }
+    mChosenRunLayerCount += runs[*bestIndex].getLayerLength();
+    mChosenRunRenderCost += bestEstimate.renderCost;
+    mChosenRunSavedCostPerFrame += bestEstimate.savedCostPerFrame;
+    mChosenRunBenefit += bestEstimate.getBenefit();
+    return runs[*bestIndex];
 }
 
 void Flattener::buildCachedSets(time_point now) {
@@ -510,7 +576,7 @@ void Flattener::buildCachedSets(time_point now) {
 
     std::vector<Run> runs = findCandidateRuns(now);
 
-    std::optional<Run> bestRun = findBestRun(runs);
+    std::optional<Run> bestRun = findBestRun(runs, now);
 
     if (!bestRun) {
         return;
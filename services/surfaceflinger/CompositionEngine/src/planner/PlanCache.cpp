@@ -0,0 +1,303 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// #define LOG_NDEBUG 0
+
+#undef LOG_TAG
+#define LOG_TAG "Planner"
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include <android-base/file.h>
+#include <android-base/parseint.h>
+#include <android-base/strings.h>
+#include <compositionengine/impl/planner/PlanCache.h>
+#include <utils/Trace.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <vector>
+
+namespace android::compositionengine::impl::planner {
+
+namespace {
+
+constexpr const char* kFileHeader = "PlanCache v1 ";
+
+// Use counts are halved after this many uses per entry of capacity.
+constexpr uint64_t kAgingPeriodPerEntry = 8;
+
+} // namespace
+
+PlanCache::PlanCache(size_t capacity, std::string path, std::string buildFingerprint)
+      : mCapacity(std::max<size_t>(capacity, 1)),
+        mPath(std::move(path)),
+        mBuildFingerprint(std::move(buildFingerprint)) {
+    if (mPath.empty()) {
+        return;
+    }
+
+    // The file is small and loading it before the first frame is what lets the first frame be
+    // predicted, so it is read synchronously. Only writing is deferred to the thread.
+    load();
+    mThread = std::thread(&PlanCache::threadMain, this);
+}
+
+PlanCache::~PlanCache() {
+    {
+        std::scoped_lock lock(mMutex);
+        mDone = true;
+        mCondition.notify_all();
+    }
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+
+    persist();
+}
+
+std::optional<Plan> PlanCache::getPlan(NonBufferHash hash) {
+    std::scoped_lock lock(mMutex);
+    const auto entry = mEntries.find(hash);
+    if (entry == mEntries.end()) {
+        ++mMissCount;
+        return std::nullopt;
+    }
+
+    ++mHitCount;
+    return entry->second.plan;
+}
+
+void PlanCache::recordPlan(NonBufferHash hash, const Plan& plan) {
+    if (plan.empty()) {
+        return;
+    }
+
+    std::scoped_lock lock(mMutex);
+    applyUsesLocked();
+
+    auto entry = mEntries.find(hash);
+    if (entry == mEntries.end()) {
+        if (mEntries.size() >= mCapacity) {
+            evictLocked();
+        }
+        entry = mEntries.emplace(hash, Entry{.plan = plan}).first;
+        mDirty = true;
+    } else if (entry->second.plan != plan) {
+        entry->second.plan = plan;
+        mDirty = true;
+    }
+
+    useLocked(entry->second);
+
+    if (mDirty) {
+        mCondition.notify_all();
+    }
+}
+
+void PlanCache::recordUse(NonBufferHash hash) {
+    const uint64_t index = mUseLogHead.fetch_add(1, std::memory_order_relaxed);
+    mUseLog[index % kUseLogCapacity].store(hash, std::memory_order_release);
+}
+
+void PlanCache::recordMisprediction(NonBufferHash hash) {
+    std::scoped_lock lock(mMutex);
+    ++mMispredictionCount;
+    if (mEntries.erase(hash) != 0) {
+        mDirty = true;
+        mCondition.notify_all();
+    }
+}
+
+size_t PlanCache::size() const {
+    std::scoped_lock lock(mMutex);
+    return mEntries.size();
+}
+
+void PlanCache::persist() {
+    if (mPath.empty()) {
+        return;
+    }
+
+    std::string contents;
+    {
+        std::scoped_lock lock(mMutex);
+        if (!mDirty) {
+            return;
+        }
+        applyUsesLocked();
+        contents = serializeLocked();
+        mDirty = false;
+    }
+    writeFile(contents);
+}
+
+void PlanCache::dump(std::string& result) const {
+    std::scoped_lock lock(mMutex);
+    result.append("Plan cache:\n");
+    base::StringAppendF(&result, "  Entries: %zu/%zu (%zu loaded from %s)\n", mEntries.size(),
+                        mCapacity, mLoadedCount, mPath.empty() ? "<memory only>" : mPath.c_str());
+    const size_t totalLookups = mHitCount + mMissCount;
+    base::StringAppendF(&result, "  Hit rate: %.2f%% (%zu/%zu)\n",
+                        totalLookups == 0 ? 0.f : 100.f * mHitCount / totalLookups, mHitCount,
+                        totalLookups);
+    base::StringAppendF(&result, "  Hits: %zu\n", mHitCount);
+    base::StringAppendF(&result, "  Misses: %zu\n", mMissCount);
+    base::StringAppendF(&result, "  Mispredictions: %zu\n", mMispredictionCount);
+    base::StringAppendF(&result, "  Evictions: %zu\n\n", mEvictionCount);
+}
+
+void PlanCache::load() {
+    ATRACE_CALL();
+    std::string contents;
+    if (!base::ReadFileToString(mPath, &contents)) {
+        ALOGV("[%s] No plan cache found at %s", __func__, mPath.c_str());
+        return;
+    }
+
+    const std::vector<std::string> lines = base::Split(contents, "\n");
+    if (lines.empty() || lines[0] != kFileHeader + mBuildFingerprint) {
+        ALOGI("Discarding plan cache %s written by another build", mPath.c_str());
+        return;
+    }
+
+    std::vector<std::pair<NonBufferHash, Entry>> entries;
+    for (size_t i = 1; i < lines.size(); ++i) {
+        const std::vector<std::string> fields = base::Split(lines[i], " ");
+        NonBufferHash hash;
+        uint32_t useCount;
+        std::optional<Plan> plan = fields.size() == 3 ? Plan::fromString(fields[1]) : std::nullopt;
+        if (!plan || plan->empty() || !base::ParseUint(fields[0], &hash) ||
+            !base::ParseUint(fields[2], &useCount)) {
+            ALOGW("Skipping malformed plan cache entry '%s'", lines[i].c_str());
+            continue;
+        }
+        entries.emplace_back(hash, Entry{.plan = std::move(*plan), .useCount = useCount});
+    }
+
+    std::scoped_lock lock(mMutex);
+    // Entries are written from the least to the most recently used, so keep the last ones if the
+    // capacity was lowered since.
+    const size_t first = entries.size() > mCapacity ? entries.size() - mCapacity : 0;
+    for (size_t i = first; i < entries.size(); ++i) {
+        auto& [hash, entry] = entries[i];
+        entry.lastUse = ++mClock;
+        mEntries[hash] = std::move(entry);
+    }
+    mLoadedCount = mEntries.size();
+}
+
+std::string PlanCache::serializeLocked() const {
+    std::vector<std::pair<NonBufferHash, const Entry*>> entries;
+    entries.reserve(mEntries.size());
+    for (const auto& [hash, entry] : mEntries) {
+        entries.emplace_back(hash, &entry);
+    }
+    std::sort(entries.begin(), entries.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.second->lastUse < rhs.second->lastUse;
+    });
+
+    std::string result = kFileHeader + mBuildFingerprint;
+    for (const auto& [hash, entry] : entries) {
+        base::StringAppendF(&result, "\n%#zx %s %u", hash, to_string(entry->plan).c_str(),
+                            entry->useCount);
+    }
+    return result;
+}
+
+void PlanCache::writeFile(const std::string& contents) const {
+    ATRACE_CALL();
+    // Write to a temporary file first, so that a crash cannot leave a truncated cache behind.
+    const std::string tmpPath = mPath + ".tmp";
+    if (!base::WriteStringToFile(contents, tmpPath)) {
+        ALOGW("Could not write plan cache to %s", tmpPath.c_str());
+        return;
+    }
+    if (std::rename(tmpPath.c_str(), mPath.c_str()) != 0) {
+        ALOGW("Could not rename plan cache to %s", mPath.c_str());
+        std::remove(tmpPath.c_str());
+    }
+}
+
+void PlanCache::useLocked(Entry& entry) {
+    ++mClock;
+    if (mClock % (mCapacity * kAgingPeriodPerEntry) == 0) {
+        agingLocked();
+    }
+
+    if (entry.useCount < std::numeric_limits<uint32_t>::max()) {
+        ++entry.useCount;
+    }
+    entry.lastUse = mClock;
+}
+
+void PlanCache::applyUsesLocked() {
+    const uint64_t head = mUseLogHead.load(std::memory_order_acquire);
+    if (head - mUseLogTail > kUseLogCapacity) {
+        mUseLogTail = head - kUseLogCapacity;
+    }
+    for (; mUseLogTail < head; ++mUseLogTail) {
+        const NonBufferHash hash =
+                mUseLog[mUseLogTail % kUseLogCapacity].load(std::memory_order_relaxed);
+        if (const auto entry = mEntries.find(hash); entry != mEntries.end()) {
+            useLocked(entry->second);
+        }
+    }
+}
+
+void PlanCache::evictLocked() {
+    const auto victim = std::min_element(mEntries.begin(), mEntries.end(),
+                                         [](const auto& lhs, const auto& rhs) {
+                                             const Entry& left = lhs.second;
+                                             const Entry& right = rhs.second;
+                                             if (left.useCount != right.useCount) {
+                                                 return left.useCount < right.useCount;
+                                             }
+                                             return left.lastUse < right.lastUse;
+                                         });
+    ALOGV("[%s] Evicting %zx", __func__, victim->first);
+    mEntries.erase(victim);
+    ++mEvictionCount;
+}
+
+void PlanCache::agingLocked() {
+    for (auto& [_, entry] : mEntries) {
+        entry.useCount /= 2;
+    }
+}
+
+void PlanCache::threadMain() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            base::ScopedLockAssertion assumeLocked(mMutex);
+            mCondition.wait(lock, [&]() REQUIRES(mMutex) { return mDone || mDirty; });
+            if (mDone) {
+                break;
+            }
+
+            // Batch the changes of the next few seconds into a single write.
+            mCondition.wait_for(lock, kPersistDelay, [&]() REQUIRES(mMutex) { return mDone; });
+            if (mDone) {
+                break;
+            }
+        } // unlock mMutex
+
+        persist();
+    }
+}
+
+} // namespace android::compositionengine::impl::planner
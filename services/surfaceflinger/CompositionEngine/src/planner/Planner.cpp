@@ -20,9 +20,11 @@
 #define LOG_TAG "Planner"
 #define ATRACE_TAG ATRACE_TAG_GRAPHICS
 
+#include <android-base/parsedouble.h>
 #include <android-base/properties.h>
 #include <compositionengine/LayerFECompositionState.h>
 #include <compositionengine/impl/OutputLayerCompositionState.h>
+#include <compositionengine/impl/planner/PlanCache.h>
 #include <compositionengine/impl/planner/Planner.h>
 
 #include <utils/Trace.h>
@@ -53,6 +55,53 @@ std::optional<Flattener::Tunables::RenderScheduling> buildRenderSchedulingTunabl
             });
 }
 
+float getFloatProperty(const std::string& key, float defaultValue) {
+    float value;
+    return base::ParseFloat(base::GetProperty(key, std::string()), &value) ? value : defaultValue;
+}
+
+CostModel::Tunables buildCostModelTunables() {
+    using Tunables = CostModel::Tunables;
+    return Tunables{
+            .blurWeight = getFloatProperty(std::string("debug.sf.flattener_cost_blur_weight"),
+                                           Tunables::kDefaultBlurWeight),
+            .roundedCornersWeight =
+                    getFloatProperty(std::string("debug.sf.flattener_cost_rounded_corners_weight"),
+                                     Tunables::kDefaultRoundedCornersWeight),
+            .dataspaceConversionWeight = getFloatProperty(
+                    std::string("debug.sf.flattener_cost_dataspace_conversion_weight"),
+                    Tunables::kDefaultDataspaceConversionWeight),
+            .overlayWeight = getFloatProperty(std::string("debug.sf.flattener_cost_overlay_weight"),
+                                              Tunables::kDefaultOverlayWeight),
+            .framePeriod = std::chrono::nanoseconds(base::GetUintProperty<uint64_t>(
+                    std::string("debug.sf.flattener_cost_frame_period_ns"),
+                    Tunables::kDefaultFramePeriod.count())),
+            .maxExpectedFrames = base::GetUintProperty<
+                    size_t>(std::string("debug.sf.flattener_cost_max_expected_frames"),
+                            Tunables::kDefaultMaxExpectedFrames),
+            .enabled = base::GetBoolProperty(std::string("debug.sf.flattener_enable_cost_model"),
+                                             false),
+            .skipUnprofitableRuns =
+                    base::GetBoolProperty(std::string("debug.sf.flattener_skip_unprofitable_runs"),
+                                          false),
+    };
+}
+
+TexturePool::Tunables buildTexturePoolTunables() {
+    using Tunables = TexturePool::Tunables;
+    return Tunables{
+            .fitCachedSetBounds =
+                    base::GetBoolProperty(std::string("debug.sf.planner_texture_pool_fit_bounds"),
+                                          Tunables::kDefaultFitCachedSetBounds),
+            .bucketGranularity = base::GetIntProperty<
+                    int32_t>(std::string("debug.sf.planner_texture_pool_bucket_granularity"),
+                             Tunables::kDefaultBucketGranularity),
+            .budgetBytes = base::GetUintProperty<
+                    size_t>(std::string("debug.sf.planner_texture_pool_budget_bytes"),
+                            Tunables::kDefaultBudgetBytes),
+    };
+}
+
 Flattener::Tunables buildFlattenerTuneables() {
     const auto activeLayerTimeout = std::chrono::milliseconds(
             base::GetIntProperty<int32_t>(std::string(
@@ -65,9 +114,26 @@ Flattener::Tunables buildFlattenerTuneables() {
             .mActiveLayerTimeout = activeLayerTimeout,
             .mRenderScheduling = buildRenderSchedulingTunables(),
             .mEnableHolePunch = enableHolePunch,
+            .mCostModel = buildCostModelTunables(),
+            .mTexturePool = buildTexturePoolTunables(),
     };
 }
 
+// The plan cache is shared by the planners of all displays, so that they write a single file.
+std::shared_ptr<PlanCache> getPlanCache() {
+    if (!base::GetBoolProperty(std::string("debug.sf.enable_planner_plan_cache"), false)) {
+        return nullptr;
+    }
+
+    static const std::shared_ptr<PlanCache> sPlanCache = std::make_shared<PlanCache>(
+            base::GetUintProperty<size_t>(std::string("debug.sf.planner_plan_cache_size"),
+                                          PlanCache::kDefaultCapacity),
+            base::GetProperty(std::string("debug.sf.planner_plan_cache_path"),
+                              std::string("/data/misc/surfaceflinger/planner_plan_cache")),
+            base::GetProperty(std::string("ro.build.fingerprint"), std::string()));
+    return sPlanCache;
+}
+
 } // namespace
 
 Planner::Planner(renderengine::RenderEngine& renderEngine)
@@ -75,6 +141,9 @@ Planner::Planner(renderengine::RenderEngine& renderEngine)
                    buildFlattenerTuneables()) {
     mPredictorEnabled =
             base::GetBoolProperty(std::string("debug.sf.enable_planner_prediction"), false);
+    if (mPredictorEnabled) {
+        mPredictor.setPlanCache(getPlanCache());
+    }
 }
 
 void Planner::setDisplaySize(ui::Size size) {
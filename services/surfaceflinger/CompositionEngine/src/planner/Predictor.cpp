@@ -19,6 +19,7 @@
 #undef LOG_TAG
 #define LOG_TAG "Planner"
 
+#include <compositionengine/impl/planner/PlanCache.h>
 #include <compositionengine/impl/planner/Predictor.h>
 
 namespace android::compositionengine::impl::planner {
@@ -177,6 +178,17 @@ std::optional<Predictor::PredictedPlan> Predictor::getPredictedPlan(
         return PredictedPlan{.hash = hash, .plan = *exactMatch, .type = Prediction::Type::Exact};
     }
 
+    // Stacks that are already known in this process are better described by their predictions, so
+    // only look up new stacks in the plan cache
+    if (mPlanCache && !hasPrediction(hash)) {
+        if (std::optional<Plan> cachedPlan = mPlanCache->getPlan(hash); cachedPlan) {
+            ALOGV("[%s] Found a cached plan for %zx", __func__, hash);
+            return PredictedPlan{.hash = hash,
+                                 .plan = std::move(*cachedPlan),
+                                 .type = Prediction::Type::Exact};
+        }
+    }
+
     // If only a hash was passed in for a layer stack with a cached set, don't perform
     // approximate matches and return early
     if (layers.empty()) {
@@ -222,14 +234,19 @@ void Predictor::recordResult(std::optional<PredictedPlan> predictedPlan,
 void Predictor::dump(std::string& result) const {
     result.append("Predictor state:\n");
 
-    const size_t hitCount = mExactHitCount + mApproximateHitCount;
+    const size_t hitCount = mExactHitCount + mCachedHitCount + mApproximateHitCount;
     const size_t totalAttempts = hitCount + mMissCount;
     base::StringAppendF(&result, "Global non-skipped hit rate: %.2f%% (%zd/%zd)\n",
                         100.0f * hitCount / totalAttempts, hitCount, totalAttempts);
     base::StringAppendF(&result, "  Exact hits: %zd\n", mExactHitCount);
+    base::StringAppendF(&result, "  Plan cache hits: %zd\n", mCachedHitCount);
     base::StringAppendF(&result, "  Approximate hits: %zd\n", mApproximateHitCount);
     base::StringAppendF(&result, "  Misses: %zd\n\n", mMissCount);
 
+    if (mPlanCache) {
+        mPlanCache->dump(result);
+    }
+
     dumpPredictionsByFrequency(result);
 }
 
@@ -308,6 +325,10 @@ Prediction& Predictor::getPrediction(NonBufferHash hash) {
     return const_cast<Prediction&>(const_cast<const Predictor*>(this)->getPrediction(hash));
 }
 
+bool Predictor::hasPrediction(NonBufferHash hash) const {
+    return mPredictions.count(hash) != 0 || getCandidateEntryByHash(hash) != mCandidates.cend();
+}
+
 std::optional<Plan> Predictor::getExactMatch(NonBufferHash hash) const {
     const Prediction* match = nullptr;
     if (const auto predictionEntry = mPredictions.find(hash);
@@ -393,6 +414,11 @@ void Predictor::promoteIfCandidate(NonBufferHash predictionHash) {
 
 void Predictor::recordPredictedResult(PredictedPlan predictedPlan,
                                       const std::vector<const LayerState*>& layers, Plan result) {
+    if (!hasPrediction(predictedPlan.hash)) {
+        recordCachedResult(std::move(predictedPlan), layers, std::move(result));
+        return;
+    }
+
     Prediction& prediction = getPrediction(predictedPlan.hash);
     if (prediction.getPlan() != result) {
         ALOGV("[%s] %s prediction missed, expected %s, found %s", __func__,
@@ -400,6 +426,9 @@ void Predictor::recordPredictedResult(PredictedPlan predictedPlan,
               to_string(result).c_str());
         prediction.recordMiss(predictedPlan.type);
         ++mMissCount;
+        if (mPlanCache && predictedPlan.type == Prediction::Type::Exact) {
+            mPlanCache->recordMisprediction(predictedPlan.hash);
+        }
         return;
     }
 
@@ -417,6 +446,8 @@ void Predictor::recordPredictedResult(PredictedPlan predictedPlan,
     ALOGV("[%s] %s prediction hit", __func__, to_string(predictedPlan.type).c_str());
     ALOGV("[%s] Plan: %s", __func__, to_string(result).c_str());
     prediction.recordHit(predictedPlan.type);
+    const bool firstExactHit = predictedPlan.type == Prediction::Type::Exact &&
+            prediction.getHitCount(Prediction::Type::Exact) == 1;
 
     const auto stackMatchesHash = [hash = predictedPlan.hash](const ApproximateStack& stack) {
         return stack.hash == hash;
@@ -435,6 +466,41 @@ void Predictor::recordPredictedResult(PredictedPlan predictedPlan,
     }
 
     promoteIfCandidate(predictedPlan.hash);
+
+    // The stack is added to the cache on its first exact hit. Later hits only count as uses, which
+    // doesn't lock the cache.
+    if (mPlanCache && firstExactHit) {
+        mPlanCache->recordPlan(predictedPlan.hash, result);
+    } else if (mPlanCache && predictedPlan.type == Prediction::Type::Exact) {
+        mPlanCache->recordUse(predictedPlan.hash);
+    }
+}
+
+void Predictor::recordCachedResult(PredictedPlan predictedPlan,
+                                   const std::vector<const LayerState*>& layers, Plan result) {
+    if (predictedPlan.plan != result) {
+        ALOGV("[%s] Cached plan missed, expected %s, found %s", __func__,
+              to_string(predictedPlan.plan).c_str(), to_string(result).c_str());
+        mPlanCache->recordMisprediction(predictedPlan.hash);
+        ++mMissCount;
+
+        // Learn the stack again as a novel one
+        mCandidates.emplace_front(predictedPlan.hash, Prediction(layers, result));
+        if (mCandidates.size() > MAX_CANDIDATES) {
+            mCandidates.pop_back();
+        }
+        return;
+    }
+
+    ALOGV("[%s] Cached plan hit", __func__);
+    ++mCachedHitCount;
+    mPlanCache->recordPlan(predictedPlan.hash, result);
+
+    // The plan was confirmed again, so the stack skips the candidate list
+    Prediction prediction(layers, result);
+    prediction.recordHit(Prediction::Type::Exact);
+    mSimilarStacks[result].push_back(predictedPlan.hash);
+    mPredictions.emplace(predictedPlan.hash, std::move(prediction));
 }
 
 bool Predictor::findSimilarPrediction(const std::vector<const LayerState*>& layers, Plan result) {
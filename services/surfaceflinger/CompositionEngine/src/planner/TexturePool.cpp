@@ -23,14 +23,35 @@
 #include <renderengine/impl/ExternalTexture.h>
 #include <utils/Log.h>
 
+#include <map>
+
 namespace android::compositionengine::impl::planner {
 
+namespace {
+
+// Textures are allocated as RGBA_8888
+constexpr size_t kBytesPerPixel = 4;
+
+size_t getByteSize(ui::Size size) {
+    return size.isValid() ? static_cast<size_t>(size.getWidth()) *
+                    static_cast<size_t>(size.getHeight()) * kBytesPerPixel
+                          : 0;
+}
+
+ui::Size getTextureSize(const renderengine::ExternalTexture& texture) {
+    return ui::Size(static_cast<int32_t>(texture.getBuffer()->getWidth()),
+                    static_cast<int32_t>(texture.getBuffer()->getHeight()));
+}
+
+} // namespace
+
 void TexturePool::allocatePool() {
     mPool.clear();
-    if (mEnabled && mSize.isValid()) {
+    // When fitting the bounds of CachedSets, the sizes that are needed are not known upfront.
+    if (mEnabled && mSize.isValid() && !mTunables.fitCachedSetBounds) {
         mPool.resize(kMinPoolSize);
         std::generate_n(mPool.begin(), kMinPoolSize, [&]() {
-            return Entry{genTexture(), nullptr};
+            return Entry{genTexture(mSize), nullptr};
         });
     }
 }
@@ -44,49 +65,95 @@ void TexturePool::setDisplaySize(ui::Size size) {
 }
 
 std::shared_ptr<TexturePool::AutoTexture> TexturePool::borrowTexture() {
-    if (mPool.empty()) {
-        return std::make_shared<AutoTexture>(*this, genTexture(), nullptr);
+    return borrowTexture(mSize);
+}
+
+std::shared_ptr<TexturePool::AutoTexture> TexturePool::borrowTexture(ui::Size size) {
+    const ui::Size bucketSize = getBucketSize(size);
+    ++mBorrowCount;
+    mBorrowedBytes += getByteSize(bucketSize);
+
+    const auto entry = std::find_if(mPool.begin(), mPool.end(), [&](const Entry& pooled) {
+        return getTextureSize(*pooled.texture) == bucketSize;
+    });
+    if (entry == mPool.end()) {
+        ++mAllocationStallCount;
+        return std::make_shared<AutoTexture>(*this, genTexture(bucketSize), nullptr);
     }
 
-    const auto entry = mPool.front();
-    mPool.pop_front();
-    return std::make_shared<AutoTexture>(*this, entry.texture, entry.fence);
+    const auto texture = std::make_shared<AutoTexture>(*this, entry->texture, entry->fence);
+    mPool.erase(entry);
+    return texture;
 }
 
 void TexturePool::returnTexture(std::shared_ptr<renderengine::ExternalTexture>&& texture,
                                 const sp<Fence>& fence) {
+    const ui::Size size = getTextureSize(*texture);
+    mBorrowedBytes -= std::min(mBorrowedBytes, getByteSize(size));
+
     // Drop the texture on the floor if the pool is not enabled
     if (!mEnabled) {
         return;
     }
 
-    // Or the texture on the floor if the pool is no longer tracking textures of the same size.
-    if (static_cast<int32_t>(texture->getBuffer()->getWidth()) != mSize.getWidth() ||
-        static_cast<int32_t>(texture->getBuffer()->getHeight()) != mSize.getHeight()) {
-        ALOGV("Deallocating texture from Planner's pool - display size changed (previous: (%dx%d), "
-              "current: (%dx%d))",
-              texture->getBuffer()->getWidth(), texture->getBuffer()->getHeight(), mSize.getWidth(),
-              mSize.getHeight());
+    // Or the texture on the floor if the pool no longer hands out textures of the same size.
+    if (getBucketSize(size) != size) {
+        ALOGV("Deallocating texture from Planner's pool - display size changed (texture: (%dx%d), "
+              "display: (%dx%d))",
+              size.getWidth(), size.getHeight(), mSize.getWidth(), mSize.getHeight());
         return;
     }
 
-    // Also ensure the pool does not grow beyond a maximum size.
-    if (mPool.size() == kMaxPoolSize) {
-        ALOGD("Deallocating texture from Planner's pool - max size [%" PRIu64 "] reached",
-              static_cast<uint64_t>(kMaxPoolSize));
-        return;
+    mPool.push_back({std::move(texture), fence});
+    trimToBudget();
+}
+
+void TexturePool::trimToBudget() {
+    const size_t budgetBytes = getBudgetBytes();
+    size_t poolBytes = getPoolBytes();
+    while (poolBytes > budgetBytes && !mPool.empty()) {
+        const ui::Size size = getTextureSize(*mPool.front().texture);
+        ALOGV("Deallocating texture (%dx%d) from Planner's pool - budget of %zu bytes reached",
+              size.getWidth(), size.getHeight(), budgetBytes);
+        poolBytes -= getByteSize(size);
+        mPool.pop_front();
+        ++mTrimCount;
     }
+}
 
-    mPool.push_back({std::move(texture), fence});
+ui::Size TexturePool::getBucketSize(ui::Size size) const {
+    if (!mTunables.fitCachedSetBounds) {
+        return mSize;
+    }
+
+    const int32_t granularity = std::max(mTunables.bucketGranularity, 1);
+    const auto roundUp = [granularity](int32_t value, int32_t max) {
+        const int32_t rounded = (std::max(value, 1) + granularity - 1) / granularity * granularity;
+        return std::min(rounded, max);
+    };
+    return ui::Size(roundUp(size.getWidth(), mSize.getWidth()),
+                    roundUp(size.getHeight(), mSize.getHeight()));
+}
+
+size_t TexturePool::getBudgetBytes() const {
+    return mTunables.budgetBytes != 0 ? mTunables.budgetBytes : kMaxPoolSize * getByteSize(mSize);
 }
 
-std::shared_ptr<renderengine::ExternalTexture> TexturePool::genTexture() {
-    LOG_ALWAYS_FATAL_IF(!mSize.isValid(), "Attempted to generate texture with invalid size");
+size_t TexturePool::getPoolBytes() const {
+    size_t poolBytes = 0;
+    for (const Entry& entry : mPool) {
+        poolBytes += getByteSize(getTextureSize(*entry.texture));
+    }
+    return poolBytes;
+}
+
+std::shared_ptr<renderengine::ExternalTexture> TexturePool::genTexture(ui::Size size) {
+    LOG_ALWAYS_FATAL_IF(!size.isValid(), "Attempted to generate texture with invalid size");
     return std::make_shared<
             renderengine::impl::
                     ExternalTexture>(sp<GraphicBuffer>::
-                                             make(static_cast<uint32_t>(mSize.getWidth()),
-                                                  static_cast<uint32_t>(mSize.getHeight()),
+                                             make(static_cast<uint32_t>(size.getWidth()),
+                                                  static_cast<uint32_t>(size.getHeight()),
                                                   HAL_PIXEL_FORMAT_RGBA_8888, 1U,
                                                   static_cast<uint64_t>(
                                                           GraphicBuffer::USAGE_HW_RENDER |
@@ -105,8 +172,26 @@ void TexturePool::setEnabled(bool enabled) {
 
 void TexturePool::dump(std::string& out) const {
     base::StringAppendF(&out,
-                        "TexturePool (%s) has %zu buffers of size [%" PRId32 ", %" PRId32 "]\n",
-                        mEnabled ? "enabled" : "disabled", mPool.size(), mSize.width, mSize.height);
+                        "TexturePool (%s) has %zu buffers for display size [%" PRId32 ", %" PRId32
+                        "]%s\n",
+                        mEnabled ? "enabled" : "disabled", mPool.size(), mSize.width, mSize.height,
+                        mTunables.fitCachedSetBounds ? ", fitting cached set bounds" : "");
+
+    std::map<std::pair<int32_t, int32_t>, size_t> bucketCounts;
+    for (const Entry& entry : mPool) {
+        const ui::Size size = getTextureSize(*entry.texture);
+        ++bucketCounts[{size.getWidth(), size.getHeight()}];
+    }
+    for (const auto& [size, count] : bucketCounts) {
+        base::StringAppendF(&out, "  [%" PRId32 ", %" PRId32 "]: %zu buffers\n", size.first,
+                            size.second, count);
+    }
+
+    base::StringAppendF(&out, "  Occupancy: %zu/%zu bytes pooled, %zu bytes borrowed\n",
+                        getPoolBytes(), getBudgetBytes(), mBorrowedBytes);
+    base::StringAppendF(&out, "  Borrowed textures: %zu (%zu allocation stalls)\n", mBorrowCount,
+                        mAllocationStallCount);
+    base::StringAppendF(&out, "  Textures trimmed to budget: %zu\n", mTrimCount);
 }
 
-} // namespace android::compositionengine::impl::planner
\ No newline at end of file
+} // namespace android::compositionengine::impl::planner
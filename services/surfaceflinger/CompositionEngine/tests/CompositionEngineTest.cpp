@@ -22,6 +22,11 @@
 #include <compositionengine/mock/OutputLayer.h>
 #include <gtest/gtest.h>
 #include <renderengine/mock/RenderEngine.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 
 #include "MockHWComposer.h"
 #include "TimeStats/TimeStats.h"
@@ -32,12 +37,16 @@ namespace {
 using ::testing::_;
 using ::testing::DoAll;
 using ::testing::InSequence;
+using ::testing::InvokeWithoutArgs;
 using ::testing::Ref;
 using ::testing::Return;
 using ::testing::ReturnRef;
 using ::testing::SaveArg;
+using ::testing::Sequence;
 using ::testing::StrictMock;
 
+using namespace std::chrono_literals;
+
 struct CompositionEngineTest : public testing::Test {
     std::shared_ptr<TimeStats> mTimeStats;
 
@@ -116,6 +125,125 @@ TEST_F(CompositionEnginePresentTest, worksAsExpected) {
     mEngine.present(mRefreshArgs);
 }
 
+/*
+ * CompositionEngine::present with CompositionRefreshArgs::parallelOutputs
+ */
+
+struct CompositionEngineParallelPresentTest : public CompositionEnginePresentTest {
+    struct ThreadedRenderEngine : public renderengine::mock::RenderEngine {
+        std::optional<pid_t> getRenderEngineTid() const override { return gettid(); }
+    };
+
+    static constexpr PhysicalDisplayId kDisplayId1 = PhysicalDisplayId::fromPort(1u);
+    static constexpr PhysicalDisplayId kDisplayId2 = PhysicalDisplayId::fromPort(2u);
+    static constexpr PhysicalDisplayId kDisplayId3 = PhysicalDisplayId::fromPort(3u);
+
+    // Only reached if the outputs are not presented concurrently.
+    static constexpr auto kPresentTimeout = 5s;
+
+    CompositionEngineParallelPresentTest() {
+        mEngine.setRenderEngine(&mRenderEngine);
+        mEngine.setHwComposer(std::unique_ptr<android::HWComposer>(mHwComposer));
+        mRefreshArgs.parallelOutputs = true;
+    }
+
+    void setDisplay(mock::Output& output, PhysicalDisplayId displayId,
+                    bool multiThreadedPresentSupport) {
+        EXPECT_CALL(output, getDisplayId()).WillRepeatedly(Return(displayId));
+        EXPECT_CALL(*mHwComposer, hasMultiThreadedPresentSupport(HalDisplayId(displayId)))
+                .WillRepeatedly(Return(multiThreadedPresentSupport));
+    }
+
+    // Each present waits for the presents of all outputs to start, which they only do if the
+    // outputs are presented concurrently.
+    void expectConcurrentPrepareAndPresent(mock::Output& output) {
+        Sequence seq;
+        EXPECT_CALL(output, prepare(Ref(mRefreshArgs), _)).InSequence(seq);
+        EXPECT_CALL(output, present(Ref(mRefreshArgs)))
+                .InSequence(seq)
+                .WillOnce(InvokeWithoutArgs([this] { waitForAllPresents(); }));
+    }
+
+    void waitForAllPresents() {
+        std::unique_lock lock(mPresentMutex);
+        mPresentCount++;
+        mPresentCondition.notify_all();
+        if (!mPresentCondition.wait_for(lock, kPresentTimeout, [this] {
+                return mPresentCount == mRefreshArgs.outputs.size();
+            })) {
+            mPresentTimedOut = true;
+        }
+    }
+
+    StrictMock<ThreadedRenderEngine> mRenderEngine;
+    android::mock::HWComposer* mHwComposer = new StrictMock<android::mock::HWComposer>();
+
+    std::mutex mPresentMutex;
+    std::condition_variable mPresentCondition;
+    size_t mPresentCount = 0;
+    bool mPresentTimedOut = false;
+};
+
+TEST_F(CompositionEngineParallelPresentTest, presentsTwoOutputsInParallel) {
+    setDisplay(*mOutput1, kDisplayId1, true);
+    setDisplay(*mOutput2, kDisplayId2, true);
+
+    EXPECT_CALL(mEngine, preComposition(Ref(mRefreshArgs)));
+    expectConcurrentPrepareAndPresent(*mOutput1);
+    expectConcurrentPrepareAndPresent(*mOutput2);
+
+    mRefreshArgs.outputs = {mOutput1, mOutput2};
+    mEngine.present(mRefreshArgs);
+
+    EXPECT_FALSE(mPresentTimedOut);
+}
+
+TEST_F(CompositionEngineParallelPresentTest, presentsThreeOutputsInParallel) {
+    setDisplay(*mOutput1, kDisplayId1, true);
+    setDisplay(*mOutput2, kDisplayId2, true);
+    setDisplay(*mOutput3, kDisplayId3, true);
+
+    EXPECT_CALL(mEngine, preComposition(Ref(mRefreshArgs)));
+    expectConcurrentPrepareAndPresent(*mOutput1);
+    expectConcurrentPrepareAndPresent(*mOutput2);
+    expectConcurrentPrepareAndPresent(*mOutput3);
+
+    mRefreshArgs.outputs = {mOutput1, mOutput2, mOutput3};
+    mEngine.present(mRefreshArgs);
+
+    EXPECT_FALSE(mPresentTimedOut);
+}
+
+TEST_F(CompositionEngineParallelPresentTest, presentsSequentiallyWithoutThreadedRenderEngine) {
+    StrictMock<renderengine::mock::RenderEngine> renderEngine;
+    mEngine.setRenderEngine(&renderEngine);
+
+    InSequence seq;
+    EXPECT_CALL(mEngine, preComposition(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput1, prepare(Ref(mRefreshArgs), _));
+    EXPECT_CALL(*mOutput2, prepare(Ref(mRefreshArgs), _));
+    EXPECT_CALL(*mOutput1, present(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput2, present(Ref(mRefreshArgs)));
+
+    mRefreshArgs.outputs = {mOutput1, mOutput2};
+    mEngine.present(mRefreshArgs);
+}
+
+TEST_F(CompositionEngineParallelPresentTest, presentsSequentiallyWithoutMultiThreadedPresent) {
+    setDisplay(*mOutput1, kDisplayId1, true);
+    setDisplay(*mOutput2, kDisplayId2, false);
+
+    InSequence seq;
+    EXPECT_CALL(mEngine, preComposition(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput1, prepare(Ref(mRefreshArgs), _));
+    EXPECT_CALL(*mOutput2, prepare(Ref(mRefreshArgs), _));
+    EXPECT_CALL(*mOutput1, present(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput2, present(Ref(mRefreshArgs)));
+
+    mRefreshArgs.outputs = {mOutput1, mOutput2};
+    mEngine.present(mRefreshArgs);
+}
+
 /*
  * CompositionEngine::updateCursorAsync
  */
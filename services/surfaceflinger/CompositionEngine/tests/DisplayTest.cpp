@@ -15,6 +15,7 @@
  */
 
 #include <cmath>
+#include <future>
 
 #include <compositionengine/DisplayColorProfileCreationArgs.h>
 #include <compositionengine/DisplayCreationArgs.h>
@@ -66,6 +67,9 @@ using testing::Sequence;
 using testing::SetArgPointee;
 using testing::StrictMock;
 
+using CompositionStrategyPredictionState = android::compositionengine::impl::
+        OutputCompositionState::CompositionStrategyPredictionState;
+
 constexpr PhysicalDisplayId DEFAULT_DISPLAY_ID = PhysicalDisplayId::fromPort(123u);
 constexpr HalVirtualDisplayId HAL_VIRTUAL_DISPLAY_ID{456u};
 constexpr GpuVirtualDisplayId GPU_VIRTUAL_DISPLAY_ID{789u};
@@ -1025,6 +1029,142 @@ TEST_F(DisplayFinishFrameTest, performsCompositionIfDirtyAndNotEmpty) {
     gpuDisplay->finishFrame(std::move(mResultWithBuffer));
 }
 
+/*
+ * Display::prepareFrameAsync()
+ */
+
+struct DisplayPrepareFrameAsyncTest : public DisplayTestCommon {
+    struct Display : public DisplayTestCommon::PartialMockDisplay {
+        using DisplayTestCommon::PartialMockDisplay::PartialMockDisplay;
+
+        MOCK_METHOD0(updateProtectedContentState, void());
+        MOCK_METHOD2(dequeueRenderBuffer,
+                     bool(base::unique_fd*, std::shared_ptr<renderengine::ExternalTexture>*));
+        MOCK_METHOD3(composeSurfaces,
+                     std::optional<base::unique_fd>(const Region&,
+                                                    std::shared_ptr<renderengine::ExternalTexture>,
+                                                    base::unique_fd&));
+        MOCK_METHOD1(chooseCompositionStrategyAsync,
+                     std::future<bool>(
+                             std::optional<android::HWComposer::DeviceRequestedChanges>*));
+    };
+
+    DisplayPrepareFrameAsyncTest() {
+        mDisplay->setRenderSurfaceForTest(std::unique_ptr<RenderSurface>(mRenderSurface));
+        mDisplay->setEarlyClientTarget(true);
+        mDisplay->editState().isEnabled = true;
+        mDisplay->editState().previousDeviceRequestedChanges = mDeviceRequestedChanges;
+        mDisplay->editState().previousDeviceRequestedSuccess = true;
+
+        EXPECT_CALL(*mDisplay, anyLayersRequireClientComposition()).WillRepeatedly(Return(true));
+        EXPECT_CALL(*mDisplay, allLayersRequireClientComposition()).WillRepeatedly(Return(false));
+        EXPECT_CALL(*mDisplay, updateProtectedContentState());
+        EXPECT_CALL(*mDisplay, dequeueRenderBuffer(_, _))
+                .WillOnce(DoAll(SetArgPointee<1>(mBuffer), Return(true)));
+        EXPECT_CALL(*mDisplay, composeSurfaces(_, mBuffer, _))
+                .WillOnce(Return(ByMove(base::unique_fd())));
+    }
+
+    // The HWC composes the layers as requested, so it can present the frame without validating it.
+    android::HWComposer::DeviceRequestedChanges mDeviceRequestedChanges{
+            {},
+            hal::DisplayRequest::FLIP_CLIENT_TARGET,
+            {},
+            {DEFAULT_DISPLAY_ID.value,
+             {aidl::android::hardware::graphics::common::PixelFormat::RGBA_8888,
+              aidl::android::hardware::graphics::common::Dataspace::UNKNOWN},
+             -1.f,
+             DimmingStage::NONE},
+    };
+    std::shared_ptr<renderengine::ExternalTexture> mBuffer =
+            std::make_shared<renderengine::mock::FakeExternalTexture>(1U /*width*/, 1U /*height*/,
+                                                                      1ULL /* bufferId */,
+                                                                      HAL_PIXEL_FORMAT_RGBA_8888,
+                                                                      0ULL /*usage*/);
+    mock::RenderSurface* mRenderSurface = new StrictMock<mock::RenderSurface>();
+    std::shared_ptr<Display> mDisplay =
+            createPartialMockDisplay<Display>(mCompositionEngine,
+                                              getDisplayCreationArgsForPhysicalDisplay());
+};
+
+TEST_F(DisplayPrepareFrameAsyncTest, presentsWithClientTargetIfPredictionIsAccepted) {
+    EXPECT_CALL(*mDisplay, applyChangedTypesToLayers(mDeviceRequestedChanges.changedTypes));
+    EXPECT_CALL(*mDisplay, applyDisplayRequests(mDeviceRequestedChanges.displayRequests));
+    EXPECT_CALL(*mDisplay, applyLayerRequestsToLayers(mDeviceRequestedChanges.layerRequests));
+    EXPECT_CALL(*mRenderSurface, prepareFrame(true, true));
+
+    // The client target is queued before the HWC is asked for the composition strategy, which
+    // lets the HWC present the frame right away.
+    InSequence seq;
+    EXPECT_CALL(*mRenderSurface, queueBuffer(_));
+    EXPECT_CALL(mHwComposer,
+                getDeviceCompositionChanges(HalDisplayId(DEFAULT_DISPLAY_ID), false, _, _, _))
+            .WillOnce(Return(NO_ERROR));
+    EXPECT_CALL(mHwComposer, getValidateSkipped(HalDisplayId(DEFAULT_DISPLAY_ID)))
+            .WillOnce(Return(true));
+
+    impl::GpuCompositionResult result = mDisplay->prepareFrameAsync();
+
+    EXPECT_EQ(mDisplay->getState().strategyPrediction,
+              CompositionStrategyPredictionState::SUCCESS);
+    EXPECT_TRUE(result.bufferQueued);
+    EXPECT_FALSE(result.bufferAvailable());
+    EXPECT_EQ(mDisplay->getState().previousDeviceRequestedChanges, mDeviceRequestedChanges);
+}
+
+TEST_F(DisplayPrepareFrameAsyncTest, composesAgainIfPredictionMisses) {
+    auto newDeviceRequestedChanges = mDeviceRequestedChanges;
+    newDeviceRequestedChanges.displayRequests = static_cast<hal::DisplayRequest>(0);
+
+    EXPECT_CALL(*mDisplay, applyChangedTypesToLayers(mDeviceRequestedChanges.changedTypes))
+            .Times(2);
+    EXPECT_CALL(*mDisplay, applyDisplayRequests(mDeviceRequestedChanges.displayRequests));
+    EXPECT_CALL(*mDisplay, applyDisplayRequests(newDeviceRequestedChanges.displayRequests));
+    EXPECT_CALL(*mDisplay, applyLayerRequestsToLayers(mDeviceRequestedChanges.layerRequests))
+            .Times(2);
+    EXPECT_CALL(*mRenderSurface, prepareFrame(true, true)).Times(2);
+    EXPECT_CALL(*mRenderSurface, queueBuffer(_));
+    EXPECT_CALL(mHwComposer,
+                getDeviceCompositionChanges(HalDisplayId(DEFAULT_DISPLAY_ID), false, _, _, _))
+            .WillOnce(DoAll(SetArgPointee<4>(newDeviceRequestedChanges), Return(NO_ERROR)));
+    EXPECT_CALL(mHwComposer, getValidateSkipped(HalDisplayId(DEFAULT_DISPLAY_ID)))
+            .WillOnce(Return(false));
+
+    impl::GpuCompositionResult result = mDisplay->prepareFrameAsync();
+
+    EXPECT_EQ(mDisplay->getState().strategyPrediction, CompositionStrategyPredictionState::FAIL);
+    EXPECT_FALSE(result.bufferQueued);
+    EXPECT_EQ(mDisplay->getState().previousDeviceRequestedChanges, newDeviceRequestedChanges);
+}
+
+TEST_F(DisplayPrepareFrameAsyncTest, validatesIfPredictedChangesAreNotEmpty) {
+    auto deviceRequestedChanges = mDeviceRequestedChanges;
+    deviceRequestedChanges.changedTypes = {{nullptr, Composition::CLIENT}};
+    deviceRequestedChanges.layerRequests = {{nullptr, hal::LayerRequest::CLEAR_CLIENT_TARGET}};
+    mDisplay->editState().previousDeviceRequestedChanges = deviceRequestedChanges;
+
+    EXPECT_CALL(*mDisplay, applyChangedTypesToLayers(deviceRequestedChanges.changedTypes));
+    EXPECT_CALL(*mDisplay, applyDisplayRequests(deviceRequestedChanges.displayRequests));
+    EXPECT_CALL(*mDisplay, applyLayerRequestsToLayers(deviceRequestedChanges.layerRequests));
+    EXPECT_CALL(*mRenderSurface, prepareFrame(true, true));
+
+    // The HWC would present the layers with the requested composition types if it did not
+    // validate the frame, so the client target is only queued once the frame is validated.
+    std::promise<bool> chooseCompositionStrategyResult;
+    chooseCompositionStrategyResult.set_value(true);
+    EXPECT_CALL(*mDisplay, chooseCompositionStrategyAsync(_))
+            .WillOnce(DoAll(SetArgPointee<0>(deviceRequestedChanges),
+                            Return(ByMove(chooseCompositionStrategyResult.get_future()))));
+    EXPECT_CALL(*mRenderSurface, queueBuffer(_)).Times(0);
+
+    impl::GpuCompositionResult result = mDisplay->prepareFrameAsync();
+
+    EXPECT_EQ(mDisplay->getState().strategyPrediction,
+              CompositionStrategyPredictionState::SUCCESS);
+    EXPECT_FALSE(result.bufferQueued);
+    EXPECT_EQ(mDisplay->getState().previousDeviceRequestedChanges, deviceRequestedChanges);
+}
+
 /*
  * Display functional tests
  */
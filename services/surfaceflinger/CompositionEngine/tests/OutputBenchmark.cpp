@@ -0,0 +1,110 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <compositionengine/CompositionRefreshArgs.h>
+#include <compositionengine/LayerFECompositionState.h>
+#include <compositionengine/impl/Output.h>
+#include <compositionengine/mock/CompositionEngine.h>
+#include <compositionengine/mock/LayerFE.h>
+#include <gmock/gmock.h>
+
+#include <deque>
+
+namespace android::compositionengine {
+namespace {
+
+using testing::NiceMock;
+using testing::Return;
+
+// Usage: atest libcompositionengine_benchmark
+
+constexpr int32_t kDisplayWidth = 1080;
+constexpr int32_t kDisplayHeight = 2340;
+
+struct Layer {
+    Layer() {
+        ON_CALL(*layerFE, getCompositionState()).WillByDefault(Return(&layerFEState));
+        ON_CALL(*layerFE, getDebugName()).WillByDefault(Return("Layer"));
+    }
+
+    sp<NiceMock<mock::LayerFE>> layerFE = sp<NiceMock<mock::LayerFE>>::make();
+    LayerFECompositionState layerFEState;
+};
+
+// Builds a stack of partially overlapping layers, similar to a launcher with
+// many widgets: a mix of opaque and translucent layers, some with shadows.
+void createLayerStack(size_t layerCount, std::deque<Layer>& layers,
+                      CompositionRefreshArgs& refreshArgs) {
+    for (size_t i = 0; i < layerCount; i++) {
+        Layer& layer = layers.emplace_back();
+        auto& state = layer.layerFEState;
+        const float left = static_cast<float>((i * 37) % (kDisplayWidth - 300));
+        const float top = static_cast<float>((i * 53) % (kDisplayHeight - 300));
+        state.isVisible = true;
+        state.isOpaque = i % 3 == 0;
+        state.contentDirty = false;
+        state.geomLayerBounds = FloatRect{0, 0, 300, 300};
+        state.geomLayerTransform.set(left, top);
+        state.shadowRadius = i % 5 == 0 ? 8.f : 0.f;
+        state.transparentRegionHint = i % 7 == 1 ? Region(Rect(20, 20, 120, 120)) : Region();
+        refreshArgs.layers.push_back(layer.layerFE);
+    }
+    refreshArgs.updatingOutputGeometryThisFrame = true;
+}
+
+// Rebuilds the layer stack of an output every iteration, moving one layer
+// near the top of the stack each time, as an animation would. Reports the
+// time spent on the calling thread.
+void BM_rebuildLayerStacks(benchmark::State& state) {
+    const size_t layerCount = static_cast<size_t>(state.range(0));
+    const bool parallel = state.range(1) != 0;
+
+    NiceMock<mock::CompositionEngine> compositionEngine;
+    std::shared_ptr<impl::Output> output = impl::createOutput(compositionEngine);
+    auto& outputState = output->editState();
+    outputState.isEnabled = true;
+    outputState.displaySpace.setBounds(ui::Size(kDisplayWidth, kDisplayHeight));
+    outputState.layerStackSpace.setContent(Rect(0, 0, kDisplayWidth, kDisplayHeight));
+    outputState.transform = ui::Transform(ui::Transform::ROT_0, kDisplayWidth, kDisplayHeight);
+
+    std::deque<Layer> layers;
+    CompositionRefreshArgs refreshArgs;
+    createLayerStack(layerCount, layers, refreshArgs);
+    refreshArgs.parallelVisibility = parallel;
+
+    auto& animatedLayer = layers[layerCount - layerCount / 4].layerFEState;
+    float offset = 0.f;
+    for (auto _ : state) {
+        offset = offset >= 100.f ? 0.f : offset + 1.f;
+        animatedLayer.geomLayerTransform.set(offset, offset);
+
+        LayerFESet latchedLayers;
+        output->rebuildLayerStacks(refreshArgs, latchedLayers);
+        output->editState().dirtyRegion.clear();
+    }
+}
+
+BENCHMARK(BM_rebuildLayerStacks)
+        ->ArgNames({"layers", "parallel"})
+        ->ArgsProduct({{32, 128, 256}, {0, 1}})
+        ->UseRealTime();
+
+} // namespace
+} // namespace android::compositionengine
+
+BENCHMARK_MAIN();
@@ -33,6 +33,7 @@
 #include <ui/Rect.h>
 #include <ui/Region.h>
 
+#include <array>
 #include <cmath>
 #include <cstdint>
 
@@ -2004,6 +2005,145 @@ TEST_F(OutputEnsureOutputLayerIfVisibleTest, transparentRegionClipsWhenOutsideBo
                 RegionEq(kTransparentRegionHint));
 }
 
+/*
+ * Output::collectVisibleLayers() with CompositionRefreshArgs::parallelVisibility
+ */
+
+struct OutputParallelVisibilityTest : public testing::Test {
+    struct Layer {
+        Layer() {
+            EXPECT_CALL(*layerFE, getCompositionState()).WillRepeatedly(Return(&layerFEState));
+            EXPECT_CALL(*layerFE, getDebugName()).WillRepeatedly(Return("Layer"));
+        }
+
+        sp<StrictMock<mock::LayerFE>> layerFE = sp<StrictMock<mock::LayerFE>>::make();
+        LayerFECompositionState layerFEState;
+    };
+
+    static constexpr size_t kLayerCount = 12;
+
+    OutputParallelVisibilityTest() {
+        for (auto* output : {mSequentialOutput.get(), mParallelOutput.get()}) {
+            auto& state = output->editState();
+            state.isEnabled = true;
+            state.displaySpace.setBounds(ui::Size(200, 300));
+            state.layerStackSpace.setContent(Rect(0, 0, 200, 300));
+            state.transform = ui::Transform(TR_IDENT, 200, 300);
+        }
+
+        // A cascade of overlapping layers, alternating between opaque and
+        // translucent ones, some with shadows and transparent region hints.
+        for (size_t i = 0; i < kLayerCount; i++) {
+            auto& state = mLayers[i].layerFEState;
+            const float offset = static_cast<float>(i * 10);
+            state.isVisible = true;
+            state.isOpaque = i % 2 == 0;
+            state.contentDirty = true;
+            state.geomLayerBounds = FloatRect{0, 0, 100, 150};
+            state.geomLayerTransform.set(offset, offset);
+            state.shadowRadius = i % 3 == 0 ? 4.f : 0.f;
+            state.transparentRegionHint = i % 4 == 1 ? Region(Rect(10, 10, 50, 50)) : Region();
+            mRefreshArgs.layers.push_back(mLayers[i].layerFE);
+        }
+        mRefreshArgs.updatingOutputGeometryThisFrame = true;
+    }
+
+    void rebuildLayerStacks() {
+        LayerFESet sequentialLatchedLayers;
+        mRefreshArgs.parallelVisibility = false;
+        mSequentialOutput->rebuildLayerStacks(mRefreshArgs, sequentialLatchedLayers);
+
+        LayerFESet parallelLatchedLayers;
+        mRefreshArgs.parallelVisibility = true;
+        mParallelOutput->rebuildLayerStacks(mRefreshArgs, parallelLatchedLayers);
+
+        EXPECT_EQ(sequentialLatchedLayers, parallelLatchedLayers);
+    }
+
+    void expectSameVisibility() {
+        EXPECT_THAT(mParallelOutput->getState().dirtyRegion,
+                    RegionEq(mSequentialOutput->getState().dirtyRegion));
+        EXPECT_THAT(mParallelOutput->getState().undefinedRegion,
+                    RegionEq(mSequentialOutput->getState().undefinedRegion));
+
+        ASSERT_EQ(mSequentialOutput->getOutputLayerCount(),
+                  mParallelOutput->getOutputLayerCount());
+        for (size_t i = 0; i < mSequentialOutput->getOutputLayerCount(); i++) {
+            const auto* expected = mSequentialOutput->getOutputLayerOrderedByZByIndex(i);
+            const auto* actual = mParallelOutput->getOutputLayerOrderedByZByIndex(i);
+            EXPECT_EQ(&expected->getLayerFE(), &actual->getLayerFE());
+
+            const auto& expectedState = expected->getState();
+            const auto& actualState = actual->getState();
+            EXPECT_THAT(actualState.visibleRegion, RegionEq(expectedState.visibleRegion));
+            EXPECT_THAT(actualState.visibleNonTransparentRegion,
+                        RegionEq(expectedState.visibleNonTransparentRegion));
+            EXPECT_THAT(actualState.coveredRegion, RegionEq(expectedState.coveredRegion));
+            EXPECT_THAT(actualState.outputSpaceVisibleRegion,
+                        RegionEq(expectedState.outputSpaceVisibleRegion));
+            EXPECT_THAT(actualState.shadowRegion, RegionEq(expectedState.shadowRegion));
+            EXPECT_THAT(actualState.outputSpaceBlockingRegionHint,
+                        RegionEq(expectedState.outputSpaceBlockingRegionHint));
+        }
+    }
+
+    void clearDirtyRegions() {
+        mSequentialOutput->editState().dirtyRegion.clear();
+        mParallelOutput->editState().dirtyRegion.clear();
+    }
+
+    StrictMock<mock::CompositionEngine> mCompositionEngine;
+    std::shared_ptr<impl::Output> mSequentialOutput = impl::createOutput(mCompositionEngine);
+    std::shared_ptr<impl::Output> mParallelOutput = impl::createOutput(mCompositionEngine);
+    CompositionRefreshArgs mRefreshArgs;
+    std::array<Layer, kLayerCount> mLayers;
+};
+
+TEST_F(OutputParallelVisibilityTest, matchesSequentialComputation) {
+    rebuildLayerStacks();
+    expectSameVisibility();
+}
+
+TEST_F(OutputParallelVisibilityTest, matchesSequentialComputationWhenNothingChanged) {
+    rebuildLayerStacks();
+    clearDirtyRegions();
+
+    for (auto& layer : mLayers) {
+        layer.layerFEState.contentDirty = false;
+    }
+    rebuildLayerStacks();
+    expectSameVisibility();
+}
+
+TEST_F(OutputParallelVisibilityTest, matchesSequentialComputationWhenALayerMoves) {
+    rebuildLayerStacks();
+    clearDirtyRegions();
+
+    for (auto& layer : mLayers) {
+        layer.layerFEState.contentDirty = false;
+    }
+    mLayers[kLayerCount / 2].layerFEState.geomLayerTransform.set(60.f, 20.f);
+    rebuildLayerStacks();
+    expectSameVisibility();
+
+    // Hiding a layer changes the coverage of the layers below it.
+    clearDirtyRegions();
+    mLayers[kLayerCount - 2].layerFEState.isVisible = false;
+    rebuildLayerStacks();
+    expectSameVisibility();
+}
+
+TEST_F(OutputParallelVisibilityTest, matchesSequentialComputationWhenTheOutputRotates) {
+    rebuildLayerStacks();
+    clearDirtyRegions();
+
+    for (auto* output : {mSequentialOutput.get(), mParallelOutput.get()}) {
+        output->editState().transform = ui::Transform(TR_ROT_90, 200, 300);
+    }
+    rebuildLayerStacks();
+    expectSameVisibility();
+}
+
 /*
  * Output::present()
  */
@@ -3108,6 +3248,16 @@ TEST_F(OutputFinishFrameTest, predictionSucceeded) {
     mOutput.finishFrame(std::move(result));
 }
 
+TEST_F(OutputFinishFrameTest, predictionSucceededWithBufferQueued) {
+    mOutput.mState.isEnabled = true;
+    mOutput.mState.strategyPrediction = CompositionStrategyPredictionState::SUCCESS;
+    EXPECT_CALL(*mRenderSurface, queueBuffer(_)).Times(0);
+
+    impl::GpuCompositionResult result;
+    result.bufferQueued = true;
+    mOutput.finishFrame(std::move(result));
+}
+
 TEST_F(OutputFinishFrameTest, predictionFailedAndBufferIsReused) {
     mOutput.mState.isEnabled = true;
     mOutput.mState.strategyPrediction = CompositionStrategyPredictionState::FAIL;
@@ -479,6 +479,93 @@ TEST_F(CachedSetTest, renderWhitePoint) {
     cachedSet.append(CachedSet(layer3));
 }
 
+TEST_F(CachedSetTest, renderIntoTextureFittingBounds) {
+    // Skip the 0th layer to ensure that the bounding box of the layers is offset from (0, 0)
+    CachedSet::Layer& layer1 = *mTestLayers[1]->cachedSetLayer.get();
+    sp<mock::LayerFE> layerFE1 = mTestLayers[1]->layerFE;
+    CachedSet::Layer& layer2 = *mTestLayers[2]->cachedSetLayer.get();
+    sp<mock::LayerFE> layerFE2 = mTestLayers[2]->layerFE;
+
+    CachedSet cachedSet(layer1);
+    cachedSet.append(CachedSet(layer2));
+
+    const ui::Size displaySize(10, 10);
+    TexturePool texturePool(mRenderEngine,
+                            TexturePool::Tunables{
+                                    .fitCachedSetBounds = true,
+                                    .bucketGranularity = 1,
+                                    .budgetBytes = 0,
+                            });
+    texturePool.setDisplaySize(displaySize);
+    mOutputState.framebufferSpace.setBounds(displaySize);
+    mOutputState.framebufferSpace.setContent(Rect(displaySize));
+    mOutputState.displaySpace.setBounds(displaySize);
+
+    const auto drawLayers = [&](const renderengine::DisplaySettings& displaySettings,
+                                const std::vector<renderengine::LayerSettings>&,
+                                const std::shared_ptr<renderengine::ExternalTexture>& texture,
+                                const bool, base::unique_fd&&) -> ftl::Future<FenceResult> {
+        // The content is shifted so that the bounds of the set start at the texture's origin
+        EXPECT_EQ(Rect(-1, -1, 9, 9), displaySettings.physicalDisplay);
+        EXPECT_EQ(2u, texture->getBuffer()->getWidth());
+        EXPECT_EQ(2u, texture->getBuffer()->getHeight());
+        return ftl::yield<FenceResult>(Fence::NO_FENCE);
+    };
+
+    EXPECT_CALL(*layerFE1, prepareClientComposition(_))
+            .WillOnce(Return(std::make_optional<compositionengine::LayerFE::LayerSettings>()));
+    EXPECT_CALL(*layerFE2, prepareClientComposition(_))
+            .WillOnce(Return(std::make_optional<compositionengine::LayerFE::LayerSettings>()));
+    EXPECT_CALL(mRenderEngine, drawLayers(_, _, _, _, _)).WillOnce(Invoke(drawLayers));
+    cachedSet.render(mRenderEngine, texturePool, mOutputState, true);
+    expectReadyBuffer(cachedSet);
+
+    EXPECT_EQ(Rect(1, 1, 3, 3), cachedSet.getTextureBounds());
+}
+
+TEST_F(CachedSetTest, renderIntoScreenSizedTextureIfFramebufferIsRotated) {
+    CachedSet::Layer& layer1 = *mTestLayers[1]->cachedSetLayer.get();
+    sp<mock::LayerFE> layerFE1 = mTestLayers[1]->layerFE;
+    CachedSet::Layer& layer2 = *mTestLayers[2]->cachedSetLayer.get();
+    sp<mock::LayerFE> layerFE2 = mTestLayers[2]->layerFE;
+
+    CachedSet cachedSet(layer1);
+    cachedSet.append(CachedSet(layer2));
+
+    // A square display installed rotated has the same bounds in both spaces.
+    const ui::Size displaySize(10, 10);
+    TexturePool texturePool(mRenderEngine,
+                            TexturePool::Tunables{
+                                    .fitCachedSetBounds = true,
+                                    .bucketGranularity = 1,
+                                    .budgetBytes = 0,
+                            });
+    texturePool.setDisplaySize(displaySize);
+    mOutputState.framebufferSpace.setBounds(displaySize);
+    mOutputState.framebufferSpace.setContent(Rect(displaySize));
+    mOutputState.framebufferSpace.setOrientation(ui::ROTATION_90);
+    mOutputState.displaySpace.setBounds(displaySize);
+    mOutputState.displaySpace.setOrientation(ui::ROTATION_0);
+
+    const auto drawLayers = [&](const renderengine::DisplaySettings& displaySettings,
+                                const std::vector<renderengine::LayerSettings>&,
+                                const std::shared_ptr<renderengine::ExternalTexture>& texture,
+                                const bool, base::unique_fd&&) -> ftl::Future<FenceResult> {
+        EXPECT_EQ(Rect(displaySize), displaySettings.physicalDisplay);
+        EXPECT_EQ(10u, texture->getBuffer()->getWidth());
+        EXPECT_EQ(10u, texture->getBuffer()->getHeight());
+        return ftl::yield<FenceResult>(Fence::NO_FENCE);
+    };
+
+    EXPECT_CALL(*layerFE1, prepareClientComposition(_))
+            .WillOnce(Return(std::make_optional<compositionengine::LayerFE::LayerSettings>()));
+    EXPECT_CALL(*layerFE2, prepareClientComposition(_))
+            .WillOnce(Return(std::make_optional<compositionengine::LayerFE::LayerSettings>()));
+    EXPECT_CALL(mRenderEngine, drawLayers(_, _, _, _, _)).WillOnce(Invoke(drawLayers));
+    cachedSet.render(mRenderEngine, texturePool, mOutputState, true);
+    expectReadyBuffer(cachedSet);
+}
+
 TEST_F(CachedSetTest, renderWhitePointNoColorTransform) {
     // Skip the 0th layer to ensure that the bounding box of the layers is offset from (0, 0)
     // This is a duplicate of the "renderWhitePoint" test, but setting "deviceHandlesColorTransform"
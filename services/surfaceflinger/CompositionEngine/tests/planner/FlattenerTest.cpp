@@ -69,6 +69,9 @@ protected:
     void initializeOverrideBuffer(const std::vector<const LayerState*>& layers);
     void initializeFlattener(const std::vector<const LayerState*>& layers);
     void expectAllLayersFlattened(const std::vector<const LayerState*>& layers);
+    // Replays frames at a 60Hz cadence. If set, updatingLayer posts a buffer on every frame.
+    void replayFrames(const std::vector<const LayerState*>& layers, size_t frameCount,
+                      LayerState* updatingLayer = nullptr);
 
     // mRenderEngine is held as a reference in mFlattener, so explicitly destroy mFlattener first.
     renderengine::mock::RenderEngine mRenderEngine;
@@ -193,6 +196,19 @@ void FlattenerTest::expectAllLayersFlattened(const std::vector<const LayerState*
     }
 }
 
+void FlattenerTest::replayFrames(const std::vector<const LayerState*>& layers, size_t frameCount,
+                                 LayerState* updatingLayer) {
+    for (size_t i = 0; i < frameCount; i++) {
+        mTime += 16ms;
+        if (updatingLayer) {
+            updatingLayer->resetFramesSinceBufferUpdate();
+        }
+        initializeOverrideBuffer(layers);
+        mFlattener->flattenLayers(layers, getNonBufferHash(layers), mTime);
+        mFlattener->renderCachedSets(mOutputState, std::nullopt, true);
+    }
+}
+
 TEST_F(FlattenerTest, flattenLayers_NewLayerStack) {
     auto& layerState1 = mTestLayers[0]->layerState;
     auto& layerState2 = mTestLayers[1]->layerState;
@@ -1416,5 +1432,195 @@ TEST_F(FlattenerTest, flattenLayers_includes_DISPLAY_DECORATION) {
     EXPECT_EQ(overrideBuffer1, overrideBuffer3);
 }
 
+TEST_F(FlattenerTest, flattenLayers_choosesFirstRunWithoutCostModel) {
+    mFlattener->setDisplaySize({100, 100});
+
+    // Flattening layers 4 and 5 would save more on each frame, but without the cost model the
+    // first run is flattened first.
+    for (size_t i = 3; i < 5; i++) {
+        mTestLayers[i]->outputLayerCompositionState.displayFrame = Rect(0, 0, 100, 100);
+        mTestLayers[i]->layerState->update(&mTestLayers[i]->outputLayer);
+    }
+
+    std::vector<const LayerState*> layers;
+    for (const auto& testLayer : mTestLayers) {
+        layers.push_back(testLayer->layerState.get());
+    }
+    const auto& overrideBuffer1 = layers[0]->getOutputLayer()->getState().overrideInfo.buffer;
+    const auto& overrideBuffer2 = layers[1]->getOutputLayer()->getState().overrideInfo.buffer;
+    const auto& overrideBuffer3 = layers[2]->getOutputLayer()->getState().overrideInfo.buffer;
+    const auto& overrideBuffer4 = layers[3]->getOutputLayer()->getState().overrideInfo.buffer;
+    const auto& overrideBuffer5 = layers[4]->getOutputLayer()->getState().overrideInfo.buffer;
+
+    initializeFlattener(layers);
+
+    EXPECT_CALL(mRenderEngine, drawLayers(_, _, _, _, _))
+            .Times(2)
+            .WillRepeatedly(
+                    [](const auto&...) { return ftl::yield<FenceResult>(Fence::NO_FENCE); });
+    size_t frameCount = 0;
+    while (!overrideBuffer1 && frameCount++ < 20) {
+        replayFrames(layers, 1, mTestLayers[2]->layerState.get());
+    }
+    EXPECT_NE(nullptr, overrideBuffer1);
+    EXPECT_EQ(overrideBuffer1, overrideBuffer2);
+    EXPECT_EQ(nullptr, overrideBuffer4);
+
+    replayFrames(layers, 2, mTestLayers[2]->layerState.get());
+    EXPECT_NE(nullptr, overrideBuffer4);
+    EXPECT_EQ(overrideBuffer4, overrideBuffer5);
+    EXPECT_EQ(nullptr, overrideBuffer3);
+    EXPECT_NE(overrideBuffer1, overrideBuffer4);
+
+    std::string dump;
+    mFlattener->dump(dump);
+    EXPECT_NE(std::string::npos, dump.find("Chosen runs: 2 (0 not the first candidate)")) << dump;
+}
+
+class FlattenerCostModelTest : public FlattenerTest {
+public:
+    FlattenerCostModelTest()
+          : FlattenerTest(Flattener::Tunables{.mActiveLayerTimeout = 100ms,
+                                              .mRenderScheduling = std::nullopt,
+                                              .mEnableHolePunch = true,
+                                              .mCostModel = {.enabled = true}}) {}
+};
+
+TEST_F(FlattenerCostModelTest, flattenLayers_choosesMostBeneficialRunFirst) {
+    mFlattener->setDisplaySize({100, 100});
+
+    // Layers 1 and 2 are small, while layers 4 and 5 are large and overlap, so flattening them
+    // saves more on each frame.
+    for (size_t i = 3; i < 5; i++) {
+        mTestLayers[i]->outputLayerCompositionState.displayFrame = Rect(0, 0, 100, 100);
+        mTestLayers[i]->layerState->update(&mTestLayers[i]->outputLayer);
+    }
+
+    std::vector<const LayerState*> layers;
+    for (const auto& testLayer : mTestLayers) {
+        layers.push_back(testLayer->layerState.get());
+    }
+    const auto& overrideBuffer1 = layers[0]->getOutputLayer()->getState().overrideInfo.buffer;
+    const auto& overrideBuffer2 = layers[1]->getOutputLayer()->getState().overrideInfo.buffer;
+    const auto& overrideBuffer3 = layers[2]->getOutputLayer()->getState().overrideInfo.buffer;
+    const auto& overrideBuffer4 = layers[3]->getOutputLayer()->getState().overrideInfo.buffer;
+    const auto& overrideBuffer5 = layers[4]->getOutputLayer()->getState().overrideInfo.buffer;
+
+    initializeFlattener(layers);
+
+    // Layer 3 keeps updating, so layers 1 and 2, and layers 4 and 5, are separate runs once the
+    // other layers become inactive.
+    EXPECT_CALL(mRenderEngine, drawLayers(_, _, _, _, _))
+            .Times(2)
+            .WillRepeatedly(
+                    [](const auto&...) { return ftl::yield<FenceResult>(Fence::NO_FENCE); });
+    size_t frameCount = 0;
+    while (!overrideBuffer4 && frameCount++ < 20) {
+        replayFrames(layers, 1, mTestLayers[2]->layerState.get());
+    }
+    EXPECT_NE(nullptr, overrideBuffer4);
+    EXPECT_EQ(overrideBuffer4, overrideBuffer5);
+    EXPECT_EQ(nullptr, overrideBuffer1);
+
+    replayFrames(layers, 2, mTestLayers[2]->layerState.get());
+    EXPECT_NE(nullptr, overrideBuffer1);
+    EXPECT_EQ(overrideBuffer1, overrideBuffer2);
+    EXPECT_EQ(nullptr, overrideBuffer3);
+    EXPECT_NE(overrideBuffer1, overrideBuffer4);
+
+    std::string dump;
+    mFlattener->dump(dump);
+    EXPECT_NE(std::string::npos, dump.find("Chosen runs: 2 (1 not the first candidate)")) << dump;
+}
+
+// The default model is not enabled, and a plugged in model is used regardless.
+TEST_F(FlattenerTest, flattenLayers_usesPluggedInCostModel) {
+    // Prefers the runs starting higher in the layer stack.
+    class TopmostRunCostModel : public impl::planner::CostModel {
+    public:
+        TopmostRunCostModel() : CostModel(Tunables{}) {}
+
+        RunEstimate estimateRun(std::vector<CachedSet>::const_iterator start, size_t,
+                                const CachedSet*, ui::Size,
+                                std::chrono::steady_clock::time_point) const override {
+            const int32_t firstLayerId = start->getFirstLayer().getState()->getId();
+            return RunEstimate{
+                    .savedCostPerFrame = static_cast<float>(firstLayerId),
+                    .expectedFrames = 1.f,
+            };
+        }
+    };
+    mFlattener->setCostModel(std::make_unique<TopmostRunCostModel>());
+
+    std::vector<const LayerState*> layers;
+    for (const auto& testLayer : mTestLayers) {
+        layers.push_back(testLayer->layerState.get());
+    }
+    const auto& overrideBuffer1 = layers[0]->getOutputLayer()->getState().overrideInfo.buffer;
+    const auto& overrideBuffer4 = layers[3]->getOutputLayer()->getState().overrideInfo.buffer;
+    const auto& overrideBuffer5 = layers[4]->getOutputLayer()->getState().overrideInfo.buffer;
+
+    initializeFlattener(layers);
+
+    EXPECT_CALL(mRenderEngine, drawLayers(_, _, _, _, _))
+            .WillRepeatedly(
+                    [](const auto&...) { return ftl::yield<FenceResult>(Fence::NO_FENCE); });
+    size_t frameCount = 0;
+    while (!overrideBuffer4 && frameCount++ < 20) {
+        replayFrames(layers, 1, mTestLayers[2]->layerState.get());
+    }
+    EXPECT_NE(nullptr, overrideBuffer4);
+    EXPECT_EQ(overrideBuffer4, overrideBuffer5);
+    EXPECT_EQ(nullptr, overrideBuffer1);
+}
+
+class FlattenerSkipUnprofitableRunsTest : public FlattenerTest {
+public:
+    FlattenerSkipUnprofitableRunsTest()
+          : FlattenerTest(Flattener::Tunables{.mActiveLayerTimeout = 100ms,
+                                              .mRenderScheduling = std::nullopt,
+                                              .mEnableHolePunch = true,
+                                              .mCostModel = {.enabled = true,
+                                                             .skipUnprofitableRuns = true}}) {}
+};
+
+TEST_F(FlattenerSkipUnprofitableRunsTest, flattenLayers_skipsUnprofitableRuns) {
+    // The layers are small and far apart, so presenting them flattened would read more pixels than
+    // presenting them separately.
+    const std::vector<const LayerState*> layers = {
+            mTestLayers[0]->layerState.get(),
+            mTestLayers[1]->layerState.get(),
+    };
+
+    initializeFlattener(layers);
+
+    EXPECT_CALL(mRenderEngine, drawLayers(_, _, _, _, _)).Times(0);
+    replayFrames(layers, 20);
+    for (const auto layer : layers) {
+        EXPECT_EQ(nullptr, layer->getOutputLayer()->getState().overrideInfo.buffer);
+    }
+
+    std::string dump;
+    mFlattener->dump(dump);
+    EXPECT_NE(std::string::npos, dump.find("Chosen runs: 0")) << dump;
+}
+
+TEST_F(FlattenerSkipUnprofitableRunsTest, flattenLayers_flattensProfitableRuns) {
+    // The layers overlap, so presenting them flattened reads fewer pixels on each frame.
+    mTestLayers[1]->outputLayerCompositionState.displayFrame =
+            mTestLayers[0]->outputLayerCompositionState.displayFrame;
+    mTestLayers[1]->layerState->update(&mTestLayers[1]->outputLayer);
+
+    const std::vector<const LayerState*> layers = {
+            mTestLayers[0]->layerState.get(),
+            mTestLayers[1]->layerState.get(),
+    };
+
+    initializeFlattener(layers);
+
+    mTime += 200ms;
+    expectAllLayersFlattened(layers);
+}
+
 } // namespace
 } // namespace android::compositionengine
@@ -0,0 +1,178 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "PlanCacheTest"
+
+#include <android-base/file.h>
+#include <compositionengine/impl/planner/PlanCache.h>
+#include <gtest/gtest.h>
+
+#include <aidl/android/hardware/graphics/composer3/Composition.h>
+
+using aidl::android::hardware::graphics::composer3::Composition;
+
+namespace android::compositionengine::impl::planner {
+namespace {
+
+const std::string sBuildFingerprint = "test/build:1";
+
+Plan makePlan(std::initializer_list<Composition> types) {
+    Plan plan;
+    for (Composition type : types) {
+        plan.addLayerType(type);
+    }
+    return plan;
+}
+
+const Plan sDevicePlan = makePlan({Composition::DEVICE, Composition::DEVICE});
+const Plan sClientPlan = makePlan({Composition::CLIENT, Composition::DEVICE});
+
+class PlanCacheTest : public testing::Test {
+protected:
+    std::string cachePath() const { return std::string(mDir.path) + "/plan_cache"; }
+
+    TemporaryDir mDir;
+};
+
+TEST_F(PlanCacheTest, getPlan_returnsRecordedPlan) {
+    PlanCache cache(PlanCache::kDefaultCapacity, "", sBuildFingerprint);
+    EXPECT_FALSE(cache.getPlan(1));
+
+    cache.recordPlan(1, sDevicePlan);
+    EXPECT_EQ(sDevicePlan, cache.getPlan(1));
+    EXPECT_FALSE(cache.getPlan(2));
+
+    cache.recordPlan(1, sClientPlan);
+    EXPECT_EQ(sClientPlan, cache.getPlan(1));
+    EXPECT_EQ(1u, cache.size());
+}
+
+TEST_F(PlanCacheTest, recordMisprediction_dropsEntry) {
+    PlanCache cache(PlanCache::kDefaultCapacity, "", sBuildFingerprint);
+    cache.recordPlan(1, sDevicePlan);
+    cache.recordMisprediction(1);
+    EXPECT_FALSE(cache.getPlan(1));
+    EXPECT_EQ(0u, cache.size());
+}
+
+TEST_F(PlanCacheTest, evictsLeastFrequentlyUsed) {
+    PlanCache cache(2, "", sBuildFingerprint);
+    cache.recordPlan(1, sDevicePlan);
+    cache.recordPlan(1, sDevicePlan);
+    cache.recordPlan(2, sDevicePlan);
+    cache.recordPlan(3, sDevicePlan);
+
+    EXPECT_TRUE(cache.getPlan(1));
+    EXPECT_FALSE(cache.getPlan(2));
+    EXPECT_TRUE(cache.getPlan(3));
+}
+
+TEST_F(PlanCacheTest, evictsLeastRecentlyUsedAmongEquallyFrequent) {
+    PlanCache cache(2, "", sBuildFingerprint);
+    cache.recordPlan(1, sDevicePlan);
+    cache.recordPlan(2, sDevicePlan);
+    cache.recordPlan(3, sDevicePlan);
+
+    EXPECT_FALSE(cache.getPlan(1));
+    EXPECT_TRUE(cache.getPlan(2));
+    EXPECT_TRUE(cache.getPlan(3));
+}
+
+TEST_F(PlanCacheTest, recordUse_countsTowardsEviction) {
+    PlanCache cache(2, "", sBuildFingerprint);
+    cache.recordPlan(1, sDevicePlan);
+    cache.recordPlan(2, sDevicePlan);
+    cache.recordUse(1);
+    cache.recordUse(1);
+    // Uses of stacks which are not cached are ignored.
+    cache.recordUse(3);
+    cache.recordPlan(3, sDevicePlan);
+
+    EXPECT_TRUE(cache.getPlan(1));
+    EXPECT_FALSE(cache.getPlan(2));
+    EXPECT_TRUE(cache.getPlan(3));
+}
+
+TEST_F(PlanCacheTest, agingLetsNewStacksReplaceOldFrequentOnes) {
+    PlanCache cache(2, "", sBuildFingerprint);
+    for (int i = 0; i < 40; i++) {
+        cache.recordPlan(1, sDevicePlan);
+    }
+    // Stack 2 is used less often than stack 1 overall, but its uses are more recent, and the use
+    // count of stack 1 is halved since.
+    for (int i = 0; i < 20; i++) {
+        cache.recordPlan(2, sDevicePlan);
+    }
+    cache.recordPlan(3, sDevicePlan);
+
+    EXPECT_FALSE(cache.getPlan(1));
+    EXPECT_TRUE(cache.getPlan(2));
+    EXPECT_TRUE(cache.getPlan(3));
+}
+
+TEST_F(PlanCacheTest, persistsAcrossInstances) {
+    {
+        PlanCache cache(PlanCache::kDefaultCapacity, cachePath(), sBuildFingerprint);
+        cache.recordPlan(0, sClientPlan);
+        cache.recordPlan(0xfedcba9876543210, sDevicePlan);
+    }
+
+    PlanCache cache(PlanCache::kDefaultCapacity, cachePath(), sBuildFingerprint);
+    EXPECT_EQ(2u, cache.size());
+    EXPECT_EQ(sClientPlan, cache.getPlan(0));
+    EXPECT_EQ(sDevicePlan, cache.getPlan(0xfedcba9876543210));
+}
+
+TEST_F(PlanCacheTest, loadKeepsMostRecentlyUsedEntries) {
+    {
+        PlanCache cache(PlanCache::kDefaultCapacity, cachePath(), sBuildFingerprint);
+        cache.recordPlan(1, sDevicePlan);
+        cache.recordPlan(2, sDevicePlan);
+        cache.recordPlan(3, sDevicePlan);
+        cache.recordPlan(1, sDevicePlan);
+    }
+
+    PlanCache cache(2, cachePath(), sBuildFingerprint);
+    EXPECT_EQ(2u, cache.size());
+    EXPECT_TRUE(cache.getPlan(1));
+    EXPECT_TRUE(cache.getPlan(3));
+}
+
+TEST_F(PlanCacheTest, discardsCacheOfAnotherBuild) {
+    {
+        PlanCache cache(PlanCache::kDefaultCapacity, cachePath(), sBuildFingerprint);
+        cache.recordPlan(1, sDevicePlan);
+    }
+
+    PlanCache cache(PlanCache::kDefaultCapacity, cachePath(), "test/build:2");
+    EXPECT_EQ(0u, cache.size());
+    EXPECT_FALSE(cache.getPlan(1));
+}
+
+TEST_F(PlanCacheTest, skipsMalformedEntries) {
+    ASSERT_TRUE(base::WriteStringToFile("PlanCache v1 " + sBuildFingerprint +
+                                                "\n0x1 DD 3\n0x2 XX 1\nnot an entry\n0x3 CD 1",
+                                        cachePath()));
+
+    PlanCache cache(PlanCache::kDefaultCapacity, cachePath(), sBuildFingerprint);
+    EXPECT_EQ(2u, cache.size());
+    EXPECT_EQ(sDevicePlan, cache.getPlan(1));
+    EXPECT_EQ(sClientPlan, cache.getPlan(3));
+}
+
+} // namespace
+} // namespace android::compositionengine::impl::planner
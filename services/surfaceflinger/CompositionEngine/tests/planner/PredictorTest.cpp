@@ -18,6 +18,7 @@
 #undef LOG_TAG
 #define LOG_TAG "PredictorTest"
 
+#include <compositionengine/impl/planner/PlanCache.h>
 #include <compositionengine/impl/planner/Predictor.h>
 #include <compositionengine/mock/LayerFE.h>
 #include <compositionengine/mock/OutputLayer.h>
@@ -550,5 +551,73 @@ TEST_F(PredictorTest, recordMissedPlan_skipsApproximateMatch) {
     EXPECT_FALSE(predictedPlanTwo);
 }
 
+TEST_F(PredictorTest, getPredictedPlan_confirmedPlanIsPredictedByAnotherPredictor) {
+    mock::OutputLayer outputLayerOne;
+    sp<mock::LayerFE> layerFEOne = sp<mock::LayerFE>::make();
+    OutputLayerCompositionState outputLayerCompositionStateOne;
+    LayerFECompositionState layerFECompositionStateOne;
+    layerFECompositionStateOne.compositionType = Composition::DEVICE;
+    setupMocksForLayer(outputLayerOne, *layerFEOne, outputLayerCompositionStateOne,
+                       layerFECompositionStateOne);
+    LayerState layerStateOne(&outputLayerOne);
+
+    Plan plan;
+    plan.addLayerType(Composition::DEVICE);
+
+    auto planCache = std::make_shared<PlanCache>(PlanCache::kDefaultCapacity, "", "test");
+    NonBufferHash hash = getNonBufferHash({&layerStateOne});
+
+    // The plan is only cached once a prediction for it was confirmed.
+    Predictor predictor;
+    predictor.setPlanCache(planCache);
+    predictor.recordResult(std::nullopt, hash, {&layerStateOne}, false, plan);
+    EXPECT_EQ(0u, planCache->size());
+    auto predictedPlan = predictor.getPredictedPlan({&layerStateOne}, hash);
+    predictor.recordResult(predictedPlan, hash, {&layerStateOne}, false, plan);
+    EXPECT_EQ(1u, planCache->size());
+
+    // A new predictor, e.g. after a restart, predicts the plan on the first frame.
+    Predictor predictorTwo;
+    predictorTwo.setPlanCache(planCache);
+    auto predictedPlanTwo = predictorTwo.getPredictedPlan({&layerStateOne}, hash);
+    Predictor::PredictedPlan expectedPlan{hash, plan, Prediction::Type::Exact};
+    EXPECT_EQ(expectedPlan, predictedPlanTwo);
+
+    // Once confirmed, the stack is known to the new predictor.
+    predictorTwo.recordResult(predictedPlanTwo, hash, {&layerStateOne}, false, plan);
+    EXPECT_EQ(expectedPlan, predictorTwo.getPredictedPlan({}, hash));
+}
+
+TEST_F(PredictorTest, recordResult_cachedPlanMissDropsCachedPlan) {
+    mock::OutputLayer outputLayerOne;
+    sp<mock::LayerFE> layerFEOne = sp<mock::LayerFE>::make();
+    OutputLayerCompositionState outputLayerCompositionStateOne;
+    LayerFECompositionState layerFECompositionStateOne;
+    layerFECompositionStateOne.compositionType = Composition::DEVICE;
+    setupMocksForLayer(outputLayerOne, *layerFEOne, outputLayerCompositionStateOne,
+                       layerFECompositionStateOne);
+    LayerState layerStateOne(&outputLayerOne);
+
+    Plan plan;
+    plan.addLayerType(Composition::DEVICE);
+    Plan planTwo;
+    planTwo.addLayerType(Composition::CLIENT);
+
+    auto planCache = std::make_shared<PlanCache>(PlanCache::kDefaultCapacity, "", "test");
+    NonBufferHash hash = getNonBufferHash({&layerStateOne});
+    planCache->recordPlan(hash, plan);
+
+    Predictor predictor;
+    predictor.setPlanCache(planCache);
+    auto predictedPlan = predictor.getPredictedPlan({&layerStateOne}, hash);
+    ASSERT_TRUE(predictedPlan);
+    predictor.recordResult(predictedPlan, hash, {&layerStateOne}, false, planTwo);
+    EXPECT_EQ(0u, planCache->size());
+
+    // The stack is learned again from the actual plan.
+    Predictor::PredictedPlan expectedPlan{hash, planTwo, Prediction::Type::Exact};
+    EXPECT_EQ(expectedPlan, predictor.getPredictedPlan({}, hash));
+}
+
 } // namespace
 } // namespace android::compositionengine::impl::planner
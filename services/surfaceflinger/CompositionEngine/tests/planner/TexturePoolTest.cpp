@@ -30,13 +30,21 @@ const ui::Size kDisplaySizeTwo(2, 2);
 
 class TestableTexturePool : public TexturePool {
 public:
-    TestableTexturePool(renderengine::RenderEngine& renderEngine) : TexturePool(renderEngine) {}
+    TestableTexturePool(renderengine::RenderEngine& renderEngine,
+                        const Tunables& tunables = kDefaultTunables)
+          : TexturePool(renderEngine, tunables) {}
 
     size_t getMinPoolSize() const { return kMinPoolSize; }
     size_t getMaxPoolSize() const { return kMaxPoolSize; }
     size_t getPoolSize() const { return mPool.size(); }
+    size_t getPoolBytes() const { return TexturePool::getPoolBytes(); }
 };
 
+ui::Size getSize(const std::shared_ptr<TexturePool::AutoTexture>& texture) {
+    return ui::Size(static_cast<int32_t>(texture->get()->getBuffer()->getWidth()),
+                    static_cast<int32_t>(texture->get()->getBuffer()->getHeight()));
+}
+
 struct TexturePoolTest : public testing::Test {
     TexturePoolTest() {
         const ::testing::TestInfo* const test_info =
@@ -170,5 +178,106 @@ TEST_F(TexturePoolTest, reallocatesWhenReEnabled) {
     EXPECT_EQ(mTexturePool.getPoolSize(), mTexturePool.getMinPoolSize());
 }
 
+TEST_F(TexturePoolTest, countsAllocationStalls) {
+    std::vector<std::shared_ptr<TexturePool::AutoTexture>> textures;
+    for (size_t i = 0; i < mTexturePool.getMinPoolSize() + 2; i++) {
+        textures.emplace_back(mTexturePool.borrowTexture());
+    }
+
+    std::string dump;
+    mTexturePool.dump(dump);
+    EXPECT_NE(std::string::npos, dump.find("(2 allocation stalls)")) << dump;
+}
+
+const ui::Size kLargeDisplaySize(300, 200);
+constexpr size_t kBucketBytes = 64 * 64 * 4;
+
+class TexturePoolFitBoundsTest : public testing::Test {
+protected:
+    TexturePoolFitBoundsTest() {
+        mTexturePool.setEnabled(true);
+        mTexturePool.setDisplaySize(kLargeDisplaySize);
+    }
+
+    renderengine::mock::RenderEngine mRenderEngine;
+    TestableTexturePool mTexturePool =
+            TestableTexturePool(mRenderEngine,
+                                TexturePool::Tunables{
+                                        .fitCachedSetBounds = true,
+                                        .bucketGranularity = 64,
+                                        .budgetBytes = 3 * kBucketBytes,
+                                });
+};
+
+TEST_F(TexturePoolFitBoundsTest, doesNotPreallocate) {
+    EXPECT_EQ(0u, mTexturePool.getPoolSize());
+}
+
+TEST_F(TexturePoolFitBoundsTest, roundsUpToBucketsWithinDisplay) {
+    EXPECT_EQ(ui::Size(64, 64), getSize(mTexturePool.borrowTexture(ui::Size(1, 64))));
+    EXPECT_EQ(ui::Size(128, 192), getSize(mTexturePool.borrowTexture(ui::Size(65, 130))));
+    EXPECT_EQ(ui::Size(300, 200), getSize(mTexturePool.borrowTexture(ui::Size(290, 195))));
+    EXPECT_EQ(kLargeDisplaySize, getSize(mTexturePool.borrowTexture()));
+}
+
+TEST_F(TexturePoolFitBoundsTest, reusesTexturesOfTheSameBucket) {
+    uint64_t bufferId;
+    {
+        auto texture = mTexturePool.borrowTexture(ui::Size(10, 10));
+        bufferId = texture->get()->getBuffer()->getId();
+    }
+    EXPECT_EQ(1u, mTexturePool.getPoolSize());
+
+    // A texture of another bucket is not handed out
+    auto largeTexture = mTexturePool.borrowTexture(ui::Size(100, 10));
+    EXPECT_NE(bufferId, largeTexture->get()->getBuffer()->getId());
+    EXPECT_EQ(1u, mTexturePool.getPoolSize());
+
+    auto texture = mTexturePool.borrowTexture(ui::Size(60, 20));
+    EXPECT_EQ(bufferId, texture->get()->getBuffer()->getId());
+    EXPECT_EQ(0u, mTexturePool.getPoolSize());
+}
+
+TEST_F(TexturePoolFitBoundsTest, trimsLeastRecentlyReturnedTexturesToBudget) {
+    std::deque<std::shared_ptr<TexturePool::AutoTexture>> textures;
+    std::vector<uint64_t> bufferIds;
+    for (size_t i = 0; i < 4; i++) {
+        textures.emplace_back(mTexturePool.borrowTexture(ui::Size(64, 64)));
+        bufferIds.push_back(textures.back()->get()->getBuffer()->getId());
+    }
+
+    while (!textures.empty()) {
+        textures.pop_front();
+    }
+    EXPECT_EQ(3u, mTexturePool.getPoolSize());
+    EXPECT_EQ(3 * kBucketBytes, mTexturePool.getPoolBytes());
+
+    // The first texture returned was freed
+    for (size_t i = 1; i < 4; i++) {
+        auto texture = mTexturePool.borrowTexture(ui::Size(64, 64));
+        EXPECT_EQ(bufferIds[i], texture->get()->getBuffer()->getId());
+    }
+}
+
+TEST_F(TexturePoolFitBoundsTest, trimsSmallTexturesForLargeOnes) {
+    std::deque<std::shared_ptr<TexturePool::AutoTexture>> textures;
+    for (size_t i = 0; i < 3; i++) {
+        textures.emplace_back(mTexturePool.borrowTexture(ui::Size(64, 64)));
+    }
+    textures.clear();
+    EXPECT_EQ(3u, mTexturePool.getPoolSize());
+
+    mTexturePool.borrowTexture(ui::Size(64, 128));
+    EXPECT_EQ(2u, mTexturePool.getPoolSize());
+    EXPECT_EQ(3 * kBucketBytes, mTexturePool.getPoolBytes());
+}
+
+TEST_F(TexturePoolFitBoundsTest, dropsTexturesLargerThanDisplay) {
+    auto texture = mTexturePool.borrowTexture(ui::Size(300, 200));
+    mTexturePool.setDisplaySize(ui::Size(200, 200));
+    texture.reset();
+    EXPECT_EQ(0u, mTexturePool.getPoolSize());
+}
+
 } // namespace
 } // namespace android::compositionengine::impl::planner
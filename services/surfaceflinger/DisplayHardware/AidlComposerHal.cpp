@@ -278,6 +278,8 @@ bool AidlComposer::isSupported(OptionalFeature feature) const {
         case OptionalFeature::KernelIdleTimer:
         case OptionalFeature::PhysicalDisplayOrientation:
             return true;
+        case OptionalFeature::MultiThreadedPresent:
+            return !mSingleReader;
     }
 }
 
@@ -21,6 +21,7 @@
 #include <ftl/shared_mutex.h>
 #include <ui/DisplayMap.h>
 
+#include <atomic>
 #include <functional>
 #include <optional>
 #include <string>
@@ -268,8 +269,8 @@ private:
 
     // Without DisplayCapability::MULTI_THREADED_PRESENT, we use a single reader
     // for all displays. With the capability, we use a separate reader for each
-    // display.
-    bool mSingleReader = true;
+    // display. Only changed with mMutex held, but read by isSupported without it.
+    std::atomic_bool mSingleReader = true;
     // Invalid displayId used as a key to mReaders when mSingleReader is true.
     static constexpr int64_t kSingleReaderKey = 0;
 
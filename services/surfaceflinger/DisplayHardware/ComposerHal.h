@@ -100,6 +100,9 @@ public:
         DisplayBrightnessCommand,
         KernelIdleTimer,
         PhysicalDisplayOrientation,
+        // Whether commands for different displays may be executed and read back concurrently,
+        // i.e. each display has its own reader.
+        MultiThreadedPresent,
     };
 
     virtual bool isSupported(OptionalFeature) const = 0;
@@ -50,7 +50,8 @@ using ui::Dataspace;
 
 FramebufferSurface::FramebufferSurface(HWComposer& hwc, PhysicalDisplayId displayId,
                                        const sp<IGraphicBufferConsumer>& consumer,
-                                       const ui::Size& size, const ui::Size& maxSize)
+                                       const ui::Size& size, const ui::Size& maxSize,
+                                       bool earlyClientTarget)
       : ConsumerBase(consumer),
         mDisplayId(displayId),
         mMaxSize(maxSize),
@@ -60,7 +61,9 @@ FramebufferSurface::FramebufferSurface(HWComposer& hwc, PhysicalDisplayId displa
         mHwc(hwc),
         mHasPendingRelease(false),
         mPreviousBufferSlot(BufferQueue::INVALID_BUFFER_SLOT),
-        mPreviousBuffer() {
+        mPreviousBuffer(),
+        mHasUncommittedBuffer(false),
+        mEarlyClientTarget(earlyClientTarget) {
     ALOGV("Creating for display %s", to_string(displayId).c_str());
 
     mName = "FramebufferSurface";
@@ -94,6 +97,14 @@ status_t FramebufferSurface::prepareFrame(CompositionType /*compositionType*/) {
 status_t FramebufferSurface::advanceFrame() {
     Mutex::Autolock lock(mMutex);
 
+    // With an early client target, the client target may be queued again before the frame is
+    // committed, if the composition strategy it was composed for changed. It will not be
+    // presented, so release it before acquiring the new one, rather than holding it along with
+    // the buffer pending release.
+    if (mEarlyClientTarget && mHasUncommittedBuffer) {
+        releaseUncommittedBufferLocked();
+    }
+
     BufferItem item;
     status_t err = acquireBufferLocked(&item, 0);
     if (err == BufferQueue::NO_BUFFER_AVAILABLE) {
@@ -130,6 +141,7 @@ status_t FramebufferSurface::advanceFrame() {
         mHwcBufferIds[mCurrentBufferSlot] = mCurrentBuffer->getId();
         hwcBuffer = mCurrentBuffer; // HWC hasn't previously seen this buffer in this slot
     }
+    mHasUncommittedBuffer = true;
     status_t result = mHwc.setClientTarget(mDisplayId, mCurrentBufferSlot, mCurrentFence, hwcBuffer,
                                            mDataspace);
     if (result != NO_ERROR) {
@@ -140,6 +152,33 @@ status_t FramebufferSurface::advanceFrame() {
     return NO_ERROR;
 }
 
+void FramebufferSurface::releaseUncommittedBufferLocked() {
+    // The buffer may still be rendered to, so it must not be reused before its acquire fence.
+    if (mCurrentFence->isValid()) {
+        status_t result = addReleaseFence(mCurrentBufferSlot, mCurrentBuffer, mCurrentFence);
+        ALOGE_IF(result != NO_ERROR,
+                 "releaseUncommittedBuffer: failed to add the fence: %s (%d)", strerror(-result),
+                 result);
+    }
+    status_t result = releaseBufferLocked(mCurrentBufferSlot, mCurrentBuffer);
+    ALOGE_IF(result != NO_ERROR, "releaseUncommittedBuffer: error releasing buffer: %s (%d)",
+             strerror(-result), result);
+
+    // The buffer pending release is the one the HWC presented last, so it is current again.
+    if (mHasPendingRelease) {
+        mCurrentBufferSlot = mPreviousBufferSlot;
+        mCurrentBuffer = mPreviousBuffer;
+        mPreviousBufferSlot = BufferQueue::INVALID_BUFFER_SLOT;
+        mPreviousBuffer.clear();
+        mHasPendingRelease = false;
+    } else {
+        mCurrentBufferSlot = BufferQueue::INVALID_BUFFER_SLOT;
+        mCurrentBuffer.clear();
+    }
+    mCurrentFence = Fence::NO_FENCE;
+    mHasUncommittedBuffer = false;
+}
+
 void FramebufferSurface::freeBufferLocked(int slotIndex) {
     ConsumerBase::freeBufferLocked(slotIndex);
     if (slotIndex == mCurrentBufferSlot) {
@@ -148,6 +187,7 @@ void FramebufferSurface::freeBufferLocked(int slotIndex) {
 }
 
 void FramebufferSurface::onFrameCommitted() {
+    mHasUncommittedBuffer = false;
     if (mHasPendingRelease) {
         sp<Fence> fence = mHwc.getPresentFence(mDisplayId);
         if (fence->isValid()) {
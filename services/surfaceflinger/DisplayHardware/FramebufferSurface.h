@@ -42,7 +42,7 @@ class FramebufferSurface : public ConsumerBase, public compositionengine::Displa
 public:
     FramebufferSurface(HWComposer& hwc, PhysicalDisplayId displayId,
                        const sp<IGraphicBufferConsumer>& consumer, const ui::Size& size,
-                       const ui::Size& maxSize);
+                       const ui::Size& maxSize, bool earlyClientTarget = false);
 
     virtual status_t beginFrame(bool mustRecompose);
     virtual status_t prepareFrame(CompositionType compositionType);
@@ -69,6 +69,10 @@ private:
 
     virtual void dumpLocked(String8& result, const char* prefix) const;
 
+    // Releases the current buffer, which was never presented, and makes the buffer pending
+    // release current again.
+    void releaseUncommittedBufferLocked();
+
     const PhysicalDisplayId mDisplayId;
 
     // Framebuffer size has a dimension limitation in pixels based on the graphics capabilities of
@@ -105,6 +109,14 @@ private:
     bool mHasPendingRelease;
     int mPreviousBufferSlot;
     sp<GraphicBuffer> mPreviousBuffer;
+
+    // True if the current buffer was set as the client target after the last frame was
+    // committed, i.e. it has not been presented yet.
+    bool mHasUncommittedBuffer;
+
+    // Whether the client target may be queued again before the frame is committed, see
+    // debug.sf.early_client_target. Uncommitted buffers are only released if so.
+    const bool mEarlyClientTarget;
 };
 
 // ---------------------------------------------------------------------------
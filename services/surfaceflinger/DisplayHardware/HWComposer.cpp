@@ -133,6 +133,11 @@ bool HWComposer::hasDisplayCapability(HalDisplayId displayId, DisplayCapability
     return mDisplayData.at(displayId).hwcDisplay->hasCapability(capability);
 }
 
+bool HWComposer::hasMultiThreadedPresentSupport(HalDisplayId displayId) const {
+    return mComposer->isSupported(Hwc2::Composer::OptionalFeature::MultiThreadedPresent) &&
+            hasDisplayCapability(displayId, DisplayCapability::MULTI_THREADED_PRESENT);
+}
+
 std::optional<DisplayIdentificationInfo> HWComposer::onHotplug(hal::HWDisplayId hwcDisplayId,
                                                                hal::Connection connection) {
     switch (connection) {
@@ -121,6 +121,10 @@ public:
     virtual bool hasDisplayCapability(
             HalDisplayId,
             aidl::android::hardware::graphics::composer3::DisplayCapability) const = 0;
+    // Whether the display may be presented concurrently with other displays. Requires the
+    // display to report DisplayCapability::MULTI_THREADED_PRESENT, and the composer to read
+    // back its results separately from other displays, so this is never true for HIDL.
+    virtual bool hasMultiThreadedPresentSupport(HalDisplayId) const = 0;
 
     virtual size_t getMaxVirtualDisplayCount() const = 0;
     virtual size_t getMaxVirtualDisplayDimension() const = 0;
@@ -324,6 +328,7 @@ public:
     bool hasDisplayCapability(
             HalDisplayId,
             aidl::android::hardware::graphics::composer3::DisplayCapability) const override;
+    bool hasMultiThreadedPresentSupport(HalDisplayId) const override;
 
     size_t getMaxVirtualDisplayCount() const override;
     size_t getMaxVirtualDisplayDimension() const override;
@@ -265,6 +265,7 @@ bool HidlComposer::isSupported(OptionalFeature feature) const {
         case OptionalFeature::DisplayBrightnessCommand:
         case OptionalFeature::KernelIdleTimer:
         case OptionalFeature::PhysicalDisplayOrientation:
+        case OptionalFeature::MultiThreadedPresent:
             return false;
     }
 }
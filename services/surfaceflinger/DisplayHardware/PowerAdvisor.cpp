@@ -114,6 +114,7 @@ void PowerAdvisor::onBootFinished() {
 }
 
 void PowerAdvisor::setExpensiveRenderingExpected(DisplayId displayId, bool expected) {
+    std::lock_guard lock(mExpensiveRenderingMutex);
     if (!mHasExpensiveRendering) {
         ALOGV("Skipped sending EXPENSIVE_RENDERING because HAL doesn't support it");
         return;
@@ -317,6 +318,7 @@ bool PowerAdvisor::startPowerHintSession(const std::vector<int32_t>& threadIds)
 }
 
 void PowerAdvisor::setGpuFenceTime(DisplayId displayId, std::unique_ptr<FenceTime>&& fenceTime) {
+    std::lock_guard lock(mDisplayTimingDataMutex);
     DisplayTimingData& displayData = mDisplayTimingData[displayId];
     if (displayData.gpuEndFenceTime) {
         nsecs_t signalTime = displayData.gpuEndFenceTime->getSignalTime();
@@ -343,6 +345,7 @@ void PowerAdvisor::setGpuFenceTime(DisplayId displayId, std::unique_ptr<FenceTim
 
 void PowerAdvisor::setHwcValidateTiming(DisplayId displayId, TimePoint validateStartTime,
                                         TimePoint validateEndTime) {
+    std::lock_guard lock(mDisplayTimingDataMutex);
     DisplayTimingData& displayData = mDisplayTimingData[displayId];
     displayData.hwcValidateStartTime = validateStartTime;
     displayData.hwcValidateEndTime = validateEndTime;
@@ -350,17 +353,20 @@ void PowerAdvisor::setHwcValidateTiming(DisplayId displayId, TimePoint validateS
 
 void PowerAdvisor::setHwcPresentTiming(DisplayId displayId, TimePoint presentStartTime,
                                        TimePoint presentEndTime) {
+    std::lock_guard lock(mDisplayTimingDataMutex);
     DisplayTimingData& displayData = mDisplayTimingData[displayId];
     displayData.hwcPresentStartTime = presentStartTime;
     displayData.hwcPresentEndTime = presentEndTime;
 }
 
 void PowerAdvisor::setSkippedValidate(DisplayId displayId, bool skipped) {
+    std::lock_guard lock(mDisplayTimingDataMutex);
     mDisplayTimingData[displayId].skippedValidate = skipped;
 }
 
 void PowerAdvisor::setRequiresClientComposition(DisplayId displayId,
                                                 bool requiresClientComposition) {
+    std::lock_guard lock(mDisplayTimingDataMutex);
     mDisplayTimingData[displayId].usedClientComposition = requiresClientComposition;
 }
 
@@ -378,6 +384,7 @@ void PowerAdvisor::setFrameDelay(Duration frameDelayDuration) {
 }
 
 void PowerAdvisor::setHwcPresentDelayedTime(DisplayId displayId, TimePoint earliestFrameStartTime) {
+    std::lock_guard lock(mDisplayTimingDataMutex);
     mDisplayTimingData[displayId].hwcPresentDelayedTime = earliestFrameStartTime;
 }
 
@@ -401,13 +408,14 @@ std::vector<DisplayId> PowerAdvisor::getOrderedDisplayIds(
         std::optional<TimePoint> DisplayTimingData::*sortBy) {
     std::vector<DisplayId> sortedDisplays;
     std::copy_if(mDisplayIds.begin(), mDisplayIds.end(), std::back_inserter(sortedDisplays),
-                 [&](DisplayId id) {
+                 [&](DisplayId id) REQUIRES(mDisplayTimingDataMutex) {
                      return mDisplayTimingData.count(id) &&
                              (mDisplayTimingData[id].*sortBy).has_value();
                  });
-    std::sort(sortedDisplays.begin(), sortedDisplays.end(), [&](DisplayId idA, DisplayId idB) {
-        return *(mDisplayTimingData[idA].*sortBy) < *(mDisplayTimingData[idB].*sortBy);
-    });
+    std::sort(sortedDisplays.begin(), sortedDisplays.end(),
+              [&](DisplayId idA, DisplayId idB) REQUIRES(mDisplayTimingDataMutex) {
+                  return *(mDisplayTimingData[idA].*sortBy) < *(mDisplayTimingData[idB].*sortBy);
+              });
     return sortedDisplays;
 }
 
@@ -432,6 +440,7 @@ std::optional<Duration> PowerAdvisor::estimateWorkDuration() {
 
     // The timing info for the previously calculated display, if there was one
     std::optional<DisplayTimeline> previousDisplayTiming;
+    std::lock_guard lock(mDisplayTimingDataMutex);
     std::vector<DisplayId>&& displayIds =
             getOrderedDisplayIds(&DisplayTimingData::hwcPresentStartTime);
     DisplayTimeline displayTiming;
@@ -18,6 +18,7 @@
 
 #include <atomic>
 #include <chrono>
+#include <mutex>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -141,8 +142,10 @@ private:
     std::unique_ptr<power::PowerHalController> mPowerHal;
     std::atomic_bool mBootFinished = false;
 
-    std::unordered_set<DisplayId> mExpensiveDisplays;
-    bool mNotifiedExpensiveRendering = false;
+    // Displays presented in parallel report their state concurrently.
+    std::mutex mExpensiveRenderingMutex;
+    std::unordered_set<DisplayId> mExpensiveDisplays GUARDED_BY(mExpensiveRenderingMutex);
+    std::atomic_bool mNotifiedExpensiveRendering = false;
 
     SurfaceFlinger& mFlinger;
     std::atomic_bool mSendUpdateImminent = true;
@@ -213,14 +216,18 @@ private:
 
     // Filter and sort the display ids by a given property
     std::vector<DisplayId> getOrderedDisplayIds(
-            std::optional<TimePoint> DisplayTimingData::*sortBy);
+            std::optional<TimePoint> DisplayTimingData::*sortBy)
+            REQUIRES(mDisplayTimingDataMutex);
     // Estimates a frame's total work duration including gpu time.
     std::optional<Duration> estimateWorkDuration();
     // There are two different targets and actual work durations we care about,
     // this normalizes them together and takes the max of the two
     Duration combineTimingEstimates(Duration totalDuration, Duration flingerDuration);
 
-    std::unordered_map<DisplayId, DisplayTimingData> mDisplayTimingData;
+    // Displays presented in parallel report their timing concurrently.
+    std::mutex mDisplayTimingDataMutex;
+    std::unordered_map<DisplayId, DisplayTimingData> mDisplayTimingData
+            GUARDED_BY(mDisplayTimingDataMutex);
 
     // Current frame's delay
     Duration mFrameDelayDuration{0ns};
@@ -250,7 +257,7 @@ private:
     sp<hardware::power::IPowerHintSession> mHintSession GUARDED_BY(mHintSessionMutex) = nullptr;
 
     // Initialize to true so we try to call, to check if it's supported
-    bool mHasExpensiveRendering = true;
+    bool mHasExpensiveRendering GUARDED_BY(mExpensiveRenderingMutex) = true;
     bool mHasDisplayUpdateImminent = true;
     // Queue of actual durations saved to report
     std::vector<hardware::power::WorkDuration> mHintSessionQueue;
@@ -24,10 +24,14 @@
 #include <utils/Log.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
 #include <chrono>
 #include <cinttypes>
+#include <iterator>
+#include <new>
 #include <numeric>
 #include <unordered_set>
+#include <utility>
 
 namespace android::frametimeline {
 
@@ -299,8 +303,10 @@ int64_t TraceCookieCounter::getCookieForTracing() {
 }
 
 SurfaceFrame::SurfaceFrame(const FrameTimelineInfo& frameTimelineInfo, pid_t ownerPid,
-                           uid_t ownerUid, int32_t layerId, std::string layerName,
-                           std::string debugName, PredictionState predictionState,
+                           uid_t ownerUid, int32_t layerId,
+                           std::shared_ptr<const std::string> layerName,
+                           std::shared_ptr<const std::string> debugName,
+                           PredictionState predictionState,
                            frametimeline::TimelineItem&& predictions,
                            std::shared_ptr<TimeStats> timeStats,
                            JankClassificationThresholds thresholds,
@@ -347,7 +353,7 @@ void SurfaceFrame::setPresentState(PresentState presentState, nsecs_t lastLatchT
     LOG_ALWAYS_FATAL_IF(mPresentState != PresentState::Unknown,
                         "setPresentState called on a SurfaceFrame from Layer - %s, that has a "
                         "PresentState - %s set already.",
-                        mDebugName.c_str(), toString(mPresentState).c_str());
+                        mDebugName->c_str(), toString(mPresentState).c_str());
     mPresentState = presentState;
     mLastLatchTime = lastLatchTime;
 }
@@ -415,7 +421,7 @@ void SurfaceFrame::promoteToBuffer() {
     LOG_ALWAYS_FATAL_IF(mIsBuffer == true,
                         "Trying to promote an already promoted BufferSurfaceFrame from layer %s "
                         "with token %" PRId64 "",
-                        mDebugName.c_str(), mToken);
+                        mDebugName->c_str(), mToken);
     mIsBuffer = true;
 }
 
@@ -427,7 +433,7 @@ bool SurfaceFrame::getIsBuffer() const {
 void SurfaceFrame::dump(std::string& result, const std::string& indent, nsecs_t baseTime) const {
     std::scoped_lock lock(mMutex);
     StringAppendF(&result, "%s", indent.c_str());
-    StringAppendF(&result, "Layer - %s", mDebugName.c_str());
+    StringAppendF(&result, "Layer - %s", mDebugName->c_str());
     if (mJankType != JankType::None) {
         // Easily identify a janky Surface Frame in the dump
         StringAppendF(&result, " [*] ");
@@ -478,7 +484,7 @@ void SurfaceFrame::dump(std::string& result, const std::string& indent, nsecs_t
 std::string SurfaceFrame::miniDump() const {
     std::scoped_lock lock(mMutex);
     std::string result;
-    StringAppendF(&result, "Layer - %s\n", mDebugName.c_str());
+    StringAppendF(&result, "Layer - %s\n", mDebugName->c_str());
     StringAppendF(&result, "Token: %" PRId64 "\n", mToken);
     StringAppendF(&result, "Is Buffer?: %d\n", mIsBuffer);
     StringAppendF(&result, "Present State : %s\n", toString(mPresentState).c_str());
@@ -612,7 +618,7 @@ void SurfaceFrame::onPresent(nsecs_t presentTime, int32_t displayFrameJankType,
 
     if (mPredictionState != PredictionState::None) {
         // Only update janky frames if the app used vsync predictions
-        mTimeStats->incrementJankyFrames({refreshRate, mRenderRate, mOwnerUid, mLayerName,
+        mTimeStats->incrementJankyFrames({refreshRate, mRenderRate, mOwnerUid, *mLayerName,
                                           mGameMode, mJankType, displayDeadlineDelta,
                                           displayPresentDelta, deadlineDelta});
     }
@@ -637,7 +643,7 @@ void SurfaceFrame::tracePredictions(int64_t displayFrameToken, nsecs_t monoBootO
         expectedSurfaceFrameStartEvent->set_display_frame_token(displayFrameToken);
 
         expectedSurfaceFrameStartEvent->set_pid(mOwnerPid);
-        expectedSurfaceFrameStartEvent->set_layer_name(mDebugName);
+        expectedSurfaceFrameStartEvent->set_layer_name(*mDebugName);
     });
 
     // Expected timeline end
@@ -686,7 +692,7 @@ void SurfaceFrame::traceActuals(int64_t displayFrameToken, nsecs_t monoBootOffse
         actualSurfaceFrameStartEvent->set_display_frame_token(displayFrameToken);
 
         actualSurfaceFrameStartEvent->set_pid(mOwnerPid);
-        actualSurfaceFrameStartEvent->set_layer_name(mDebugName);
+        actualSurfaceFrameStartEvent->set_layer_name(*mDebugName);
 
         if (mPresentState == PresentState::Dropped) {
             actualSurfaceFrameStartEvent->set_present_type(FrameTimelineEvent::PRESENT_DROPPED);
@@ -760,13 +766,97 @@ std::optional<TimelineItem> TokenManager::getPredictionsForToken(int64_t token)
     return {};
 }
 
+// A free list of the blocks that SurfaceFrames were allocated in, along with their shared_ptr
+// control block. Shared by the allocator of every SurfaceFrame, since Layers may keep their last
+// SurfaceFrames alive after the FrameTimeline is destroyed.
+class SurfaceFramePool {
+public:
+    SurfaceFramePool() { mFreeBlocks.reserve(kMaxFreeBlocks); }
+
+    ~SurfaceFramePool() {
+        for (void* block : mFreeBlocks) {
+            ::operator delete(block);
+        }
+    }
+
+    void* allocate(size_t size) {
+        {
+            std::scoped_lock lock(mMutex);
+            if (size == mBlockSize && !mFreeBlocks.empty()) {
+                void* block = mFreeBlocks.back();
+                mFreeBlocks.pop_back();
+                return block;
+            }
+        }
+        return ::operator new(size);
+    }
+
+    void deallocate(void* block, size_t size) {
+        {
+            std::scoped_lock lock(mMutex);
+            if (mBlockSize == 0) {
+                mBlockSize = size;
+            }
+            if (size == mBlockSize && mFreeBlocks.size() < kMaxFreeBlocks) {
+                mFreeBlocks.push_back(block);
+                return;
+            }
+        }
+        ::operator delete(block);
+    }
+
+private:
+    // Enough for the SurfaceFrames of a few display frames to be released at once.
+    static constexpr size_t kMaxFreeBlocks = 256;
+
+    std::mutex mMutex;
+    size_t mBlockSize GUARDED_BY(mMutex) = 0;
+    std::vector<void*> mFreeBlocks GUARDED_BY(mMutex);
+};
+
+namespace {
+
+template <typename T>
+class SurfaceFrameAllocator {
+public:
+    using value_type = T;
+
+    explicit SurfaceFrameAllocator(std::shared_ptr<SurfaceFramePool> pool)
+          : mPool(std::move(pool)) {}
+
+    template <typename U>
+    SurfaceFrameAllocator(const SurfaceFrameAllocator<U>& other) : mPool(other.mPool) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(mPool->allocate(n * sizeof(T))); }
+    void deallocate(T* p, size_t n) { mPool->deallocate(p, n * sizeof(T)); }
+
+    template <typename U>
+    bool operator==(const SurfaceFrameAllocator<U>& other) const {
+        return mPool == other.mPool;
+    }
+    template <typename U>
+    bool operator!=(const SurfaceFrameAllocator<U>& other) const {
+        return mPool != other.mPool;
+    }
+
+private:
+    template <typename U>
+    friend class SurfaceFrameAllocator;
+
+    std::shared_ptr<SurfaceFramePool> mPool;
+};
+
+} // namespace
+
 FrameTimeline::FrameTimeline(std::shared_ptr<TimeStats> timeStats, pid_t surfaceFlingerPid,
                              JankClassificationThresholds thresholds, bool useBootTimeClock)
-      : mUseBootTimeClock(useBootTimeClock),
+      : mDisplayFrames(kDefaultMaxDisplayFrames),
+        mUseBootTimeClock(useBootTimeClock),
         mMaxDisplayFrames(kDefaultMaxDisplayFrames),
         mTimeStats(std::move(timeStats)),
         mSurfaceFlingerPid(surfaceFlingerPid),
-        mJankClassificationThresholds(thresholds) {
+        mJankClassificationThresholds(thresholds),
+        mSurfaceFramePool(std::make_shared<SurfaceFramePool>()) {
     mCurrentDisplayFrame =
             std::make_shared<DisplayFrame>(mTimeStats, thresholds, &mTraceCookieCounter);
 }
@@ -788,27 +878,44 @@ std::shared_ptr<SurfaceFrame> FrameTimeline::createSurfaceFrameForToken(
         const FrameTimelineInfo& frameTimelineInfo, pid_t ownerPid, uid_t ownerUid, int32_t layerId,
         std::string layerName, std::string debugName, bool isBuffer, GameMode gameMode) {
     ATRACE_CALL();
+    const auto makeSurfaceFrame = [&](PredictionState predictionState,
+                                      TimelineItem&& predictions) {
+        return std::allocate_shared<SurfaceFrame>(
+                SurfaceFrameAllocator<SurfaceFrame>(mSurfaceFramePool), frameTimelineInfo, ownerPid,
+                ownerUid, layerId, internName(std::move(layerName)),
+                internName(std::move(debugName)), predictionState, std::move(predictions),
+                mTimeStats, mJankClassificationThresholds, &mTraceCookieCounter, isBuffer,
+                gameMode);
+    };
+
     if (frameTimelineInfo.vsyncId == FrameTimelineInfo::INVALID_VSYNC_ID) {
-        return std::make_shared<SurfaceFrame>(frameTimelineInfo, ownerPid, ownerUid, layerId,
-                                              std::move(layerName), std::move(debugName),
-                                              PredictionState::None, TimelineItem(), mTimeStats,
-                                              mJankClassificationThresholds, &mTraceCookieCounter,
-                                              isBuffer, gameMode);
+        return makeSurfaceFrame(PredictionState::None, TimelineItem());
     }
     std::optional<TimelineItem> predictions =
             mTokenManager.getPredictionsForToken(frameTimelineInfo.vsyncId);
     if (predictions) {
-        return std::make_shared<SurfaceFrame>(frameTimelineInfo, ownerPid, ownerUid, layerId,
-                                              std::move(layerName), std::move(debugName),
-                                              PredictionState::Valid, std::move(*predictions),
-                                              mTimeStats, mJankClassificationThresholds,
-                                              &mTraceCookieCounter, isBuffer, gameMode);
+        return makeSurfaceFrame(PredictionState::Valid, std::move(*predictions));
+    }
+    return makeSurfaceFrame(PredictionState::Expired, TimelineItem());
+}
+
+std::shared_ptr<const std::string> FrameTimeline::internName(std::string name) {
+    std::scoped_lock lock(mInternedNamesMutex);
+    if (const auto it = mInternedNames.find(name); it != mInternedNames.end()) {
+        return it->second;
+    }
+
+    if (mInternedNames.size() >= mInternedNamesPruneSize) {
+        // Names that only the map refers to belong to layers without SurfaceFrames left.
+        for (auto it = mInternedNames.begin(); it != mInternedNames.end();) {
+            it = it->second.use_count() == 1 ? mInternedNames.erase(it) : std::next(it);
+        }
+        mInternedNamesPruneSize = std::max(kMinInternedNamesPruneSize, 2 * mInternedNames.size());
     }
-    return std::make_shared<SurfaceFrame>(frameTimelineInfo, ownerPid, ownerUid, layerId,
-                                          std::move(layerName), std::move(debugName),
-                                          PredictionState::Expired, TimelineItem(), mTimeStats,
-                                          mJankClassificationThresholds, &mTraceCookieCounter,
-                                          isBuffer, gameMode);
+
+    auto interned = std::make_shared<const std::string>(std::move(name));
+    mInternedNames.emplace(*interned, interned);
+    return interned;
 }
 
 FrameTimeline::DisplayFrame::DisplayFrame(std::shared_ptr<TimeStats> timeStats,
@@ -883,6 +990,21 @@ void FrameTimeline::DisplayFrame::setGpuFence(const std::shared_ptr<FenceTime>&
     mGpuFence = gpuFence;
 }
 
+void FrameTimeline::DisplayFrame::reset() {
+    mToken = FrameTimelineInfo::INVALID_VSYNC_ID;
+    mSurfaceFlingerPredictions = TimelineItem();
+    mSurfaceFlingerActuals = TimelineItem();
+    // Keeps the capacity of the vector, so that it doesn't grow again.
+    mSurfaceFrames.clear();
+    mPredictionState = PredictionState::None;
+    mJankType = JankType::None;
+    mGpuFence = FenceTime::NO_FENCE;
+    mFramePresentMetadata = FramePresentMetadata::UnknownPresent;
+    mFrameReadyMetadata = FrameReadyMetadata::UnknownFinish;
+    mFrameStartMetadata = FrameStartMetadata::UnknownStart;
+    mRefreshRate = Fps();
+}
+
 void FrameTimeline::DisplayFrame::classifyJank(nsecs_t& deadlineDelta, nsecs_t& deltaToVsync,
                                                nsecs_t previousPresentTime) {
     const bool presentTimeValid =
@@ -1235,16 +1357,42 @@ void FrameTimeline::flushPendingPresentFences() {
 }
 
 void FrameTimeline::finalizeCurrentDisplayFrame() {
-    while (mDisplayFrames.size() >= mMaxDisplayFrames) {
-        // We maintain only a fixed number of frames' data. Pop older frames
-        mDisplayFrames.pop_front();
+    // We maintain only a fixed number of frames' data, so the oldest frame is evicted.
+    std::shared_ptr<DisplayFrame> evictedFrame =
+            mDisplayFrames.push(std::move(mCurrentDisplayFrame));
+
+    // The evicted frame can be reused unless its present fence is still pending.
+    if (evictedFrame && evictedFrame.use_count() == 1) {
+        evictedFrame->reset();
+        mCurrentDisplayFrame = std::move(evictedFrame);
+        return;
     }
-    mDisplayFrames.push_back(mCurrentDisplayFrame);
-    mCurrentDisplayFrame.reset();
     mCurrentDisplayFrame = std::make_shared<DisplayFrame>(mTimeStats, mJankClassificationThresholds,
                                                           &mTraceCookieCounter);
 }
 
+void FrameTimeline::DisplayFrameRing::setCapacity(size_t capacity) {
+    mFrames.clear();
+    mFrames.resize(capacity);
+    mBegin = 0;
+    mSize = 0;
+}
+
+std::shared_ptr<FrameTimeline::DisplayFrame> FrameTimeline::DisplayFrameRing::push(
+        std::shared_ptr<DisplayFrame> displayFrame) {
+    if (mFrames.empty()) {
+        return displayFrame;
+    }
+    if (mSize < mFrames.size()) {
+        mFrames[(mBegin + mSize++) % mFrames.size()] = std::move(displayFrame);
+        return nullptr;
+    }
+    std::shared_ptr<DisplayFrame> oldestFrame =
+            std::exchange(mFrames[mBegin], std::move(displayFrame));
+    mBegin = (mBegin + 1) % mFrames.size();
+    return oldestFrame;
+}
+
 nsecs_t FrameTimeline::DisplayFrame::getBaseTime() const {
     nsecs_t baseTime =
             getMinTime(mPredictionState, mSurfaceFlingerPredictions, mSurfaceFlingerActuals);
@@ -1348,7 +1496,7 @@ void FrameTimeline::setMaxDisplayFrames(uint32_t size) {
     std::scoped_lock lock(mMutex);
 
     // The size can either increase or decrease, clear everything, to be consistent
-    mDisplayFrames.clear();
+    mDisplayFrames.setCapacity(size);
     mPendingPresentFences.clear();
     mMaxDisplayFrames = size;
 }
@@ -18,11 +18,13 @@
 
 #include <atomic>
 #include <chrono>
-#include <deque>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 #include <gui/ISurfaceComposer.h>
 #include <gui/JankInfo.h>
@@ -159,10 +161,11 @@ public:
     // Only FrameTimeline can construct a SurfaceFrame as it provides Predictions(through
     // TokenManager), Thresholds and TimeStats pointer.
     SurfaceFrame(const FrameTimelineInfo& frameTimelineInfo, pid_t ownerPid, uid_t ownerUid,
-                 int32_t layerId, std::string layerName, std::string debugName,
-                 PredictionState predictionState, TimelineItem&& predictions,
-                 std::shared_ptr<TimeStats> timeStats, JankClassificationThresholds thresholds,
-                 TraceCookieCounter* traceCookieCounter, bool isBuffer, GameMode);
+                 int32_t layerId, std::shared_ptr<const std::string> layerName,
+                 std::shared_ptr<const std::string> debugName, PredictionState predictionState,
+                 TimelineItem&& predictions, std::shared_ptr<TimeStats> timeStats,
+                 JankClassificationThresholds thresholds, TraceCookieCounter* traceCookieCounter,
+                 bool isBuffer, GameMode);
     ~SurfaceFrame() = default;
 
     // Returns std::nullopt if the frame hasn't been classified yet.
@@ -235,8 +238,9 @@ private:
     const int32_t mInputEventId;
     const pid_t mOwnerPid;
     const uid_t mOwnerUid;
-    const std::string mLayerName;
-    const std::string mDebugName;
+    // Interned by FrameTimeline, as every frame of a layer has the same names.
+    const std::shared_ptr<const std::string> mLayerName;
+    const std::shared_ptr<const std::string> mDebugName;
     const int32_t mLayerId;
     PresentState mPresentState GUARDED_BY(mMutex);
     const PredictionState mPredictionState;
@@ -327,6 +331,8 @@ public:
 
 namespace impl {
 
+class SurfaceFramePool;
+
 class TokenManager : public android::frametimeline::TokenManager {
 public:
     TokenManager() : mCurrentToken(FrameTimelineInfo::INVALID_VSYNC_ID + 1) {}
@@ -385,6 +391,8 @@ public:
         void setActualStartTime(nsecs_t actualStartTime);
         void setActualEndTime(nsecs_t actualEndTime);
         void setGpuFence(const std::shared_ptr<FenceTime>& gpuFence);
+        // Clears all the data, so that the DisplayFrame can be reused for a new vsync.
+        void reset();
 
         // BaseTime is the smallest timestamp in a DisplayFrame.
         // Used for dumping all timestamps relative to the oldest, making it easy to read.
@@ -478,9 +486,36 @@ private:
     void finalizeCurrentDisplayFrame() REQUIRES(mMutex);
     void dumpAll(std::string& result);
     void dumpJank(std::string& result);
+    // Returns the shared copy of the given layer name, so that SurfaceFrames of the same layer
+    // don't each hold their own.
+    std::shared_ptr<const std::string> internName(std::string name) EXCLUDES(mInternedNamesMutex);
+
+    // Fixed size window of the latest display frames, indexed from the oldest one.
+    class DisplayFrameRing {
+    public:
+        explicit DisplayFrameRing(size_t capacity) { setCapacity(capacity); }
+
+        // Clears the ring and sets its capacity.
+        void setCapacity(size_t capacity);
+        // Appends the DisplayFrame and returns the oldest one, if it was evicted to make room.
+        std::shared_ptr<DisplayFrame> push(std::shared_ptr<DisplayFrame> displayFrame);
+
+        const std::shared_ptr<DisplayFrame>& operator[](size_t i) const {
+            return mFrames[(mBegin + i) % mFrames.size()];
+        }
+        size_t size() const { return mSize; }
+        bool empty() const { return mSize == 0; }
+        void clear() { setCapacity(mFrames.size()); }
+
+    private:
+        std::vector<std::shared_ptr<DisplayFrame>> mFrames;
+        size_t mBegin = 0;
+        size_t mSize = 0;
+    };
 
-    // Sliding window of display frames. TODO(b/168072834): compare perf with fixed size array
-    std::deque<std::shared_ptr<DisplayFrame>> mDisplayFrames GUARDED_BY(mMutex);
+    // Sliding window of display frames. Evicted DisplayFrames are reused for the next vsync,
+    // unless they are still waiting for their present fence.
+    DisplayFrameRing mDisplayFrames GUARDED_BY(mMutex);
     std::vector<std::pair<std::shared_ptr<FenceTime>, std::shared_ptr<DisplayFrame>>>
             mPendingPresentFences GUARDED_BY(mMutex);
     std::shared_ptr<DisplayFrame> mCurrentDisplayFrame GUARDED_BY(mMutex);
@@ -493,6 +528,15 @@ private:
     const pid_t mSurfaceFlingerPid;
     nsecs_t mPreviousPresentTime = 0;
     const JankClassificationThresholds mJankClassificationThresholds;
+    // Recycles the memory of SurfaceFrames, which are created for every buffer and transaction.
+    const std::shared_ptr<SurfaceFramePool> mSurfaceFramePool;
+    // Keyed by views of the interned names themselves.
+    std::unordered_map<std::string_view, std::shared_ptr<const std::string>> mInternedNames
+            GUARDED_BY(mInternedNamesMutex);
+    // Names which are no longer used by any SurfaceFrame are dropped when the map grows past this.
+    size_t mInternedNamesPruneSize GUARDED_BY(mInternedNamesMutex) = kMinInternedNamesPruneSize;
+    std::mutex mInternedNamesMutex;
+    static constexpr size_t kMinInternedNamesPruneSize = 64;
     static constexpr uint32_t kDefaultMaxDisplayFrames = 64;
     // The initial container size for the vector<SurfaceFrames> inside display frame. Although
     // this number doesn't represent any bounds on the number of surface frames that can go in a
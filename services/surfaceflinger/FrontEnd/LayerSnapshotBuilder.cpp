@@ -337,6 +337,13 @@ uint32_t getPrimaryDisplayRotationFlags(
     return 0;
 }
 
+// Changes of a snapshot that are passed down to the snapshots of its children.
+constexpr ftl::Flags<RequestedLayerState::Changes> kChangesAffectingChildren =
+        RequestedLayerState::Changes::Hierarchy | RequestedLayerState::Changes::Geometry |
+        RequestedLayerState::Changes::Visibility | RequestedLayerState::Changes::Metadata |
+        RequestedLayerState::Changes::AffectsChildren | RequestedLayerState::Changes::FrameRate |
+        RequestedLayerState::Changes::GameMode;
+
 } // namespace
 
 LayerSnapshot LayerSnapshotBuilder::getRootSnapshot() {
@@ -407,6 +414,7 @@ bool LayerSnapshotBuilder::tryFastUpdate(const Args& args) {
             it->second->merge(*requested, forceUpdate, args.displayChanges, args.forceFullDamage,
                               primaryDisplayRotationFlags);
         }
+        mLayersMergedSinceLastWalk.insert(requested->id);
     }
 
     if ((args.layerLifecycleManager.getGlobalChanges().get() &
@@ -436,9 +444,15 @@ void LayerSnapshotBuilder::updateSnapshots(const Args& args) {
         mRootSnapshot.clientChanges |= layer_state_t::eReparent;
     }
 
-    for (auto& snapshot : mSnapshots) {
-        if (snapshot->reachablilty == LayerSnapshot::Reachablilty::Reachable) {
-            snapshot->reachablilty = LayerSnapshot::Reachablilty::Unreachable;
+    mUpdateDirtySubtreesOnly = canUpdateDirtySubtreesOnly(args);
+    if (mUpdateDirtySubtreesOnly) {
+        ATRACE_NAME("DirtySubtreesOnly");
+        markDirtySubtrees(args);
+    } else {
+        for (auto& snapshot : mSnapshots) {
+            if (snapshot->reachablilty == LayerSnapshot::Reachablilty::Reachable) {
+                snapshot->reachablilty = LayerSnapshot::Reachablilty::Unreachable;
+            }
         }
     }
 
@@ -451,6 +465,9 @@ void LayerSnapshotBuilder::updateSnapshots(const Args& args) {
         updateSnapshotsInHierarchy(args, args.root, root, mRootSnapshot, /*depth=*/0);
     } else {
         for (auto& [childHierarchy, variant] : args.root.mChildren) {
+            if (canSkipSubtree(*childHierarchy, mRootSnapshot)) {
+                continue;
+            }
             LayerHierarchy::ScopedAddToTraversalPath addChildToPath(root,
                                                                     childHierarchy->getLayer()->id,
                                                                     variant);
@@ -458,11 +475,15 @@ void LayerSnapshotBuilder::updateSnapshots(const Args& args) {
         }
     }
 
+    mLayersMergedSinceLastWalk.clear();
+    mDirtySubtreeLayerIds.clear();
+
     // Update touchable region crops outside the main update pass. This is because a layer could be
     // cropped by any other layer and it requires both snapshots to be updated.
     updateTouchableRegionCrop(args);
 
     const bool hasUnreachableSnapshots = sortSnapshotsByZ(args);
+    mUpdateDirtySubtreesOnly = false;
     clearChanges(mRootSnapshot);
 
     // Destroy unreachable snapshots for clone layers. And destroy snapshots for non-clone
@@ -472,6 +493,9 @@ void LayerSnapshotBuilder::updateSnapshots(const Args& args) {
         return;
     }
 
+    // The z-order traversal may have reached some of the snapshots being destroyed.
+    mSnapshotsInZOrderValid = false;
+
     std::unordered_set<uint32_t> destroyedLayerIds;
     for (auto& destroyedLayer : args.layerLifecycleManager.getDestroyedLayers()) {
         destroyedLayerIds.insert(destroyedLayer->id);
@@ -551,6 +575,9 @@ const LayerSnapshot& LayerSnapshotBuilder::updateSnapshotsInHierarchy(
     }
 
     for (auto& [childHierarchy, variant] : hierarchy.mChildren) {
+        if (canSkipSubtree(*childHierarchy, *snapshot)) {
+            continue;
+        }
         LayerHierarchy::ScopedAddToTraversalPath addChildToPath(traversalPath,
                                                                 childHierarchy->getLayer()->id,
                                                                 variant);
@@ -566,6 +593,80 @@ const LayerSnapshot& LayerSnapshotBuilder::updateSnapshotsInHierarchy(
     return *snapshot;
 }
 
+bool LayerSnapshotBuilder::canUpdateDirtySubtreesOnly(const Args& args) const {
+    static constexpr ftl::Flags<RequestedLayerState::Changes> AFFECTS_HIERARCHY =
+            RequestedLayerState::Changes::Created | RequestedLayerState::Changes::Destroyed |
+            RequestedLayerState::Changes::Hierarchy | RequestedLayerState::Changes::Mirror |
+            RequestedLayerState::Changes::Parent | RequestedLayerState::Changes::RelativeParent |
+            RequestedLayerState::Changes::Z;
+
+    if (args.forceUpdate != ForceUpdateFlags::NONE || args.displayChanges || args.parentCrop ||
+        args.root.getLayer() || !args.excludeLayerIds.empty() ||
+        args.layerLifecycleManager.getGlobalChanges().any(AFFECTS_HIERARCHY) ||
+        !args.layerLifecycleManager.getDestroyedLayers().empty()) {
+        return false;
+    }
+
+    // Clones are reached through their mirror root, which is not an ancestor of the cloned layer,
+    // so changes to a cloned layer require the full walk.
+    for (const RequestedLayerState* layer : args.layerLifecycleManager.getChangedLayers()) {
+        if (mIdToSnapshots.count(layer->id) > 1) {
+            return false;
+        }
+    }
+    for (uint32_t layerId : mLayersMergedSinceLastWalk) {
+        if (mIdToSnapshots.count(layerId) > 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void LayerSnapshotBuilder::markDirtySubtrees(const Args& args) {
+    mDirtySubtreeLayerIds.clear();
+    std::vector<uint32_t> pendingLayerIds;
+    auto markDirty = [&](uint32_t layerId) {
+        if (layerId != UNASSIGNED_LAYER_ID && mDirtySubtreeLayerIds.insert(layerId).second) {
+            pendingLayerIds.push_back(layerId);
+        }
+    };
+
+    // Layers merged through the fast path in previous updates are walked again as well, so that
+    // the snapshot properties computed in updateSnapshot catch up with their changes.
+    for (const RequestedLayerState* layer : args.layerLifecycleManager.getChangedLayers()) {
+        markDirty(layer->id);
+    }
+    for (uint32_t layerId : mLayersMergedSinceLastWalk) {
+        markDirty(layerId);
+    }
+
+    // A layer is reached through its parent and through its relative parent, so both chains of
+    // ancestors lead to a dirty subtree. Ancestors shared by several dirty layers are only
+    // visited once, which also ends the walk up relative z loops.
+    while (!pendingLayerIds.empty()) {
+        const RequestedLayerState* layer =
+                args.layerLifecycleManager.getLayerFromId(pendingLayerIds.back());
+        pendingLayerIds.pop_back();
+        if (!layer) {
+            continue;
+        }
+        markDirty(layer->parentId);
+        markDirty(layer->relativeParentId);
+    }
+}
+
+bool LayerSnapshotBuilder::canSkipSubtree(const LayerHierarchy& hierarchy,
+                                          const LayerSnapshot& parentSnapshot) const {
+    if (!mUpdateDirtySubtreesOnly) {
+        return false;
+    }
+    if (parentSnapshot.changes.any(kChangesAffectingChildren) ||
+        parentSnapshot.clientChanges & layer_state_t::AFFECTS_CHILDREN) {
+        return false;
+    }
+    return mDirtySubtreeLayerIds.find(hierarchy.getLayer()->id) == mDirtySubtreeLayerIds.end();
+}
+
 LayerSnapshot* LayerSnapshotBuilder::getSnapshot(uint32_t layerId) const {
     if (layerId == UNASSIGNED_LAYER_ID) {
         return nullptr;
@@ -575,8 +676,7 @@ LayerSnapshot* LayerSnapshotBuilder::getSnapshot(uint32_t layerId) const {
 }
 
 LayerSnapshot* LayerSnapshotBuilder::getSnapshot(const LayerHierarchy::TraversalPath& id) const {
-    auto it = mPathToSnapshot.find(id);
-    return it == mPathToSnapshot.end() ? nullptr : it->second;
+    return mPathToSnapshot.find(id);
 }
 
 LayerSnapshot* LayerSnapshotBuilder::createSnapshot(const LayerHierarchy::TraversalPath& path,
@@ -588,7 +688,7 @@ LayerSnapshot* LayerSnapshotBuilder::createSnapshot(const LayerHierarchy::Traver
     if (path.isClone() && path.variant != LayerHierarchy::Variant::Mirror) {
         snapshot->mirrorRootPath = parentSnapshot.mirrorRootPath;
     }
-    mPathToSnapshot[path] = snapshot;
+    mPathToSnapshot.insert(path, snapshot);
 
     mIdToSnapshots.emplace(path.id, snapshot);
     return snapshot;
@@ -604,32 +704,49 @@ bool LayerSnapshotBuilder::sortSnapshotsByZ(const Args& args) {
         return false;
     }
     mResortSnapshots = false;
+    mVisibleSnapshotsZ.clear();
 
     size_t globalZ = 0;
-    args.root.traverseInZOrder(
-            [this, &globalZ](const LayerHierarchy&,
-                             const LayerHierarchy::TraversalPath& traversalPath) -> bool {
-                LayerSnapshot* snapshot = getSnapshot(traversalPath);
-                if (!snapshot) {
-                    return true;
-                }
+    auto placeSnapshot = [this, &globalZ](LayerSnapshot* snapshot) {
+        if (snapshot->getIsVisible() || snapshot->hasInputInfo()) {
+            updateVisibility(*snapshot, snapshot->getIsVisible());
+            size_t oldZ = snapshot->globalZ;
+            size_t newZ = globalZ++;
+            snapshot->globalZ = newZ;
+            if (snapshot->isVisible) {
+                mVisibleSnapshotsZ.push_back(static_cast<uint32_t>(newZ));
+            }
+            if (oldZ == newZ) {
+                return;
+            }
+            mSnapshots[newZ]->globalZ = oldZ;
+            LLOGV(snapshot->sequence, "Made visible z=%zu -> %zu %s", oldZ, newZ,
+                  snapshot->getDebugString().c_str());
+            std::iter_swap(mSnapshots.begin() + static_cast<ssize_t>(oldZ),
+                           mSnapshots.begin() + static_cast<ssize_t>(newZ));
+        }
+    };
 
-                if (snapshot->getIsVisible() || snapshot->hasInputInfo()) {
-                    updateVisibility(*snapshot, snapshot->getIsVisible());
-                    size_t oldZ = snapshot->globalZ;
-                    size_t newZ = globalZ++;
-                    snapshot->globalZ = newZ;
-                    if (oldZ == newZ) {
-                        return true;
+    if (mUpdateDirtySubtreesOnly && mSnapshotsInZOrderValid) {
+        // The hierarchy did not change, so neither did the z-order traversal. Patch the snapshot
+        // list in place from the snapshots it reached last time.
+        for (LayerSnapshot* snapshot : mSnapshotsInZOrder) {
+            placeSnapshot(snapshot);
+        }
+    } else {
+        mSnapshotsInZOrder.clear();
+        args.root.traverseInZOrder(
+                [this, &placeSnapshot](const LayerHierarchy&,
+                                       const LayerHierarchy::TraversalPath& traversalPath) -> bool {
+                    LayerSnapshot* snapshot = getSnapshot(traversalPath);
+                    if (snapshot) {
+                        mSnapshotsInZOrder.push_back(snapshot);
+                        placeSnapshot(snapshot);
                     }
-                    mSnapshots[newZ]->globalZ = oldZ;
-                    LLOGV(snapshot->sequence, "Made visible z=%zu -> %zu %s", oldZ, newZ,
-                          snapshot->getDebugString().c_str());
-                    std::iter_swap(mSnapshots.begin() + static_cast<ssize_t>(oldZ),
-                                   mSnapshots.begin() + static_cast<ssize_t>(newZ));
-                }
-                return true;
-            });
+                    return true;
+                });
+        mSnapshotsInZOrderValid = true;
+    }
     mNumInterestingSnapshots = (int)globalZ;
     bool hasUnreachableSnapshots = false;
     while (globalZ < mSnapshots.size()) {
@@ -708,11 +825,8 @@ void LayerSnapshotBuilder::updateSnapshot(LayerSnapshot& snapshot, const Args& a
                                           const LayerSnapshot& parentSnapshot,
                                           const LayerHierarchy::TraversalPath& path) {
     // Always update flags and visibility
-    ftl::Flags<RequestedLayerState::Changes> parentChanges = parentSnapshot.changes &
-            (RequestedLayerState::Changes::Hierarchy | RequestedLayerState::Changes::Geometry |
-             RequestedLayerState::Changes::Visibility | RequestedLayerState::Changes::Metadata |
-             RequestedLayerState::Changes::AffectsChildren |
-             RequestedLayerState::Changes::FrameRate | RequestedLayerState::Changes::GameMode);
+    ftl::Flags<RequestedLayerState::Changes> parentChanges =
+            parentSnapshot.changes & kChangesAffectingChildren;
     snapshot.changes |= parentChanges;
     if (args.displayChanges) snapshot.changes |= RequestedLayerState::Changes::Geometry;
     snapshot.reachablilty = LayerSnapshot::Reachablilty::Reachable;
@@ -1078,10 +1192,8 @@ std::vector<std::unique_ptr<LayerSnapshot>>& LayerSnapshotBuilder::getSnapshots(
 }
 
 void LayerSnapshotBuilder::forEachVisibleSnapshot(const ConstVisitor& visitor) const {
-    for (int i = 0; i < mNumInterestingSnapshots; i++) {
-        LayerSnapshot& snapshot = *mSnapshots[(size_t)i];
-        if (!snapshot.isVisible) continue;
-        visitor(snapshot);
+    for (uint32_t z : mVisibleSnapshotsZ) {
+        visitor(*mSnapshots[z]);
     }
 }
 
@@ -1100,10 +1212,8 @@ void LayerSnapshotBuilder::forEachVisibleSnapshot(const ConstVisitor& visitor,
 }
 
 void LayerSnapshotBuilder::forEachVisibleSnapshot(const Visitor& visitor) {
-    for (int i = 0; i < mNumInterestingSnapshots; i++) {
-        std::unique_ptr<LayerSnapshot>& snapshot = mSnapshots.at((size_t)i);
-        if (!snapshot->isVisible) continue;
-        visitor(snapshot);
+    for (uint32_t z : mVisibleSnapshotsZ) {
+        visitor(mSnapshots.at(z));
     }
 }
 
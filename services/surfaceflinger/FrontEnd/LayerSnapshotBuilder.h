@@ -21,6 +21,7 @@
 #include "LayerHierarchy.h"
 #include "LayerSnapshot.h"
 #include "RequestedLayerState.h"
+#include "TraversalPathIndex.h"
 
 namespace android::surfaceflinger::frontend {
 
@@ -32,6 +33,8 @@ namespace android::surfaceflinger::frontend {
 
 // The builder also uses a fast path to update
 // snapshots when there are only buffer updates.
+// When the hierarchy itself did not change, only the
+// subtrees leading to changed layers are walked.
 class LayerSnapshotBuilder {
 public:
     enum class ForceUpdateFlags {
@@ -94,6 +97,15 @@ private:
 
     void updateSnapshots(const Args& args);
 
+    // Returns true if the hierarchy is unchanged and only the subtrees containing changed layers
+    // need to be walked.
+    bool canUpdateDirtySubtreesOnly(const Args& args) const;
+    // Collects the changed layers and their ancestors into mDirtySubtreeLayerIds.
+    void markDirtySubtrees(const Args& args);
+    // Returns true if the walk does not need to visit the hierarchy, because neither its layers
+    // nor the parent snapshot changed.
+    bool canSkipSubtree(const LayerHierarchy& hierarchy, const LayerSnapshot& parentSnapshot) const;
+
     const LayerSnapshot& updateSnapshotsInHierarchy(const Args&, const LayerHierarchy& hierarchy,
                                                     LayerHierarchy::TraversalPath& traversalPath,
                                                     const LayerSnapshot& parentSnapshot, int depth);
@@ -120,9 +132,7 @@ private:
                           const Args& args);
     void updateTouchableRegionCrop(const Args& args);
 
-    std::unordered_map<LayerHierarchy::TraversalPath, LayerSnapshot*,
-                       LayerHierarchy::TraversalPathHash>
-            mPathToSnapshot;
+    TraversalPathIndex mPathToSnapshot;
     std::multimap<uint32_t, LayerSnapshot*> mIdToSnapshots;
 
     // Track snapshots that needs touchable region crop from other snapshots
@@ -132,6 +142,20 @@ private:
     LayerSnapshot mRootSnapshot;
     bool mResortSnapshots = false;
     int mNumInterestingSnapshots = 0;
+    // Positions of the visible snapshots in mSnapshots, in z-order. Visibility only changes when
+    // the snapshots are sorted, so the per-frame iterations do not need to read the snapshots
+    // they skip.
+    std::vector<uint32_t> mVisibleSnapshotsZ;
+
+    // Set while walking only the dirty subtrees, see canUpdateDirtySubtreesOnly.
+    bool mUpdateDirtySubtreesOnly = false;
+    std::unordered_set<uint32_t> mDirtySubtreeLayerIds;
+    // Layers whose snapshots were updated through the fast path since the last walk.
+    std::unordered_set<uint32_t> mLayersMergedSinceLastWalk;
+    // Snapshots reached by the last z-order traversal, in traversal order. Reused to sort the
+    // snapshots as long as the hierarchy does not change.
+    std::vector<LayerSnapshot*> mSnapshotsInZOrder;
+    bool mSnapshotsInZOrderValid = false;
 };
 
 } // namespace android::surfaceflinger::frontend
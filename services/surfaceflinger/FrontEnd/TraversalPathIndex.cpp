@@ -0,0 +1,103 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TraversalPathIndex.h"
+
+namespace android::surfaceflinger::frontend {
+
+namespace {
+constexpr uint32_t kInitialCapacityBits = 6;
+} // namespace
+
+size_t TraversalPathIndex::homeSlot(uint64_t key) const {
+    // Fibonacci hashing spreads the sequential layer ids across the table.
+    return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> (64 - mCapacityBits));
+}
+
+size_t TraversalPathIndex::findSlot(uint64_t key) const {
+    const size_t mask = mSlots.size() - 1;
+    size_t i = homeSlot(key);
+    while (mSlots[i].snapshot && mSlots[i].key != key) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+LayerSnapshot* TraversalPathIndex::find(const LayerHierarchy::TraversalPath& path) const {
+    if (mSize == 0) {
+        return nullptr;
+    }
+    return mSlots[findSlot(makeKey(path))].snapshot;
+}
+
+void TraversalPathIndex::insert(const LayerHierarchy::TraversalPath& path,
+                                LayerSnapshot* snapshot) {
+    // Keep the load factor under 3/4 so that probe sequences stay short.
+    if ((mSize + 1) * 4 > mSlots.size() * 3) {
+        grow();
+    }
+    const uint64_t key = makeKey(path);
+    Slot& slot = mSlots[findSlot(key)];
+    if (!slot.snapshot) {
+        mSize++;
+    }
+    slot.key = key;
+    slot.snapshot = snapshot;
+}
+
+bool TraversalPathIndex::erase(const LayerHierarchy::TraversalPath& path) {
+    if (mSize == 0) {
+        return false;
+    }
+    const size_t mask = mSlots.size() - 1;
+    size_t hole = findSlot(makeKey(path));
+    if (!mSlots[hole].snapshot) {
+        return false;
+    }
+    mSlots[hole].snapshot = nullptr;
+    mSize--;
+
+    // Shift the following entries of the probe sequence back instead of leaving a tombstone. An
+    // entry can fill the hole if the hole lies between its home slot and its current slot.
+    for (size_t i = (hole + 1) & mask; mSlots[i].snapshot; i = (i + 1) & mask) {
+        const size_t home = homeSlot(mSlots[i].key);
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            mSlots[hole] = mSlots[i];
+            mSlots[i].snapshot = nullptr;
+            hole = i;
+        }
+    }
+    return true;
+}
+
+void TraversalPathIndex::clear() {
+    mSlots.clear();
+    mSize = 0;
+    mCapacityBits = 0;
+}
+
+void TraversalPathIndex::grow() {
+    std::vector<Slot> oldSlots = std::move(mSlots);
+    mCapacityBits = mCapacityBits == 0 ? kInitialCapacityBits : mCapacityBits + 1;
+    mSlots = std::vector<Slot>(size_t(1) << mCapacityBits);
+    for (const Slot& slot : oldSlots) {
+        if (slot.snapshot) {
+            mSlots[findSlot(slot.key)] = slot;
+        }
+    }
+}
+
+} // namespace android::surfaceflinger::frontend
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "LayerHierarchy.h"
+
+namespace android::surfaceflinger::frontend {
+
+struct LayerSnapshot;
+
+// Maps traversal paths to their snapshots. Traversal paths are compared by their layer id and
+// mirror root id only, so both are packed into a single key and stored inline, together with the
+// snapshot, in an open addressing table with linear probing. A lookup usually touches a single
+// cache line, instead of chasing a node per entry as std::unordered_map does.
+class TraversalPathIndex {
+public:
+    // Returns the snapshot for the path, or nullptr if there is none.
+    LayerSnapshot* find(const LayerHierarchy::TraversalPath& path) const;
+
+    // Adds the snapshot for the path, or replaces the existing one.
+    void insert(const LayerHierarchy::TraversalPath& path, LayerSnapshot* snapshot);
+
+    // Returns true if the path was in the index.
+    bool erase(const LayerHierarchy::TraversalPath& path);
+
+    size_t size() const { return mSize; }
+    void clear();
+
+private:
+    struct Slot {
+        uint64_t key = 0;
+        // Empty slots have no snapshot.
+        LayerSnapshot* snapshot = nullptr;
+    };
+
+    static uint64_t makeKey(const LayerHierarchy::TraversalPath& path) {
+        return static_cast<uint64_t>(path.mirrorRootId) << 32 | path.id;
+    }
+    size_t homeSlot(uint64_t key) const;
+    // Returns the slot holding the key, or the empty slot where it would be inserted.
+    size_t findSlot(uint64_t key) const;
+    void grow();
+
+    std::vector<Slot> mSlots;
+    size_t mSize = 0;
+    // The capacity is a power of two, so that a hash maps to a slot with a shift.
+    uint32_t mCapacityBits = 0;
+};
+
+} // namespace android::surfaceflinger::frontend
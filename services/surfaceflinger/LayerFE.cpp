@@ -83,6 +83,7 @@ const compositionengine::LayerFECompositionState* LayerFE::getCompositionState()
 }
 
 bool LayerFE::onPreComposition(nsecs_t refreshStartTime, bool) {
+    std::scoped_lock lock(mCompositionResultMutex);
     mCompositionResult.refreshStartTime = refreshStartTime;
     return mSnapshot->hasReadyFrame;
 }
@@ -327,10 +328,12 @@ void LayerFE::prepareShadowClientComposition(LayerFE::LayerSettings& caster,
 
 void LayerFE::onLayerDisplayed(ftl::SharedFuture<FenceResult> futureFenceResult,
                                ui::LayerStack layerStack) {
+    std::scoped_lock lock(mCompositionResultMutex);
     mCompositionResult.releaseFences.emplace_back(std::move(futureFenceResult), layerStack);
 }
 
-CompositionResult&& LayerFE::stealCompositionResult() {
+CompositionResult LayerFE::stealCompositionResult() {
+    std::scoped_lock lock(mCompositionResultMutex);
     return std::move(mCompositionResult);
 }
 
@@ -355,6 +358,7 @@ bool LayerFE::hasRoundedCorners() const {
 }
 
 void LayerFE::setWasClientComposed(const sp<Fence>& fence) {
+    std::scoped_lock lock(mCompositionResultMutex);
     mCompositionResult.lastClientCompositionFence = fence;
 }
 
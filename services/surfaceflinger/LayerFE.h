@@ -18,6 +18,7 @@
 
 #include <android/gui/CachingHint.h>
 #include <gui/LayerMetadata.h>
+#include <mutex>
 #include "FrontEnd/LayerSnapshot.h"
 #include "compositionengine/LayerFE.h"
 #include "compositionengine/LayerFECompositionState.h"
@@ -49,7 +50,7 @@ public:
     const gui::LayerMetadata* getRelativeMetadata() const override;
     std::optional<compositionengine::LayerFE::LayerSettings> prepareClientComposition(
             compositionengine::LayerFE::ClientCompositionTargetSettings&) const;
-    CompositionResult&& stealCompositionResult();
+    CompositionResult stealCompositionResult();
 
     std::unique_ptr<surfaceflinger::frontend::LayerSnapshot> mSnapshot;
 
@@ -77,6 +78,8 @@ private:
 
     const sp<GraphicBuffer> getBuffer() const;
 
+    // Outputs presented in parallel may report results for the same layer concurrently.
+    std::mutex mCompositionResultMutex;
     CompositionResult mCompositionResult;
     std::string mName;
 };
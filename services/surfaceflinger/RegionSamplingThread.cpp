@@ -36,8 +36,15 @@
 #include <ui/DisplayStatInfo.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
 #include <string>
 
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "DisplayDevice.h"
 #include "DisplayRenderArea.h"
 #include "FrontEnd/LayerCreationArgs.h"
@@ -99,6 +106,8 @@ RegionSamplingThread::EnvironmentTimingTunables::EnvironmentTimingTunables() {
 RegionSamplingThread::RegionSamplingThread(SurfaceFlinger& flinger, const TimingTunables& tunables)
       : mFlinger(flinger),
         mTunables(tunables),
+        mDownscaleFactor(std::max(property_get_int32("debug.sf.region_sampling_downscale", 1), 1)),
+        mRowStep(std::max(property_get_int32("debug.sf.region_sampling_row_step", 1), 1)),
         mIdleTimer(
                 "RegSampIdle",
                 std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -196,29 +205,90 @@ void RegionSamplingThread::binderDied(const wp<IBinder>& who) {
     mDescriptors.erase(who);
 }
 
+namespace {
+
+// Sums the luma of the pixels, with an approximation of Rec. 709 primaries. The vectorized loops
+// compute the same luma for each pixel as the scalar one.
+uint32_t accumulateLuma(const uint32_t* pixels, int32_t count) {
+    uint32_t accumulatedLuma = 0;
+    int32_t i = 0;
+#if defined(__ARM_NEON)
+    const uint8x8_t rWeight = vdup_n_u8(7);
+    const uint8x8_t gWeight = vdup_n_u8(23);
+    const uint8x8_t bWeight = vdup_n_u8(2);
+    uint32x4_t sums = vdupq_n_u32(0);
+    for (; i + 16 <= count; i += 16) {
+        const uint8x16x4_t rgba = vld4q_u8(reinterpret_cast<const uint8_t*>(pixels + i));
+        uint16x8_t low = vmull_u8(vget_low_u8(rgba.val[0]), rWeight);
+        low = vmlal_u8(low, vget_low_u8(rgba.val[1]), gWeight);
+        low = vmlal_u8(low, vget_low_u8(rgba.val[2]), bWeight);
+        uint16x8_t high = vmull_u8(vget_high_u8(rgba.val[0]), rWeight);
+        high = vmlal_u8(high, vget_high_u8(rgba.val[1]), gWeight);
+        high = vmlal_u8(high, vget_high_u8(rgba.val[2]), bWeight);
+        sums = vpadalq_u16(sums, vshrq_n_u16(low, 5));
+        sums = vpadalq_u16(sums, vshrq_n_u16(high, 5));
+    }
+    accumulatedLuma = vgetq_lane_u32(sums, 0) + vgetq_lane_u32(sums, 1) +
+            vgetq_lane_u32(sums, 2) + vgetq_lane_u32(sums, 3);
+#elif defined(__SSE2__)
+    // Each pixel is split into 16-bit lanes of red and blue, and of green and alpha, so that
+    // r * 7 + b * 2 and g * 23 are each a multiply-add of adjacent lanes.
+    const __m128i redBlueMask = _mm_set1_epi32(0x00FF00FF);
+    const __m128i redBlueWeights = _mm_set1_epi32(2 << 16 | 7);
+    const __m128i greenWeights = _mm_set1_epi32(23);
+    __m128i sums = _mm_setzero_si128();
+    for (; i + 4 <= count; i += 4) {
+        const __m128i pixel = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i));
+        const __m128i redBlue = _mm_and_si128(pixel, redBlueMask);
+        const __m128i greenAlpha = _mm_srli_epi16(pixel, 8);
+        const __m128i luma = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(redBlue, redBlueWeights),
+                                                          _mm_madd_epi16(greenAlpha, greenWeights)),
+                                            5);
+        sums = _mm_add_epi32(sums, luma);
+    }
+    alignas(16) uint32_t lanes[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), sums);
+    accumulatedLuma = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for (; i < count; ++i) {
+        const uint32_t pixel = pixels[i];
+        const uint32_t r = pixel & 0xFF;
+        const uint32_t g = (pixel >> 8) & 0xFF;
+        const uint32_t b = (pixel >> 16) & 0xFF;
+        const uint32_t luma = (r * 7 + b * 2 + g * 23) >> 5;
+        accumulatedLuma += luma;
+    }
+    return accumulatedLuma;
+}
+
+int32_t divideRoundUp(int32_t value, int32_t divisor) {
+    return (value + divisor - 1) / divisor;
+}
+
+// Maps an area of the sampled region to the capture of the region downscaled by the given factor,
+// covering every pixel the area partially covers.
+Rect downscaleArea(const Rect& area, int32_t factor) {
+    return Rect(area.left / factor, area.top / factor, divideRoundUp(area.right, factor),
+                divideRoundUp(area.bottom, factor));
+}
+
+} // namespace
+
 float sampleArea(const uint32_t* data, int32_t width, int32_t height, int32_t stride,
-                 uint32_t orientation, const Rect& sample_area) {
+                 uint32_t orientation, const Rect& sample_area, int32_t rowStep) {
     if (!sample_area.isValid() || (sample_area.getWidth() > width) ||
-        (sample_area.getHeight() > height)) {
+        (sample_area.getHeight() > height) || rowStep < 1) {
         ALOGE("invalid sampling region requested");
         return 0.0f;
     }
 
-    const uint32_t pixelCount =
-            (sample_area.bottom - sample_area.top) * (sample_area.right - sample_area.left);
-    uint32_t accumulatedLuma = 0;
+    const int32_t columnCount = sample_area.right - sample_area.left;
+    uint64_t accumulatedLuma = 0;
+    uint64_t pixelCount = 0;
 
-    // Calculates luma with approximation of Rec. 709 primaries
-    for (int32_t row = sample_area.top; row < sample_area.bottom; ++row) {
-        const uint32_t* rowBase = data + row * stride;
-        for (int32_t column = sample_area.left; column < sample_area.right; ++column) {
-            uint32_t pixel = rowBase[column];
-            const uint32_t r = pixel & 0xFF;
-            const uint32_t g = (pixel >> 8) & 0xFF;
-            const uint32_t b = (pixel >> 16) & 0xFF;
-            const uint32_t luma = (r * 7 + b * 2 + g * 23) >> 5;
-            accumulatedLuma += luma;
-        }
+    for (int32_t row = sample_area.top; row < sample_area.bottom; row += rowStep) {
+        accumulatedLuma += accumulateLuma(data + row * stride + sample_area.left, columnCount);
+        pixelCount += columnCount;
     }
 
     return accumulatedLuma / (255.0f * pixelCount);
@@ -239,8 +309,12 @@ std::vector<float> RegionSamplingThread::sampleBuffer(
     std::vector<float> lumas(descriptors.size());
     std::transform(descriptors.begin(), descriptors.end(), lumas.begin(),
                    [&](auto const& descriptor) {
-                       return sampleArea(data.get(), width, height, stride, orientation,
-                                         descriptor.area - leftTop);
+                       Rect area = descriptor.area - leftTop;
+                       if (mDownscaleFactor > 1) {
+                           area = downscaleArea(area, mDownscaleFactor);
+                       }
+                       return sampleArea(data.get(), width, height, stride, orientation, area,
+                                         mRowStep);
                    });
     return lumas;
 }
@@ -276,11 +350,14 @@ void RegionSamplingThread::captureSample() {
     }
 
     const Rect sampledBounds = sampleRegion.bounds();
+    // The sampled region is rendered downscaled, which averages its pixels on the GPU.
+    const ui::Size captureSize(divideRoundUp(sampledBounds.getWidth(), mDownscaleFactor),
+                               divideRoundUp(sampledBounds.getHeight(), mDownscaleFactor));
     constexpr bool kUseIdentityTransform = false;
     constexpr bool kHintForSeamlessTransition = false;
 
     SurfaceFlinger::RenderAreaFuture renderAreaFuture = ftl::defer([=] {
-        return DisplayRenderArea::create(displayWeak, sampledBounds, sampledBounds.getSize(),
+        return DisplayRenderArea::create(displayWeak, sampledBounds, captureSize,
                                          ui::Dataspace::V0_SRGB, kUseIdentityTransform,
                                          kHintForSeamlessTransition);
     });
@@ -356,14 +433,14 @@ void RegionSamplingThread::captureSample() {
     }
 
     std::shared_ptr<renderengine::ExternalTexture> buffer = nullptr;
-    if (mCachedBuffer && mCachedBuffer->getBuffer()->getWidth() == sampledBounds.getWidth() &&
-        mCachedBuffer->getBuffer()->getHeight() == sampledBounds.getHeight()) {
+    if (mCachedBuffer && mCachedBuffer->getBuffer()->getWidth() == captureSize.getWidth() &&
+        mCachedBuffer->getBuffer()->getHeight() == captureSize.getHeight()) {
         buffer = mCachedBuffer;
     } else {
         const uint32_t usage =
                 GRALLOC_USAGE_SW_READ_OFTEN | GRALLOC_USAGE_HW_RENDER | GRALLOC_USAGE_HW_TEXTURE;
         sp<GraphicBuffer> graphicBuffer =
-                sp<GraphicBuffer>::make(sampledBounds.getWidth(), sampledBounds.getHeight(),
+                sp<GraphicBuffer>::make(captureSize.getWidth(), captureSize.getHeight(),
                                         PIXEL_FORMAT_RGBA_8888, 1, usage, "RegionSamplingThread");
         const status_t bufferStatus = graphicBuffer->initCheck();
         LOG_ALWAYS_FATAL_IF(bufferStatus != OK, "captureSample: Buffer failed to allocate: %d",
@@ -42,8 +42,9 @@ struct SamplingOffsetCallback;
 
 using gui::IRegionSamplingListener;
 
+// Returns the mean luma of the area of an RGBA_8888 buffer, sampling one row in every rowStep.
 float sampleArea(const uint32_t* data, int32_t width, int32_t height, int32_t stride,
-                 uint32_t orientation, const Rect& area);
+                 uint32_t orientation, const Rect& area, int32_t rowStep = 1);
 
 class RegionSamplingThread : public IBinder::DeathRecipient {
 public:
@@ -104,6 +105,12 @@ private:
 
     SurfaceFlinger& mFlinger;
     const TimingTunables mTunables;
+    // debug.sf.region_sampling_downscale
+    // The sampled region is captured this many times smaller in each dimension.
+    const int32_t mDownscaleFactor;
+    // debug.sf.region_sampling_row_step
+    // Only one row in this many of the capture is read to compute the luma.
+    const int32_t mRowStep;
     scheduler::OneShotTimer mIdleTimer;
 
     std::thread mThread;
@@ -20,10 +20,12 @@
 
 #define ATRACE_TAG ATRACE_TAG_GRAPHICS
 
+#include <inttypes.h>
 #include <pthread.h>
 #include <sched.h>
 #include <sys/types.h>
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <optional>
@@ -211,6 +213,28 @@ binder::Status EventThreadConnection::getLatestVsyncEventData(
     return binder::Status::ok();
 }
 
+binder::Status EventThreadConnection::getVsyncEventRing(gui::VsyncEventRingInfo* outInfo) {
+    ATRACE_CALL();
+    base::unique_fd ringFd;
+    size_t readerIndex = 0;
+    if (const status_t status =
+                mEventThread->getVsyncEventRing(sp<EventThreadConnection>::fromExisting(this),
+                                                &ringFd, &readerIndex);
+        status != NO_ERROR) {
+        return binder::Status::fromStatusT(status);
+    }
+
+    outInfo->ring = os::ParcelFileDescriptor(std::move(ringFd));
+    outInfo->readerIndex = static_cast<int32_t>(readerIndex);
+    return binder::Status::ok();
+}
+
+binder::Status EventThreadConnection::enableVsyncEventRing() {
+    ATRACE_CALL();
+    return binder::Status::fromStatusT(
+            mEventThread->enableVsyncEventRing(sp<EventThreadConnection>::fromExisting(this)));
+}
+
 status_t EventThreadConnection::postEvent(const DisplayEventReceiver::Event& event) {
     constexpr auto toStatus = [](ssize_t size) {
         return size < 0 ? status_t(size) : status_t(NO_ERROR);
@@ -380,6 +404,53 @@ VsyncEventData EventThread::getLatestVsyncEventData(
     return vsyncEventData;
 }
 
+status_t EventThread::getVsyncEventRing(const sp<EventThreadConnection>& connection,
+                                        base::unique_fd* outRingFd, size_t* outReaderIndex) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (!mVsyncEventRing) {
+        mVsyncEventRing = gui::VsyncEventRing::create();
+        if (!mVsyncEventRing) {
+            return NO_INIT;
+        }
+    }
+
+    if (!connection->vsyncEventRingIndex) {
+        auto it = std::find_if(mVsyncEventRingReaders.begin(), mVsyncEventRingReaders.end(),
+                               [](const wp<EventThreadConnection>& reader) {
+                                   return reader.promote() == nullptr;
+                               });
+        if (it == mVsyncEventRingReaders.end()) {
+            if (mVsyncEventRingReaders.size() >= gui::VsyncEventRing::kMaxReaders) {
+                ALOGW("No room in the vsync event ring for %s", toString(*connection).c_str());
+                return NO_MEMORY;
+            }
+            it = mVsyncEventRingReaders.emplace(mVsyncEventRingReaders.end());
+        }
+
+        *it = connection;
+        connection->vsyncEventRingIndex =
+                static_cast<size_t>(std::distance(mVsyncEventRingReaders.begin(), it));
+    }
+
+    *outRingFd = mVsyncEventRing->dupFd();
+    if (!outRingFd->ok()) {
+        return -errno;
+    }
+    *outReaderIndex = *connection->vsyncEventRingIndex;
+    return NO_ERROR;
+}
+
+status_t EventThread::enableVsyncEventRing(const sp<EventThreadConnection>& connection) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (!connection->vsyncEventRingIndex) {
+        return INVALID_OPERATION;
+    }
+    connection->vsyncEventRingEnabled = true;
+    return NO_ERROR;
+}
+
 void EventThread::enableSyntheticVsync(bool enable) {
     std::lock_guard<std::mutex> lock(mMutex);
     if (!mVSyncState || mVSyncState->synthetic == enable) {
@@ -472,6 +543,7 @@ void EventThread::threadMain(std::unique_lock<std::mutex>& lock) {
         }
 
         if (!consumers.empty()) {
+            publishToVsyncEventRing(*event, consumers);
             dispatchEvent(*event, consumers);
             consumers.clear();
         }
@@ -679,6 +751,49 @@ void EventThread::dispatchEvent(const DisplayEventReceiver::Event& event,
     }
 }
 
+void EventThread::publishToVsyncEventRing(const DisplayEventReceiver::Event& event,
+                                          DisplayEventConsumers& consumers) {
+    if (!mVsyncEventRing || event.header.type != DisplayEventReceiver::DISPLAY_EVENT_VSYNC) {
+        return;
+    }
+
+    // Readers with the same frame interval share a single event, including its frame timelines.
+    std::vector<std::pair<nsecs_t, std::vector<size_t>>> readersByFrameInterval;
+    for (const auto& consumer : consumers) {
+        if (!consumer->vsyncEventRingEnabled) {
+            continue;
+        }
+
+        const nsecs_t frameInterval = mGetVsyncPeriodFunction(consumer->mOwnerUid);
+        auto it = std::find_if(readersByFrameInterval.begin(), readersByFrameInterval.end(),
+                               [frameInterval](const auto& readers) {
+                                   return readers.first == frameInterval;
+                               });
+        if (it == readersByFrameInterval.end()) {
+            it = readersByFrameInterval.emplace(readersByFrameInterval.end(), frameInterval,
+                                                std::vector<size_t>());
+        }
+        it->second.push_back(*consumer->vsyncEventRingIndex);
+    }
+
+    consumers.erase(std::remove_if(consumers.begin(), consumers.end(),
+                                   [](const sp<EventThreadConnection>& consumer) {
+                                       return consumer->vsyncEventRingEnabled;
+                                   }),
+                    consumers.end());
+
+    for (const auto& [frameInterval, readerIndices] : readersByFrameInterval) {
+        ATRACE_FORMAT("%s readers=%zu", __func__, readerIndices.size());
+        DisplayEventReceiver::Event copy = event;
+        copy.vsync.vsyncData.frameInterval = frameInterval;
+        generateFrameTimeline(copy.vsync.vsyncData, frameInterval, copy.header.timestamp,
+                              event.vsync.vsyncData.preferredExpectedPresentationTime(),
+                              event.vsync.vsyncData.preferredDeadlineTimestamp());
+        mVsyncEventRing->publish(copy, readerIndices);
+        mVsyncEventRingPublishCount++;
+    }
+}
+
 void EventThread::dump(std::string& result) const {
     std::lock_guard<std::mutex> lock(mMutex);
 
@@ -708,6 +823,16 @@ void EventThread::dump(std::string& result) const {
             StringAppendF(&result, "    %s\n", toString(*connection).c_str());
         }
     }
+
+    if (mVsyncEventRing) {
+        const auto readerCount =
+                std::count_if(mVsyncEventRingReaders.cbegin(), mVsyncEventRingReaders.cend(),
+                              [](const wp<EventThreadConnection>& reader) {
+                                  return reader.promote() != nullptr;
+                              });
+        StringAppendF(&result, "  vsync event ring: readers=%zu published=%" PRIu64 "\n",
+                      static_cast<size_t>(readerCount), mVsyncEventRingPublishCount);
+    }
     result += '\n';
 }
 
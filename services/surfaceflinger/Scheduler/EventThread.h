@@ -20,6 +20,7 @@
 #include <android/gui/BnDisplayEventConnection.h>
 #include <gui/DisplayEventReceiver.h>
 #include <private/gui/BitTube.h>
+#include <private/gui/VsyncEventRing.h>
 #include <sys/types.h>
 #include <utils/Errors.h>
 
@@ -27,6 +28,7 @@
 #include <condition_variable>
 #include <cstdint>
 #include <deque>
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <thread>
@@ -79,6 +81,8 @@ public:
     binder::Status setVsyncRate(int rate) override;
     binder::Status requestNextVsync() override; // asynchronous
     binder::Status getLatestVsyncEventData(ParcelableVsyncEventData* outVsyncEventData) override;
+    binder::Status getVsyncEventRing(gui::VsyncEventRingInfo* outInfo) override;
+    binder::Status enableVsyncEventRing() override;
 
     // Called in response to requestNextVsync.
     const ResyncCallback resyncCallback;
@@ -90,6 +94,11 @@ public:
     /** The frame rate set to the attached choreographer. */
     Fps frameRate;
 
+    /** The index of the connection in the vsync event ring, if it has one. */
+    std::optional<size_t> vsyncEventRingIndex;
+    /** Whether vsync events are delivered through the vsync event ring rather than the BitTube. */
+    bool vsyncEventRingEnabled = false;
+
 private:
     virtual void onFirstRef();
     EventThread* const mEventThread;
@@ -130,6 +139,13 @@ public:
     virtual void requestNextVsync(const sp<EventThreadConnection>& connection) = 0;
     virtual VsyncEventData getLatestVsyncEventData(
             const sp<EventThreadConnection>& connection) const = 0;
+    // Returns a new file descriptor for the shared vsync event ring along with the reader index
+    // of the connection. Vsync events are still posted to its BitTube until the ring is enabled.
+    virtual status_t getVsyncEventRing(const sp<EventThreadConnection>& connection,
+                                       base::unique_fd* outRingFd, size_t* outReaderIndex) = 0;
+    // Delivers the vsync events of the connection through the vsync event ring rather than its
+    // BitTube, once the client has mapped the ring.
+    virtual status_t enableVsyncEventRing(const sp<EventThreadConnection>& connection) = 0;
 
     // Retrieves the number of event connections tracked by this EventThread.
     virtual size_t getEventThreadConnectionCount() = 0;
@@ -157,6 +173,9 @@ public:
     void requestNextVsync(const sp<EventThreadConnection>& connection) override;
     VsyncEventData getLatestVsyncEventData(
             const sp<EventThreadConnection>& connection) const override;
+    status_t getVsyncEventRing(const sp<EventThreadConnection>& connection,
+                               base::unique_fd* outRingFd, size_t* outReaderIndex) override;
+    status_t enableVsyncEventRing(const sp<EventThreadConnection>& connection) override;
 
     void enableSyntheticVsync(bool) override;
 
@@ -187,6 +206,10 @@ private:
                             const sp<EventThreadConnection>& connection) const REQUIRES(mMutex);
     void dispatchEvent(const DisplayEventReceiver::Event& event,
                        const DisplayEventConsumers& consumers) REQUIRES(mMutex);
+    // Publishes a vsync event to the consumers that read the vsync event ring, with one event per
+    // frame interval, and removes them from consumers.
+    void publishToVsyncEventRing(const DisplayEventReceiver::Event& event,
+                                 DisplayEventConsumers& consumers) REQUIRES(mMutex);
 
     void removeDisplayEventConnectionLocked(const wp<EventThreadConnection>& connection)
             REQUIRES(mMutex);
@@ -225,6 +248,12 @@ private:
     std::vector<wp<EventThreadConnection>> mDisplayEventConnections GUARDED_BY(mMutex);
     std::deque<DisplayEventReceiver::Event> mPendingEvents GUARDED_BY(mMutex);
 
+    // Created when the first connection asks for it. Readers are indexed by their position in
+    // mVsyncEventRingReaders, and the slots of destroyed connections are reused.
+    std::unique_ptr<gui::VsyncEventRing> mVsyncEventRing GUARDED_BY(mMutex);
+    std::vector<wp<EventThreadConnection>> mVsyncEventRingReaders GUARDED_BY(mMutex);
+    uint64_t mVsyncEventRingPublishCount GUARDED_BY(mMutex) = 0;
+
     // VSYNC state of connected display.
     struct VSyncState {
         explicit VSyncState(PhysicalDisplayId displayId) : displayId(displayId) {}
@@ -224,7 +224,8 @@ VSyncDispatchTimerQueue::VSyncDispatchTimerQueue(std::unique_ptr<TimeKeeper> tk,
       : mTimeKeeper(std::move(tk)),
         mTracker(std::move(tracker)),
         mTimerSlack(timerSlack),
-        mMinVsyncDistance(minVsyncDistance) {}
+        mMinVsyncDistance(minVsyncDistance),
+        mModelGeneration(mTracker->modelGeneration()) {}
 
 VSyncDispatchTimerQueue::~VSyncDispatchTimerQueue() {
     std::lock_guard lock(mMutex);
@@ -251,35 +252,69 @@ void VSyncDispatchTimerQueue::rearmTimer(nsecs_t now) {
     rearmTimerSkippingUpdateFor(now, mCallbacks.end());
 }
 
+void VSyncDispatchTimerQueue::enqueueWakeup(CallbackToken token,
+                                            const VSyncDispatchTimerQueueEntry& callback) {
+    if (const auto wakeupTime = callback.wakeupTime()) {
+        mWakeupQueue.emplace(*wakeupTime, token);
+    }
+}
+
+void VSyncDispatchTimerQueue::dequeueWakeup(CallbackToken token,
+                                            const VSyncDispatchTimerQueueEntry& callback) {
+    if (const auto wakeupTime = callback.wakeupTime()) {
+        mWakeupQueue.erase({*wakeupTime, token});
+    }
+}
+
+void VSyncDispatchTimerQueue::updateCallback(CallbackMap::iterator const& it, nsecs_t now) {
+    auto& callback = it->second;
+    dequeueWakeup(it->first, *callback);
+    callback->update(*mTracker, now);
+    enqueueWakeup(it->first, *callback);
+}
+
 void VSyncDispatchTimerQueue::rearmTimerSkippingUpdateFor(
         nsecs_t now, CallbackMap::iterator const& skipUpdateIt) {
-    std::optional<nsecs_t> min;
-    std::optional<nsecs_t> targetVsync;
-    std::optional<std::string_view> nextWakeupName;
-    for (auto it = mCallbacks.begin(); it != mCallbacks.end(); it++) {
-        auto& callback = it->second;
-        if (!callback->wakeupTime() && !callback->hasPendingWorkloadUpdate()) {
-            continue;
-        }
+    const auto pendingWorkloadUpdates = std::exchange(mPendingWorkloadUpdates, {});
 
-        if (it != skipUpdateIt) {
-            callback->update(*mTracker, now);
+    // The wakeup time of an armed callback only moves if the tracker updated its model since the
+    // callback was predicted, in which case every armed callback is updated. Otherwise, only the
+    // callbacks with a pending workload update are, and the next wakeup is the head of the queue.
+    const auto modelGeneration = mTracker->modelGeneration();
+    if (std::exchange(mModelGeneration, modelGeneration) != modelGeneration) {
+        for (auto it = mCallbacks.begin(); it != mCallbacks.end(); it++) {
+            auto& callback = it->second;
+            if (!callback->wakeupTime() && !callback->hasPendingWorkloadUpdate()) {
+                continue;
+            }
+
+            if (it != skipUpdateIt) {
+                updateCallback(it, now);
+            }
         }
-        auto const wakeupTime = *callback->wakeupTime();
-        if (!min || *min > wakeupTime) {
-            nextWakeupName = callback->name();
-            min = wakeupTime;
-            targetVsync = callback->targetVsync();
+    } else {
+        for (const auto token : pendingWorkloadUpdates) {
+            const auto it = mCallbacks.find(token);
+            if (it != mCallbacks.end() && it != skipUpdateIt) {
+                updateCallback(it, now);
+            }
         }
     }
 
-    if (min && min < mIntendedWakeupTime) {
-        if (ATRACE_ENABLED() && nextWakeupName && targetVsync) {
-            ftl::Concat trace(ftl::truncated<5>(*nextWakeupName), " alarm in ", ns2us(*min - now),
-                              "us; VSYNC in ", ns2us(*targetVsync - now), "us");
+    if (skipUpdateIt != mCallbacks.end() && skipUpdateIt->second->hasPendingWorkloadUpdate()) {
+        mPendingWorkloadUpdates.push_back(skipUpdateIt->first);
+    }
+
+    if (!mWakeupQueue.empty() && mWakeupQueue.begin()->first < mIntendedWakeupTime) {
+        const auto [wakeupTime, token] = *mWakeupQueue.begin();
+        if (ATRACE_ENABLED()) {
+            const auto& callback = mCallbacks.at(token);
+            ftl::Concat trace(ftl::truncated<5>(callback->name()), " alarm in ",
+                              ns2us(wakeupTime - now), "us; VSYNC in ",
+                              ns2us(*callback->targetVsync() - now), "us");
             ATRACE_NAME(trace.c_str());
         }
-        setTimer(*min, now);
+        setTimer(wakeupTime, now);
     } else {
         ATRACE_NAME("cancel timer");
         cancelTimer();
@@ -298,21 +333,19 @@ void VSyncDispatchTimerQueue::timerCallback() {
         std::lock_guard lock(mMutex);
         auto const now = mTimeKeeper->now();
         mLastTimerCallback = now;
-        for (auto it = mCallbacks.begin(); it != mCallbacks.end(); it++) {
-            auto& callback = it->second;
-            auto const wakeupTime = callback->wakeupTime();
-            if (!wakeupTime) {
-                continue;
+        auto const lagAllowance = std::max(now - mIntendedWakeupTime, static_cast<nsecs_t>(0));
+        while (!mWakeupQueue.empty()) {
+            auto const [wakeupTime, token] = *mWakeupQueue.begin();
+            if (wakeupTime >= mIntendedWakeupTime + mTimerSlack + lagAllowance) {
+                break;
             }
+            mWakeupQueue.erase(mWakeupQueue.begin());
 
+            auto& callback = mCallbacks.at(token);
             auto const readyTime = callback->readyTime();
-
-            auto const lagAllowance = std::max(now - mIntendedWakeupTime, static_cast<nsecs_t>(0));
-            if (*wakeupTime < mIntendedWakeupTime + mTimerSlack + lagAllowance) {
-                callback->executing();
-                invocations.emplace_back(Invocation{callback, *callback->lastExecutedVsyncTarget(),
-                                                    *wakeupTime, *readyTime});
-            }
+            callback->executing();
+            invocations.emplace_back(Invocation{callback, *callback->lastExecutedVsyncTarget(),
+                                                wakeupTime, *readyTime});
         }
 
         mIntendedWakeupTime = kInvalidTime;
@@ -344,6 +377,8 @@ void VSyncDispatchTimerQueue::unregisterCallback(CallbackToken token) {
         auto it = mCallbacks.find(token);
         if (it != mCallbacks.end()) {
             entry = it->second;
+            dequeueWakeup(token, *entry);
+            std::erase(mPendingWorkloadUpdates, token);
             mCallbacks.erase(it);
         }
     }
@@ -372,11 +407,16 @@ ScheduleResult VSyncDispatchTimerQueue::scheduleLocked(CallbackToken token,
      * timer recalculation to avoid cancelling a callback that is about to fire. */
     auto const rearmImminent = now > mIntendedWakeupTime;
     if (CC_UNLIKELY(rearmImminent)) {
+        if (!callback->hasPendingWorkloadUpdate()) {
+            mPendingWorkloadUpdates.push_back(token);
+        }
         callback->addPendingWorkloadUpdate(scheduleTiming);
         return getExpectedCallbackTime(*mTracker, now, scheduleTiming);
     }
 
+    dequeueWakeup(token, *callback);
     const ScheduleResult result = callback->schedule(scheduleTiming, *mTracker, now);
+    enqueueWakeup(token, *callback);
     if (!result.has_value()) {
         return {};
     }
@@ -414,6 +454,7 @@ CancelResult VSyncDispatchTimerQueue::cancel(CallbackToken token) {
 
     auto const wakeupTime = callback->wakeupTime();
     if (wakeupTime) {
+        dequeueWakeup(token, *callback);
         callback->disarm();
 
         if (*wakeupTime == mIntendedWakeupTime) {
@@ -436,6 +477,7 @@ void VSyncDispatchTimerQueue::dump(std::string& result) const {
     StringAppendF(&result, "\tmLastTimerCallback: %.2fms ago mLastTimerSchedule: %.2fms ago\n",
                   (mTimeKeeper->now() - mLastTimerCallback) / 1e6f,
                   (mTimeKeeper->now() - mLastTimerSchedule) / 1e6f);
+    StringAppendF(&result, "\tArmed callbacks: %zu\n", mWakeupQueue.size());
     StringAppendF(&result, "\tCallbacks:\n");
     for (const auto& [token, entry] : mCallbacks) {
         entry->dump(result);
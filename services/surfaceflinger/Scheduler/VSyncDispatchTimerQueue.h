@@ -19,9 +19,12 @@
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <set>
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <android-base/thread_annotations.h>
 
@@ -109,7 +112,9 @@ private:
 
 /*
  * VSyncDispatchTimerQueue is a class that will dispatch callbacks as per VSyncDispatch interface
- * using a single timer queue.
+ * using a single timer queue. Armed callbacks are kept ordered by wakeup time, so that finding the
+ * next wakeup and dispatching expired callbacks do not visit every registered callback. Armed
+ * callbacks are only predicted again when the model of the tracker has changed.
  */
 class VSyncDispatchTimerQueue : public VSyncDispatch {
 public:
@@ -137,6 +142,7 @@ private:
 
     using CallbackMap =
             std::unordered_map<CallbackToken, std::shared_ptr<VSyncDispatchTimerQueueEntry>>;
+    using WakeupQueue = std::set<std::pair<nsecs_t, CallbackToken>>;
 
     void timerCallback();
     void setTimer(nsecs_t, nsecs_t) REQUIRES(mMutex);
@@ -145,6 +151,12 @@ private:
             REQUIRES(mMutex);
     void cancelTimer() REQUIRES(mMutex);
     ScheduleResult scheduleLocked(CallbackToken, ScheduleTiming) REQUIRES(mMutex);
+    void updateCallback(CallbackMap::iterator const&, nsecs_t now) REQUIRES(mMutex);
+
+    // Keep mWakeupQueue in sync with the wakeup times of the callbacks. A callback is dequeued
+    // before its arming state changes, and enqueued again afterwards.
+    void enqueueWakeup(CallbackToken, const VSyncDispatchTimerQueueEntry&) REQUIRES(mMutex);
+    void dequeueWakeup(CallbackToken, const VSyncDispatchTimerQueueEntry&) REQUIRES(mMutex);
 
     static constexpr nsecs_t kInvalidTime = std::numeric_limits<int64_t>::max();
     std::unique_ptr<TimeKeeper> const mTimeKeeper;
@@ -158,6 +170,13 @@ private:
     CallbackMap mCallbacks GUARDED_BY(mMutex);
     nsecs_t mIntendedWakeupTime GUARDED_BY(mMutex) = kInvalidTime;
 
+    // Armed callbacks, ordered by wakeup time.
+    WakeupQueue mWakeupQueue GUARDED_BY(mMutex);
+    // Callbacks with a workload update to apply on the next rearm.
+    std::vector<CallbackToken> mPendingWorkloadUpdates GUARDED_BY(mMutex);
+    // The generation of the tracker model that the armed callbacks were predicted with.
+    uint64_t mModelGeneration GUARDED_BY(mMutex);
+
     // For debugging purposes
     nsecs_t mLastTimerCallback GUARDED_BY(mMutex) = kInvalidTime;
     nsecs_t mLastTimerSchedule GUARDED_BY(mMutex) = kInvalidTime;
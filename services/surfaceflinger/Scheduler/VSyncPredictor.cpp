@@ -44,15 +44,37 @@ using base::StringAppendF;
 
 static auto constexpr kMaxPercent = 100u;
 
+// Ordinals are scaled up for fixed-point arithmetic in the least-squares fit.
+static constexpr int64_t kScalingFactor = 1000;
+
+namespace {
+
+// Rounds a duration to the nearest number of periods, which may be negative.
+int64_t roundToPeriods(nsecs_t duration, nsecs_t period) {
+    const nsecs_t halfPeriodLater = duration + period / 2;
+    return halfPeriodLater >= 0 ? halfPeriodLater / period
+                                : -((period - 1 - halfPeriodLater) / period);
+}
+
+nsecs_t median(std::vector<nsecs_t>& values) {
+    const auto middle = values.begin() + static_cast<std::ptrdiff_t>(values.size() / 2);
+    std::nth_element(values.begin(), middle, values.end());
+    return *middle;
+}
+
+} // namespace
+
 VSyncPredictor::~VSyncPredictor() = default;
 
 VSyncPredictor::VSyncPredictor(PhysicalDisplayId id, nsecs_t idealPeriod, size_t historySize,
-                               size_t minimumSamplesForPrediction, uint32_t outlierTolerancePercent)
+                               size_t minimumSamplesForPrediction, uint32_t outlierTolerancePercent,
+                               Estimator estimator)
       : mId(id),
         mTraceOn(property_get_bool("debug.sf.vsp_trace", false)),
         kHistorySize(historySize),
         kMinimumSamplesForPrediction(minimumSamplesForPrediction),
         kOutlierTolerancePercent(std::min(outlierTolerancePercent, kMaxPercent)),
+        mEstimator(estimator),
         mIdealPeriod(idealPeriod) {
     resetModel();
 }
@@ -103,6 +125,10 @@ nsecs_t VSyncPredictor::currentPeriod() const {
 bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
     std::lock_guard lock(mMutex);
 
+    // Even a timestamp that is not consistent with the model moves the known timestamp that
+    // predictions fall back to.
+    mModelGeneration++;
+
     if (!validate(timestamp)) {
         // VSR could elect to ignore the incongruent timestamp or resetModel(). If ts is ignored,
         // don't insert this ts into mTimestamps ringbuffer. If we are still
@@ -122,22 +148,160 @@ bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
         return false;
     }
 
+    const nsecs_t currentPeriod = mRateMap.find(mIdealPeriod)->second.slope;
+    if (mTimestamps.empty()) {
+        mOldestTimestamp = timestamp;
+        mOldestOrdinal = 0;
+        mSnap = {.period = currentPeriod,
+                 .timestamp = timestamp,
+                 .ordinal = 0,
+                 .margin = currentPeriod / 2,
+                 .maxOrdinal = 0};
+    }
+    // Snap the timestamp to a vsync count relative to the oldest timestamp, so that missed vsyncs
+    // are accounted for.
+    const int64_t ordinal =
+            mOldestOrdinal + roundToPeriods(timestamp - mOldestTimestamp, currentPeriod);
+
+    const size_t previousIndex = mLastTimestampIndex;
     if (mTimestamps.size() != kHistorySize) {
         mTimestamps.push_back(timestamp);
+        mOrdinals.push_back(ordinal);
         mLastTimestampIndex = next(mLastTimestampIndex);
     } else {
         mLastTimestampIndex = next(mLastTimestampIndex);
+        // The evicted sample is the first one added, so the sample added after it no longer has a
+        // predecessor.
+        if (mTimestamps[next(mLastTimestampIndex)] < mTimestamps[mLastTimestampIndex]) {
+            mNumOutOfOrderTimestamps--;
+        }
+        accumulate(mLastTimestampIndex, -1);
         mTimestamps[mLastTimestampIndex] = timestamp;
+        mOrdinals[mLastTimestampIndex] = ordinal;
+    }
+    if (mTimestamps.size() > 1 && timestamp < mTimestamps[previousIndex]) {
+        mNumOutOfOrderTimestamps++;
+    }
+    accumulate(mLastTimestampIndex, 1);
+    rebaseToOldest();
+    addToSnap(mLastTimestampIndex);
+    if (needsResnap(currentPeriod)) {
+        resnap(currentPeriod);
     }
 
     traceInt64If("VSP-ts", timestamp);
 
+    auto it = mRateMap.find(mIdealPeriod);
     const size_t numSamples = mTimestamps.size();
     if (numSamples < kMinimumSamplesForPrediction) {
-        mRateMap[mIdealPeriod] = {mIdealPeriod, 0};
+        // Keep the period previously learned for this ideal period, if any, until there are enough
+        // samples for a new model. It is closer to the actual period than the ideal period is, so
+        // predictions are more accurate right after a mode switch.
+        it->second.intercept = 0;
         return true;
     }
 
+    const auto model = mEstimator == Estimator::TheilSen ? fitTheilSen() : fitLeastSquares();
+    if (CC_UNLIKELY(!model)) {
+        it->second = {mIdealPeriod, 0};
+        clearTimestamps();
+        return false;
+    }
+
+    const auto [anticipatedPeriod, intercept] = *model;
+    auto const percent = std::abs(anticipatedPeriod - mIdealPeriod) * kMaxPercent / mIdealPeriod;
+    if (percent >= kOutlierTolerancePercent) {
+        it->second = {mIdealPeriod, 0};
+        clearTimestamps();
+        return false;
+    }
+
+    traceInt64If("VSP-period", anticipatedPeriod);
+    traceInt64If("VSP-intercept", intercept);
+
+    it->second = {anticipatedPeriod, intercept};
+
+    ALOGV("model update ts %" PRIu64 ": %" PRId64 " slope: %" PRId64 " intercept: %" PRId64,
+          mId.value, timestamp, anticipatedPeriod, intercept);
+    return true;
+}
+
+void VSyncPredictor::accumulate(size_t i, int64_t sign) {
+    const int64_t x = mOrdinals[i] - mOldestOrdinal;
+    const int64_t y = mTimestamps[i] - mOldestTimestamp;
+    mSums.x += sign * x;
+    mSums.y += sign * y;
+    mSums.xy += sign * x * y;
+    mSums.xx += sign * x * x;
+}
+
+size_t VSyncPredictor::oldestIndex() const {
+    // While the timestamps were added in increasing order, the oldest one is the first one added,
+    // which is the next one to be evicted.
+    if (CC_LIKELY(mNumOutOfOrderTimestamps == 0)) {
+        return next(mLastTimestampIndex);
+    }
+    return static_cast<size_t>(std::min_element(mTimestamps.begin(), mTimestamps.end()) -
+                               mTimestamps.begin());
+}
+
+void VSyncPredictor::rebaseToOldest() {
+    const size_t oldest = oldestIndex();
+    const int64_t dx = mOrdinals[oldest] - mOldestOrdinal;
+    const int64_t dy = mTimestamps[oldest] - mOldestTimestamp;
+    if (dx == 0 && dy == 0) {
+        return;
+    }
+
+    // Shifting each X_i by dx and Y_i by dy:
+    // Sigma_i( (X_i - dx) * (Y_i - dy) ) = Sigma_i( X_i * Y_i ) - dy * Sigma_i( X_i )
+    //                                      - dx * Sigma_i( Y_i ) + n * dx * dy
+    // Sigma_i( (X_i - dx) ^ 2 ) = Sigma_i( X_i ^ 2 ) - 2 * dx * Sigma_i( X_i ) + n * dx ^ 2
+    const auto n = static_cast<int64_t>(mTimestamps.size());
+    mSums.xy += n * dx * dy - dy * mSums.x - dx * mSums.y;
+    mSums.xx += n * dx * dx - 2 * dx * mSums.x;
+    mSums.x -= n * dx;
+    mSums.y -= n * dy;
+
+    mOldestTimestamp = mTimestamps[oldest];
+    mOldestOrdinal = mOrdinals[oldest];
+}
+
+nsecs_t VSyncPredictor::snapResidual(nsecs_t timestamp, int64_t ordinal) const {
+    return timestamp - mSnap.timestamp - (ordinal - mSnap.ordinal) * mSnap.period;
+}
+
+void VSyncPredictor::addToSnap(size_t i) {
+    mSnap.margin = std::min(mSnap.margin,
+                            mSnap.period / 2 - std::abs(snapResidual(mTimestamps[i], mOrdinals[i])));
+    mSnap.maxOrdinal = std::max(mSnap.maxOrdinal, mOrdinals[i]);
+}
+
+bool VSyncPredictor::needsResnap(nsecs_t period) const {
+    // Snapping each sample relative to the oldest one with |period| moves its residual by at most
+    // the residual of the oldest sample, plus the change in period for each vsync in between. If
+    // that stays within the margin, every sample keeps its ordinal.
+    const nsecs_t drift = std::abs(snapResidual(mOldestTimestamp, mOldestOrdinal)) +
+            (mSnap.maxOrdinal - mOldestOrdinal + 1) * std::abs(period - mSnap.period) + 1;
+    return mSnap.margin < drift;
+}
+
+void VSyncPredictor::resnap(nsecs_t period) {
+    mOldestOrdinal = 0;
+    mSnap = {.period = period,
+             .timestamp = mOldestTimestamp,
+             .ordinal = 0,
+             .margin = period / 2,
+             .maxOrdinal = 0};
+    mSums = {};
+    for (size_t i = 0; i < mTimestamps.size(); i++) {
+        mOrdinals[i] = roundToPeriods(mTimestamps[i] - mOldestTimestamp, period);
+        accumulate(i, 1);
+        addToSnap(i);
+    }
+}
+
+auto VSyncPredictor::fitLeastSquares() const -> std::optional<Model> {
     // This is a 'simple linear regression' calculation of Y over X, with Y being the
     // vsync timestamps, and X being the ordinal of vsync count.
     // The calculated slope is the vsync period.
@@ -153,72 +317,55 @@ bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
     //
     // intercept = mean(Y) - slope * mean(X)
     //
-    std::vector<nsecs_t> vsyncTS(numSamples);
-    std::vector<nsecs_t> ordinals(numSamples);
-
-    // Normalizing to the oldest timestamp cuts down on error in calculating the intercept.
-    const auto oldestTS = *std::min_element(mTimestamps.begin(), mTimestamps.end());
-    auto it = mRateMap.find(mIdealPeriod);
-    auto const currentPeriod = it->second.slope;
+    // Both sums are expanded in terms of the running sums, so that the fit does not depend on the
+    // number of samples. X and Y are relative to the oldest timestamp, which cuts down on error in
+    // calculating the intercept.
+    const auto n = static_cast<int64_t>(mTimestamps.size());
 
     // The mean of the ordinals must be precise for the intercept calculation, so scale them up for
     // fixed-point arithmetic.
-    constexpr int64_t kScalingFactor = 1000;
+    const nsecs_t meanTS = mSums.y / n;
+    const int64_t meanOrdinal = mSums.x * kScalingFactor / n;
 
-    nsecs_t meanTS = 0;
-    nsecs_t meanOrdinal = 0;
+    const int64_t top = kScalingFactor * mSums.xy - meanOrdinal * mSums.y -
+            kScalingFactor * meanTS * mSums.x + n * meanTS * meanOrdinal;
+    const int64_t bottom = kScalingFactor * kScalingFactor * mSums.xx -
+            2 * kScalingFactor * meanOrdinal * mSums.x + n * meanOrdinal * meanOrdinal;
 
-    for (size_t i = 0; i < numSamples; i++) {
-        const auto timestamp = mTimestamps[i] - oldestTS;
-        vsyncTS[i] = timestamp;
-        meanTS += timestamp;
-
-        const auto ordinal = currentPeriod == 0
-                ? 0
-                : (vsyncTS[i] + currentPeriod / 2) / currentPeriod * kScalingFactor;
-        ordinals[i] = ordinal;
-        meanOrdinal += ordinal;
+    if (CC_UNLIKELY(bottom == 0)) {
+        return std::nullopt;
     }
 
-    meanTS /= numSamples;
-    meanOrdinal /= numSamples;
+    nsecs_t const anticipatedPeriod = top * kScalingFactor / bottom;
+    nsecs_t const intercept = meanTS - (anticipatedPeriod * meanOrdinal / kScalingFactor);
+    return Model{anticipatedPeriod, intercept};
+}
 
-    for (size_t i = 0; i < numSamples; i++) {
-        vsyncTS[i] -= meanTS;
-        ordinals[i] -= meanOrdinal;
-    }
+auto VSyncPredictor::fitTheilSen() const -> std::optional<Model> {
+    const size_t numSamples = mTimestamps.size();
+    auto& values = mTheilSenScratch;
 
-    nsecs_t top = 0;
-    nsecs_t bottom = 0;
+    values.clear();
     for (size_t i = 0; i < numSamples; i++) {
-        top += vsyncTS[i] * ordinals[i];
-        bottom += ordinals[i] * ordinals[i];
+        for (size_t j = i + 1; j < numSamples; j++) {
+            const int64_t vsyncs = mOrdinals[j] - mOrdinals[i];
+            if (vsyncs != 0) {
+                values.push_back((mTimestamps[j] - mTimestamps[i]) / vsyncs);
+            }
+        }
     }
 
-    if (CC_UNLIKELY(bottom == 0)) {
-        it->second = {mIdealPeriod, 0};
-        clearTimestamps();
-        return false;
+    if (CC_UNLIKELY(values.empty())) {
+        return std::nullopt;
     }
+    const nsecs_t slope = median(values);
 
-    nsecs_t const anticipatedPeriod = top * kScalingFactor / bottom;
-    nsecs_t const intercept = meanTS - (anticipatedPeriod * meanOrdinal / kScalingFactor);
-
-    auto const percent = std::abs(anticipatedPeriod - mIdealPeriod) * kMaxPercent / mIdealPeriod;
-    if (percent >= kOutlierTolerancePercent) {
-        it->second = {mIdealPeriod, 0};
-        clearTimestamps();
-        return false;
+    values.clear();
+    for (size_t i = 0; i < numSamples; i++) {
+        values.push_back(mTimestamps[i] - mOldestTimestamp -
+                         slope * (mOrdinals[i] - mOldestOrdinal));
     }
-
-    traceInt64If("VSP-period", anticipatedPeriod);
-    traceInt64If("VSP-intercept", intercept);
-
-    it->second = {anticipatedPeriod, intercept};
-
-    ALOGV("model update ts %" PRIu64 ": %" PRId64 " slope: %" PRId64 " intercept: %" PRId64,
-          mId.value, timestamp, anticipatedPeriod, intercept);
-    return true;
+    return Model{slope, median(values)};
 }
 
 auto VSyncPredictor::getVsyncSequenceLocked(nsecs_t timestamp) const -> VsyncSequence {
@@ -242,7 +389,7 @@ nsecs_t VSyncPredictor::nextAnticipatedVSyncTimeFromLocked(nsecs_t timePoint) co
         return knownTimestamp + numPeriodsOut * mIdealPeriod;
     }
 
-    auto const oldest = *std::min_element(mTimestamps.begin(), mTimestamps.end());
+    auto const oldest = mOldestTimestamp;
 
     // See b/145667109, the ordinal calculation must take into account the intercept.
     auto const zeroPoint = oldest + intercept;
@@ -336,6 +483,12 @@ void VSyncPredictor::setRenderRate(Fps fps) {
     ALOGV("%s %s: %s", __func__, to_string(mId).c_str(), to_string(fps).c_str());
     std::lock_guard lock(mMutex);
     mRenderRate = fps;
+    mModelGeneration++;
+}
+
+uint64_t VSyncPredictor::modelGeneration() const {
+    std::lock_guard lock(mMutex);
+    return mModelGeneration;
 }
 
 VSyncPredictor::Model VSyncPredictor::getVSyncPredictionModel() const {
@@ -364,6 +517,7 @@ void VSyncPredictor::setPeriod(nsecs_t period) {
     }
 
     clearTimestamps();
+    mModelGeneration++;
 }
 
 void VSyncPredictor::clearTimestamps() {
@@ -376,7 +530,10 @@ void VSyncPredictor::clearTimestamps() {
         }
 
         mTimestamps.clear();
+        mOrdinals.clear();
         mLastTimestampIndex = 0;
+        mNumOutOfOrderTimestamps = 0;
+        mSums = {};
     }
 }
 
@@ -389,11 +546,15 @@ void VSyncPredictor::resetModel() {
     std::lock_guard lock(mMutex);
     mRateMap[mIdealPeriod] = {mIdealPeriod, 0};
     clearTimestamps();
+    mModelGeneration++;
 }
 
 void VSyncPredictor::dump(std::string& result) const {
     std::lock_guard lock(mMutex);
     StringAppendF(&result, "\tmIdealPeriod=%.2f\n", mIdealPeriod / 1e6f);
+    StringAppendF(&result, "\tEstimator: %s, %zu samples\n",
+                  mEstimator == Estimator::TheilSen ? "Theil-Sen" : "least squares",
+                  mTimestamps.size());
     StringAppendF(&result, "\tRefresh Rate Map:\n");
     for (const auto& [idealPeriod, periodInterceptTuple] : mRateMap) {
         StringAppendF(&result,
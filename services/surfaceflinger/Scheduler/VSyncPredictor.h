@@ -17,6 +17,7 @@
 #pragma once
 
 #include <mutex>
+#include <optional>
 #include <unordered_map>
 #include <vector>
 
@@ -29,6 +30,17 @@ namespace android::scheduler {
 
 class VSyncPredictor : public VSyncTracker {
 public:
+    // How the model is fitted to the vsync timestamps.
+    enum class Estimator {
+        // Least-squares regression, updated in constant time per timestamp as long as the
+        // timestamps are added in increasing order.
+        LeastSquares,
+        // Theil-Sen estimator: the slope is the median of the slopes between all pairs of
+        // timestamps, so that up to ~29% of them may be off without skewing the model. This costs
+        // O(historySize^2) per timestamp, and is meant for noisy timestamps like present fences.
+        TheilSen,
+    };
+
     /*
      * \param [in] PhysicalDisplayid The display this corresponds to.
      * \param [in] idealPeriod  The initial ideal period to use.
@@ -36,9 +48,11 @@ public:
      * \param [in] minimumSamplesForPrediction The minimum number of samples to collect before
      * predicting. \param [in] outlierTolerancePercent a number 0 to 100 that will be used to filter
      * samples that fall outlierTolerancePercent from an anticipated vsync event.
+     * \param [in] estimator How the model is fitted to the samples.
      */
     VSyncPredictor(PhysicalDisplayId, nsecs_t idealPeriod, size_t historySize,
-                   size_t minimumSamplesForPrediction, uint32_t outlierTolerancePercent);
+                   size_t minimumSamplesForPrediction, uint32_t outlierTolerancePercent,
+                   Estimator estimator = Estimator::LeastSquares);
     ~VSyncPredictor();
 
     bool addVsyncTimestamp(nsecs_t timestamp) final EXCLUDES(mMutex);
@@ -71,6 +85,8 @@ public:
 
     void setRenderRate(Fps) final EXCLUDES(mMutex);
 
+    uint64_t modelGeneration() const final EXCLUDES(mMutex);
+
     void dump(std::string& result) const final EXCLUDES(mMutex);
 
 private:
@@ -85,6 +101,27 @@ private:
 
     size_t next(size_t i) const REQUIRES(mMutex);
     bool validate(nsecs_t timestamp) const REQUIRES(mMutex);
+
+    // Adds (sign = 1) or removes (sign = -1) the sample at index i from mSums.
+    void accumulate(size_t i, int64_t sign) REQUIRES(mMutex);
+    // Returns the index of the oldest sample. This is constant time unless some timestamps were
+    // added out of order.
+    size_t oldestIndex() const REQUIRES(mMutex);
+    // Makes mSums relative to the oldest sample, after it has changed.
+    void rebaseToOldest() REQUIRES(mMutex);
+
+    // The distance of a sample from the vsync its ordinal stands for, as of the last snap.
+    nsecs_t snapResidual(nsecs_t timestamp, int64_t ordinal) const REQUIRES(mMutex);
+    // Accounts for the sample at index i in mSnap.
+    void addToSnap(size_t i) REQUIRES(mMutex);
+    // Returns whether snapping the samples with |period| may change any of their ordinals.
+    bool needsResnap(nsecs_t period) const REQUIRES(mMutex);
+    // Snaps every sample again with |period|, relative to the oldest one, and rebuilds mSums.
+    void resnap(nsecs_t period) REQUIRES(mMutex);
+
+    std::optional<Model> fitLeastSquares() const REQUIRES(mMutex);
+    std::optional<Model> fitTheilSen() const REQUIRES(mMutex);
+
     Model getVSyncPredictionModelLocked() const REQUIRES(mMutex);
     nsecs_t nextAnticipatedVSyncTimeFromLocked(nsecs_t timePoint) const REQUIRES(mMutex);
     bool isVSyncInPhaseLocked(nsecs_t timePoint, unsigned divisor) const REQUIRES(mMutex);
@@ -99,6 +136,7 @@ private:
     size_t const kHistorySize;
     size_t const kMinimumSamplesForPrediction;
     size_t const kOutlierTolerancePercent;
+    Estimator const mEstimator;
     std::mutex mutable mMutex;
 
     nsecs_t mIdealPeriod GUARDED_BY(mMutex);
@@ -109,9 +147,47 @@ private:
 
     size_t mLastTimestampIndex GUARDED_BY(mMutex) = 0;
     std::vector<nsecs_t> mTimestamps GUARDED_BY(mMutex);
+    // The vsync count of each timestamp in mTimestamps, relative to the timestamp they were last
+    // snapped to. It is assigned when the timestamp is added, and again whenever the learned period
+    // has changed enough that snapping with it could assign a different count.
+    std::vector<int64_t> mOrdinals GUARDED_BY(mMutex);
+    // The number of samples in mTimestamps that are older than the sample added before them.
+    size_t mNumOutOfOrderTimestamps GUARDED_BY(mMutex) = 0;
+
+    // The oldest sample, which mSums and the model intercept are relative to.
+    nsecs_t mOldestTimestamp GUARDED_BY(mMutex) = 0;
+    int64_t mOldestOrdinal GUARDED_BY(mMutex) = 0;
+
+    // Running sums over the samples, with X being the ordinal and Y the timestamp, both relative
+    // to the oldest sample.
+    struct Sums {
+        int64_t x = 0;
+        int64_t y = 0;
+        int64_t xy = 0;
+        int64_t xx = 0;
+    };
+    Sums mSums GUARDED_BY(mMutex);
+
+    // The period the ordinals were last snapped with, and the sample they were snapped relative
+    // to, which the residuals of later samples are measured from too.
+    struct Snap {
+        nsecs_t period = 0;
+        nsecs_t timestamp = 0;
+        int64_t ordinal = 0;
+        // A lower bound of how far each sample's residual is from rounding to another ordinal.
+        nsecs_t margin = 0;
+        int64_t maxOrdinal = 0;
+    };
+    Snap mSnap GUARDED_BY(mMutex);
+
+    // Scratch space for fitTheilSen, to avoid allocating for each timestamp.
+    mutable std::vector<nsecs_t> mTheilSenScratch GUARDED_BY(mMutex);
 
     std::optional<Fps> mRenderRate GUARDED_BY(mMutex);
 
+    // Incremented whenever the predictions may change.
+    uint64_t mModelGeneration GUARDED_BY(mMutex) = 0;
+
     mutable std::optional<VsyncSequence> mLastVsyncSequence GUARDED_BY(mMutex);
 };
 
@@ -91,6 +91,15 @@ public:
      */
     virtual void setRenderRate(Fps) = 0;
 
+    /*
+     * A counter that changes whenever the predictions of the tracker may have changed, for
+     * example because a timestamp was added, or the period or the render rate was set.
+     * Predictions made while the counter is unchanged are still valid.
+     *
+     * \return  The generation of the model the predictions are made from.
+     */
+    virtual uint64_t modelGeneration() const = 0;
+
     virtual void dump(std::string& result) const = 0;
 
 protected:
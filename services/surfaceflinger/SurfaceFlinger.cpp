@@ -434,6 +434,9 @@ SurfaceFlinger::SurfaceFlinger(Factory& factory) : SurfaceFlinger(factory, SkipI
     mBackpressureGpuComposition = base::GetBoolProperty("debug.sf.enable_gl_backpressure"s, true);
     ALOGI_IF(mBackpressureGpuComposition, "Enabling backpressure for GPU composition");
 
+    mParallelVisibility = base::GetBoolProperty("debug.sf.enable_parallel_visibility"s, false);
+    mParallelOutputs = base::GetBoolProperty("debug.sf.enable_parallel_outputs"s, false);
+
     property_get("ro.surface_flinger.supports_background_blur", value, "0");
     bool supportsBlurs = atoi(value);
     mSupportsBlur = supportsBlurs;
@@ -456,6 +459,9 @@ SurfaceFlinger::SurfaceFlinger(Factory& factory) : SurfaceFlinger(factory, SkipI
     property_get("debug.sf.predict_hwc_composition_strategy", value, "1");
     mPredictCompositionStrategy = atoi(value);
 
+    property_get("debug.sf.early_client_target", value, "0");
+    mEarlyClientTarget = atoi(value);
+
     property_get("debug.sf.treat_170m_as_sRGB", value, "0");
     mTreat170mAsSrgb = atoi(value);
 
@@ -2605,6 +2611,8 @@ CompositeResultsPerDisplay SurfaceFlinger::composite(
     refreshArgs.scheduledFrameTime = mScheduler->getScheduledFrameTime();
     refreshArgs.expectedPresentTime = pacesetterTarget.expectedPresentTime().ns();
     refreshArgs.hasTrustedPresentationListener = mNumTrustedPresentationListeners > 0;
+    refreshArgs.parallelVisibility = mParallelVisibility;
+    refreshArgs.parallelOutputs = mParallelOutputs;
 
     // Store the present time just before calling to the composition engine so we could notify
     // the scheduler.
@@ -3483,7 +3491,8 @@ void SurfaceFlinger::processDisplayAdded(const wp<IBinder>& displayToken,
         displaySurface =
                 sp<FramebufferSurface>::make(getHwComposer(), *displayId, bqConsumer,
                                              state.physical->activeMode->getResolution(),
-                                             ui::Size(maxGraphicsWidth, maxGraphicsHeight));
+                                             ui::Size(maxGraphicsWidth, maxGraphicsHeight),
+                                             mEarlyClientTarget);
         producer = bqProducer;
     }
 
@@ -317,6 +317,11 @@ public:
     // run parallel to the hwc validateDisplay call and re-run if the predition is incorrect.
     bool mPredictCompositionStrategy = false;
 
+    // If set along with mPredictCompositionStrategy, the client target is composed and set before
+    // the hwc is asked for the composition strategy, so that frames with client composition can
+    // be presented with a single presentOrValidateDisplay call when the prediction is correct.
+    bool mEarlyClientTarget = false;
+
     // If true, then any layer with a SMPTE 170M transfer function is decoded using the sRGB
     // transfer instead. This is mainly to preserve legacy behavior, where implementations treated
     // SMPTE 170M as sRGB prior to color management being implemented, and now implementations rely
@@ -1264,6 +1269,10 @@ private:
 
     bool mLayerCachingEnabled = false;
     bool mBackpressureGpuComposition = false;
+    // If set, composition engine computes the visible regions of the layers on multiple threads.
+    bool mParallelVisibility = false;
+    // If set, composition engine prepares and presents each display on its own thread.
+    bool mParallelOutputs = false;
 
     LayerTracing mLayerTracing;
     bool mLayerTracingEnabled = false;
@@ -25,10 +25,14 @@
 #include <utils/Timers.h>
 #include <utils/Trace.h>
 
+#include <pthread.h>
+
 #include <algorithm>
 #include <chrono>
 #include <cmath>
+#include <iterator>
 #include <unordered_map>
+#include <utility>
 
 #include "TimeStats.h"
 #include "timestatsproto/TimeStatsHelper.h"
@@ -39,6 +43,8 @@ namespace impl {
 
 namespace {
 
+std::atomic<uint64_t> gNextInstanceId = 1;
+
 FrameTimingHistogram histogramToProto(const std::unordered_map<int32_t, int32_t>& histogram,
                                       size_t maxPulledHistogramBuckets) {
     auto buckets = std::vector<std::pair<int32_t, int32_t>>(histogram.begin(), histogram.end());
@@ -93,6 +99,7 @@ SurfaceflingerStatsLayerInfo_SetFrameRateVote frameRateVoteToProto(
 
 bool TimeStats::populateGlobalAtom(std::vector<uint8_t>* pulledData) {
     std::lock_guard<std::mutex> lock(mMutex);
+    flushLayerEventsLocked();
 
     if (mTimeStats.statsStartLegacy == 0) {
         return false;
@@ -145,6 +152,7 @@ bool TimeStats::populateGlobalAtom(std::vector<uint8_t>* pulledData) {
 
 bool TimeStats::populateLayerAtom(std::vector<uint8_t>* pulledData) {
     std::lock_guard<std::mutex> lock(mMutex);
+    flushLayerEventsLocked();
 
     std::vector<TimeStatsHelper::TimeStatsLayer*> dumpStats;
     uint32_t numLayers = 0;
@@ -244,7 +252,9 @@ bool TimeStats::populateLayerAtom(std::vector<uint8_t>* pulledData) {
 TimeStats::TimeStats() : TimeStats(std::nullopt, std::nullopt) {}
 
 TimeStats::TimeStats(std::optional<size_t> maxPulledLayers,
-                     std::optional<size_t> maxPulledHistogramBuckets) {
+                     std::optional<size_t> maxPulledHistogramBuckets,
+                     LayerEventMode layerEventMode)
+      : mLayerEventMode(layerEventMode), mInstanceId(gNextInstanceId++) {
     if (maxPulledLayers) {
         mMaxPulledLayers = *maxPulledLayers;
     }
@@ -254,6 +264,17 @@ TimeStats::TimeStats(std::optional<size_t> maxPulledLayers,
     }
 }
 
+TimeStats::~TimeStats() {
+    {
+        std::lock_guard<std::mutex> lock(mLayerEventThreadMutex);
+        mStopLayerEventThread = true;
+    }
+    mLayerEventCondition.notify_one();
+    if (mLayerEventThread.joinable()) {
+        mLayerEventThread.join();
+    }
+}
+
 bool TimeStats::onPullAtom(const int atomId, std::vector<uint8_t>* pulledData) {
     bool success = false;
     if (atomId == 10062) { // SURFACEFLINGER_STATS_GLOBAL_INFO
@@ -307,6 +328,7 @@ std::string TimeStats::miniDump() {
 
     std::string result = "TimeStats miniDump:\n";
     std::lock_guard<std::mutex> lock(mMutex);
+    flushLayerEventsLocked();
     android::base::StringAppendF(&result, "Number of layers currently being tracked is %zu\n",
                                  mTimeStatsTracker.size());
     android::base::StringAppendF(&result, "Number of layers in the stats pool is %zu\n",
@@ -450,6 +472,52 @@ static int32_t clampToNearestBucket(Fps fps, size_t bucketWidth) {
     return std::round(fps.getValue() / bucketWidth) * bucketWidth;
 }
 
+TimeStatsHelper::Histogram& TimeStats::LayerStatsCache::delta(LayerDelta delta) {
+    static constexpr std::array<const char*, kLayerDeltaCount> kLayerDeltaNames = {
+            "post2acquire",    "post2present",    "acquire2present",      "latch2present",
+            "desired2present", "present2present", "present2presentDelta",
+    };
+
+    const auto index = static_cast<size_t>(delta);
+    if (!deltas[index]) {
+        deltas[index] = &layerStats->deltas[kLayerDeltaNames[index]];
+    }
+    return *deltas[index];
+}
+
+TimeStatsHelper::TimeStatsLayer& TimeStats::getLayerStatsLocked(LayerRecord& layerRecord,
+                                                                int32_t refreshRateBucket,
+                                                                int32_t renderRateBucket,
+                                                                GameMode gameMode) {
+    const TimeStatsHelper::TimelineStatsKey timelineKey = {refreshRateBucket, renderRateBucket};
+    LayerStatsCache& cache = layerRecord.statsCache;
+    if (cache.layerStats && cache.timelineKey == timelineKey && cache.gameMode == gameMode) {
+        return *cache.layerStats;
+    }
+
+    if (!mTimeStats.stats.count(timelineKey)) {
+        mTimeStats.stats[timelineKey].key = timelineKey;
+    }
+
+    TimeStatsHelper::TimelineStats& displayStats = mTimeStats.stats[timelineKey];
+
+    const uid_t uid = layerRecord.uid;
+    const std::string& layerName = layerRecord.layerName;
+    TimeStatsHelper::LayerStatsKey layerKey = {uid, layerName, gameMode};
+    if (!displayStats.stats.count(layerKey)) {
+        displayStats.stats[layerKey].displayRefreshRateBucket = refreshRateBucket;
+        displayStats.stats[layerKey].renderRateBucket = renderRateBucket;
+        displayStats.stats[layerKey].uid = uid;
+        displayStats.stats[layerKey].layerName = layerName;
+        displayStats.stats[layerKey].gameMode = gameMode;
+    }
+
+    cache = {.timelineKey = timelineKey,
+             .gameMode = gameMode,
+             .layerStats = &displayStats.stats[layerKey]};
+    return *cache.layerStats;
+}
+
 void TimeStats::flushAvailableRecordsToStatsLocked(int32_t layerId, Fps displayRefreshRate,
                                                    std::optional<Fps> renderRate,
                                                    SetFrameRateVote frameRateVote,
@@ -472,27 +540,11 @@ void TimeStats::flushAvailableRecordsToStatsLocked(int32_t layerId, Fps displayR
               timeRecords[0].frameTime.frameNumber, timeRecords[0].frameTime.presentTime);
 
         if (prevTimeRecord.ready) {
-            uid_t uid = layerRecord.uid;
-            const std::string& layerName = layerRecord.layerName;
-            TimeStatsHelper::TimelineStatsKey timelineKey = {refreshRateBucket, renderRateBucket};
-            if (!mTimeStats.stats.count(timelineKey)) {
-                mTimeStats.stats[timelineKey].key = timelineKey;
-            }
-
-            TimeStatsHelper::TimelineStats& displayStats = mTimeStats.stats[timelineKey];
-
-            TimeStatsHelper::LayerStatsKey layerKey = {uid, layerName, gameMode};
-            if (!displayStats.stats.count(layerKey)) {
-                displayStats.stats[layerKey].displayRefreshRateBucket = refreshRateBucket;
-                displayStats.stats[layerKey].renderRateBucket = renderRateBucket;
-                displayStats.stats[layerKey].uid = uid;
-                displayStats.stats[layerKey].layerName = layerName;
-                displayStats.stats[layerKey].gameMode = gameMode;
-            }
+            TimeStatsHelper::TimeStatsLayer& timeStatsLayer =
+                    getLayerStatsLocked(layerRecord, refreshRateBucket, renderRateBucket, gameMode);
             if (frameRateVote.frameRate > 0.0f) {
-                displayStats.stats[layerKey].setFrameRateVote = frameRateVote;
+                timeStatsLayer.setFrameRateVote = frameRateVote;
             }
-            TimeStatsHelper::TimeStatsLayer& timeStatsLayer = displayStats.stats[layerKey];
             timeStatsLayer.totalFrames++;
             timeStatsLayer.droppedFrames += layerRecord.droppedFrames;
             timeStatsLayer.lateAcquireFrames += layerRecord.lateAcquireFrames;
@@ -506,41 +558,42 @@ void TimeStats::flushAvailableRecordsToStatsLocked(int32_t layerId, Fps displayR
                                                       timeRecords[0].frameTime.acquireTime);
             ALOGV("[%d]-[%" PRIu64 "]-post2acquire[%d]", layerId,
                   timeRecords[0].frameTime.frameNumber, postToAcquireMs);
-            timeStatsLayer.deltas["post2acquire"].insert(postToAcquireMs);
+            layerRecord.statsCache.delta(LayerDelta::PostToAcquire).insert(postToAcquireMs);
 
             const int32_t postToPresentMs = msBetween(timeRecords[0].frameTime.postTime,
                                                       timeRecords[0].frameTime.presentTime);
             ALOGV("[%d]-[%" PRIu64 "]-post2present[%d]", layerId,
                   timeRecords[0].frameTime.frameNumber, postToPresentMs);
-            timeStatsLayer.deltas["post2present"].insert(postToPresentMs);
+            layerRecord.statsCache.delta(LayerDelta::PostToPresent).insert(postToPresentMs);
 
             const int32_t acquireToPresentMs = msBetween(timeRecords[0].frameTime.acquireTime,
                                                          timeRecords[0].frameTime.presentTime);
             ALOGV("[%d]-[%" PRIu64 "]-acquire2present[%d]", layerId,
                   timeRecords[0].frameTime.frameNumber, acquireToPresentMs);
-            timeStatsLayer.deltas["acquire2present"].insert(acquireToPresentMs);
+            layerRecord.statsCache.delta(LayerDelta::AcquireToPresent).insert(acquireToPresentMs);
 
             const int32_t latchToPresentMs = msBetween(timeRecords[0].frameTime.latchTime,
                                                        timeRecords[0].frameTime.presentTime);
             ALOGV("[%d]-[%" PRIu64 "]-latch2present[%d]", layerId,
                   timeRecords[0].frameTime.frameNumber, latchToPresentMs);
-            timeStatsLayer.deltas["latch2present"].insert(latchToPresentMs);
+            layerRecord.statsCache.delta(LayerDelta::LatchToPresent).insert(latchToPresentMs);
 
             const int32_t desiredToPresentMs = msBetween(timeRecords[0].frameTime.desiredTime,
                                                          timeRecords[0].frameTime.presentTime);
             ALOGV("[%d]-[%" PRIu64 "]-desired2present[%d]", layerId,
                   timeRecords[0].frameTime.frameNumber, desiredToPresentMs);
-            timeStatsLayer.deltas["desired2present"].insert(desiredToPresentMs);
+            layerRecord.statsCache.delta(LayerDelta::DesiredToPresent).insert(desiredToPresentMs);
 
             const int32_t presentToPresentMs = msBetween(prevTimeRecord.frameTime.presentTime,
                                                          timeRecords[0].frameTime.presentTime);
             ALOGV("[%d]-[%" PRIu64 "]-present2present[%d]", layerId,
                   timeRecords[0].frameTime.frameNumber, presentToPresentMs);
-            timeStatsLayer.deltas["present2present"].insert(presentToPresentMs);
+            layerRecord.statsCache.delta(LayerDelta::PresentToPresent).insert(presentToPresentMs);
             if (prevPresentToPresentMs) {
                 const int32_t presentToPresentDeltaMs =
                         std::abs(presentToPresentMs - *prevPresentToPresentMs);
-                timeStatsLayer.deltas["present2presentDelta"].insert(presentToPresentDeltaMs);
+                layerRecord.statsCache.delta(LayerDelta::PresentToPresentDelta)
+                        .insert(presentToPresentDeltaMs);
             }
             prevPresentToPresentMs = presentToPresentMs;
         }
@@ -573,6 +626,280 @@ bool TimeStats::canAddNewAggregatedStats(uid_t uid, const std::string& layerName
     return layerRecords < MAX_NUM_LAYER_STATS;
 }
 
+TimeStats::LayerEvent* TimeStats::LayerEventRing::beginPush() {
+    const size_t head = mHead.load(std::memory_order_relaxed);
+    if (head - mTail.load(std::memory_order_acquire) == kLayerEventRingCapacity) {
+        return nullptr;
+    }
+    return &mEvents[head % kLayerEventRingCapacity];
+}
+
+size_t TimeStats::LayerEventRing::endPush(std::atomic<uint64_t>& nextSequence) {
+    // Announce a lower bound of the number before taking it, so that a flush does not apply the
+    // events numbered after it until this one is published.
+    mPublishingSequence.store(nextSequence.load());
+    const size_t head = mHead.load(std::memory_order_relaxed);
+    mEvents[head % kLayerEventRingCapacity].sequence = nextSequence.fetch_add(1);
+    mHead.store(head + 1, std::memory_order_release);
+    mPublishingSequence.store(kNoSequence, std::memory_order_release);
+    return head + 1 - mTail.load(std::memory_order_relaxed);
+}
+
+bool TimeStats::LayerEventRing::empty() const {
+    return mHead.load(std::memory_order_acquire) == mTail.load(std::memory_order_relaxed);
+}
+
+uint64_t TimeStats::LayerEventRing::publishingSequence() const {
+    return mPublishingSequence.load();
+}
+
+void TimeStats::LayerEventRing::beginFlush() {
+    mFlushHead = mHead.load(std::memory_order_acquire);
+}
+
+const TimeStats::LayerEvent* TimeStats::LayerEventRing::front() const {
+    const size_t tail = mTail.load(std::memory_order_relaxed);
+    if (tail == mFlushHead) {
+        return nullptr;
+    }
+    return &mEvents[tail % kLayerEventRingCapacity];
+}
+
+void TimeStats::LayerEventRing::pop() {
+    const size_t tail = mTail.load(std::memory_order_relaxed);
+    // Release the fence now rather than when the slot is reused.
+    mEvents[tail % kLayerEventRingCapacity].fence = nullptr;
+    mTail.store(tail + 1, std::memory_order_release);
+}
+
+TimeStats::LayerEventRing& TimeStats::getLayerEventRing() {
+    // Releases the ring when the thread exits, after which it is removed once drained.
+    thread_local struct {
+        uint64_t instanceId = 0;
+        std::shared_ptr<LayerEventRing> ring;
+    } tCachedRing;
+
+    if (tCachedRing.instanceId != mInstanceId) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        const std::thread::id threadId = std::this_thread::get_id();
+        auto it = std::find_if(mLayerEventRings.begin(), mLayerEventRings.end(),
+                               [threadId](const ThreadLayerEventRing& threadRing) {
+                                   return threadRing.threadId == threadId;
+                               });
+        if (it == mLayerEventRings.end()) {
+            mLayerEventRings.push_back({threadId, std::make_shared<LayerEventRing>()});
+            it = std::prev(mLayerEventRings.end());
+        }
+        tCachedRing.instanceId = mInstanceId;
+        tCachedRing.ring = it->ring;
+    }
+    return *tCachedRing.ring;
+}
+
+template <typename Fill>
+void TimeStats::recordLayerEvent(Fill&& fill) {
+    if (mLayerEventMode == LayerEventMode::Synchronous) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        fill(mSynchronousLayerEvent);
+        applyLayerEventLocked(mSynchronousLayerEvent);
+        mSynchronousLayerEvent.fence = nullptr;
+        return;
+    }
+
+    LayerEventRing& ring = getLayerEventRing();
+    LayerEvent* event = ring.beginPush();
+    if (!event) {
+        // mLayerEventThread fell behind, so catch up on this thread. Don't wait for the events
+        // other threads are publishing, since this thread may have a higher priority.
+        ATRACE_NAME("LayerEventRing full");
+        std::lock_guard<std::mutex> lock(mMutex);
+        flushLayerEventsLocked(/*waitForPublishingEvents=*/false);
+        event = ring.beginPush();
+        LOG_ALWAYS_FATAL_IF(!event, "Flushing did not drain the LayerEventRing of this thread");
+    }
+
+    fill(*event);
+    const size_t pendingEvents = ring.endPush(mNextLayerEventSequence);
+
+    // Pairs with the fence in processLayerEvents, so that either the event is seen there or the
+    // idle flag is seen here.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const bool wakeLayerEventThread = mLayerEventThreadIdle.load(std::memory_order_relaxed) &&
+            mLayerEventThreadIdle.exchange(false);
+    if (wakeLayerEventThread) {
+        // Make sure that mLayerEventThread is waiting rather than about to.
+        std::lock_guard<std::mutex> lock(mLayerEventThreadMutex);
+    }
+    if (wakeLayerEventThread || pendingEvents == kLayerEventRingCapacity / 2) {
+        mLayerEventCondition.notify_one();
+    }
+}
+
+bool TimeStats::hasPendingLayerEventsLocked() const {
+    return std::any_of(mLayerEventRings.begin(), mLayerEventRings.end(),
+                       [](const ThreadLayerEventRing& threadRing) {
+                           return !threadRing.ring->empty();
+                       });
+}
+
+void TimeStats::processLayerEvents() {
+    pthread_setname_np(pthread_self(), "TimeStats");
+
+    while (true) {
+        bool idle;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            flushLayerEventsLocked();
+
+            mLayerEventThreadIdle.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            idle = !hasPendingLayerEventsLocked();
+            if (!idle) {
+                mLayerEventThreadIdle.store(false, std::memory_order_relaxed);
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(mLayerEventThreadMutex);
+        if (mStopLayerEventThread) break;
+
+        // Apply the events once they have been pending for a while, or when a ring is half full,
+        // but do not wake up periodically while there are none.
+        if (idle) {
+            mLayerEventCondition.wait(lock, [this] {
+                return mStopLayerEventThread || !mLayerEventThreadIdle.load();
+            });
+        } else {
+            mLayerEventCondition.wait_for(lock, kLayerEventFlushInterval);
+        }
+        if (mStopLayerEventThread) break;
+    }
+}
+
+void TimeStats::flushLayerEventsLocked(bool waitForPublishingEvents) {
+    ATRACE_CALL();
+
+    // Remove the rings of the threads that have exited, once their last events are applied.
+    const auto isReleased = [](const ThreadLayerEventRing& threadRing) {
+        if (threadRing.ring.use_count() > 1) return false;
+        // Pairs with the release of the reference of the exited thread.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return threadRing.ring->empty();
+    };
+    mLayerEventRings.erase(std::remove_if(mLayerEventRings.begin(), mLayerEventRings.end(),
+                                          isReleased),
+                           mLayerEventRings.end());
+
+    // Only the events numbered below the watermark are applied, so that none is applied before an
+    // earlier one that is still being published. Every event numbered below it is published, since
+    // an event being published has announced a lower bound of its number before taking it.
+    // Otherwise, every published event is applied. An event still being published was recorded
+    // concurrently with the events published after it took its number, so applying it after them
+    // still applies the events in an order the callers could have made them in.
+    uint64_t watermark = LayerEventRing::kNoSequence;
+    if (waitForPublishingEvents) {
+        watermark = mNextLayerEventSequence.load();
+        for (const auto& [threadId, ring] : mLayerEventRings) {
+            watermark = std::min(watermark, ring->publishingSequence());
+        }
+    }
+    for (const auto& [threadId, ring] : mLayerEventRings) {
+        ring->beginFlush();
+    }
+
+    while (true) {
+        LayerEventRing* nextRing = nullptr;
+        const LayerEvent* nextEvent = nullptr;
+        for (const auto& [threadId, ring] : mLayerEventRings) {
+            const LayerEvent* event = ring->front();
+            if (event && event->sequence < watermark &&
+                (!nextEvent || event->sequence < nextEvent->sequence)) {
+                nextRing = ring.get();
+                nextEvent = event;
+            }
+        }
+        if (!nextEvent) break;
+
+        applyLayerEventLocked(*nextEvent);
+        nextRing->pop();
+    }
+}
+
+void TimeStats::applyLayerEventLocked(const LayerEvent& event) {
+    using Type = LayerEvent::Type;
+
+    switch (event.type) {
+        case Type::PostTime:
+            setPostTimeLocked(event);
+            break;
+        case Type::LatchTime:
+            if (TimeRecord* timeRecord =
+                        findWaitingTimeRecordLocked(event.layerId, event.frameNumber)) {
+                timeRecord->frameTime.latchTime = event.time;
+            }
+            break;
+        case Type::LatchSkipped:
+            if (LayerRecord* layerRecord = findLayerRecordLocked(event.layerId)) {
+                switch (event.latchSkipReason) {
+                    case LatchSkipReason::LateAcquire:
+                        layerRecord->lateAcquireFrames++;
+                        break;
+                }
+            }
+            break;
+        case Type::BadDesiredPresent:
+            if (LayerRecord* layerRecord = findLayerRecordLocked(event.layerId)) {
+                layerRecord->badDesiredPresentFrames++;
+            }
+            break;
+        case Type::DesiredTime:
+            if (TimeRecord* timeRecord =
+                        findWaitingTimeRecordLocked(event.layerId, event.frameNumber)) {
+                timeRecord->frameTime.desiredTime = event.time;
+            }
+            break;
+        case Type::AcquireTime:
+            if (TimeRecord* timeRecord =
+                        findWaitingTimeRecordLocked(event.layerId, event.frameNumber)) {
+                timeRecord->frameTime.acquireTime = event.time;
+            }
+            break;
+        case Type::AcquireFence:
+            if (TimeRecord* timeRecord =
+                        findWaitingTimeRecordLocked(event.layerId, event.frameNumber)) {
+                timeRecord->acquireFence = event.fence;
+            }
+            break;
+        case Type::PresentTime:
+        case Type::PresentFence:
+            setPresentLocked(event);
+            break;
+        case Type::JankyFrames:
+            incrementJankyFramesLocked(event);
+            break;
+        case Type::RemoveTimeRecord:
+            removeTimeRecordLocked(event.layerId, event.frameNumber);
+            break;
+        case Type::Destroy:
+            mTimeStatsTracker.erase(event.layerId);
+            break;
+    }
+}
+
+TimeStats::LayerRecord* TimeStats::findLayerRecordLocked(int32_t layerId) {
+    const auto it = mTimeStatsTracker.find(layerId);
+    return it == mTimeStatsTracker.end() ? nullptr : &it->second;
+}
+
+TimeStats::TimeRecord* TimeStats::findWaitingTimeRecordLocked(int32_t layerId,
+                                                              uint64_t frameNumber) {
+    LayerRecord* layerRecord = findLayerRecordLocked(layerId);
+    if (!layerRecord || layerRecord->waitData < 0 ||
+        layerRecord->waitData >= static_cast<int32_t>(layerRecord->timeRecords.size()))
+        return nullptr;
+    TimeRecord& timeRecord = layerRecord->timeRecords[layerRecord->waitData];
+    return timeRecord.frameTime.frameNumber == frameNumber ? &timeRecord : nullptr;
+}
+
 void TimeStats::setPostTime(int32_t layerId, uint64_t frameNumber, const std::string& layerName,
                             uid_t uid, nsecs_t postTime, GameMode gameMode) {
     if (!mEnabled.load()) return;
@@ -581,21 +908,38 @@ void TimeStats::setPostTime(int32_t layerId, uint64_t frameNumber, const std::st
     ALOGV("[%d]-[%" PRIu64 "]-[%s]-PostTime[%" PRId64 "]", layerId, frameNumber, layerName.c_str(),
           postTime);
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!canAddNewAggregatedStats(uid, layerName, gameMode)) {
+    recordLayerEvent([&](LayerEvent& event) {
+        event.type = LayerEvent::Type::PostTime;
+        event.layerId = layerId;
+        event.frameNumber = frameNumber;
+        event.layerName = layerName;
+        event.uid = uid;
+        event.time = postTime;
+        event.gameMode = gameMode;
+    });
+}
+
+void TimeStats::setPostTimeLocked(const LayerEvent& event) {
+    const int32_t layerId = event.layerId;
+    LayerRecord* layerRecord = findLayerRecordLocked(layerId);
+    // Skip looking up the layer stats by name if the frames of the layer are already aggregated.
+    const bool hasLayerStats = layerRecord && layerRecord->statsCache.layerStats &&
+            layerRecord->statsCache.gameMode == event.gameMode && layerRecord->uid == event.uid &&
+            layerRecord->layerName == event.layerName;
+    if (!hasLayerStats && !canAddNewAggregatedStats(event.uid, event.layerName, event.gameMode)) {
         return;
     }
-    if (!mTimeStatsTracker.count(layerId) && mTimeStatsTracker.size() < MAX_NUM_LAYER_RECORDS &&
-        layerNameIsValid(layerName)) {
-        mTimeStatsTracker[layerId].uid = uid;
-        mTimeStatsTracker[layerId].layerName = layerName;
-        mTimeStatsTracker[layerId].gameMode = gameMode;
+    if (!layerRecord && mTimeStatsTracker.size() < MAX_NUM_LAYER_RECORDS &&
+        layerNameIsValid(event.layerName)) {
+        layerRecord = &mTimeStatsTracker[layerId];
+        layerRecord->uid = event.uid;
+        layerRecord->layerName = event.layerName;
+        layerRecord->gameMode = event.gameMode;
     }
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
-    if (layerRecord.timeRecords.size() == MAX_NUM_TIME_RECORDS) {
+    if (!layerRecord) return;
+    if (layerRecord->timeRecords.size() == MAX_NUM_TIME_RECORDS) {
         ALOGE("[%d]-[%s]-timeRecords is at its maximum size[%zu]. Ignore this when unittesting.",
-              layerId, layerRecord.layerName.c_str(), MAX_NUM_TIME_RECORDS);
+              layerId, layerRecord->layerName.c_str(), MAX_NUM_TIME_RECORDS);
         mTimeStatsTracker.erase(layerId);
         return;
     }
@@ -605,17 +949,17 @@ void TimeStats::setPostTime(int32_t layerId, uint64_t frameNumber, const std::st
     TimeRecord timeRecord = {
             .frameTime =
                     {
-                            .frameNumber = frameNumber,
-                            .postTime = postTime,
-                            .latchTime = postTime,
-                            .acquireTime = postTime,
-                            .desiredTime = postTime,
+                            .frameNumber = event.frameNumber,
+                            .postTime = event.time,
+                            .latchTime = event.time,
+                            .acquireTime = event.time,
+                            .desiredTime = event.time,
                     },
     };
-    layerRecord.timeRecords.push_back(timeRecord);
-    if (layerRecord.waitData < 0 ||
-        layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
-        layerRecord.waitData = layerRecord.timeRecords.size() - 1;
+    layerRecord->timeRecords.push_back(timeRecord);
+    if (layerRecord->waitData < 0 ||
+        layerRecord->waitData >= static_cast<int32_t>(layerRecord->timeRecords.size()))
+        layerRecord->waitData = layerRecord->timeRecords.size() - 1;
 }
 
 void TimeStats::setLatchTime(int32_t layerId, uint64_t frameNumber, nsecs_t latchTime) {
@@ -624,16 +968,12 @@ void TimeStats::setLatchTime(int32_t layerId, uint64_t frameNumber, nsecs_t latc
     ATRACE_CALL();
     ALOGV("[%d]-[%" PRIu64 "]-LatchTime[%" PRId64 "]", layerId, frameNumber, latchTime);
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
-    if (layerRecord.waitData < 0 ||
-        layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
-        return;
-    TimeRecord& timeRecord = layerRecord.timeRecords[layerRecord.waitData];
-    if (timeRecord.frameTime.frameNumber == frameNumber) {
-        timeRecord.frameTime.latchTime = latchTime;
-    }
+    recordLayerEvent([&](LayerEvent& event) {
+        event.type = LayerEvent::Type::LatchTime;
+        event.layerId = layerId;
+        event.frameNumber = frameNumber;
+        event.time = latchTime;
+    });
 }
 
 void TimeStats::incrementLatchSkipped(int32_t layerId, LatchSkipReason reason) {
@@ -643,15 +983,11 @@ void TimeStats::incrementLatchSkipped(int32_t layerId, LatchSkipReason reason) {
     ALOGV("[%d]-LatchSkipped-Reason[%d]", layerId,
           static_cast<std::underlying_type<LatchSkipReason>::type>(reason));
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
-
-    switch (reason) {
-        case LatchSkipReason::LateAcquire:
-            layerRecord.lateAcquireFrames++;
-            break;
-    }
+    recordLayerEvent([&](LayerEvent& event) {
+        event.type = LayerEvent::Type::LatchSkipped;
+        event.layerId = layerId;
+        event.latchSkipReason = reason;
+    });
 }
 
 void TimeStats::incrementBadDesiredPresent(int32_t layerId) {
@@ -660,10 +996,10 @@ void TimeStats::incrementBadDesiredPresent(int32_t layerId) {
     ATRACE_CALL();
     ALOGV("[%d]-BadDesiredPresent", layerId);
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
-    layerRecord.badDesiredPresentFrames++;
+    recordLayerEvent([&](LayerEvent& event) {
+        event.type = LayerEvent::Type::BadDesiredPresent;
+        event.layerId = layerId;
+    });
 }
 
 void TimeStats::setDesiredTime(int32_t layerId, uint64_t frameNumber, nsecs_t desiredTime) {
@@ -672,16 +1008,12 @@ void TimeStats::setDesiredTime(int32_t layerId, uint64_t frameNumber, nsecs_t de
     ATRACE_CALL();
     ALOGV("[%d]-[%" PRIu64 "]-DesiredTime[%" PRId64 "]", layerId, frameNumber, desiredTime);
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
-    if (layerRecord.waitData < 0 ||
-        layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
-        return;
-    TimeRecord& timeRecord = layerRecord.timeRecords[layerRecord.waitData];
-    if (timeRecord.frameTime.frameNumber == frameNumber) {
-        timeRecord.frameTime.desiredTime = desiredTime;
-    }
+    recordLayerEvent([&](LayerEvent& event) {
+        event.type = LayerEvent::Type::DesiredTime;
+        event.layerId = layerId;
+        event.frameNumber = frameNumber;
+        event.time = desiredTime;
+    });
 }
 
 void TimeStats::setAcquireTime(int32_t layerId, uint64_t frameNumber, nsecs_t acquireTime) {
@@ -690,16 +1022,12 @@ void TimeStats::setAcquireTime(int32_t layerId, uint64_t frameNumber, nsecs_t ac
     ATRACE_CALL();
     ALOGV("[%d]-[%" PRIu64 "]-AcquireTime[%" PRId64 "]", layerId, frameNumber, acquireTime);
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
-    if (layerRecord.waitData < 0 ||
-        layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
-        return;
-    TimeRecord& timeRecord = layerRecord.timeRecords[layerRecord.waitData];
-    if (timeRecord.frameTime.frameNumber == frameNumber) {
-        timeRecord.frameTime.acquireTime = acquireTime;
-    }
+    recordLayerEvent([&](LayerEvent& event) {
+        event.type = LayerEvent::Type::AcquireTime;
+        event.layerId = layerId;
+        event.frameNumber = frameNumber;
+        event.time = acquireTime;
+    });
 }
 
 void TimeStats::setAcquireFence(int32_t layerId, uint64_t frameNumber,
@@ -710,16 +1038,12 @@ void TimeStats::setAcquireFence(int32_t layerId, uint64_t frameNumber,
     ALOGV("[%d]-[%" PRIu64 "]-AcquireFenceTime[%" PRId64 "]", layerId, frameNumber,
           acquireFence->getSignalTime());
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
-    if (layerRecord.waitData < 0 ||
-        layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
-        return;
-    TimeRecord& timeRecord = layerRecord.timeRecords[layerRecord.waitData];
-    if (timeRecord.frameTime.frameNumber == frameNumber) {
-        timeRecord.acquireFence = acquireFence;
-    }
+    recordLayerEvent([&](LayerEvent& event) {
+        event.type = LayerEvent::Type::AcquireFence;
+        event.layerId = layerId;
+        event.frameNumber = frameNumber;
+        event.fence = acquireFence;
+    });
 }
 
 void TimeStats::setPresentTime(int32_t layerId, uint64_t frameNumber, nsecs_t presentTime,
@@ -730,21 +1054,16 @@ void TimeStats::setPresentTime(int32_t layerId, uint64_t frameNumber, nsecs_t pr
     ATRACE_CALL();
     ALOGV("[%d]-[%" PRIu64 "]-PresentTime[%" PRId64 "]", layerId, frameNumber, presentTime);
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
-    if (layerRecord.waitData < 0 ||
-        layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
-        return;
-    TimeRecord& timeRecord = layerRecord.timeRecords[layerRecord.waitData];
-    if (timeRecord.frameTime.frameNumber == frameNumber) {
-        timeRecord.frameTime.presentTime = presentTime;
-        timeRecord.ready = true;
-        layerRecord.waitData++;
-    }
-
-    flushAvailableRecordsToStatsLocked(layerId, displayRefreshRate, renderRate, frameRateVote,
-                                       gameMode);
+    recordLayerEvent([&](LayerEvent& event) {
+        event.type = LayerEvent::Type::PresentTime;
+        event.layerId = layerId;
+        event.frameNumber = frameNumber;
+        event.time = presentTime;
+        event.displayRefreshRate = displayRefreshRate;
+        event.renderRate = renderRate;
+        event.frameRateVote = frameRateVote;
+        event.gameMode = gameMode;
+    });
 }
 
 void TimeStats::setPresentFence(int32_t layerId, uint64_t frameNumber,
@@ -757,21 +1076,36 @@ void TimeStats::setPresentFence(int32_t layerId, uint64_t frameNumber,
     ALOGV("[%d]-[%" PRIu64 "]-PresentFenceTime[%" PRId64 "]", layerId, frameNumber,
           presentFence->getSignalTime());
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
-    if (layerRecord.waitData < 0 ||
-        layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
+    recordLayerEvent([&](LayerEvent& event) {
+        event.type = LayerEvent::Type::PresentFence;
+        event.layerId = layerId;
+        event.frameNumber = frameNumber;
+        event.fence = presentFence;
+        event.displayRefreshRate = displayRefreshRate;
+        event.renderRate = renderRate;
+        event.frameRateVote = frameRateVote;
+        event.gameMode = gameMode;
+    });
+}
+
+void TimeStats::setPresentLocked(const LayerEvent& event) {
+    LayerRecord* layerRecord = findLayerRecordLocked(event.layerId);
+    if (!layerRecord || layerRecord->waitData < 0 ||
+        layerRecord->waitData >= static_cast<int32_t>(layerRecord->timeRecords.size()))
         return;
-    TimeRecord& timeRecord = layerRecord.timeRecords[layerRecord.waitData];
-    if (timeRecord.frameTime.frameNumber == frameNumber) {
-        timeRecord.presentFence = presentFence;
+    TimeRecord& timeRecord = layerRecord->timeRecords[layerRecord->waitData];
+    if (timeRecord.frameTime.frameNumber == event.frameNumber) {
+        if (event.type == LayerEvent::Type::PresentFence) {
+            timeRecord.presentFence = event.fence;
+        } else {
+            timeRecord.frameTime.presentTime = event.time;
+        }
         timeRecord.ready = true;
-        layerRecord.waitData++;
+        layerRecord->waitData++;
     }
 
-    flushAvailableRecordsToStatsLocked(layerId, displayRefreshRate, renderRate, frameRateVote,
-                                       gameMode);
+    flushAvailableRecordsToStatsLocked(event.layerId, event.displayRefreshRate, event.renderRate,
+                                       event.frameRateVote, event.gameMode);
 }
 
 static const constexpr int32_t kValidJankyReason = JankType::DisplayHAL |
@@ -815,8 +1149,24 @@ void TimeStats::incrementJankyFrames(const JankyFramesInfo& info) {
     if (!mEnabled.load()) return;
 
     ATRACE_CALL();
-    std::lock_guard<std::mutex> lock(mMutex);
 
+    // Recorded along with the per-layer setters, so that the layer stats created when flushing the
+    // first present fence of a layer are found below.
+    recordLayerEvent([&](LayerEvent& event) {
+        event.type = LayerEvent::Type::JankyFrames;
+        event.layerName = info.layerName;
+        event.uid = info.uid;
+        event.gameMode = info.gameMode;
+        event.displayRefreshRate = info.refreshRate;
+        event.renderRate = info.renderRate;
+        event.jankReasons = info.reasons;
+        event.displayDeadlineDelta = info.displayDeadlineDelta;
+        event.displayPresentJitter = info.displayPresentJitter;
+        event.appDeadlineDelta = info.appDeadlineDelta;
+    });
+}
+
+void TimeStats::incrementJankyFramesLocked(const LayerEvent& event) {
     // Only update layer stats if we're already tracking the layer in TimeStats.
     // Otherwise, continue tracking the statistic but use a default layer name instead.
     // As an implementation detail, we do this because this method is expected to be
@@ -832,9 +1182,9 @@ void TimeStats::incrementJankyFrames(const JankyFramesInfo& info) {
     constexpr GameMode kDefaultGameMode = GameMode::Unsupported;
 
     const int32_t refreshRateBucket =
-            clampToNearestBucket(info.refreshRate, REFRESH_RATE_BUCKET_WIDTH);
+            clampToNearestBucket(event.displayRefreshRate, REFRESH_RATE_BUCKET_WIDTH);
     const int32_t renderRateBucket =
-            clampToNearestBucket(info.renderRate ? *info.renderRate : info.refreshRate,
+            clampToNearestBucket(event.renderRate ? *event.renderRate : event.displayRefreshRate,
                                  RENDER_RATE_BUCKET_WIDTH);
     const TimeStatsHelper::TimelineStatsKey timelineKey = {refreshRateBucket, renderRateBucket};
 
@@ -844,36 +1194,40 @@ void TimeStats::incrementJankyFrames(const JankyFramesInfo& info) {
 
     TimeStatsHelper::TimelineStats& timelineStats = mTimeStats.stats[timelineKey];
 
-    updateJankPayload<TimeStatsHelper::TimelineStats>(timelineStats, info.reasons);
+    updateJankPayload<TimeStatsHelper::TimelineStats>(timelineStats, event.jankReasons);
 
-    TimeStatsHelper::LayerStatsKey layerKey = {info.uid, info.layerName, info.gameMode};
+    TimeStatsHelper::LayerStatsKey layerKey = {event.uid, event.layerName, event.gameMode};
     if (!timelineStats.stats.count(layerKey)) {
-        layerKey = {info.uid, kDefaultLayerName, kDefaultGameMode};
+        layerKey = {event.uid, kDefaultLayerName, kDefaultGameMode};
         timelineStats.stats[layerKey].displayRefreshRateBucket = refreshRateBucket;
         timelineStats.stats[layerKey].renderRateBucket = renderRateBucket;
-        timelineStats.stats[layerKey].uid = info.uid;
+        timelineStats.stats[layerKey].uid = event.uid;
         timelineStats.stats[layerKey].layerName = kDefaultLayerName;
         timelineStats.stats[layerKey].gameMode = kDefaultGameMode;
     }
 
     TimeStatsHelper::TimeStatsLayer& timeStatsLayer = timelineStats.stats[layerKey];
-    updateJankPayload<TimeStatsHelper::TimeStatsLayer>(timeStatsLayer, info.reasons);
+    updateJankPayload<TimeStatsHelper::TimeStatsLayer>(timeStatsLayer, event.jankReasons);
 
-    if (info.reasons & kValidJankyReason) {
+    if (event.jankReasons & kValidJankyReason) {
         // TimeStats Histograms only retain positive values, so we don't need to check if these
         // deadlines were really missed if we know that the frame had jank, since deadlines
         // that were met will be dropped.
-        timelineStats.displayDeadlineDeltas.insert(toMs(info.displayDeadlineDelta));
-        timelineStats.displayPresentDeltas.insert(toMs(info.displayPresentJitter));
-        timeStatsLayer.deltas["appDeadlineDeltas"].insert(toMs(info.appDeadlineDelta));
+        timelineStats.displayDeadlineDeltas.insert(toMs(event.displayDeadlineDelta));
+        timelineStats.displayPresentDeltas.insert(toMs(event.displayPresentJitter));
+        timeStatsLayer.deltas["appDeadlineDeltas"].insert(toMs(event.appDeadlineDelta));
     }
 }
 
 void TimeStats::onDestroy(int32_t layerId) {
     ATRACE_CALL();
     ALOGV("[%d]-onDestroy", layerId);
-    std::lock_guard<std::mutex> lock(mMutex);
-    mTimeStatsTracker.erase(layerId);
+
+    // Recorded even while disabled, as the layer record may have been created before.
+    recordLayerEvent([&](LayerEvent& event) {
+        event.type = LayerEvent::Type::Destroy;
+        event.layerId = layerId;
+    });
 }
 
 void TimeStats::removeTimeRecord(int32_t layerId, uint64_t frameNumber) {
@@ -882,20 +1236,27 @@ void TimeStats::removeTimeRecord(int32_t layerId, uint64_t frameNumber) {
     ATRACE_CALL();
     ALOGV("[%d]-[%" PRIu64 "]-removeTimeRecord", layerId, frameNumber);
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
+    recordLayerEvent([&](LayerEvent& event) {
+        event.type = LayerEvent::Type::RemoveTimeRecord;
+        event.layerId = layerId;
+        event.frameNumber = frameNumber;
+    });
+}
+
+void TimeStats::removeTimeRecordLocked(int32_t layerId, uint64_t frameNumber) {
+    LayerRecord* layerRecord = findLayerRecordLocked(layerId);
+    if (!layerRecord) return;
     size_t removeAt = 0;
-    for (const TimeRecord& record : layerRecord.timeRecords) {
+    for (const TimeRecord& record : layerRecord->timeRecords) {
         if (record.frameTime.frameNumber == frameNumber) break;
         removeAt++;
     }
-    if (removeAt == layerRecord.timeRecords.size()) return;
-    layerRecord.timeRecords.erase(layerRecord.timeRecords.begin() + removeAt);
-    if (layerRecord.waitData > static_cast<int32_t>(removeAt)) {
-        layerRecord.waitData--;
+    if (removeAt == layerRecord->timeRecords.size()) return;
+    layerRecord->timeRecords.erase(layerRecord->timeRecords.begin() + removeAt);
+    if (layerRecord->waitData > static_cast<int32_t>(removeAt)) {
+        layerRecord->waitData--;
     }
-    layerRecord.droppedFrames++;
+    layerRecord->droppedFrames++;
 }
 
 void TimeStats::flushPowerTimeLocked() {
@@ -1037,6 +1398,9 @@ void TimeStats::enable() {
     mEnabled.store(true);
     mTimeStats.statsStartLegacy = static_cast<int64_t>(std::time(0));
     mPowerTime.prevTime = systemTime();
+    if (mLayerEventMode == LayerEventMode::Deferred && !mLayerEventThread.joinable()) {
+        mLayerEventThread = std::thread(&TimeStats::processLayerEvents, this);
+    }
     ALOGD("Enabled");
 }
 
@@ -1046,6 +1410,7 @@ void TimeStats::disable() {
     ATRACE_CALL();
 
     std::lock_guard<std::mutex> lock(mMutex);
+    flushLayerEventsLocked();
     flushPowerTimeLocked();
     mEnabled.store(false);
     mTimeStats.statsEndLegacy = static_cast<int64_t>(std::time(0));
@@ -1054,6 +1419,7 @@ void TimeStats::disable() {
 
 void TimeStats::clearAll() {
     std::lock_guard<std::mutex> lock(mMutex);
+    flushLayerEventsLocked();
     mTimeStats.stats.clear();
     clearGlobalLocked();
     clearLayersLocked();
@@ -1110,6 +1476,7 @@ void TimeStats::dump(bool asProto, std::optional<uint32_t> maxLayers, std::strin
         return;
     }
 
+    flushLayerEventsLocked();
     mTimeStats.statsEndLegacy = static_cast<int64_t>(std::time(0));
 
     flushPowerTimeLocked();
@@ -16,12 +16,21 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <deque>
+#include <limits>
+#include <memory>
 #include <mutex>
 #include <optional>
+#include <string>
+#include <thread>
 #include <unordered_map>
 #include <variant>
+#include <vector>
 
 #include <android/hardware/graphics/composer/2.4/IComposerClient.h>
 #include <gui/JankInfo.h>
@@ -207,6 +216,31 @@ class TimeStats : public android::TimeStats {
         std::shared_ptr<FenceTime> presentFence;
     };
 
+    // Histograms of a TimeStatsLayer, in the order of their names in LayerStatsCache::delta.
+    enum class LayerDelta {
+        PostToAcquire,
+        PostToPresent,
+        AcquireToPresent,
+        LatchToPresent,
+        DesiredToPresent,
+        PresentToPresent,
+        PresentToPresentDelta,
+    };
+    static constexpr size_t kLayerDeltaCount = 7;
+
+    // The stats that the frames of a layer were last aggregated into, so that each frame does not
+    // look them up by layer name. The pointers stay valid until the layer stats are cleared, which
+    // also clears the layer records.
+    struct LayerStatsCache {
+        TimeStatsHelper::TimelineStatsKey timelineKey;
+        GameMode gameMode = GameMode::Unsupported;
+        TimeStatsHelper::TimeStatsLayer* layerStats = nullptr;
+        // Looked up on first use, as dumps only list the histograms which were inserted into.
+        std::array<TimeStatsHelper::Histogram*, kLayerDeltaCount> deltas{};
+
+        TimeStatsHelper::Histogram& delta(LayerDelta);
+    };
+
     struct LayerRecord {
         uid_t uid;
         std::string layerName;
@@ -221,6 +255,86 @@ class TimeStats : public android::TimeStats {
         TimeRecord prevTimeRecord;
         std::optional<int32_t> prevPresentToPresentMs;
         std::deque<TimeRecord> timeRecords;
+        LayerStatsCache statsCache;
+    };
+
+    // A call to one of the per-layer setters, recorded on the calling thread and applied to the
+    // stats later on. Only the fields of the given type are set.
+    struct LayerEvent {
+        enum class Type {
+            PostTime,
+            LatchTime,
+            LatchSkipped,
+            BadDesiredPresent,
+            DesiredTime,
+            AcquireTime,
+            AcquireFence,
+            PresentTime,
+            PresentFence,
+            JankyFrames,
+            RemoveTimeRecord,
+            Destroy,
+        };
+
+        Type type = Type::Destroy;
+        int32_t layerId = 0;
+        // Orders the events recorded by different threads.
+        uint64_t sequence = 0;
+        uint64_t frameNumber = 0;
+        nsecs_t time = 0;
+        std::shared_ptr<FenceTime> fence;
+        uid_t uid = 0;
+        GameMode gameMode = GameMode::Unsupported;
+        LatchSkipReason latchSkipReason = LatchSkipReason::LateAcquire;
+        std::string layerName;
+        Fps displayRefreshRate;
+        std::optional<Fps> renderRate;
+        SetFrameRateVote frameRateVote;
+        // JankyFrames only, along with layerName, uid, gameMode and the rates above.
+        int32_t jankReasons = 0;
+        nsecs_t displayDeadlineDelta = 0;
+        nsecs_t displayPresentJitter = 0;
+        nsecs_t appDeadlineDelta = 0;
+    };
+
+    // Single producer, single consumer ring of the events recorded by a thread. The slots are
+    // reused, so that recording an event does not allocate once the strings in the slots are large
+    // enough. The consumer is whichever thread holds mMutex.
+    class LayerEventRing {
+    public:
+        static constexpr uint64_t kNoSequence = std::numeric_limits<uint64_t>::max();
+
+        // Returns the slot to record the next event into, or nullptr if the ring is full.
+        LayerEvent* beginPush();
+        // Numbers the event recorded by beginPush from nextSequence and publishes it, and returns
+        // the number of pending events.
+        size_t endPush(std::atomic<uint64_t>& nextSequence);
+
+        bool empty() const;
+        // Returns a lower bound of the number of the event endPush is publishing, or kNoSequence.
+        uint64_t publishingSequence() const;
+
+        // Makes the events published so far available to front(), but none published later.
+        void beginFlush();
+        // Returns the oldest pending event, or nullptr if there is none.
+        const LayerEvent* front() const;
+        void pop();
+
+    private:
+        const std::unique_ptr<LayerEvent[]> mEvents =
+                std::make_unique<LayerEvent[]>(kLayerEventRingCapacity);
+        // Written by the producer and consumer respectively, so kept on separate cache lines.
+        alignas(64) std::atomic<size_t> mHead = 0;
+        std::atomic<uint64_t> mPublishingSequence = kNoSequence;
+        alignas(64) std::atomic<size_t> mTail = 0;
+        // The head seen by the last beginFlush. Only used by the consumer.
+        size_t mFlushHead = 0;
+    };
+
+    struct ThreadLayerEventRing {
+        std::thread::id threadId;
+        // Also owned by the thread-local cache of getLayerEventRing, until the thread exits.
+        std::shared_ptr<LayerEventRing> ring;
     };
 
     struct PowerTime {
@@ -240,10 +354,26 @@ class TimeStats : public android::TimeStats {
     };
 
 public:
+    // How the per-layer setters apply their events to the stats.
+    enum class LayerEventMode {
+        // Later on, by mLayerEventThread or by whichever thread reads the stats first.
+        Deferred,
+        // Like Deferred, but without mLayerEventThread, so that the events are only applied when
+        // the stats are read or a ring is full. For testing only.
+        DeferredWithoutThread,
+        // On the calling thread, under the TimeStats lock.
+        Synchronous,
+    };
+
+    // The number of events each thread can record before they have to be applied.
+    static constexpr size_t kLayerEventRingCapacity = 1024;
+
     TimeStats();
     // For testing only for injecting custom dependencies.
     TimeStats(std::optional<size_t> maxPulledLayers,
-              std::optional<size_t> maxPulledHistogramBuckets);
+              std::optional<size_t> maxPulledHistogramBuckets,
+              LayerEventMode layerEventMode = LayerEventMode::Deferred);
+    ~TimeStats() override;
 
     bool onPullAtom(const int atomId, std::vector<uint8_t>* pulledData) override;
     void parseArgs(bool asProto, const Vector<String16>& args, std::string& result) override;
@@ -296,6 +426,8 @@ private:
     bool populateGlobalAtom(std::vector<uint8_t>* pulledData);
     bool populateLayerAtom(std::vector<uint8_t>* pulledData);
     bool recordReadyLocked(int32_t layerId, TimeRecord* timeRecord);
+    TimeStatsHelper::TimeStatsLayer& getLayerStatsLocked(LayerRecord&, int32_t refreshRateBucket,
+                                                         int32_t renderRateBucket, GameMode);
     void flushAvailableRecordsToStatsLocked(int32_t layerId, Fps displayRefreshRate,
                                             std::optional<Fps> renderRate, SetFrameRateVote,
                                             GameMode);
@@ -303,6 +435,25 @@ private:
     void flushAvailableGlobalRecordsToStatsLocked();
     bool canAddNewAggregatedStats(uid_t uid, const std::string& layerName, GameMode);
 
+    // Records the event filled in by fill(LayerEvent&) into the ring of the calling thread.
+    template <typename Fill>
+    void recordLayerEvent(Fill&& fill);
+    LayerEventRing& getLayerEventRing();
+    void processLayerEvents();
+    bool hasPendingLayerEventsLocked() const;
+    // Applies the pending events of all threads, in the order they were recorded. If
+    // waitForPublishingEvents is false, the events published after one that another thread is
+    // still publishing are applied as well.
+    void flushLayerEventsLocked(bool waitForPublishingEvents = true);
+    void applyLayerEventLocked(const LayerEvent&);
+    LayerRecord* findLayerRecordLocked(int32_t layerId);
+    // Returns the record of the frame that is waiting for its timestamps, if it is frameNumber.
+    TimeRecord* findWaitingTimeRecordLocked(int32_t layerId, uint64_t frameNumber);
+    void setPostTimeLocked(const LayerEvent&);
+    void setPresentLocked(const LayerEvent&);
+    void incrementJankyFramesLocked(const LayerEvent&);
+    void removeTimeRecordLocked(int32_t layerId, uint64_t frameNumber);
+
     void enable();
     void disable();
     void clearAll();
@@ -318,6 +469,27 @@ private:
     PowerTime mPowerTime;
     GlobalRecord mGlobalRecord;
 
+    // The per-layer setters are called from the main thread for every frame of every layer, so
+    // they only record an event into a ring of the calling thread, and the events are aggregated
+    // by mLayerEventThread, or by whichever thread reads the stats first.
+    const LayerEventMode mLayerEventMode;
+    // Identifies this instance in the thread-local cache of getLayerEventRing.
+    const uint64_t mInstanceId;
+    std::vector<ThreadLayerEventRing> mLayerEventRings;
+    std::atomic<uint64_t> mNextLayerEventSequence = 0;
+    // Set when mLayerEventThread found every ring empty, so that the next event published wakes it
+    // up.
+    std::atomic<bool> mLayerEventThreadIdle = false;
+    // The event applied by the setters when events are not deferred.
+    LayerEvent mSynchronousLayerEvent;
+    std::thread mLayerEventThread;
+    // Only held by mLayerEventThread while waiting, so that waking it up does not wait for the
+    // readers of the stats.
+    std::mutex mLayerEventThreadMutex;
+    std::condition_variable mLayerEventCondition;
+    bool mStopLayerEventThread = false;
+    static constexpr std::chrono::milliseconds kLayerEventFlushInterval{100};
+
     static const size_t MAX_NUM_LAYER_RECORDS = 200;
 
     static const size_t REFRESH_RATE_BUCKET_WIDTH = 30;
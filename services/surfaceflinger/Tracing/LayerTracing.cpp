@@ -141,7 +141,7 @@ void LayerTracing::notify(bool visibleRegionDirty, int64_t time, int64_t vsyncId
     }
     entry.mutable_displays()->Swap(displays);
     entry.set_vsync_id(vsyncId);
-    mBuffer->emplace(std::move(entry));
+    mBuffer->emplace(entry);
 }
 
 } // namespace android
@@ -18,57 +18,99 @@
 
 #include <android-base/file.h>
 #include <android-base/stringprintf.h>
+#include <android-base/unique_fd.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
 
+#include <fcntl.h>
 #include <log/log.h>
+#include <sys/stat.h>
 #include <utils/Errors.h>
 #include <utils/Timers.h>
 #include <utils/Trace.h>
+#include <unistd.h>
 #include <chrono>
+#include <cinttypes>
+#include <cstring>
 #include <fstream>
-#include <queue>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
 
 namespace android {
 
 class SurfaceFlinger;
 
+// Ring of serialized trace entries in a single contiguous buffer.
+//
+// Each entry is stored encoded as an occurrence of the repeated entry field of FileProto, i.e.
+// prefixed with the field tag and its length. Since concatenated encodings of a message are merged
+// when parsed, the trace file is written as the encoded FileProto followed by the buffer as is,
+// without parsing the entries or serializing them again.
+//
+// Entries are never split: if an entry doesn't fit at the end of the buffer, it is written at the
+// start, and the end of the buffer is left unused until the oldest entries wrap around too.
 template <typename FileProto, typename EntryProto>
 class RingBuffer {
 public:
     size_t size() const { return mSizeInBytes; }
     size_t used() const { return mUsedInBytes; }
-    size_t frameCount() const { return mStorage.size(); }
+    size_t frameCount() const { return mFrameCount; }
     void setSize(size_t newSize) { mSizeInBytes = newSize; }
-    const std::string& front() const { return mStorage.front(); }
-    const std::string& back() const { return mStorage.back(); }
+    std::string front() const { return std::string(payload(mHead)); }
+    std::string back() const { return std::string(payload(mNewest)); }
 
     void reset() {
-        // use the swap trick to make sure memory is released
-        std::deque<std::string>().swap(mStorage);
+        // release the memory of the buffer
+        mData.reset();
+        mCapacity = 0U;
         mUsedInBytes = 0U;
+        mFrameCount = 0U;
+        clearPositions();
     }
 
     void writeToProto(FileProto& fileProto) {
-        fileProto.mutable_entry()->Reserve(static_cast<int>(mStorage.size()) +
+        fileProto.mutable_entry()->Reserve(static_cast<int>(mFrameCount) +
                                            fileProto.entry().size());
-        for (const std::string& entry : mStorage) {
-            EntryProto* entryProto = fileProto.add_entry();
-            entryProto->ParseFromString(entry);
-        }
+        forEachSegment([&](const uint8_t* data, size_t size) {
+            for (size_t offset = 0; offset < size;) {
+                const Entry entry = readEntry(data + offset);
+                EntryProto* entryProto = fileProto.add_entry();
+                entryProto->ParseFromArray(data + offset + entry.headerSize,
+                                           static_cast<int>(entry.payloadSize));
+                offset += entry.headerSize + entry.payloadSize;
+            }
+        });
     }
 
     status_t writeToFile(FileProto& fileProto, std::string filename) {
         ATRACE_CALL();
-        writeToProto(fileProto);
-        std::string output;
-        if (!fileProto.SerializeToString(&output)) {
+        std::string header;
+        if (!fileProto.SerializeToString(&header)) {
             ALOGE("Could not serialize proto.");
             return UNKNOWN_ERROR;
         }
 
         // -rw-r--r--
         const mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
-        if (!android::base::WriteStringToFile(output, filename, mode, getuid(), getgid(), true)) {
+        base::unique_fd fd(TEMP_FAILURE_RETRY(
+                open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode)));
+        if (fd == -1 || fchmod(fd.get(), mode) == -1 || fchown(fd.get(), getuid(), getgid()) == -1) {
+            ALOGE("Could not save the proto file %s", filename.c_str());
+            return PERMISSION_DENIED;
+        }
+
+        // The entries are written straight from the buffer, so that writing a large trace doesn't
+        // need another copy of it in memory.
+        bool written = base::WriteFully(fd.get(), header.data(), header.size());
+        forEachSegment([&](const uint8_t* data, size_t size) {
+            written = written && base::WriteFully(fd.get(), data, size);
+        });
+        if (!written) {
             ALOGE("Could not save the proto file %s", filename.c_str());
+            unlink(filename.c_str());
             return PERMISSION_DENIED;
         }
         return NO_ERROR;
@@ -76,44 +118,37 @@ public:
 
     status_t appendToStream(FileProto& fileProto, std::ofstream& out) {
         ATRACE_CALL();
-        writeToProto(fileProto);
-        std::string output;
-        if (!fileProto.SerializeToString(&output)) {
+        std::string header;
+        if (!fileProto.SerializeToString(&header)) {
             ALOGE("Could not serialize proto.");
             return UNKNOWN_ERROR;
         }
 
-        out << output;
+        out << header;
+        forEachSegment([&](const uint8_t* data, size_t size) {
+            out.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+        });
         return NO_ERROR;
     }
 
     std::vector<std::string> emplace(std::string&& serializedProto) {
-        std::vector<std::string> replacedEntries;
-        size_t protoSize = static_cast<size_t>(serializedProto.size());
-        while (mUsedInBytes + protoSize > mSizeInBytes) {
-            if (mStorage.empty()) {
-                return {};
-            }
-            mUsedInBytes -= static_cast<size_t>(mStorage.front().size());
-            replacedEntries.emplace_back(mStorage.front());
-            mStorage.pop_front();
-        }
-        mUsedInBytes += protoSize;
-        mStorage.emplace_back(serializedProto);
-        return replacedEntries;
+        return emplace(serializedProto.size(), [&](uint8_t* data) {
+            std::memcpy(data, serializedProto.data(), serializedProto.size());
+        });
     }
 
-    std::vector<std::string> emplace(EntryProto&& proto) {
-        std::string serializedProto;
-        proto.SerializeToString(&serializedProto);
-        return emplace(std::move(serializedProto));
+    // Serializes the proto directly into the buffer.
+    std::vector<std::string> emplace(const EntryProto& proto) {
+        return emplace(proto.ByteSizeLong(),
+                       [&](uint8_t* data) { proto.SerializeWithCachedSizesToArray(data); });
     }
 
     void dump(std::string& result) const {
         std::chrono::milliseconds duration(0);
         if (frameCount() > 0) {
             EntryProto entry;
-            entry.ParseFromString(mStorage.front());
+            const std::string_view oldest = payload(mHead);
+            entry.ParseFromArray(oldest.data(), static_cast<int>(oldest.size()));
             duration = std::chrono::duration_cast<std::chrono::milliseconds>(
                     std::chrono::nanoseconds(systemTime() - entry.elapsed_realtime_nanos()));
         }
@@ -125,9 +160,164 @@ public:
     }
 
 private:
+    using CodedOutputStream = google::protobuf::io::CodedOutputStream;
+    using WireFormatLite = google::protobuf::internal::WireFormatLite;
+
+    static constexpr uint32_t kEntryTag =
+            WireFormatLite::MakeTag(FileProto::kEntryFieldNumber,
+                                    WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+
+    struct Entry {
+        size_t headerSize;
+        size_t payloadSize;
+    };
+
+    // Decodes the tag and length prefix of the entry at the given position.
+    static Entry readEntry(const uint8_t* data) {
+        size_t headerSize = static_cast<size_t>(CodedOutputStream::VarintSize32(kEntryTag));
+        size_t payloadSize = 0;
+        for (int shift = 0;; shift += 7) {
+            const uint8_t byte = data[headerSize++];
+            payloadSize |= static_cast<size_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                break;
+            }
+        }
+        return {headerSize, payloadSize};
+    }
+
+    std::string_view payload(size_t offset) const {
+        const Entry entry = readEntry(mData.get() + offset);
+        return std::string_view(reinterpret_cast<const char*>(mData.get()) + offset +
+                                        entry.headerSize,
+                                entry.payloadSize);
+    }
+
+    // Calls f with each contiguous range of entries, from the oldest to the newest.
+    template <typename F>
+    void forEachSegment(F&& f) const {
+        if (mFrameCount == 0) {
+            return;
+        }
+        if (mWrapped) {
+            f(mData.get() + mHead, mWrapEnd - mHead);
+            f(mData.get(), mTail);
+        } else {
+            f(mData.get() + mHead, mTail - mHead);
+        }
+    }
+
+    void clearPositions() {
+        mHead = 0U;
+        mTail = 0U;
+        mNewest = 0U;
+        mWrapEnd = 0U;
+        mWrapped = false;
+    }
+
+    std::string popFront() {
+        const Entry entry = readEntry(mData.get() + mHead);
+        std::string removed(payload(mHead));
+        mHead += entry.headerSize + entry.payloadSize;
+        mUsedInBytes -= entry.headerSize + entry.payloadSize;
+        if (--mFrameCount == 0) {
+            clearPositions();
+        } else if (mWrapped && mHead == mWrapEnd) {
+            mHead = 0U;
+            mWrapped = false;
+        }
+        return removed;
+    }
+
+    // Moves the entries to the start of a buffer of the given capacity, which must hold them.
+    void resize(size_t capacity) {
+        // Not value-initialized, so that the pages of a large buffer are only committed once
+        // entries are written to them.
+        std::unique_ptr<uint8_t[]> data(new uint8_t[capacity]);
+        size_t tail = 0U;
+        forEachSegment([&](const uint8_t* segment, size_t size) {
+            std::memcpy(data.get() + tail, segment, size);
+            tail += size;
+        });
+        const size_t newest = mFrameCount > 0 ? tail - (mTail - mNewest) : 0U;
+        mData = std::move(data);
+        mCapacity = capacity;
+        mHead = 0U;
+        mTail = tail;
+        mNewest = newest;
+        mWrapEnd = 0U;
+        mWrapped = false;
+    }
+
+    // Returns the position where an entry of the given size can be written, after removing the
+    // oldest entries to make room for it.
+    std::optional<size_t> reserve(size_t entrySize, std::vector<std::string>& replacedEntries) {
+        while (mUsedInBytes + entrySize > mSizeInBytes) {
+            if (mFrameCount == 0) {
+                return std::nullopt;
+            }
+            replacedEntries.emplace_back(popFront());
+        }
+        if (mCapacity != mSizeInBytes) {
+            resize(mSizeInBytes);
+        }
+
+        while (true) {
+            const size_t available = mWrapped ? mHead - mTail : mCapacity - mTail;
+            if (available >= entrySize) {
+                return mTail;
+            }
+            if (!mWrapped) {
+                // Leave the end of the buffer unused and continue from its start.
+                mWrapEnd = mTail;
+                mTail = 0U;
+                mWrapped = true;
+            } else {
+                replacedEntries.emplace_back(popFront());
+            }
+        }
+    }
+
+    template <typename Serialize>
+    std::vector<std::string> emplace(size_t protoSize, Serialize&& serialize) {
+        const size_t headerSize =
+                static_cast<size_t>(CodedOutputStream::VarintSize32(kEntryTag) +
+                                    CodedOutputStream::VarintSize64(protoSize));
+        const size_t entrySize = headerSize + protoSize;
+
+        std::vector<std::string> replacedEntries;
+        const std::optional<size_t> offset = reserve(entrySize, replacedEntries);
+        if (!offset) {
+            return {};
+        }
+
+        uint8_t* data = mData.get() + *offset;
+        data = CodedOutputStream::WriteVarint32ToArray(kEntryTag, data);
+        data = CodedOutputStream::WriteVarint64ToArray(protoSize, data);
+        serialize(data);
+
+        mNewest = *offset;
+        mTail = *offset + entrySize;
+        mUsedInBytes += entrySize;
+        mFrameCount++;
+        return replacedEntries;
+    }
+
     size_t mUsedInBytes = 0U;
     size_t mSizeInBytes = 0U;
-    std::deque<std::string> mStorage;
+    size_t mFrameCount = 0U;
+
+    std::unique_ptr<uint8_t[]> mData;
+    size_t mCapacity = 0U;
+    // Position of the oldest entry, and past the newest one.
+    size_t mHead = 0U;
+    size_t mTail = 0U;
+    // Position of the newest entry.
+    size_t mNewest = 0U;
+    // When the entries wrap around, the oldest ones end at mWrapEnd, and the newest ones start at
+    // the beginning of the buffer.
+    size_t mWrapEnd = 0U;
+    bool mWrapped = false;
 };
 
 } // namespace android
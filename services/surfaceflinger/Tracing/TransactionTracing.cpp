@@ -202,10 +202,8 @@ void TransactionTracing::addEntry(const std::vector<CommittedUpdates>& committed
             }
         }
 
-        std::string serializedProto;
-        entryProto.SerializeToString(&serializedProto);
+        std::vector<std::string> entries = mBuffer.emplace(entryProto);
         entryProto.Clear();
-        std::vector<std::string> entries = mBuffer.emplace(std::move(serializedProto));
         removedEntries.reserve(removedEntries.size() + entries.size());
         removedEntries.insert(removedEntries.end(), std::make_move_iterator(entries.begin()),
                               std::make_move_iterator(entries.end()));
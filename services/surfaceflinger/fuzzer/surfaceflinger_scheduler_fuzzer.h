@@ -102,6 +102,8 @@ public:
 
     void setRenderRate(Fps) override {}
 
+    uint64_t modelGeneration() const override { return 0; }
+
     nsecs_t nextVSyncTime(nsecs_t timePoint) const {
         if (timePoint % mPeriod == 0) {
             return timePoint;
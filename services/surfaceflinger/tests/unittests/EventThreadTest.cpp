@@ -507,6 +507,68 @@ TEST_F(EventThreadTest, getLatestVsyncEventData) {
     }
 }
 
+TEST_F(EventThreadTest, vsyncEventRingReadersGetVsyncEventsFromTheRing) {
+    setupEventThread(VSYNC_PERIOD);
+
+    base::unique_fd ringFd;
+    size_t readerIndex = 0;
+    ASSERT_EQ(NO_ERROR, mThread->getVsyncEventRing(mConnection, &ringFd, &readerIndex));
+    EXPECT_EQ(0u, readerIndex);
+    const auto ring = gui::VsyncEventRing::map(std::move(ringFd));
+    ASSERT_NE(nullptr, ring);
+    ASSERT_EQ(NO_ERROR, mThread->enableVsyncEventRing(mConnection));
+
+    // A second connection gets its own reader index.
+    ConnectionEventRecorder secondConnectionEventRecorder{0};
+    sp<MockEventThreadConnection> secondConnection =
+            createConnection(secondConnectionEventRecorder);
+    size_t secondReaderIndex = 0;
+    ASSERT_EQ(NO_ERROR, mThread->getVsyncEventRing(secondConnection, &ringFd, &secondReaderIndex));
+    EXPECT_EQ(1u, secondReaderIndex);
+
+    mThread->requestNextVsync(mConnection);
+    expectVSyncCallbackScheduleReceived(true);
+    onVSyncEvent(123, 456, 789);
+
+    // The vsync event is published to the ring, but not posted to the BitTube.
+    ASSERT_TRUE(ring->waitForEvent(0, 1s));
+    uint64_t lastSequence = 0;
+    DisplayEventReceiver::Event event;
+    ASSERT_TRUE(ring->readLatest(readerIndex, &lastSequence, &event));
+    EXPECT_EQ(DisplayEventReceiver::DISPLAY_EVENT_VSYNC, event.header.type);
+    EXPECT_EQ(123, event.header.timestamp);
+    EXPECT_EQ(1u, event.vsync.count);
+    EXPECT_EQ(VSYNC_PERIOD.count(), event.vsync.vsyncData.frameInterval);
+    EXPECT_FALSE(mConnectionEventCallRecorder.waitForUnexpectedCall().has_value());
+
+    // The second connection did not request a vsync.
+    lastSequence = 0;
+    EXPECT_FALSE(ring->readLatest(secondReaderIndex, &lastSequence, &event));
+}
+
+TEST_F(EventThreadTest, vsyncEventRingReadersGetVsyncEventsFromTheBitTubeUntilEnabled) {
+    setupEventThread(VSYNC_PERIOD);
+
+    // The ring isn't enabled without one, as if the client failed to map it.
+    EXPECT_EQ(INVALID_OPERATION, mThread->enableVsyncEventRing(mConnection));
+
+    base::unique_fd ringFd;
+    size_t readerIndex = 0;
+    ASSERT_EQ(NO_ERROR, mThread->getVsyncEventRing(mConnection, &ringFd, &readerIndex));
+    const auto ring = gui::VsyncEventRing::map(std::move(ringFd));
+    ASSERT_NE(nullptr, ring);
+
+    mThread->requestNextVsync(mConnection);
+    expectVSyncCallbackScheduleReceived(true);
+    onVSyncEvent(123, 456, 789);
+
+    // The vsync event is posted to the BitTube, and not published to the ring.
+    expectVsyncEventReceivedByConnection(123, 1u);
+    uint64_t lastSequence = 0;
+    DisplayEventReceiver::Event event;
+    EXPECT_FALSE(ring->readLatest(readerIndex, &lastSequence, &event));
+}
+
 TEST_F(EventThreadTest, setVsyncRateZeroPostsNoVSyncEventsToThatConnection) {
     setupEventThread(VSYNC_PERIOD);
 
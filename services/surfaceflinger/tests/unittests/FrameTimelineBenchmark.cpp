@@ -0,0 +1,161 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <FrameTimeline/FrameTimeline.h>
+#include <TimeStats/TimeStats.h>
+#include <ui/FenceTime.h>
+
+#include <malloc.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Counts the heap allocations of the process, and the bytes they use.
+std::atomic<size_t> gAllocationCount = 0;
+std::atomic<size_t> gAllocatedBytes = 0;
+
+} // namespace
+
+void* operator new(size_t size) {
+    void* p = std::malloc(size);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    gAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    gAllocatedBytes.fetch_add(malloc_usable_size(p), std::memory_order_relaxed);
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    if (p) {
+        gAllocatedBytes.fetch_sub(malloc_usable_size(p), std::memory_order_relaxed);
+        std::free(p);
+    }
+}
+
+void operator delete(void* p, size_t) noexcept {
+    operator delete(p);
+}
+
+namespace android::frametimeline {
+namespace {
+
+// Usage: atest libsurfaceflinger_frametimeline_benchmark
+//
+// Makes the FrameTimeline calls of SurfaceFlinger and its layers for each display frame, and
+// reports the CPU time and the heap allocations per display frame, along with the memory held by
+// the history of display frames once it is full.
+
+constexpr pid_t kSurfaceFlingerPid = 666;
+constexpr Fps kRefreshRate = 120_Hz;
+constexpr GameMode kGameMode = GameMode::Unsupported;
+
+class Compositor {
+public:
+    Compositor(std::shared_ptr<TimeStats> timeStats, size_t layerCount)
+          : mFrameTimeline(std::move(timeStats), kSurfaceFlingerPid) {
+        for (size_t i = 0; i < layerCount; i++) {
+            mLayerNames.push_back("com.example.app/com.example.app.Activity#" +
+                                  std::to_string(i));
+        }
+    }
+
+    void composite() {
+        const nsecs_t period = kRefreshRate.getPeriodNsecs();
+        const nsecs_t vsync = ++mFrameCount * period;
+
+        // The present fence of the previous frame signals before this frame is presented.
+        if (mPreviousPresentFence) {
+            mPreviousPresentFence->signalForTest(vsync);
+        }
+
+        auto* tokenManager = mFrameTimeline.getTokenManager();
+        const int64_t sfToken =
+                tokenManager->generateTokenForPredictions({vsync, vsync + period / 2,
+                                                           vsync + period});
+        const int64_t appToken =
+                tokenManager->generateTokenForPredictions({vsync - period, vsync - period / 2,
+                                                           vsync + period});
+        mFrameTimeline.setSfWakeUp(sfToken, vsync, kRefreshRate);
+
+        FrameTimelineInfo frameTimelineInfo;
+        frameTimelineInfo.vsyncId = appToken;
+        for (size_t i = 0; i < mLayerNames.size(); i++) {
+            const auto layerId = static_cast<int32_t>(i);
+            auto surfaceFrame =
+                    mFrameTimeline.createSurfaceFrameForToken(frameTimelineInfo, /*ownerPid*/ 1000,
+                                                              /*ownerUid*/ 10000, layerId,
+                                                              mLayerNames[i], mLayerNames[i],
+                                                              /*isBuffer*/ true, kGameMode);
+            surfaceFrame->setActualQueueTime(vsync - period / 2);
+            surfaceFrame->setAcquireFenceTime(vsync - period / 4);
+            surfaceFrame->setPresentState(SurfaceFrame::PresentState::Presented, vsync - period);
+            mFrameTimeline.addSurfaceFrame(std::move(surfaceFrame));
+        }
+
+        auto presentFence = mFenceMap.createFenceTimeForTest(Fence::NO_FENCE);
+        mFrameTimeline.setSfPresent(vsync + period / 2, presentFence);
+        mPreviousPresentFence = std::move(presentFence);
+    }
+
+private:
+    impl::FrameTimeline mFrameTimeline;
+    FenceToFenceTimeMap mFenceMap;
+    std::shared_ptr<FenceTime> mPreviousPresentFence;
+    std::vector<std::string> mLayerNames;
+    nsecs_t mFrameCount = 0;
+};
+
+void BM_compositeFrame(benchmark::State& state) {
+    const auto layerCount = static_cast<size_t>(state.range(0));
+    auto timeStats = std::make_shared<android::impl::TimeStats>();
+
+    const size_t bytesBefore = gAllocatedBytes.load();
+    Compositor compositor(timeStats, layerCount);
+
+    // Fill the history of display frames, so that old frames are evicted from now on.
+    constexpr size_t kWarmUpFrameCount = 256;
+    for (size_t i = 0; i < kWarmUpFrameCount; i++) {
+        compositor.composite();
+    }
+
+    const size_t allocationsBefore = gAllocationCount.load();
+    for (auto _ : state) {
+        compositor.composite();
+    }
+
+    state.counters["allocationsPerFrame"] =
+            benchmark::Counter(static_cast<double>(gAllocationCount.load() - allocationsBefore),
+                               benchmark::Counter::kAvgIterations);
+    // Mostly the history of display frames, and the SurfaceFrames they hold.
+    state.counters["retainedKiB"] =
+            static_cast<double>(gAllocatedBytes.load() - bytesBefore) / 1024.;
+}
+
+BENCHMARK(BM_compositeFrame)->ArgName("layers")->Arg(5)->Arg(20)->Arg(60);
+
+} // namespace
+} // namespace android::frametimeline
+
+BENCHMARK_MAIN();
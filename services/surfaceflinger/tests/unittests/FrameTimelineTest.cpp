@@ -464,6 +464,38 @@ TEST_F(FrameTimelineTest, setMaxDisplayFramesSetsSizeProperly) {
     EXPECT_EQ(getNumberOfDisplayFrames(), *maxDisplayFrames);
 }
 
+TEST_F(FrameTimelineTest, evictedDisplayFrameIsResetBeforeReuse) {
+    auto presentFence = fenceFactory.createFenceTimeForTest(Fence::NO_FENCE);
+    presentFence->signalForTest(2);
+
+    std::weak_ptr<SurfaceFrame> firstSurfaceFrame;
+    for (size_t i = 0; i < *maxDisplayFrames + 1; i++) {
+        auto surfaceFrame =
+                mFrameTimeline->createSurfaceFrameForToken({}, sPidOne, sUidOne, sLayerIdOne,
+                                                           sLayerNameOne, sLayerNameOne,
+                                                           /*isBuffer*/ true, sGameMode);
+        if (i == 0) {
+            firstSurfaceFrame = surfaceFrame;
+        }
+        int64_t sfToken = mTokenManager->generateTokenForPredictions({22, 26, 30});
+        mFrameTimeline->setSfWakeUp(sfToken, 22, Fps::fromPeriodNsecs(11));
+        surfaceFrame->setPresentState(SurfaceFrame::PresentState::Presented);
+        mFrameTimeline->addSurfaceFrame(surfaceFrame);
+        mFrameTimeline->setSfPresent(27, presentFence);
+    }
+
+    // The SurfaceFrames of the evicted display frame are released
+    EXPECT_TRUE(firstSurfaceFrame.expired());
+
+    // The display frame after the evicted one keeps nothing from it
+    mFrameTimeline->setSfPresent(27, presentFence);
+    auto displayFrame = getDisplayFrame(*maxDisplayFrames - 1);
+    EXPECT_TRUE(displayFrame->getSurfaceFrames().empty());
+    EXPECT_EQ(compareTimelineItems(displayFrame->getPredictions(), TimelineItem()), true);
+    EXPECT_EQ(displayFrame->getActuals().startTime, 0);
+    EXPECT_EQ(getNumberOfDisplayFrames(), *maxDisplayFrames);
+}
+
 TEST_F(FrameTimelineTest, presentFenceSignaled_invalidSignalTime) {
     Fps refreshRate = Fps::fromPeriodNsecs(11);
 
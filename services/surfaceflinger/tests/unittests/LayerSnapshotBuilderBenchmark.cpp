@@ -0,0 +1,176 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "Client.h" // temporarily needed for LayerCreationArgs
+#include "FrontEnd/LayerCreationArgs.h"
+#include "FrontEnd/LayerHierarchy.h"
+#include "FrontEnd/LayerLifecycleManager.h"
+#include "FrontEnd/LayerSnapshotBuilder.h"
+
+namespace android::surfaceflinger::frontend {
+namespace {
+
+// Usage: atest libsurfaceflinger_frontend_benchmark
+
+class LayerTree {
+public:
+    // Creates `fanout` root layers, each with `fanout` children that have
+    // `fanout` visible leaves.
+    explicit LayerTree(uint32_t fanout) {
+        uint32_t id = 1;
+        for (uint32_t i = 0; i < fanout; i++) {
+            const uint32_t rootId = id++;
+            createLayer(rootId, UNASSIGNED_LAYER_ID);
+            for (uint32_t j = 0; j < fanout; j++) {
+                const uint32_t childId = id++;
+                createLayer(childId, rootId);
+                for (uint32_t k = 0; k < fanout; k++) {
+                    const uint32_t leafId = id++;
+                    createLayer(leafId, childId);
+                    setColor(leafId);
+                    mLeafIds.push_back(leafId);
+                }
+            }
+        }
+    }
+
+    void setColor(uint32_t id) {
+        std::vector<TransactionState> transactions;
+        transactions.emplace_back();
+        transactions.back().states.push_back({});
+        transactions.back().states.front().state.what = layer_state_t::eColorChanged;
+        transactions.back().states.front().state.color.rgb = half3(1._hf, 1._hf, 1._hf);
+        transactions.back().states.front().layerId = id;
+        mLifecycleManager.applyTransactions(transactions);
+    }
+
+    void setCrop(uint32_t id, const Rect& crop) {
+        std::vector<TransactionState> transactions;
+        transactions.emplace_back();
+        transactions.back().states.push_back({});
+        transactions.back().states.front().state.what = layer_state_t::eCropChanged;
+        transactions.back().states.front().state.crop = crop;
+        transactions.back().states.front().layerId = id;
+        mLifecycleManager.applyTransactions(transactions);
+    }
+
+    void update(LayerSnapshotBuilder::ForceUpdateFlags forceUpdate) {
+        if (mLifecycleManager.getGlobalChanges().test(RequestedLayerState::Changes::Hierarchy)) {
+            mHierarchyBuilder.update(mLifecycleManager.getLayers(),
+                                     mLifecycleManager.getDestroyedLayers());
+        }
+        LayerSnapshotBuilder::Args args{.root = mHierarchyBuilder.getHierarchy(),
+                                        .layerLifecycleManager = mLifecycleManager,
+                                        .forceUpdate = forceUpdate,
+                                        .includeMetadata = false,
+                                        .displays = mDisplayInfos,
+                                        .globalShadowSettings = mGlobalShadowSettings,
+                                        .supportedLayerGenericMetadata = {},
+                                        .genericLayerMetadataKeyMap = {}};
+        mSnapshotBuilder.update(args);
+        mLifecycleManager.commitChanges();
+    }
+
+    const std::vector<uint32_t>& leafIds() const { return mLeafIds; }
+    const LayerSnapshotBuilder& snapshotBuilder() const { return mSnapshotBuilder; }
+    size_t layerCount() const { return mLifecycleManager.getLayers().size(); }
+
+private:
+    void createLayer(uint32_t id, uint32_t parentId) {
+        LayerCreationArgs args(std::make_optional(id));
+        args.name = "testlayer";
+        args.addToRoot = parentId == UNASSIGNED_LAYER_ID;
+        args.parentId = parentId;
+        std::vector<std::unique_ptr<RequestedLayerState>> layers;
+        layers.emplace_back(std::make_unique<RequestedLayerState>(args));
+        mLifecycleManager.addLayers(std::move(layers));
+    }
+
+    LayerLifecycleManager mLifecycleManager;
+    LayerHierarchyBuilder mHierarchyBuilder{{}};
+    LayerSnapshotBuilder mSnapshotBuilder;
+    DisplayInfos mDisplayInfos;
+    renderengine::ShadowSettings mGlobalShadowSettings;
+    std::vector<uint32_t> mLeafIds;
+};
+
+// Changes the crop of one leaf every frame, as an animating window would, and
+// updates the snapshots. With `incremental` off, every update walks the whole
+// hierarchy.
+void BM_updateOneLeafPerFrame(benchmark::State& state) {
+    const uint32_t fanout = static_cast<uint32_t>(state.range(0));
+    const bool incremental = state.range(1) != 0;
+    const auto forceUpdate = incremental ? LayerSnapshotBuilder::ForceUpdateFlags::NONE
+                                         : LayerSnapshotBuilder::ForceUpdateFlags::HIERARCHY;
+
+    LayerTree tree(fanout);
+    tree.update(LayerSnapshotBuilder::ForceUpdateFlags::ALL);
+
+    const uint32_t animatedLayerId = tree.leafIds()[tree.leafIds().size() / 2];
+    int32_t offset = 0;
+    for (auto _ : state) {
+        offset = offset >= 100 ? 0 : offset + 1;
+        tree.setCrop(animatedLayerId, Rect(offset, offset, offset + 100, offset + 100));
+        tree.update(forceUpdate);
+    }
+    state.counters["layers"] = static_cast<double>(tree.layerCount());
+}
+
+BENCHMARK(BM_updateOneLeafPerFrame)
+        ->ArgNames({"fanout", "incremental"})
+        ->ArgsProduct({{6, 10, 14}, {0, 1}});
+
+// Visits the visible snapshots in z-order, as done every frame to build the composition
+// layers. A fanout of 8 creates a scene of about 500 layers.
+void BM_forEachVisibleSnapshot(benchmark::State& state) {
+    LayerTree tree(static_cast<uint32_t>(state.range(0)));
+    tree.update(LayerSnapshotBuilder::ForceUpdateFlags::ALL);
+
+    for (auto _ : state) {
+        size_t visibleLayers = 0;
+        tree.snapshotBuilder().forEachVisibleSnapshot(
+                [&visibleLayers](const LayerSnapshot& snapshot) {
+                    visibleLayers += snapshot.hasSomethingToDraw() ? 1 : 0;
+                });
+        benchmark::DoNotOptimize(visibleLayers);
+    }
+    state.counters["layers"] = static_cast<double>(tree.layerCount());
+}
+
+BENCHMARK(BM_forEachVisibleSnapshot)->ArgName("fanout")->Arg(5)->Arg(8);
+
+// Looks up the snapshot of every layer by id.
+void BM_getSnapshot(benchmark::State& state) {
+    LayerTree tree(static_cast<uint32_t>(state.range(0)));
+    tree.update(LayerSnapshotBuilder::ForceUpdateFlags::ALL);
+    const uint32_t layerCount = static_cast<uint32_t>(tree.layerCount());
+
+    for (auto _ : state) {
+        for (uint32_t id = 1; id <= layerCount; id++) {
+            benchmark::DoNotOptimize(tree.snapshotBuilder().getSnapshot(id));
+        }
+    }
+    state.counters["layers"] = static_cast<double>(layerCount);
+}
+
+BENCHMARK(BM_getSnapshot)->ArgName("fanout")->Arg(5)->Arg(8);
+
+} // namespace
+} // namespace android::surfaceflinger::frontend
+
+BENCHMARK_MAIN();
@@ -233,6 +233,78 @@ TEST_F(LayerSnapshotTest, AlphaInheritedByChildren) {
     EXPECT_EQ(getSnapshot(1221)->alpha, 0.25f);
 }
 
+// Incremental updates
+TEST_F(LayerSnapshotTest, changeOnLeafOnlyUpdatesLeaf) {
+    // Every snapshot the walk visits is marked reachable again, so the snapshots marked
+    // unreachable here stay that way only if their subtrees are skipped.
+    for (uint32_t layerId : {111u, 121u, 13u, 2u, 122u, 1221u}) {
+        getSnapshot(layerId)->reachablilty = LayerSnapshot::Reachablilty::Unreachable;
+    }
+
+    Rect crop(1, 2, 3, 4);
+    setCrop(1221, crop);
+    UPDATE_AND_VERIFY(mSnapshotBuilder, STARTING_ZORDER);
+    EXPECT_EQ(getSnapshot(1221)->geomCrop, crop);
+    EXPECT_TRUE(getSnapshot(1221)->changes.test(RequestedLayerState::Changes::Geometry));
+    EXPECT_FALSE(getSnapshot(122)->changes.test(RequestedLayerState::Changes::Geometry));
+    EXPECT_FALSE(getSnapshot(111)->changes.test(RequestedLayerState::Changes::Geometry));
+
+    EXPECT_EQ(getSnapshot(1221)->reachablilty, LayerSnapshot::Reachablilty::Reachable);
+    EXPECT_EQ(getSnapshot(122)->reachablilty, LayerSnapshot::Reachablilty::Reachable);
+    for (uint32_t layerId : {111u, 121u, 13u, 2u}) {
+        EXPECT_EQ(getSnapshot(layerId)->reachablilty, LayerSnapshot::Reachablilty::Unreachable)
+                << "layer " << layerId << " was walked";
+        getSnapshot(layerId)->reachablilty = LayerSnapshot::Reachablilty::Reachable;
+    }
+}
+
+TEST_F(LayerSnapshotTest, changeOnParentUpdatesDirtySubtree) {
+    setAlpha(12, 0.5);
+    UPDATE_AND_VERIFY(mSnapshotBuilder, STARTING_ZORDER);
+    EXPECT_EQ(getSnapshot(1221)->alpha, 0.5f);
+
+    setAlpha(1221, 0.5);
+    UPDATE_AND_VERIFY(mSnapshotBuilder, STARTING_ZORDER);
+    EXPECT_EQ(getSnapshot(12)->alpha, 0.5f);
+    EXPECT_EQ(getSnapshot(1221)->alpha, 0.25f);
+    EXPECT_EQ(getSnapshot(111)->alpha, 1.f);
+}
+
+TEST_F(LayerSnapshotTest, hidingLeafUpdatesZOrder) {
+    hideLayer(111);
+    UPDATE_AND_VERIFY(mSnapshotBuilder, {1, 11, 12, 121, 122, 1221, 13, 2});
+
+    showLayer(111);
+    UPDATE_AND_VERIFY(mSnapshotBuilder, STARTING_ZORDER);
+}
+
+TEST_F(LayerSnapshotTest, changeOnRelativeLayerUpdatesRelativeSubtree) {
+    reparentRelativeLayer(13, 11);
+    UPDATE_AND_VERIFY(mSnapshotBuilder, {1, 11, 13, 111, 12, 121, 122, 1221, 2});
+
+    hideLayer(13);
+    UPDATE_AND_VERIFY(mSnapshotBuilder, {1, 11, 111, 12, 121, 122, 1221, 2});
+
+    showLayer(13);
+    UPDATE_AND_VERIFY(mSnapshotBuilder, {1, 11, 13, 111, 12, 121, 122, 1221, 2});
+
+    hideLayer(11);
+    UPDATE_AND_VERIFY(mSnapshotBuilder, {1, 12, 121, 122, 1221, 2});
+
+    showLayer(11);
+    UPDATE_AND_VERIFY(mSnapshotBuilder, {1, 11, 13, 111, 12, 121, 122, 1221, 2});
+}
+
+TEST_F(LayerSnapshotTest, fastPathChangeIsKeptAcrossIncrementalUpdates) {
+    setColor(111, {1._hf, 0._hf, 0._hf});
+    UPDATE_AND_VERIFY(mSnapshotBuilder, STARTING_ZORDER);
+
+    setCrop(2, Rect(1, 2, 3, 4));
+    UPDATE_AND_VERIFY(mSnapshotBuilder, STARTING_ZORDER);
+    EXPECT_EQ(getSnapshot(111)->color.rgb, half3(1._hf, 0._hf, 0._hf));
+    EXPECT_EQ(getSnapshot(111)->changes.get(), 0u);
+}
+
 // Change states
 TEST_F(LayerSnapshotTest, UpdateClearsPreviousChangeStates) {
     setCrop(1, Rect(1, 2, 3, 4));
@@ -27,6 +27,7 @@
 #include <gtest/gtest.h>
 #include <array>
 #include <limits>
+#include <random>
 
 #include "RegionSamplingThread.h"
 
@@ -106,6 +107,60 @@ TEST_F(RegionSamplingTest, bounds_checking) {
                 testing::Eq(0.0));
 }
 
+// The luma computed one pixel at a time, as it was before it was vectorized.
+float referenceSampleArea(const uint32_t* data, int32_t stride, const Rect& area) {
+    const uint32_t pixelCount = (area.bottom - area.top) * (area.right - area.left);
+    uint32_t accumulatedLuma = 0;
+    for (int32_t row = area.top; row < area.bottom; ++row) {
+        for (int32_t column = area.left; column < area.right; ++column) {
+            const uint32_t pixel = data[row * stride + column];
+            const uint32_t r = pixel & 0xFF;
+            const uint32_t g = (pixel >> 8) & 0xFF;
+            const uint32_t b = (pixel >> 16) & 0xFF;
+            accumulatedLuma += (r * 7 + b * 2 + g * 23) >> 5;
+        }
+    }
+    return accumulatedLuma / (255.0f * pixelCount);
+}
+
+TEST_F(RegionSamplingTest, matches_reference_luma) {
+    std::mt19937 generator(42);
+    std::generate(buffer.begin(), buffer.end(), [&] { return static_cast<uint32_t>(generator()); });
+
+    // Areas of every width up to the whole buffer, at different offsets, so that the vectorized
+    // loop is checked along with the pixels left over after it.
+    for (int32_t width = 1; width <= kWidth; ++width) {
+        const int32_t left = (kWidth - width) * (width % 3) / 2;
+        const Rect area{left, width % 5, left + width, kHeight - width % 7};
+        EXPECT_THAT(sampleArea(buffer.data(), kWidth, kHeight, kStride, kOrientation, area),
+                    testing::FloatEq(referenceSampleArea(buffer.data(), kStride, area)))
+                << "area " << area.left << "," << area.top << "," << area.right << ","
+                << area.bottom;
+    }
+}
+
+TEST_F(RegionSamplingTest, row_step_approximates_luma) {
+    // Rows of the same pixels, shaded from top to bottom.
+    for (int32_t row = 0; row < kHeight; ++row) {
+        for (int32_t column = 0; column < kStride; ++column) {
+            const uint32_t shade = row * 128 / kHeight + column * 127 / kStride;
+            buffer[row * kStride + column] = shade | shade << 8 | (255 - shade) << 16;
+        }
+    }
+
+    const float luma =
+            sampleArea(buffer.data(), kWidth, kHeight, kStride, kOrientation, whole_area);
+    for (int32_t rowStep = 2; rowStep <= 4; ++rowStep) {
+        EXPECT_THAT(sampleArea(buffer.data(), kWidth, kHeight, kStride, kOrientation, whole_area,
+                               rowStep),
+                    testing::FloatNear(luma, 0.02f))
+                << "row step " << rowStep;
+    }
+
+    EXPECT_THAT(sampleArea(buffer.data(), kWidth, kHeight, kStride, kOrientation, whole_area, 0),
+                testing::Eq(0.0));
+}
+
 } // namespace android
 
 // TODO(b/129481165): remove the #pragma below and fix conversion issues
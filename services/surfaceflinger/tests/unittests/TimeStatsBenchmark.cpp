@@ -0,0 +1,104 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <TimeStats/TimeStats.h>
+#include <utils/String16.h>
+#include <utils/Vector.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace {
+
+// Usage: atest libsurfaceflinger_timestats_benchmark
+//
+// Records the timestamps of every layer for each frame, as SurfaceFlinger does on the main thread,
+// and reports the time spent in TimeStats per frame. Frames are paced at the refresh rate, so that
+// the stats are aggregated in the background as they would be on a device.
+
+constexpr int32_t kLayerCount = 60;
+constexpr Fps kRefreshRate = 120_Hz;
+constexpr GameMode kGameMode = GameMode::Unsupported;
+
+void BM_recordFrame(benchmark::State& state, impl::TimeStats::LayerEventMode layerEventMode) {
+    impl::TimeStats timeStats(std::nullopt, std::nullopt, layerEventMode);
+
+    std::string result;
+    Vector<String16> args;
+    args.push_back(String16("-enable"));
+    timeStats.parseArgs(/*asProto*/ false, args, result);
+
+    std::vector<std::string> layerNames;
+    for (int32_t layerId = 0; layerId < kLayerCount; layerId++) {
+        layerNames.push_back("com.example.app/com.example.app.Activity#" +
+                             std::to_string(layerId));
+    }
+
+    const nsecs_t period = kRefreshRate.getPeriodNsecs();
+    const auto framePeriod = std::chrono::nanoseconds(period);
+    uint64_t frameNumber = 0;
+    nsecs_t frameTime = 0;
+
+    for (auto _ : state) {
+        frameNumber++;
+        frameTime += period;
+        // The fences are created by the callers of TimeStats, so outside of the measured time.
+        std::vector<std::shared_ptr<FenceTime>> acquireFences;
+        for (int32_t layerId = 0; layerId < kLayerCount; layerId++) {
+            acquireFences.push_back(std::make_shared<FenceTime>(frameTime + period / 4));
+        }
+        const auto presentFence = std::make_shared<FenceTime>(frameTime + 2 * period);
+
+        const auto start = std::chrono::steady_clock::now();
+        for (int32_t layerId = 0; layerId < kLayerCount; layerId++) {
+            timeStats.setPostTime(layerId, frameNumber, layerNames[layerId], /*uid*/ 10000,
+                                  frameTime, kGameMode);
+            timeStats.setAcquireFence(layerId, frameNumber, acquireFences[layerId]);
+            timeStats.setDesiredTime(layerId, frameNumber, frameTime);
+            timeStats.setLatchTime(layerId, frameNumber, frameTime + period / 2);
+        }
+        for (int32_t layerId = 0; layerId < kLayerCount; layerId++) {
+            timeStats.setPresentFence(layerId, frameNumber, presentFence, kRefreshRate,
+                                      kRefreshRate, {}, kGameMode);
+        }
+        const auto end = std::chrono::steady_clock::now();
+
+        state.SetIterationTime(std::chrono::duration<double>(end - start).count());
+        std::this_thread::sleep_until(start + framePeriod);
+    }
+}
+
+// Five seconds of frames, rather than until the time spent in TimeStats adds up to the minimum
+// benchmark time.
+constexpr int64_t kFrameCount = 600;
+
+BENCHMARK_CAPTURE(BM_recordFrame, synchronous, impl::TimeStats::LayerEventMode::Synchronous)
+        ->UseManualTime()
+        ->Iterations(kFrameCount);
+BENCHMARK_CAPTURE(BM_recordFrame, deferred, impl::TimeStats::LayerEventMode::Deferred)
+        ->UseManualTime()
+        ->Iterations(kFrameCount);
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -30,8 +30,10 @@
 #include <utils/String16.h>
 #include <utils/Vector.h>
 
+#include <array>
 #include <chrono>
 #include <random>
+#include <thread>
 #include <unordered_set>
 
 #include "libsurfaceflinger_unittest_main.h"
@@ -742,6 +744,125 @@ TEST_F(TimeStatsTest, canInsertMultipleLayersTimeStats) {
     EXPECT_EQ(2, globalProto.stats_size());
 }
 
+TEST_F(TimeStatsTest, canInsertLayerTimeStatsFromMultipleThreads) {
+    EXPECT_TRUE(inputCommand(InputCommand::ENABLE, FMT_STRING).empty());
+
+    // Post each buffer from another thread, as binder threads would.
+    for (uint64_t frameNumber = 1; frameNumber <= 3; frameNumber++) {
+        const nsecs_t ts = static_cast<nsecs_t>(frameNumber) * 10000000;
+        std::thread([&] {
+            setTimeStamp(TimeStamp::POST, LAYER_ID_0, frameNumber, ts, {}, kGameMode);
+        }).join();
+        setTimeStamp(TimeStamp::ACQUIRE, LAYER_ID_0, frameNumber, ts + 1000000, {}, kGameMode);
+        setTimeStamp(TimeStamp::LATCH, LAYER_ID_0, frameNumber, ts + 2000000, {}, kGameMode);
+        setTimeStamp(TimeStamp::DESIRED, LAYER_ID_0, frameNumber, ts + 3000000, {}, kGameMode);
+        setTimeStamp(TimeStamp::PRESENT, LAYER_ID_0, frameNumber, ts + 4000000, {}, kGameMode);
+    }
+
+    SFTimeStatsGlobalProto globalProto;
+    ASSERT_TRUE(globalProto.ParseFromString(inputCommand(InputCommand::DUMP_ALL, FMT_PROTO)));
+
+    ASSERT_EQ(1, globalProto.stats_size());
+    const SFTimeStatsLayerProto& layerProto = globalProto.stats(0);
+    EXPECT_EQ(genLayerName(LAYER_ID_0), layerProto.layer_name());
+    EXPECT_EQ(2, layerProto.total_frames());
+}
+
+// Checks that every frame but the first of a layer recorded with NORMAL_SEQUENCE, with frames
+// kFramePeriod apart, was aggregated.
+static void expectNormalFrames(const SFTimeStatsLayerProto& layerProto, uint64_t frameCount) {
+    EXPECT_EQ(static_cast<int32_t>(frameCount) - 1, layerProto.total_frames());
+    ASSERT_EQ(6, layerProto.deltas_size());
+    for (const SFTimeStatsDeltaProto& deltaProto : layerProto.deltas()) {
+        SCOPED_TRACE(deltaProto.delta_name());
+        // A frame aggregated from events applied out of order would fall into another bucket.
+        ASSERT_EQ(1, deltaProto.histograms_size());
+        EXPECT_EQ(static_cast<int32_t>(frameCount) - 1, deltaProto.histograms(0).frame_count());
+    }
+}
+
+constexpr nsecs_t kFramePeriod = 20000000;
+
+TEST_F(TimeStatsTest, canInsertLayerTimeStatsWhenLayerEventRingIsFull) {
+    // Without the thread that applies the events, they are only applied when the ring is full.
+    mTimeStats = std::make_unique<impl::TimeStats>(std::nullopt, std::nullopt,
+                                                   impl::TimeStats::LayerEventMode::
+                                                           DeferredWithoutThread);
+    EXPECT_TRUE(inputCommand(InputCommand::ENABLE, FMT_STRING).empty());
+
+    constexpr uint64_t kFrameCount =
+            2 * impl::TimeStats::kLayerEventRingCapacity / std::size(NORMAL_SEQUENCE) + 1;
+    for (uint64_t frameNumber = 1; frameNumber <= kFrameCount; frameNumber++) {
+        insertTimeRecord(NORMAL_SEQUENCE, LAYER_ID_0, frameNumber,
+                         static_cast<nsecs_t>(frameNumber) * kFramePeriod);
+    }
+
+    SFTimeStatsGlobalProto globalProto;
+    ASSERT_TRUE(globalProto.ParseFromString(inputCommand(InputCommand::DUMP_ALL, FMT_PROTO)));
+
+    ASSERT_EQ(1, globalProto.stats_size());
+    EXPECT_EQ(genLayerName(LAYER_ID_0), globalProto.stats(0).layer_name());
+    expectNormalFrames(globalProto.stats(0), kFrameCount);
+}
+
+TEST_F(TimeStatsTest, canInsertLayerTimeStatsFromConcurrentThreads) {
+    EXPECT_TRUE(inputCommand(InputCommand::ENABLE, FMT_STRING).empty());
+
+    // Each layer posts its buffers from one thread and latches and presents them on another, so
+    // the events of a frame are recorded by two threads, while the other layers record theirs.
+    // Each latching thread records more events than its ring holds.
+    constexpr size_t kLayerCount = 4;
+    constexpr uint64_t kFrameCount =
+            2 * impl::TimeStats::kLayerEventRingCapacity / (std::size(NORMAL_SEQUENCE) - 1) + 1;
+
+    std::atomic<bool> start = false;
+    std::array<std::atomic<uint64_t>, kLayerCount> postedFrames{};
+    std::array<std::atomic<uint64_t>, kLayerCount> presentedFrames{};
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < kLayerCount; i++) {
+        const int32_t layerId = static_cast<int32_t>(i);
+        threads.emplace_back([&, i, layerId] {
+            while (!start) std::this_thread::yield();
+            for (uint64_t frameNumber = 1; frameNumber <= kFrameCount; frameNumber++) {
+                while (presentedFrames[i] != frameNumber - 1) std::this_thread::yield();
+                setTimeStamp(TimeStamp::POST, layerId, frameNumber,
+                             static_cast<nsecs_t>(frameNumber) * kFramePeriod, {}, kGameMode);
+                postedFrames[i] = frameNumber;
+            }
+        });
+        threads.emplace_back([&, i, layerId] {
+            while (!start) std::this_thread::yield();
+            for (uint64_t frameNumber = 1; frameNumber <= kFrameCount; frameNumber++) {
+                while (postedFrames[i] != frameNumber) std::this_thread::yield();
+                nsecs_t ts = static_cast<nsecs_t>(frameNumber) * kFramePeriod;
+                for (size_t step = 1; step < std::size(NORMAL_SEQUENCE); step++) {
+                    ts += 1000000;
+                    setTimeStamp(NORMAL_SEQUENCE[step], layerId, frameNumber, ts, {}, kGameMode);
+                }
+                presentedFrames[i] = frameNumber;
+            }
+        });
+    }
+    start = true;
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    SFTimeStatsGlobalProto globalProto;
+    ASSERT_TRUE(globalProto.ParseFromString(inputCommand(InputCommand::DUMP_ALL, FMT_PROTO)));
+
+    ASSERT_EQ(static_cast<int>(kLayerCount), globalProto.stats_size());
+    std::unordered_set<std::string> layerNames;
+    for (const SFTimeStatsLayerProto& layerProto : globalProto.stats()) {
+        SCOPED_TRACE(layerProto.layer_name());
+        layerNames.insert(layerProto.layer_name());
+        expectNormalFrames(layerProto, kFrameCount);
+    }
+    for (size_t i = 0; i < kLayerCount; i++) {
+        EXPECT_EQ(1u, layerNames.count(genLayerName(static_cast<int32_t>(i))));
+    }
+}
+
 TEST_F(TimeStatsTest, canInsertUnorderedLayerTimeStats) {
     EXPECT_TRUE(inputCommand(InputCommand::ENABLE, FMT_STRING).empty());
 
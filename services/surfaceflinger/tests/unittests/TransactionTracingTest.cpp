@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <android-base/file.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
@@ -334,4 +335,39 @@ TEST(LayerTraceTest, canStreamLayersTrace) {
     // magic?
     EXPECT_EQ(outProto.entry().size(), 3);
 }
+
+// Verify the entries written straight from the ring buffer are parsed in order, after the entries
+// of the file proto, once the buffer wrapped around.
+TEST(LayerTraceTest, ringBufferWritesEntriesInOrder) {
+    RingBuffer<LayersTraceFileProto, LayersTraceProto> buffer;
+    buffer.setSize(256);
+    for (int64_t vsyncId = 1; vsyncId <= 20; vsyncId++) {
+        LayersTraceProto entry;
+        entry.set_vsync_id(vsyncId);
+        entry.set_where("bufferLatched");
+        buffer.emplace(entry);
+    }
+    ASSERT_GT(buffer.frameCount(), 1u);
+    ASSERT_LE(buffer.used(), buffer.size());
+
+    LayersTraceProto back;
+    back.ParseFromString(buffer.back());
+    EXPECT_EQ(back.vsync_id(), 20);
+
+    LayersTraceFileProto fileProto = LayerTracing::createTraceFileProto();
+    fileProto.add_entry()->set_vsync_id(0);
+    TemporaryFile file;
+    ASSERT_EQ(buffer.writeToFile(fileProto, file.path), NO_ERROR);
+
+    std::string output;
+    ASSERT_TRUE(base::ReadFileToString(file.path, &output));
+    LayersTraceFileProto outProto;
+    ASSERT_TRUE(outProto.ParseFromString(output));
+    EXPECT_EQ(outProto.magic_number(), fileProto.magic_number());
+    ASSERT_EQ(outProto.entry().size(), static_cast<int>(buffer.frameCount()) + 1);
+    EXPECT_EQ(outProto.entry(0).vsync_id(), 0);
+    for (int i = 1; i < outProto.entry().size(); i++) {
+        EXPECT_EQ(outProto.entry(i).vsync_id(), 20 - outProto.entry().size() + 1 + i);
+    }
+}
 } // namespace android
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <unordered_map>
+
+#include "FrontEnd/TraversalPathIndex.h"
+
+namespace android::surfaceflinger::frontend {
+
+using TraversalPath = LayerHierarchy::TraversalPath;
+
+namespace {
+
+LayerSnapshot* fakeSnapshot(uintptr_t value) {
+    return reinterpret_cast<LayerSnapshot*>(value);
+}
+
+} // namespace
+
+TEST(TraversalPathIndexTest, findInEmptyIndex) {
+    TraversalPathIndex index;
+    EXPECT_EQ(index.find(TraversalPath{.id = 1}), nullptr);
+    EXPECT_FALSE(index.erase(TraversalPath{.id = 1}));
+}
+
+TEST(TraversalPathIndexTest, clonesHaveTheirOwnEntries) {
+    TraversalPathIndex index;
+    index.insert(TraversalPath{.id = 1}, fakeSnapshot(0x10));
+    index.insert(TraversalPath{.id = 1, .mirrorRootId = 5}, fakeSnapshot(0x20));
+    EXPECT_EQ(index.size(), 2u);
+    EXPECT_EQ(index.find(TraversalPath{.id = 1}), fakeSnapshot(0x10));
+    EXPECT_EQ(index.find(TraversalPath{.id = 1, .mirrorRootId = 5}), fakeSnapshot(0x20));
+    EXPECT_EQ(index.find(TraversalPath{.id = 5}), nullptr);
+
+    // Only the id and the mirror root are part of the key.
+    EXPECT_EQ(index.find(TraversalPath{.id = 1, .variant = LayerHierarchy::Variant::Relative}),
+              fakeSnapshot(0x10));
+}
+
+TEST(TraversalPathIndexTest, insertReplacesExistingEntry) {
+    TraversalPathIndex index;
+    index.insert(TraversalPath{.id = 1}, fakeSnapshot(0x10));
+    index.insert(TraversalPath{.id = 1}, fakeSnapshot(0x20));
+    EXPECT_EQ(index.size(), 1u);
+    EXPECT_EQ(index.find(TraversalPath{.id = 1}), fakeSnapshot(0x20));
+}
+
+TEST(TraversalPathIndexTest, matchesUnorderedMap) {
+    TraversalPathIndex index;
+    std::unordered_map<uint64_t, LayerSnapshot*> expected;
+    uint32_t seed = 1;
+    auto next = [&seed]() {
+        seed = seed * 1103515245 + 12345;
+        return seed >> 8;
+    };
+
+    for (int i = 0; i < 20000; i++) {
+        const TraversalPath path{.id = next() % 500,
+                                 .mirrorRootId = next() % 4 ? UNASSIGNED_LAYER_ID : next() % 8};
+        const uint64_t key = static_cast<uint64_t>(path.mirrorRootId) << 32 | path.id;
+        switch (next() % 3) {
+            case 0: {
+                LayerSnapshot* snapshot = fakeSnapshot(next() | 1);
+                index.insert(path, snapshot);
+                expected[key] = snapshot;
+                break;
+            }
+            case 1:
+                EXPECT_EQ(index.erase(path), expected.erase(key) == 1);
+                break;
+            default: {
+                auto it = expected.find(key);
+                EXPECT_EQ(index.find(path), it == expected.end() ? nullptr : it->second);
+                break;
+            }
+        }
+        ASSERT_EQ(index.size(), expected.size());
+    }
+
+    index.clear();
+    EXPECT_EQ(index.size(), 0u);
+    EXPECT_EQ(index.find(TraversalPath{.id = 1}), nullptr);
+}
+
+} // namespace android::surfaceflinger::frontend
@@ -55,6 +55,7 @@ public:
     bool needsMoreSamples() const final { return false; }
     bool isVSyncInPhase(nsecs_t, Fps) const final { return false; }
     void setRenderRate(Fps) final {}
+    uint64_t modelGeneration() const final { return 0; }
     void dump(std::string&) const final {}
 
 private:
@@ -81,6 +82,7 @@ public:
         std::lock_guard lock(mMutex);
         mPeriod = interval;
         mBase = last_known;
+        mGeneration++;
     }
 
     nsecs_t currentPeriod() const final {
@@ -93,12 +95,19 @@ public:
     bool needsMoreSamples() const final { return false; }
     bool isVSyncInPhase(nsecs_t, Fps) const final { return false; }
     void setRenderRate(Fps) final {}
+
+    uint64_t modelGeneration() const final {
+        std::lock_guard lock(mMutex);
+        return mGeneration;
+    }
+
     void dump(std::string&) const final {}
 
 private:
     std::mutex mutable mMutex;
     nsecs_t mPeriod;
     nsecs_t mBase = 0;
+    uint64_t mGeneration = 0;
 };
 
 struct VSyncDispatchRealtimeTest : testing::Test {
@@ -46,6 +46,8 @@ public:
         ON_CALL(*this, addVsyncTimestamp(_)).WillByDefault(Return(true));
         ON_CALL(*this, currentPeriod())
                 .WillByDefault(Invoke(this, &MockVSyncTracker::getCurrentPeriod));
+        // Tests may change the predictions at any time, so by default the model is never the same.
+        ON_CALL(*this, modelGeneration()).WillByDefault(Invoke([this] { return ++mGeneration; }));
     }
 
     MOCK_METHOD1(addVsyncTimestamp, bool(nsecs_t));
@@ -56,6 +58,7 @@ public:
     MOCK_CONST_METHOD0(needsMoreSamples, bool());
     MOCK_CONST_METHOD2(isVSyncInPhase, bool(nsecs_t, Fps));
     MOCK_METHOD(void, setRenderRate, (Fps), (override));
+    MOCK_CONST_METHOD0(modelGeneration, uint64_t());
     MOCK_CONST_METHOD1(dump, void(std::string&));
 
     nsecs_t nextVSyncTime(nsecs_t timePoint) const {
@@ -69,6 +72,7 @@ public:
 
 protected:
     nsecs_t const mPeriod;
+    mutable uint64_t mGeneration = 0;
 };
 
 class ControllableClock : public TimeKeeper {
@@ -1061,6 +1065,152 @@ TEST_F(VSyncDispatchTimerQueueTest, updatesVsyncTimeForCloseWakeupTime) {
     EXPECT_THAT(cb.mReadyTime[0], Eq(2000));
 }
 
+TEST_F(VSyncDispatchTimerQueueTest, updatesFarCallbacksWhenPeriodChanges) {
+    nsecs_t period = mPeriod;
+    uint64_t generation = 0;
+    ON_CALL(*mStubTracker.get(), nextAnticipatedVSyncTimeFrom(_))
+            .WillByDefault(Invoke([&period](nsecs_t timePoint) {
+                return (timePoint + period - 1) / period * period;
+            }));
+    ON_CALL(*mStubTracker.get(), modelGeneration()).WillByDefault(ReturnPointee(&generation));
+
+    CountingCallback cb0(mDispatch);
+    CountingCallback cb1(mDispatch);
+    CountingCallback cb2(mDispatch);
+
+    mDispatch->schedule(cb0, {.workDuration = 100, .readyDuration = 0, .earliestVsync = 1000});
+    mDispatch->schedule(cb1, {.workDuration = 100, .readyDuration = 0, .earliestVsync = 3000});
+    mDispatch->schedule(cb2, {.workDuration = 700, .readyDuration = 0, .earliestVsync = 3001});
+
+    // With the shorter period, cb2 wakes up at 2500 for the vsync at 3200, before cb1 does, even
+    // though it was scheduled to wake up after cb1.
+    period = 800;
+    generation++;
+
+    Sequence seq;
+    EXPECT_CALL(mMockClock, alarmAt(_, 2500)).InSequence(seq);
+    EXPECT_CALL(mMockClock, alarmAt(_, 3100)).InSequence(seq);
+
+    advanceToNextCallback();
+    ASSERT_THAT(cb0.mCalls.size(), Eq(1));
+    EXPECT_THAT(cb0.mCalls[0], Eq(1000));
+
+    advanceToNextCallback();
+    ASSERT_THAT(cb2.mCalls.size(), Eq(1));
+    EXPECT_THAT(cb2.mCalls[0], Eq(3200));
+    EXPECT_THAT(cb2.mWakeupTime[0], Eq(2500));
+    EXPECT_THAT(cb1.mCalls.size(), Eq(0));
+
+    advanceToNextCallback();
+    ASSERT_THAT(cb1.mCalls.size(), Eq(1));
+    EXPECT_THAT(cb1.mCalls[0], Eq(3200));
+    EXPECT_THAT(cb1.mWakeupTime[0], Eq(3100));
+}
+
+TEST_F(VSyncDispatchTimerQueueTest, doesNotPredictArmedCallbacksAgainWhileModelIsUnchanged) {
+    uint64_t generation = 0;
+    ON_CALL(*mStubTracker.get(), modelGeneration()).WillByDefault(ReturnPointee(&generation));
+
+    CountingCallback cb0(mDispatch);
+    CountingCallback cb1(mDispatch);
+    mDispatch->schedule(cb0, {.workDuration = 100, .readyDuration = 0, .earliestVsync = 1000});
+    mDispatch->schedule(cb1, {.workDuration = 100, .readyDuration = 0, .earliestVsync = 3000});
+
+    // cb1 was predicted when it was scheduled, so the next wakeup is read from the queue.
+    EXPECT_CALL(*mStubTracker.get(), nextAnticipatedVSyncTimeFrom(_)).Times(0);
+    EXPECT_CALL(mMockClock, alarmAt(_, 2900));
+
+    advanceToNextCallback();
+    ASSERT_THAT(cb0.mCalls.size(), Eq(1));
+    EXPECT_THAT(cb0.mCalls[0], Eq(1000));
+    EXPECT_THAT(cb1.mCalls.size(), Eq(0));
+}
+
+TEST_F(VSyncDispatchTimerQueueTest, manyCallbacksOnManyDisplaysRunInOrderWithoutJitter) {
+    // Each display has its own dispatch, with callbacks at various offsets that schedule
+    // themselves for the next vsync when they run, like EventThread and MessageQueue do.
+    constexpr size_t kCallbacksPerDisplay = 32;
+    constexpr size_t kFrames = 20;
+
+    struct Invocation {
+        size_t callback;
+        nsecs_t vsyncTime;
+        nsecs_t wakeupTime;
+        nsecs_t now;
+    };
+
+    struct Display {
+        nsecs_t period;
+        NiceMock<ControllableClock>* clock;
+        std::shared_ptr<VSyncDispatch> dispatch;
+        std::vector<VSyncDispatch::CallbackToken> tokens;
+        std::vector<Invocation> invocations;
+    };
+
+    std::vector<Display> displays;
+    for (const nsecs_t period : {1000, 833, 2000}) {
+        auto clock = std::make_unique<NiceMock<ControllableClock>>();
+        auto& display = displays.emplace_back(Display{.period = period, .clock = clock.get()});
+        display.dispatch =
+                std::make_shared<VSyncDispatchTimerQueue>(std::move(clock),
+                                                          std::make_shared<
+                                                                  NiceMock<MockVSyncTracker>>(
+                                                                  period),
+                                                          mDispatchGroupThreshold,
+                                                          mVsyncMoveThreshold);
+    }
+
+    for (auto& display : displays) {
+        for (size_t i = 0; i < kCallbacksPerDisplay; i++) {
+            const nsecs_t workDuration = 10 + static_cast<nsecs_t>(i * 37) % (display.period - 20);
+            display.tokens.push_back(display.dispatch->registerCallback(
+                    [&display, i, workDuration](nsecs_t vsyncTime, nsecs_t wakeupTime, nsecs_t) {
+                        display.invocations.push_back({i, vsyncTime, wakeupTime,
+                                                       display.clock->fakeTime()});
+                        display.dispatch->schedule(display.tokens[i],
+                                                   {.workDuration = workDuration,
+                                                    .readyDuration = 0,
+                                                    .earliestVsync = vsyncTime + display.period});
+                    },
+                    "stress"));
+            display.dispatch->schedule(display.tokens.back(),
+                                       {.workDuration = workDuration,
+                                        .readyDuration = 0,
+                                        .earliestVsync = display.period});
+        }
+    }
+
+    for (auto& display : displays) {
+        while (display.invocations.size() < kCallbacksPerDisplay * kFrames) {
+            display.clock->advanceToNextCallback();
+        }
+
+        std::vector<std::vector<nsecs_t>> vsyncTimes(kCallbacksPerDisplay);
+        nsecs_t lastWakeupTime = 0;
+        for (const auto& invocation : display.invocations) {
+            // Callbacks run in wakeup order, on time or grouped with an earlier wakeup.
+            EXPECT_LE(lastWakeupTime, invocation.wakeupTime);
+            EXPECT_LE(invocation.now, invocation.wakeupTime);
+            EXPECT_LT(invocation.wakeupTime, invocation.now + mDispatchGroupThreshold);
+            lastWakeupTime = invocation.wakeupTime;
+            vsyncTimes[invocation.callback].push_back(invocation.vsyncTime);
+        }
+
+        // No vsync is missed or repeated.
+        for (const auto& times : vsyncTimes) {
+            ASSERT_FALSE(times.empty());
+            for (size_t frame = 1; frame < times.size(); frame++) {
+                EXPECT_EQ(display.period, times[frame] - times[frame - 1]);
+            }
+        }
+
+        for (const auto token : display.tokens) {
+            display.dispatch->cancel(token);
+            display.dispatch->unregisterCallback(token);
+        }
+    }
+}
+
 class VSyncDispatchTimerQueueEntryTest : public testing::Test {
 protected:
     nsecs_t const mPeriod = 1000;
@@ -0,0 +1,195 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <scheduler/Fps.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "Scheduler/VSyncPredictor.h"
+
+namespace android::scheduler {
+namespace {
+
+// Usage: atest libsurfaceflinger_vsync_predictor_benchmark
+//
+// Replays recorded vsync timestamps into a VSyncPredictor, and reports the error of the vsync
+// predicted for each timestamp, along with the CPU time to add each timestamp to the model.
+
+using Estimator = VSyncPredictor::Estimator;
+
+constexpr PhysicalDisplayId kDisplayId = PhysicalDisplayId::fromPort(42u);
+
+struct Sample {
+    // The timestamp fed to the model, e.g. of a HW vsync or present fence.
+    nsecs_t timestamp;
+    // The actual vsync, which the prediction is compared to.
+    nsecs_t vsync;
+    nsecs_t idealPeriod;
+};
+
+using Recording = std::vector<Sample>;
+
+// Real vsync timestamps from b/190331974, including timestamps very close to each other.
+Recording realTrace60Hz() {
+    constexpr nsecs_t kIdealPeriod = (60_Hz).getPeriodNsecs();
+    const std::vector<nsecs_t> timestamps{
+            198353408177, 198370074844, 198371400000, 198374274000, 198390941000, 198407565000,
+            198540887994, 198607538588, 198624218276, 198657655939, 198674224176, 198690880955,
+            198724204319, 198740988133, 198758166681, 198790869196, 198824205052, 198840871678,
+            198857715631, 198890885797, 198924199640, 198940873834, 198974204401,
+    };
+
+    Recording recording;
+    for (const nsecs_t timestamp : timestamps) {
+        recording.push_back({timestamp, timestamp, kIdealPeriod});
+    }
+    return recording;
+}
+
+struct Noise {
+    // Standard deviation of the jitter of each timestamp.
+    nsecs_t jitter = 0;
+    // Probability that a timestamp is missed, and how late a timestamp is with some probability.
+    float missedProbability = 0.f;
+    float lateProbability = 0.f;
+    nsecs_t lateness = 0;
+};
+
+// Appends noisy timestamps for vsyncs at the given rate. The actual period differs slightly from
+// the ideal one, as it does on real panels.
+void appendVsyncs(Recording& recording, Fps fps, size_t count, const Noise& noise,
+                  std::mt19937& generator) {
+    const nsecs_t idealPeriod = fps.getPeriodNsecs();
+    const nsecs_t period = idealPeriod + idealPeriod / 2000;
+    const nsecs_t start = recording.empty() ? 0 : recording.back().vsync + period;
+
+    std::normal_distribution<double> jitter(0., static_cast<double>(noise.jitter));
+    std::bernoulli_distribution missed(noise.missedProbability);
+    std::bernoulli_distribution late(noise.lateProbability);
+
+    for (size_t i = 0; i < count; i++) {
+        const nsecs_t vsync = start + static_cast<nsecs_t>(i) * period;
+        if (missed(generator)) {
+            continue;
+        }
+        const nsecs_t timestamp = vsync + static_cast<nsecs_t>(jitter(generator)) +
+                (late(generator) ? noise.lateness : 0);
+        recording.push_back({timestamp, vsync, idealPeriod});
+    }
+}
+
+Recording jittery120Hz() {
+    std::mt19937 generator(120);
+    Recording recording;
+    appendVsyncs(recording, 120_Hz, 1000, {.jitter = 50'000, .missedProbability = .02f},
+                 generator);
+    return recording;
+}
+
+Recording lateFences60Hz() {
+    std::mt19937 generator(60);
+    Recording recording;
+    appendVsyncs(recording, 60_Hz, 1000,
+                 {.jitter = 20'000, .lateProbability = .1f, .lateness = 2'000'000}, generator);
+    return recording;
+}
+
+Recording modeSwitches() {
+    std::mt19937 generator(90);
+    Recording recording;
+    for (int i = 0; i < 4; i++) {
+        appendVsyncs(recording, i % 2 ? 90_Hz : 60_Hz, 250, {.jitter = 20'000}, generator);
+    }
+    return recording;
+}
+
+VSyncPredictor makePredictor(Estimator estimator, nsecs_t idealPeriod) {
+    constexpr size_t kHistorySize = 20;
+    constexpr size_t kMinSamplesForPrediction = 6;
+    constexpr uint32_t kDiscardOutlierPercent = 20;
+    return VSyncPredictor(kDisplayId, idealPeriod, kHistorySize, kMinSamplesForPrediction,
+                          kDiscardOutlierPercent, estimator);
+}
+
+template <typename Callback>
+void replay(VSyncPredictor& predictor, const Recording& recording, Callback&& callback) {
+    nsecs_t idealPeriod = recording.front().idealPeriod;
+    for (const Sample& sample : recording) {
+        if (sample.idealPeriod != idealPeriod) {
+            idealPeriod = sample.idealPeriod;
+            predictor.setPeriod(idealPeriod);
+        }
+        callback(sample);
+        predictor.addVsyncTimestamp(sample.timestamp);
+    }
+}
+
+void BM_replay(benchmark::State& state, Recording (*record)(), Estimator estimator) {
+    const Recording recording = record();
+
+    // Predict the vsync of each sample from half a period before it, before adding the sample.
+    nsecs_t totalError = 0;
+    nsecs_t maxError = 0;
+    size_t predictions = 0;
+    {
+        auto predictor = makePredictor(estimator, recording.front().idealPeriod);
+        replay(predictor, recording, [&](const Sample& sample) {
+            if (predictor.needsMoreSamples()) {
+                return;
+            }
+            const nsecs_t prediction =
+                    predictor.nextAnticipatedVSyncTimeFrom(sample.vsync - sample.idealPeriod / 2);
+            const nsecs_t error = std::abs(prediction - sample.vsync);
+            totalError += error;
+            maxError = std::max(maxError, error);
+            predictions++;
+        });
+    }
+
+    for (auto _ : state) {
+        auto predictor = makePredictor(estimator, recording.front().idealPeriod);
+        replay(predictor, recording, [](const Sample&) {});
+        benchmark::DoNotOptimize(predictor.currentPeriod());
+    }
+
+    state.counters["meanErrorUs"] =
+            predictions ? static_cast<double>(totalError) / 1e3 / predictions : 0.;
+    state.counters["maxErrorUs"] = static_cast<double>(maxError) / 1e3;
+    // The CPU time per sample, in seconds.
+    state.counters["timePerSample"] =
+            benchmark::Counter(static_cast<double>(recording.size()),
+                               benchmark::Counter::kIsIterationInvariantRate |
+                                       benchmark::Counter::kInvert);
+}
+
+BENCHMARK_CAPTURE(BM_replay, realTrace60Hz_leastSquares, realTrace60Hz, Estimator::LeastSquares);
+BENCHMARK_CAPTURE(BM_replay, realTrace60Hz_theilSen, realTrace60Hz, Estimator::TheilSen);
+BENCHMARK_CAPTURE(BM_replay, jittery120Hz_leastSquares, jittery120Hz, Estimator::LeastSquares);
+BENCHMARK_CAPTURE(BM_replay, jittery120Hz_theilSen, jittery120Hz, Estimator::TheilSen);
+BENCHMARK_CAPTURE(BM_replay, lateFences60Hz_leastSquares, lateFences60Hz, Estimator::LeastSquares);
+BENCHMARK_CAPTURE(BM_replay, lateFences60Hz_theilSen, lateFences60Hz, Estimator::TheilSen);
+BENCHMARK_CAPTURE(BM_replay, modeSwitches_leastSquares, modeSwitches, Estimator::LeastSquares);
+BENCHMARK_CAPTURE(BM_replay, modeSwitches_theilSen, modeSwitches, Estimator::TheilSen);
+
+} // namespace
+} // namespace android::scheduler
+
+BENCHMARK_MAIN();
@@ -99,6 +99,26 @@ TEST_F(VSyncPredictorTest, reportsSamplesNeededAfterExplicitRateChange) {
     EXPECT_FALSE(tracker.needsMoreSamples());
 }
 
+TEST_F(VSyncPredictorTest, changesModelGenerationWhenPredictionsMayChange) {
+    auto generation = tracker.modelGeneration();
+    const auto expectNewGeneration = [&] {
+        EXPECT_NE(generation, tracker.modelGeneration());
+        generation = tracker.modelGeneration();
+    };
+
+    tracker.addVsyncTimestamp(mNow += mPeriod);
+    expectNewGeneration();
+    tracker.setPeriod(mPeriod * 2);
+    expectNewGeneration();
+    tracker.setRenderRate(Fps::fromPeriodNsecs(mPeriod * 4));
+    expectNewGeneration();
+    tracker.resetModel();
+    expectNewGeneration();
+
+    tracker.nextAnticipatedVSyncTimeFrom(mNow);
+    EXPECT_EQ(generation, tracker.modelGeneration());
+}
+
 TEST_F(VSyncPredictorTest, transitionsToModelledPointsAfterSynthetic) {
     auto last = mNow;
     auto const bias = 10;
@@ -557,6 +577,93 @@ TEST_F(VSyncPredictorTest, robustToDuplicateTimestamps_60hzRealTraceData) {
     EXPECT_THAT(intercept, IsCloseTo(expectedIntercept, mMaxRoundingError));
 }
 
+TEST_F(VSyncPredictorTest, toleratesMissedVsyncs) {
+    auto const realPeriod = 1010;
+    for (auto i = 0; i < 3 * kHistorySize; i++) {
+        // Every third vsync is missed.
+        if (i % 3 != 2) {
+            EXPECT_TRUE(tracker.addVsyncTimestamp(i * realPeriod));
+        }
+    }
+
+    auto [slope, intercept] = tracker.getVSyncPredictionModel();
+    EXPECT_THAT(slope, Eq(realPeriod));
+    EXPECT_THAT(intercept, Eq(0));
+    auto const last = (3 * kHistorySize - 2) * realPeriod;
+    EXPECT_THAT(tracker.nextAnticipatedVSyncTimeFrom(last + 10), Eq(last + realPeriod));
+    EXPECT_THAT(tracker.nextAnticipatedVSyncTimeFrom(last + realPeriod + 10),
+                Eq(last + 2 * realPeriod));
+}
+
+TEST_F(VSyncPredictorTest, usesPriorPeriodForRateWhileCollectingSamples) {
+    auto const realPeriod = 1010;
+    for (auto i = 0u; i < kMinimumSamplesForPrediction; i++) {
+        tracker.addVsyncTimestamp(mNow += realPeriod);
+    }
+    EXPECT_THAT(tracker.getVSyncPredictionModel().slope, Eq(realPeriod));
+
+    tracker.setPeriod(mPeriod * 2);
+    tracker.setPeriod(mPeriod);
+
+    // The period learned for this rate is kept until there are enough samples for a new model,
+    // rather than falling back to the ideal period.
+    tracker.addVsyncTimestamp(mNow += realPeriod);
+    EXPECT_TRUE(tracker.needsMoreSamples());
+    EXPECT_THAT(tracker.getVSyncPredictionModel().slope, Eq(realPeriod));
+    EXPECT_THAT(tracker.nextAnticipatedVSyncTimeFrom(mNow + 10), Eq(mNow + realPeriod));
+}
+
+TEST_F(VSyncPredictorTest, theilSenIgnoresNoisyTimestamps) {
+    VSyncPredictor leastSquaresTracker{DEFAULT_DISPLAY_ID, mPeriod, 20,
+                                       kMinimumSamplesForPrediction, kOutlierTolerancePercent};
+    VSyncPredictor theilSenTracker{DEFAULT_DISPLAY_ID,
+                                   mPeriod,
+                                   20,
+                                   kMinimumSamplesForPrediction,
+                                   kOutlierTolerancePercent,
+                                   VSyncPredictor::Estimator::TheilSen};
+    for (auto i = 0; i < 20; i++) {
+        // A fifth of the timestamps are late, like a present fence signaled after a busy frame.
+        auto const timestamp = i * mPeriod + (i % 5 == 4 ? 150 : 0);
+        leastSquaresTracker.addVsyncTimestamp(timestamp);
+        theilSenTracker.addVsyncTimestamp(timestamp);
+    }
+
+    auto const leastSquares = leastSquaresTracker.getVSyncPredictionModel();
+    EXPECT_THAT(leastSquares.slope, Ne(mPeriod));
+    EXPECT_THAT(leastSquares.intercept, Ne(0));
+
+    auto const theilSen = theilSenTracker.getVSyncPredictionModel();
+    EXPECT_THAT(theilSen.slope, Eq(mPeriod));
+    EXPECT_THAT(theilSen.intercept, Eq(0));
+}
+
+TEST_F(VSyncPredictorTest, theilSenFitsRealTraceData) {
+    VSyncPredictor tracker{DEFAULT_DISPLAY_ID,
+                           mPeriod,
+                           kHistorySize,
+                           kMinimumSamplesForPrediction,
+                           kOutlierTolerancePercent,
+                           VSyncPredictor::Estimator::TheilSen};
+    std::vector<nsecs_t> const simulatedVsyncs{
+            198353408177, 198370074844, 198371400000, 198374274000, 198390941000, 198407565000,
+            198540887994, 198607538588, 198624218276, 198657655939, 198674224176, 198690880955,
+            198724204319, 198740988133, 198758166681, 198790869196, 198824205052, 198840871678,
+            198857715631, 198890885797, 198924199640, 198940873834, 198974204401,
+    };
+    auto constexpr idealPeriod = 16'666'666;
+    auto constexpr expectedPeriod = 16'665'283;
+    auto constexpr expectedIntercept = -97'694;
+
+    tracker.setPeriod(idealPeriod);
+    for (auto const& timestamp : simulatedVsyncs) {
+        tracker.addVsyncTimestamp(timestamp);
+    }
+    auto [slope, intercept] = tracker.getVSyncPredictionModel();
+    EXPECT_THAT(slope, IsCloseTo(expectedPeriod, mMaxRoundingError));
+    EXPECT_THAT(intercept, IsCloseTo(expectedIntercept, mMaxRoundingError));
+}
+
 TEST_F(VSyncPredictorTest, setRenderRateIsRespected) {
     auto last = mNow;
     for (auto i = 0u; i < kMinimumSamplesForPrediction; i++) {
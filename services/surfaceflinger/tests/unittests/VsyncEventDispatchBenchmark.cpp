@@ -0,0 +1,206 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <gui/DisplayEventReceiver.h>
+#include <private/gui/BitTube.h>
+#include <private/gui/VsyncEventRing.h>
+
+#include <poll.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace {
+
+// Usage: atest libsurfaceflinger_vsync_dispatch_benchmark
+
+using namespace std::chrono_literals;
+using Event = DisplayEventReceiver::Event;
+
+Event makeVsync(uint32_t count) {
+    Event event{};
+    event.header.type = DisplayEventReceiver::DISPLAY_EVENT_VSYNC;
+    event.header.timestamp = count;
+    event.vsync.count = count;
+    return event;
+}
+
+// Records when the last reader received the event of the current iteration.
+class Completion {
+public:
+    explicit Completion(size_t readerCount) : mReaderCount(readerCount) {}
+
+    void reset() {
+        std::lock_guard lock(mMutex);
+        mReceived = 0;
+        mDone = false;
+    }
+
+    void onReceived() {
+        if (mReceived.fetch_add(1) + 1 == mReaderCount) {
+            std::lock_guard lock(mMutex);
+            mLastReceived = std::chrono::steady_clock::now();
+            mDone = true;
+            mCondition.notify_one();
+        }
+    }
+
+    std::chrono::steady_clock::time_point wait() {
+        std::unique_lock lock(mMutex);
+        mCondition.wait(lock, [this] { return mDone; });
+        return mLastReceived;
+    }
+
+private:
+    const size_t mReaderCount;
+    std::atomic<size_t> mReceived = 0;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    bool mDone = false;
+    std::chrono::steady_clock::time_point mLastReceived;
+};
+
+// Mirrors EventThread writing the event to the BitTube of each connection, with one thread per
+// client waiting on its socket.
+class BitTubeDispatcher {
+public:
+    BitTubeDispatcher(size_t connectionCount, Completion& completion) {
+        for (size_t i = 0; i < connectionCount; i++) {
+            mTubes.push_back(std::make_unique<gui::BitTube>(gui::BitTube::DefaultSize));
+        }
+        for (auto& tube : mTubes) {
+            mReaders.emplace_back([this, &tube = *tube, &completion] {
+                pollfd fd{.fd = tube.getFd(), .events = POLLIN, .revents = 0};
+                Event event;
+                while (true) {
+                    poll(&fd, 1, -1);
+                    while (DisplayEventReceiver::getEvents(&tube, &event, 1) == 1) {
+                        if (mStop) {
+                            return;
+                        }
+                        completion.onReceived();
+                    }
+                }
+            });
+        }
+    }
+
+    ~BitTubeDispatcher() {
+        mStop = true;
+        dispatch(makeVsync(0));
+        for (auto& reader : mReaders) {
+            reader.join();
+        }
+    }
+
+    void dispatch(const Event& event) {
+        for (auto& tube : mTubes) {
+            DisplayEventReceiver::sendEvents(tube.get(), &event, 1);
+        }
+    }
+
+private:
+    std::vector<std::unique_ptr<gui::BitTube>> mTubes;
+    std::vector<std::thread> mReaders;
+    std::atomic<bool> mStop = false;
+};
+
+// Publishes the event once to a VsyncEventRing, with one thread per client waiting on the ring.
+class RingDispatcher {
+public:
+    RingDispatcher(size_t connectionCount, Completion& completion)
+          : mWriter(gui::VsyncEventRing::create()), mReaderIndices(connectionCount) {
+        std::iota(mReaderIndices.begin(), mReaderIndices.end(), size_t{0});
+        for (size_t index : mReaderIndices) {
+            mRings.push_back(gui::VsyncEventRing::map(mWriter->dupFd()));
+            mReaders.emplace_back([this, &ring = *mRings.back(), index, &completion] {
+                uint64_t lastSequence = 0;
+                Event event;
+                while (true) {
+                    ring.waitForEvent(lastSequence, 1s);
+                    if (mStop) {
+                        return;
+                    }
+                    if (ring.readLatest(index, &lastSequence, &event)) {
+                        completion.onReceived();
+                    }
+                }
+            });
+        }
+    }
+
+    ~RingDispatcher() {
+        mStop = true;
+        dispatch(makeVsync(0));
+        for (auto& reader : mReaders) {
+            reader.join();
+        }
+    }
+
+    void dispatch(const Event& event) { mWriter->publish(event, mReaderIndices); }
+
+private:
+    const std::unique_ptr<gui::VsyncEventRing> mWriter;
+    // Each client maps the ring on its own, as it would in its own process.
+    std::vector<std::unique_ptr<gui::VsyncEventRing>> mRings;
+    std::vector<size_t> mReaderIndices;
+    std::vector<std::thread> mReaders;
+    std::atomic<bool> mStop = false;
+};
+
+// Measures the time from dispatching a vsync event until the last connection received it.
+template <typename Dispatcher>
+void BM_dispatchVsync(benchmark::State& state) {
+    const size_t connectionCount = static_cast<size_t>(state.range(0));
+    Completion completion(connectionCount);
+    Dispatcher dispatcher(connectionCount, completion);
+
+    uint32_t count = 0;
+    for (auto _ : state) {
+        completion.reset();
+        const auto start = std::chrono::steady_clock::now();
+        dispatcher.dispatch(makeVsync(++count));
+        const auto lastReceived = completion.wait();
+        state.SetIterationTime(std::chrono::duration<double>(lastReceived - start).count());
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_dispatchVsync, BitTubeDispatcher)
+        ->ArgName("connections")
+        ->Arg(10)
+        ->Arg(100)
+        ->Arg(500)
+        ->UseManualTime();
+BENCHMARK_TEMPLATE(BM_dispatchVsync, RingDispatcher)
+        ->ArgName("connections")
+        ->Arg(10)
+        ->Arg(100)
+        ->Arg(500)
+        ->UseManualTime();
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -47,6 +47,11 @@ public:
     MOCK_METHOD(void, requestNextVsync, (const sp<android::EventThreadConnection>&), (override));
     MOCK_METHOD(VsyncEventData, getLatestVsyncEventData,
                 (const sp<android::EventThreadConnection>&), (const, override));
+    MOCK_METHOD(status_t, getVsyncEventRing,
+                (const sp<android::EventThreadConnection>&, base::unique_fd*, size_t*),
+                (override));
+    MOCK_METHOD(status_t, enableVsyncEventRing, (const sp<android::EventThreadConnection>&),
+                (override));
     MOCK_METHOD(void, requestLatestConfig, (const sp<android::EventThreadConnection>&));
     MOCK_METHOD(void, pauseVsyncCallback, (bool));
     MOCK_METHOD(size_t, getEventThreadConnectionCount, (), (override));
@@ -35,6 +35,7 @@ public:
     MOCK_CONST_METHOD0(needsMoreSamples, bool());
     MOCK_CONST_METHOD2(isVSyncInPhase, bool(nsecs_t, Fps));
     MOCK_METHOD(void, setRenderRate, (Fps), (override));
+    MOCK_CONST_METHOD0(modelGeneration, uint64_t());
     MOCK_CONST_METHOD1(dump, void(std::string&));
 };
 